@@ -9,18 +9,31 @@
  */
 
 #include <string>
+#include <vector>
 
 #include <media_source_handler.hpp>
 #include "http_server.hpp"
 #include <format/raw/tmss_format_raw.hpp>
 #include <format/ffmpeg/tmss_format_base.hpp>
+#include <format/flv/tmss_format_flv.hpp>
 #include <transport/tmss_trans_tcp.hpp>
+#include <transport/tmss_trans_uring.hpp>
 #include <log/log.hpp>
 #include <util/timer.hpp>
+#include <util/util.hpp>
 #include <protocol/http/http_client.hpp>
+#include <protocol/http/http_stack.hpp>
 #include <protocol/rtmp/rtmp_client.hpp>
+#include <protocol/srt/srt_client.hpp>
+#include <protocol/srt/srt_server.hpp>
+#include <srt_api_handler.hpp>
 
 namespace tmss {
+// the cached files larger than it are on disk, if the disk dir is set
+const int file_disk_min_size = 4 * 1024 * 1024;
+// the aggregate messages to rtmp upstreams, if forward_aggregate is set
+const int forward_aggregate_size = 64 * 1024;
+
 int MediaSource::handle_connect(std::shared_ptr<IClientConn> conn) {
     int ret = error_success;
 
@@ -112,7 +125,8 @@ MediaSource::~MediaSource() {
     }
 }
 
-int parse_params(int num, char** param, int &port) {
+int parse_params(int num, char** param, int &port, int &workers, bool &cpu_steering,
+        int &srt_port, bool &use_uring, std::string &disk_dir, int &keep_alive_ms) {
     std::string temp;
     for (int i = 1; i < num; i++) {
         char* p = param[i];
@@ -143,6 +157,63 @@ int parse_params(int num, char** param, int &port) {
                         continue;
                     }
                     return -1;
+                case 'w':
+                case 'W':
+                    // the threads of listener group, 0 is the cpu count
+                    if (*p) {
+                        workers = atoi(p);
+                        continue;
+                    }
+                    if (param[++i]) {
+                        workers = atoi(param[i]);
+                        continue;
+                    }
+                    return -1;
+                case 's':
+                case 'S':
+                    cpu_steering = true;
+                    continue;
+                case 'i':
+                case 'I':
+                    // the http connections on io_uring
+                    use_uring = true;
+                    continue;
+                case 'd':
+                case 'D':
+                    // the dir of the cached files on disk
+                    if (*p) {
+                        disk_dir = p;
+                        continue;
+                    }
+                    if (param[++i]) {
+                        disk_dir = param[i];
+                        continue;
+                    }
+                    return -1;
+                case 'k':
+                case 'K':
+                    // the idle timeout of keep-alive http connections, in seconds
+                    if (*p) {
+                        keep_alive_ms = atoi(p) * 1000;
+                        continue;
+                    }
+                    if (param[++i]) {
+                        keep_alive_ms = atoi(param[i]) * 1000;
+                        continue;
+                    }
+                    return -1;
+                case 'u':
+                case 'U':
+                    // the srt port over udp
+                    if (*p) {
+                        srt_port = atoi(p);
+                        continue;
+                    }
+                    if (param[++i]) {
+                        srt_port = atoi(param[i]);
+                        continue;
+                    }
+                    return -1;
                 default:
                     break;
             }
@@ -159,29 +230,112 @@ int MediaSource::init(int num, char** param) {
     int ret = error_success;
     std::string ip = "127.0.0.1";
     int port = 8002;
+    // no listener group, accept on this thread
+    int workers = -1;
+    bool cpu_steering = false;
+    // no srt server if not set
+    int srt_port = 0;
+    bool use_uring = false;
+    // the cached files are in memory if not set
+    std::string disk_dir;
+    // the default idle timeout of http server if not set
+    int keep_alive_ms = 0;
     tmss_info("there are {} params", num);
-    parse_params(num, param, port);
+    parse_params(num, param, port, workers, cpu_steering, srt_port, use_uring, disk_dir, keep_alive_ms);
+    if (workers >= 0 && srt_port > 0) {
+        // each worker has its own channels, the srt streams can not reach the http viewers of workers
+        ret = error_config_conflict;
+        tmss_error("the srt server (-u) can not run with the listener group (-w), ret={}", ret);
+        return ret;
+    }
     // load config
     // different server can share the same channel or file
     std::shared_ptr<ChannelPool> channel_pool = std::make_shared<ChannelPool>();
     channel_pool->start();
     std::shared_ptr<FileCache> file_cache = std::make_shared<FileCache>();
-
-    // http server over tcp
-    auto server_conn = std::make_shared<TcpServerConn>();
-    std::shared_ptr<IServer> server = std::make_shared<HttpServer>(server_conn, channel_pool, file_cache);
-    ret = server->init(ip, port);
-    if (ret != error_success) {
-        tmss_error("http_server init failed, ret={}", ret);
-        return ret;
+    if (!disk_dir.empty()) {
+        file_cache->set_disk_dir(disk_dir, file_disk_min_size);
     }
-    ret = server->run();
-    if (ret != error_success) {
-        tmss_error("http_server run failed, ret={}", ret);
-        return ret;
+
+    if (workers >= 0) {
+        listener_group = std::make_shared<ListenerGroup>();
+        listener_group->set_uring(use_uring);
+        ret = listener_group->init(ip, port, workers, cpu_steering);
+        if (ret != error_success) {
+            tmss_error("listener_group init failed, ret={}", ret);
+            return ret;
+        }
+        std::shared_ptr<MediaSource> self = shared_from_this();
+        ret = listener_group->run([self, disk_dir, keep_alive_ms](std::shared_ptr<IServerConn> server_conn) {
+            // each st thread has its own channels and http mux
+            std::shared_ptr<ChannelPool> channel_pool = std::make_shared<ChannelPool>();
+            channel_pool->start();
+            std::shared_ptr<FileCache> file_cache = std::make_shared<FileCache>();
+            if (!disk_dir.empty()) {
+                file_cache->set_disk_dir(disk_dir, file_disk_min_size);
+            }
+            HttpMux::get_instance()->register_handler("/", 0, self);
+            HttpMux::get_instance()->register_handler("/api/srt", 1,
+                std::make_shared<SrtApiHandler>());
+            std::shared_ptr<HttpServer> http_server =
+                std::make_shared<HttpServer>(server_conn, channel_pool, file_cache);
+            if (keep_alive_ms > 0) {
+                http_server->set_keep_alive_timeout(keep_alive_ms);
+            }
+            return std::static_pointer_cast<IServer>(http_server);
+        });
+        if (ret != error_success) {
+            tmss_error("listener_group run failed, ret={}", ret);
+            return ret;
+        }
+    } else {
+        // http server over tcp
+        std::shared_ptr<IServerConn> server_conn;
+        if (use_uring && StUring::get_instance()) {
+            server_conn = std::make_shared<UringServerConn>();
+        } else {
+            if (use_uring) {
+                tmss_warn("no io_uring, http server on st epoll");
+            }
+            server_conn = std::make_shared<TcpServerConn>();
+        }
+        std::shared_ptr<HttpServer> server = std::make_shared<HttpServer>(server_conn, channel_pool, file_cache);
+        if (keep_alive_ms > 0) {
+            server->set_keep_alive_timeout(keep_alive_ms);
+        }
+        ret = server->init(ip, port);
+        if (ret != error_success) {
+            tmss_error("http_server init failed, ret={}", ret);
+            return ret;
+        }
+        ret = server->run();
+        if (ret != error_success) {
+            tmss_error("http_server run failed, ret={}", ret);
+            return ret;
+        }
+
+        server_group.push_back(server);
     }
 
-    server_group.push_back(server);
+    // srt server, the mpeg-ts streams are in the same channels of http
+    if (srt_port > 0) {
+        auto srt_server_conn = std::make_shared<SRTServerConn>(ST_SRT_MODE_LIVE);
+        std::shared_ptr<SrtServer> srt_server =
+            std::make_shared<SrtServer>(srt_server_conn, channel_pool, file_cache);
+        srt_server->set_user_handler(shared_from_this());
+        ret = srt_server->init(ip, srt_port);
+        if (ret != error_success) {
+            tmss_error("srt_server init failed, ret={}", ret);
+            return ret;
+        }
+        ret = srt_server->run();
+        if (ret != error_success) {
+            tmss_error("srt_server run failed, ret={}", ret);
+            return ret;
+        }
+
+        server_group.push_back(srt_server);
+    }
     // other servers
 
     tmss_info("init success");
@@ -211,6 +365,15 @@ int MediaSource::handle_play_stream(std::shared_ptr<IClientConn> conn,
         std::shared_ptr<Request> req,
         std::shared_ptr<IServer> server) {
     int ret = error_success;
+    std::shared_ptr<HttpRequest> http_req = std::dynamic_pointer_cast<HttpRequest>(req);
+    if (http_req && http_req->websocket_upgrade) {
+        // ws-flv/ws-ts, only the live stream is served over websocket
+        ret = HttpMux::get_instance()->upgrade_websocket(conn, http_req);
+        if (ret != error_success) {
+            tmss_error("upgrade websocket failed, ret={}", ret);
+            return ret;
+        }
+    }
     // get or create Channel
     std::string stream_key = create_channel_key(req);
     tmss_info("handle_play_stream,stream_key={}", stream_key.c_str());
@@ -225,11 +388,31 @@ int MediaSource::handle_play_stream(std::shared_ptr<IClientConn> conn,
 
     // create mux based on request
     std::shared_ptr<IMux> muxer = create_mux_by_ext(req->ext);
+    if (req->ext == "flv" && (req->params_map["origin_protocol"] == "rtmp"
+            || channel->is_flv_tag_input())) {
+        // the rtmp messages or the published flv tags, no need to remux
+        muxer = std::make_shared<FlvTagMux>();
+    }
     std::shared_ptr<IContext> context = create_context_by_ext(req->ext);
     output->init_format(muxer);
-    std::shared_ptr<HttpClient> client = std::make_shared<HttpClient>();
-    client->init(conn);
-    output->init_play_client(client);
+    std::shared_ptr<IClient> play_client;
+    if (std::dynamic_pointer_cast<SrtRequest>(req)) {
+        // the mux output is sent as srt messages, no response header
+        play_client = std::make_shared<SrtClient>();
+        play_client->init(conn);
+    } else {
+        std::shared_ptr<HttpClient> client = std::make_shared<HttpClient>();
+        client->init(conn);
+        // the live stream has no length, use chunked to keep the response framed
+        client->set_response_info(CHttp::getContentType(req->ext), req->keep_alive);
+        if (http_req && http_req->websocket) {
+            // the same mux output in websocket frames
+            client->set_websocket();
+            http_req->websocket_client = client;
+        }
+        play_client = client;
+    }
+    output->init_play_client(play_client);
     output->set_context(context);
 
     output->set_type(EOutputPlay);
@@ -254,6 +437,8 @@ int MediaSource::handle_play_stream(std::shared_ptr<IClientConn> conn,
     }
 
     output->run();
+    // the output writes to the connection until it closes
+    req->streaming = true;
 
     tmss_info("handle_play_stream");
 
@@ -264,6 +449,17 @@ int MediaSource::handle_publish(std::shared_ptr<IClientConn> conn,
         std::shared_ptr<Request> req,
         std::shared_ptr<IServer> server) {
     int ret = error_success;
+    if (listener_group) {
+        // each worker has its own channels, the pushed stream can not reach the viewers of others
+        std::string response;
+        CHttp http;
+        http.buildResponseHeader(403, "", 0, false, false, response);
+        conn->write(response.c_str(), response.length());
+        ret = error_config_conflict;
+        tmss_error("the publish can not run with the listener group (-w), ret={}", ret);
+        return ret;
+    }
+    req->format = req->ext;
     // get or create Channel
     std::string stream_key = create_channel_key(req);
 
@@ -275,21 +471,52 @@ int MediaSource::handle_publish(std::shared_ptr<IClientConn> conn,
     std::shared_ptr<Pool<InputHandler>> input_pool = server->get_input_pool();
     std::shared_ptr<InputHandler> input = std::make_shared<InputHandler>(input_pool, channel);
 
-    // check req->format
-    std::shared_ptr<IDeMux> demuxer = std::make_shared<RawDeMux>();
+    // the pushed flv/ts body is demuxed as the origin pull
+    std::shared_ptr<IDeMux> demuxer = create_demux_by_format(req->format);
+    if (req->format == "flv" && !req->params_map["forward_rtmp"].empty()) {
+        // the rtmp forward relays the flv tags, parse them without libavformat
+        demuxer = std::make_shared<FlvTagDeMux>();
+        channel->set_flv_tag_input(true);
+    }
+    std::shared_ptr<IContext> context = create_context_by_format(req->format);
+
+    // the client reads the body, decode the chunked body
+    std::shared_ptr<IClient> client;
+    std::shared_ptr<HttpRequest> http_req = std::dynamic_pointer_cast<HttpRequest>(req);
+    if (http_req) {
+        std::shared_ptr<HttpClient> http_client = std::make_shared<HttpClient>();
+        http_client->init(conn);
+        ret = http_client->set_request_body(http_req->body, http_req->content_length, http_req->chunked);
+        if (ret != error_success) {
+            tmss_error("set request body failed, ret={}", ret);
+            return ret;
+        }
+        client = http_client;
+    } else {
+        // srt, the ts packets in messages
+        client = std::make_shared<SrtClient>();
+        client->init(conn);
+    }
+
     input->init_format(demuxer);
     input->init_conn(conn);
-
-    std::shared_ptr<IContext> context = std::make_shared<IContext>();
+    input->init_origin_client(client);
     input->set_context(context);
     input->set_type(EInputPublish);
+    input->init_input();
+
+    // check if it need forward
+    ret = create_forward(channel, req, server);
+    if (ret != error_success) {
+        tmss_error("create forward failed, ret={}", ret);
+        return ret;
+    }
 
     channel->add_input(input);
 
     input->run();
-
-    // check if it need forward
-    create_forward(channel, req, server);
+    // the input reads from the connection until it closes
+    req->detached = true;
 
     // start channel
     channel->run();
@@ -312,7 +539,11 @@ int MediaSource::handle_api(std::shared_ptr<IClientConn> conn,
     create_origin_stream(channel, req, server);
 
     // get or create output
-    create_forward(channel, req, server);
+    ret = create_forward(channel, req, server);
+    if (ret != error_success) {
+        tmss_error("create forward failed, ret={}", ret);
+        return ret;
+    }
 
     // start channel
     channel->run();
@@ -349,10 +580,21 @@ int MediaSource::create_origin_stream(std::shared_ptr<Channel> channel,
 
     // check req->format
     std::string origin_format = "flv";    //  to do
+    std::string origin_ext = origin_format;
+    int origin_port = 80;
+    std::shared_ptr<IClient> origin_client;
+    if (req->params_map["origin_protocol"] == "rtmp") {
+        // the rtmp messages are demuxed to flv tags directly
+        origin_format = "rtmp";
+        origin_ext = "";
+        origin_port = atoll(CONSTS_RTMP_DEFAULT_PORT);
+        origin_client = std::make_shared<RtmpClient>();
+    } else {
+        origin_client = std::make_shared<HttpClient>();
+    }
     std::shared_ptr<IContext> context = create_context_by_format(origin_format);
     std::shared_ptr<IDeMux> demuxer = create_demux_by_format(origin_format);
 
-    std::shared_ptr<HttpClient> origin_client = std::make_shared<HttpClient>();
     origin_client->init(origin_conn);
     input->init_format(demuxer);
     input->init_conn(origin_conn);
@@ -364,17 +606,20 @@ int MediaSource::create_origin_stream(std::shared_ptr<Channel> channel,
     if (req->params_map["origin_host"].length() > 0) {
         origin_ip = req->params_map["origin_host"];
     }
-    int origin_port = 80;
     if (req->params_map["origin_port"].length() > 0) {
         origin_port = atoll(req->params_map["origin_port"].c_str());
     }
     if (req->params_map["origin_param"] == "no") {
         param = "";
     }
-    tmss_info("origin_host={}, origin_ip={}, origin_port={}", origin_ip, origin_ip, origin_port);
+    tmss_info("origin_host={}, origin_ip={}, origin_port={}", origin_host, origin_ip, origin_port);
     Address address(origin_ip, origin_port);
     //  input->set_origin_address(address);
-    input->set_origin_info(address, origin_host, origin_path, stream, origin_format, param);
+    input->set_origin_info(address, origin_host, origin_path, stream, origin_ext, param);
+    // origin_host may be several origins, a.com,b.com:8080, the input fails over among them
+    std::shared_ptr<OriginGroup> origin_group = OriginGroup::fetch(origin_host);
+    origin_group->set_origins(origin_ip, origin_port);
+    input->set_origin_group(origin_group);
 
     channel->add_input(input);
 
@@ -391,10 +636,92 @@ int MediaSource::create_origin_stream(std::shared_ptr<Channel> channel,
     return ret;
 }
 
+int MediaSource::create_rtmp_forward(std::shared_ptr<Channel> channel,
+        std::shared_ptr<Request> req,
+        std::shared_ptr<IServer> server,
+        const std::string& forward_host) {
+    int ret = error_success;
+    std::string host = forward_host;
+    int port = atoll(CONSTS_RTMP_DEFAULT_PORT);
+    std::size_t found = host.find(":");
+    if (found != std::string::npos) {
+        port = atoll(host.substr(found + 1).c_str());
+        host = host.substr(0, found);
+    }
+    if (host.empty() || port <= 0) {
+        ret = error_rtmp_no_request;
+        tmss_error("invalid forward host={}, ret={}", forward_host, ret);
+        return ret;
+    }
+
+    std::string app = req->path;
+    while (!app.empty() && app.front() == '/') {
+        app.erase(0, 1);
+    }
+    while (!app.empty() && app.back() == '/') {
+        app.pop_back();
+    }
+    std::string stream = req->name;
+    found = stream.find(".");
+    if (found != std::string::npos) {
+        stream = stream.substr(0, found);
+    }
+
+    // the packets are shared by all outputs of channel, no copy for forward
+    std::shared_ptr<IClientConn> forward_conn = std::make_shared<TcpStreamConn>(nullptr);
+    std::shared_ptr<Pool<OutputHandler>> output_pool = server->get_output_pool();
+    std::shared_ptr<OutputHandler> output = std::make_shared<OutputHandler>(output_pool, channel);
+    output->init_conn(forward_conn);
+    std::shared_ptr<RtmpMux> muxer = std::make_shared<RtmpMux>();
+    // forward_aggregate=max delay ms, merge the audio/video between our tiers
+    int aggregate_delay_ms = atoi(req->params_map["forward_aggregate"].c_str());
+    if (aggregate_delay_ms > 0) {
+        muxer->set_aggregate_output(forward_aggregate_size, aggregate_delay_ms);
+    }
+    output->init_format(muxer);
+
+    std::string forward_url = "rtmp://" + host + ":" + std::to_string(port)
+        + "/" + app + "/" + stream;
+    Address address(host, port);
+    output->set_forward_address(address);
+    output->set_forward_url(forward_url);
+    output->set_context(std::make_shared<IContext>());
+    output->set_type(EOutputForawrd);
+
+    channel->add_output(output);
+
+    output->run();
+
+    tmss_info("create rtmp forward, url={}", forward_url);
+    return ret;
+}
+
 int MediaSource::create_forward(std::shared_ptr<Channel> channel,
         std::shared_ptr<Request> req,
         std::shared_ptr<IServer> server) {
     int ret = error_success;
+    // push to rtmp upstreams, forward_rtmp=host[:port],host[:port]
+    std::string forward_rtmp = req->params_map["forward_rtmp"];
+    if (!forward_rtmp.empty()) {
+        // RtmpMux only relays flv tags, from the rtmp origin or the published flv
+        if (!channel->is_flv_tag_input() && req->params_map["origin_protocol"] != "rtmp") {
+            ret = error_rtmp_forward_input;
+            tmss_error("rtmp forward needs an rtmp origin or flv publish, stream={}, ret={}",
+                req->name, ret);
+            return ret;
+        }
+        std::vector<std::string> forward_hosts;
+        split_string(forward_rtmp, ",", forward_hosts);
+        for (auto forward_host : forward_hosts) {
+            ret = create_rtmp_forward(channel, req, server, forward_host);
+            if (ret != error_success) {
+                tmss_error("create rtmp forward failed, host={}, ret={}", forward_host, ret);
+                return ret;
+            }
+        }
+        return ret;
+    }
+
     // get or create output
     std::shared_ptr<IClientConn> forward_conn;
     std::shared_ptr<Pool<OutputHandler>> output_pool = server->get_output_pool();
@@ -459,8 +786,12 @@ int MediaSource::create_origin_file(std::shared_ptr<File>& file,
 
     input->set_context(context);
     input->set_type(EInputOrigin);
+    std::shared_ptr<HttpClient> origin_client = std::make_shared<HttpClient>();
+    origin_client->init(origin_conn);
+
     input->init_format(demuxer);
     input->init_conn(origin_conn);
+    input->init_origin_client(origin_client);
     input->init_input();
 
     std::string origin_ip = origin_host;     //  to do
@@ -502,15 +833,47 @@ int MediaSource::handle_play_file(std::shared_ptr<IClientConn> conn,
         create_origin_file(file, req, server);
     }
 
-    std::shared_ptr<IMux> muxer = std::make_shared<RawMux>();
+    std::shared_ptr<RawMux> muxer = std::make_shared<RawMux>();
+    muxer->set_content_type(CHttp::getContentType(req->ext));
     int out_buf_size = 1024 * 16;
     uint8_t* out_buf = new uint8_t[out_buf_size];
     std::shared_ptr<IContext> context = std::make_shared<IContext>();
     muxer->init_output(out_buf, out_buf_size,
         conn.get(), file_output_func, static_cast<void*>(context.get()), static_cast<void*>(context.get()));
 
+    // the length is known only when the file is complete,
+    // otherwise the body ends with the connection.
+    if (file->complete()) {
+        muxer->set_content_length(file->get_total_length());
+        muxer->set_keep_alive(req->keep_alive);
+    } else {
+        req->keep_alive = false;
+    }
+
     int offset = 0;
     while (!(file->complete()) || (offset < file->get_total_length())) {
+        if (file->get_fd() >= 0) {
+            // on disk, sent from the page cache without the copies to buffers
+            int size = file->wait_range(offset);
+            ret = muxer->send_status(200);
+            if (ret != error_success) {
+                tmss_error("send http header error,{}", ret);
+                break;
+            }
+            if (size <= 0) {
+                continue;
+            }
+            int sent = conn->sendfile(file->get_fd(), offset, size);
+            if (sent != size) {
+                tmss_error("file sendfile error,{},{}/{}", sent, size, offset);
+                ret = (sent < 0) ? sent : error_socket_write;
+                break;
+            }
+            offset += size;
+            tmss_info("sendfile size={},offset={},file_length={},file_complete={}",
+                size, offset, file->get_total_length(), file->complete());
+            continue;
+        }
         char buffer[1024];
         int size = sizeof(buffer);
         ret = file->seek_range(buffer, size, offset);     // timeout
@@ -536,9 +899,15 @@ int MediaSource::handle_play_file(std::shared_ptr<IClientConn> conn,
             size, offset, file->get_total_length(), file->complete());
     }
 
-    tmss_info("file send complete");
+    if (ret == error_success) {
+        // the empty file
+        ret = muxer->send_status(200);
+    } else {
+        // the response is broken, can not reuse the connection
+        req->keep_alive = false;
+    }
 
-    conn->set_stop();
+    tmss_info("file send complete");
 
     return ret;
 }
@@ -586,7 +955,8 @@ int MediaSource::handle_play_segment(std::shared_ptr<IClientConn> conn,
 
     std::string key =
         req->vhost + req->path + req->name;
-    std::shared_ptr<IMux> muxer = std::make_shared<RawMux>();
+    std::shared_ptr<RawMux> muxer = std::make_shared<RawMux>();
+    muxer->set_content_type(CHttp::getContentType(req->ext));
     int out_buf_size = 1024 * 16;
     uint8_t* out_buf = new uint8_t[out_buf_size];
     std::shared_ptr<IContext> context = std::make_shared<IContext>();
@@ -604,16 +974,26 @@ int MediaSource::handle_play_segment(std::shared_ptr<IClientConn> conn,
     } else {
         // check if it is need origin
         tmss_info("not find the file or expire");
+        muxer->set_content_length(0);
+        muxer->set_keep_alive(req->keep_alive);
         ret = muxer->send_status(404);
         if (ret != error_success) {
             tmss_error("send http header error,{}", ret);
             return ret;
         }
         tmss_info("send http 404");
-        conn->close();
         return ret;
     }
 
+    // the length is known only when the file is complete,
+    // otherwise the body ends with the connection.
+    if (file->complete()) {
+        muxer->set_content_length(file->get_total_length());
+        muxer->set_keep_alive(req->keep_alive);
+    } else {
+        req->keep_alive = false;
+    }
+
     int offset = 0;
     while (!(file->complete()) || (offset < file->get_total_length())) {
         char buffer[1024];
@@ -641,9 +1021,15 @@ int MediaSource::handle_play_segment(std::shared_ptr<IClientConn> conn,
             size, offset, file->get_total_length(), file->complete());
     }
 
-    tmss_info("file send complete");
+    if (ret == error_success) {
+        // the empty file
+        ret = muxer->send_status(200);
+    } else {
+        // the response is broken, can not reuse the connection
+        req->keep_alive = false;
+    }
 
-    conn->set_stop();
+    tmss_info("file send complete");
 
     return ret;
 }
@@ -652,6 +1038,8 @@ int init_default_handler(int num, char** param) {
     int level = 0;
     std::shared_ptr<MediaSource> media_source = std::make_shared<MediaSource>();
     HttpMux::get_instance()->register_handler("/", level++, media_source);
+    HttpMux::get_instance()->register_handler("/api/srt", level++,
+        std::make_shared<SrtApiHandler>());
     int ret = media_source->init(num, param);
     if (ret != error_success) {
         tmss_error("media_souce init error, ret={}", ret);
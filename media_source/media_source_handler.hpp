@@ -12,6 +12,7 @@
 #include "tmss_user_control.hpp"
 #include "http_server.hpp"
 #include "tmss_channel.hpp"
+#include "listener_group.hpp"
 
 namespace tmss {
 class MediaSource : virtual public IUserHandler, public std::enable_shared_from_this<MediaSource> {
@@ -40,6 +41,13 @@ class MediaSource : virtual public IUserHandler, public std::enable_shared_from_
     virtual int create_origin_stream(std::shared_ptr<Channel> channel,
         std::shared_ptr<Request> req,
         std::shared_ptr<IServer> server);
+    /*
+    *   push the channel to rtmp upstream, each forward has its own connection.
+    */
+    virtual int create_rtmp_forward(std::shared_ptr<Channel> channel,
+        std::shared_ptr<Request> req,
+        std::shared_ptr<IServer> server,
+        const std::string& forward_host);
     virtual int create_forward(std::shared_ptr<Channel> channel,
         std::shared_ptr<Request> req,
         std::shared_ptr<IServer> server);
@@ -65,6 +73,8 @@ class MediaSource : virtual public IUserHandler, public std::enable_shared_from_
 
  private:
     std::vector<std::shared_ptr<IServer>> server_group;
+    // the http listeners on worker threads, if workers are set
+    std::shared_ptr<ListenerGroup> listener_group;
 };
 
 int init_default_handler(int num, char** param);
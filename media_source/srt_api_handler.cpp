@@ -0,0 +1,50 @@
+/* Copyright [2021] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021.
+ *        Author:  rainwu.
+ *
+ * =====================================================================================
+ */
+#include <string>
+
+#include <srt_api_handler.hpp>
+#include <defs/err.hpp>
+#include <log/log.hpp>
+#include <transport/tmss_trans_srt.hpp>
+#include <protocol/http/http_client.hpp>
+
+namespace tmss {
+int SrtApiHandler::handle_connect(std::shared_ptr<IClientConn> conn) {
+    return error_success;
+}
+
+int SrtApiHandler::handle_request(std::shared_ptr<IClientConn> conn,
+        std::shared_ptr<Request> req,
+        std::shared_ptr<IServer> server) {
+    std::string body = SrtStatCollector::dump_json();
+
+    std::shared_ptr<HttpClient> client = std::make_shared<HttpClient>();
+    client->init(conn);
+    client->set_response_info("application/json", true);
+    int ret = client->send_status(200);
+    if (ret == error_success) {
+        ret = client->write_data(body.data(), body.size());
+        ret = (ret < 0) ? ret : client->send_eof();
+    }
+    if (ret != error_success) {
+        tmss_error("send srt stats failed, ret={}", ret);
+        req->keep_alive = false;
+    }
+    return ret;
+}
+
+int SrtApiHandler::handle_cycle(std::shared_ptr<Channel> channel) {
+    return error_success;
+}
+
+int SrtApiHandler::handle_disconnect(std::shared_ptr<IClientConn> conn) {
+    return error_success;
+}
+}  // namespace tmss
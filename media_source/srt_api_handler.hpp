@@ -0,0 +1,32 @@
+/* Copyright [2021] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021.
+ *        Author:  rainwu.
+ *
+ * =====================================================================================
+ */
+#pragma once
+#include <memory>
+#include "tmss_user_control.hpp"
+
+namespace tmss {
+/*
+*   the stats of srt connections of all threads, as json, for the monitor.
+*   GET /api/srt
+*/
+class SrtApiHandler : public IUserHandler {
+ public:
+    SrtApiHandler() = default;
+    virtual ~SrtApiHandler() = default;
+
+ public:
+    virtual int handle_connect(std::shared_ptr<IClientConn> conn);
+    virtual int handle_request(std::shared_ptr<IClientConn> conn,
+        std::shared_ptr<Request> req,
+        std::shared_ptr<IServer> server);
+    virtual int handle_cycle(std::shared_ptr<Channel> channel);
+    virtual int handle_disconnect(std::shared_ptr<IClientConn> conn);
+};
+}  // namespace tmss
@@ -7,6 +7,8 @@
 #include <log/log.hpp>
 
 namespace tmss {
+const int max_gop_cache_size = 2048;
+
 PacketQueue::PacketQueue(int size) : max_size(size) {
     cond = st_cond_new();
 }
@@ -73,5 +75,80 @@ bool PacketQueue::can_use() {
     return true;
 }
 
+void PacketQueue::clear() {
+    std::queue<std::shared_ptr<IPacket>> empty;
+    queue.swap(empty);
+}
+
+GopCache::GopCache() {
+    has_video = false;
+    max_size = max_gop_cache_size;
+}
+
+GopCache::~GopCache() {
+}
+
+int GopCache::cache(std::shared_ptr<IPacket> packet) {
+    int ret = error_success;
+    int media_type = packet->get_media_type();
+
+    if (packet->is_sequence_header()) {
+        if (media_type == EMediaVideo) {
+            video_header = packet;
+        } else if (media_type == EMediaAudio) {
+            audio_header = packet;
+        } else if (media_type == EMediaScript) {
+            metadata = packet;
+        }
+        return ret;
+    }
+
+    if (media_type == EMediaVideo) {
+        has_video = true;
+        // start a new gop
+        if (packet->is_key_frame()) {
+            gop.clear();
+        }
+    } else if (media_type != EMediaAudio) {
+        return ret;
+    }
+
+    // wait for the key frame, audio only stream is cached directly
+    if (gop.empty() && has_video && !packet->is_key_frame()) {
+        return ret;
+    }
+
+    // the gop is too long, drop it and wait for the next key frame
+    if (static_cast<int>(gop.size()) >= max_size) {
+        tmss_warn("gop cache overflow, drop {} packets", gop.size());
+        gop.clear();
+        return ret;
+    }
+    gop.push_back(packet);
+
+    return ret;
+}
+
+void GopCache::dump(std::vector<std::shared_ptr<IPacket>>& packets) {
+    if (metadata) {
+        packets.push_back(metadata);
+    }
+    if (video_header) {
+        packets.push_back(video_header);
+    }
+    if (audio_header) {
+        packets.push_back(audio_header);
+    }
+    packets.insert(packets.end(), gop.begin(), gop.end());
+}
+
+void GopCache::clear() {
+    metadata = nullptr;
+    video_header = nullptr;
+    audio_header = nullptr;
+    gop.clear();
+    has_video = false;
+}
+
 }  // namespace tmss
 
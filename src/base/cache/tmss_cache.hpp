@@ -12,6 +12,7 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <vector>
 #include <defs/err.hpp>
 #include <format/base/packet.hpp>
 #include <format/base/frame.hpp>
@@ -58,6 +59,8 @@ class PacketQueue {
     virtual int dequeue(std::shared_ptr<IFrame> &frame, int timeout_us = -1);
     virtual int send_no_msg();
     virtual bool can_use();
+    // drop all packets not consumed
+    virtual void clear();
 
  private:
     std::queue<std::shared_ptr<IPacket>> queue;
@@ -65,5 +68,26 @@ class PacketQueue {
     st_cond_t cond;
     int max_size;
 };
+
+/*
+*   the packets from the last key frame and the sequence headers,
+*   shared with the outputs without copy, to start an output with a key frame.
+*/
+class GopCache {
+ public:
+    GopCache();
+    ~GopCache();
+    int cache(std::shared_ptr<IPacket> packet);
+    void dump(std::vector<std::shared_ptr<IPacket>>& packets);
+    void clear();
+
+ private:
+    std::shared_ptr<IPacket> metadata;
+    std::shared_ptr<IPacket> video_header;
+    std::shared_ptr<IPacket> audio_header;
+    std::vector<std::shared_ptr<IPacket>> gop;
+    bool has_video;
+    int max_size;
+};
 }  // namespace tmss
 
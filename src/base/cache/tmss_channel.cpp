@@ -39,6 +39,7 @@ Channel::Channel() : ICoroutineHandler("channel") {
     idle_at = -1;
     channel_exit_time = -1;
     status = EChannelInit;
+    flv_tag_input = false;
     tmss_info("create channel");
 }
 
@@ -47,6 +48,7 @@ Channel::Channel(const std::string& key) : ICoroutineHandler("channel") {
     idle_at = -1;
     channel_exit_time = -1;
     status = EChannelInit;
+    flv_tag_input = false;
     tmss_info("create channel");
 }
 
@@ -91,6 +93,17 @@ int Channel::add_output(std::shared_ptr<PacketQueue> new_output) {
         auto output = std::dynamic_pointer_cast<OutputHandler>(new_output);
         output->init_output(input_context);
     //  }
+
+    // the player joins the live, start it from the metadata, sequence headers
+    // and the key frame. the forward replays them itself when connected.
+    if (output->get_type() == EOutputPlay) {
+        std::vector<std::shared_ptr<IPacket>> packets;
+        gop_cache.dump(packets);
+        for (auto packet : packets) {
+            new_output->enqueue(packet);
+        }
+        tmss_info("replay gop cache to output, {} packets", packets.size());
+    }
     return ret;
 }
 
@@ -200,6 +213,7 @@ int Channel::on_process() {
 
 int Channel::on_cycle(std::shared_ptr<IPacket> packet) {
     int ret = error_success;
+    gop_cache.cache(packet);
     // segment, like flv->hls
     if (segment_cache) {
         ret = segment_cache->handle_packet(packet);
@@ -251,6 +265,10 @@ int Channel::get_cache(SortedCache<std::shared_ptr<IPacket>> msgs) {
     return ret;
 }
 
+void Channel::dump_gop_cache(std::vector<std::shared_ptr<IPacket>>& packets) {
+    gop_cache.dump(packets);
+}
+
 int64_t Channel::get_idle_time() {
     return (idle_at > 0) ? (get_cache_time() - idle_at) : -1;
 }
@@ -270,6 +288,7 @@ int Channel::on_stop() {
         tmss_info("set output stop");
     }
     channel_exit_time = get_cache_time();
+    gop_cache.clear();
 
     tmss_info("channel stop");
     return ret;
@@ -291,6 +310,14 @@ void Channel::set_status(EStatusChannel status) {
     this->status = status;
 }
 
+bool Channel::is_flv_tag_input() {
+    return flv_tag_input;
+}
+
+void Channel::set_flv_tag_input(bool flv_tag_input) {
+    this->flv_tag_input = flv_tag_input;
+}
+
 std::string Channel::get_key() {
     return key;
 }
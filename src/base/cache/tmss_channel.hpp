@@ -47,11 +47,13 @@ class Channel : public ICoroutineHandler {
     std::shared_ptr<IUserHandler>           user_ctrl;
     std::shared_ptr<IContext>          context;
     SortedCache<IPacket>          cache;
+    GopCache                gop_cache;          // replay to the new or reconnected output
     std::string             stream_id;          // file name in url
 
     int64_t                 idle_at;            // no input or output
     int64_t                 channel_exit_time;  // channel stop time
     EStatusChannel          status;
+    bool                    flv_tag_input;      // the input packets are FlvTagPacket
 
     std::shared_ptr<IContext> input_context;        // to do
 
@@ -66,6 +68,10 @@ class Channel : public ICoroutineHandler {
     void del_all_output();
     virtual int init_cache();
     int get_cache(SortedCache<std::shared_ptr<IPacket>> msgs);
+    /*
+    * the packets from the last key frame, shared without copy
+    */
+    void dump_gop_cache(std::vector<std::shared_ptr<IPacket>>& packets);
     void init_user_ctrl(std::shared_ptr<IUserHandler> ctrl);
     int run();
     int cycle() override;
@@ -92,6 +98,11 @@ class Channel : public ICoroutineHandler {
 
     EStatusChannel get_status();
     void set_status(EStatusChannel status);
+    /*
+    *   the flv tags are played by FlvTagMux and forwarded by RtmpMux, without remux
+    */
+    bool is_flv_tag_input();
+    void set_flv_tag_input(bool flv_tag_input);
     std::string get_key();
 
     void wake_up();
@@ -4,18 +4,33 @@
  */
 
 #include "tmss_input.hpp"
+
+#include <string.h>
+
 #include "tmss_channel.hpp"
 #include <log/log.hpp>
 #include <util/util.hpp>
+#include <util/timer.hpp>
 
 namespace tmss {
 const int max_input_queue_size = 1000;
+// the rounds over the origins
+const int max_origin_try_count = 3;
+// the origin broken again soon after failover, wait before the next
+const utime_t min_failover_interval_us = 1 * 1000 * 1000;
+// FLV, version, flags, header size, and the previous tag size 0
+const int flv_header_size = 13;
 
 int read_packet(void *opaque, uint8_t *buf, int buf_size) {
     InputHandler* input = static_cast<InputHandler*>(opaque);
     return input->fetch_stream(reinterpret_cast<char*>(buf), buf_size);   // client_conn
 }
 
+int read_buf(void *opaque, IOBuf& buf, int size) {
+    InputHandler* input = static_cast<InputHandler*>(opaque);
+    return input->fetch_stream(buf, size);
+}
+
 InputHandler::InputHandler(std::shared_ptr<Pool<InputHandler>> pool,
             std::shared_ptr<Channel> channel) :
         PacketQueue(max_input_queue_size), ICoroutineHandler("input"),
@@ -24,7 +39,9 @@ InputHandler::InputHandler(std::shared_ptr<Pool<InputHandler>> pool,
     status = ESourceInit;
     this->channel = channel;
 
-    origin_try_count = 1;
+    origin_try_count = max_origin_try_count;
+    is_resume = false;
+    failover_at = 0;
 }
 
 InputHandler::~InputHandler() {
@@ -45,17 +62,19 @@ bool InputHandler::can_use() {
 }
 
 int InputHandler::origin_start() {
-    int count = 0;
     int ret = error_success;
-    while (count < origin_try_count) {
+    for (int count = 0; count < origin_try_count; count++) {
         if (count > 0) {
             st_usleep(1 * 1000 * 1000);
-        } else {
         }
-        count++;
-        ret = input_conn->connect(origin_address);
+        if (is_stop) {
+            ret = error_ingest_no_input;
+            tmss_info("input stop");
+            break;
+        }
+        ret = origin_connect(failed_address);
         if (ret != 0) {
-            tmss_error("connect origin error,{}", origin_address.str());
+            tmss_error("connect origin error,{}", ret);
             continue;
         }
         if (!client) {
@@ -63,23 +82,99 @@ int InputHandler::origin_start() {
             ret = error_ingest_no_client;
             return ret;
         }
+        utime_t request_at = st_utime();
         ret = client->request(origin_request.vhost,
             origin_request.path,
             origin_request.name,
             origin_request.params,
             demux);
+        if (ret == error_success && is_resume) {
+            ret = skip_stream_header();
+        }
         if (ret != 0) {
-            tmss_error("ingest origin error,{},{}", ret, origin_request.to_str());
+            tmss_error("ingest origin error,{},{},{}",
+                ret, origin_address.str(), origin_request.to_str());
+            if (origin_group) {
+                origin_group->on_failure(origin_address);
+            }
+            failed_address = origin_address.str();
+            input_conn->close();
             continue;
         }
+        if (origin_group) {
+            origin_group->on_first_byte(origin_address, st_utime() - request_at);
+        }
 
-        tmss_info("ingest origin success,{}", origin_request.to_str());
+        tmss_info("ingest origin success,{},{}", origin_address.str(), origin_request.to_str());
+        failed_address.clear();
+        break;
     }
 
     tmss_info("origin start.");
     return ret;
 }
 
+int InputHandler::origin_connect(const std::string& exclude) {
+    int ret = error_success;
+    if (!origin_group) {
+        ret = input_conn->connect(origin_address);
+        if (ret != error_success) {
+            tmss_error("connect origin error,{}", origin_address.str());
+            return ret;
+        }
+        return client->reset_conn(input_conn);
+    }
+
+    std::shared_ptr<IClientConn> conn;
+    ret = origin_group->connect(conn, origin_address, exclude);
+    if (ret != error_success) {
+        return ret;
+    }
+    input_conn->close();
+    input_conn = conn;
+    return client->reset_conn(input_conn);
+}
+
+int InputHandler::origin_failover() {
+    int ret = error_success;
+    tmss_warn("origin broken, failover,{},{}", origin_address.str(), origin_request.to_str());
+    if (origin_group) {
+        origin_group->on_failure(origin_address);
+    }
+    failed_address = origin_address.str();
+    input_conn->close();
+
+    if (get_cache_time() - failover_at < min_failover_interval_us) {
+        st_usleep(min_failover_interval_us);
+    }
+    failover_at = get_cache_time();
+
+    // the packets are enqueued as before, the outputs never know
+    if ((ret = demux->on_resume()) != error_success) {
+        tmss_error("demux resume error, {}", ret);
+        return ret;
+    }
+    is_resume = true;
+    status = ESourceInit;
+    return ret;
+}
+
+int InputHandler::skip_stream_header() {
+    if (origin_ext != "flv") {
+        return error_success;
+    }
+    std::shared_ptr<Buffer> cache = client->io_buffer->get_buffer();
+    int ret = client->io_buffer->ensure(flv_header_size);
+    if (ret != error_success) {
+        tmss_error("read flv header error, {}", ret);
+        return error_socket_read;
+    }
+    if (memcmp(cache->rcurrent(), "FLV", 3) == 0) {
+        cache->seek_read(flv_header_size);
+    }
+    return error_success;
+}
+
 int InputHandler::fetch_stream(char* buff, int wanted_size) {
     int read_size = client->read_data(buff, wanted_size);
     tmss_info("read data, {}/{}", read_size, wanted_size);
@@ -90,6 +185,16 @@ int InputHandler::fetch_stream(char* buff, int wanted_size) {
     }
 }
 
+int InputHandler::fetch_stream(IOBuf& buf, int wanted_size) {
+    int read_size = client->read_buf(buf, wanted_size);
+    tmss_info("read buf, {}/{}", read_size, wanted_size);
+    if (read_size > 0) {
+        return read_size;
+    } else {
+        return -1;
+    }
+}
+
 void InputHandler::init_conn(std::shared_ptr<IClientConn> conn) {
     input_conn = conn;
 }
@@ -116,9 +221,16 @@ void InputHandler::set_origin_info(Address& origin_address,
     this->origin_request.vhost = origin_host;
     this->origin_request.path = origin_path;
     this->origin_request.name = stream;
-    this->origin_request.name += ".";
-    this->origin_request.name += ext;
+    if (!ext.empty()) {
+        this->origin_request.name += ".";
+        this->origin_request.name += ext;
+    }
     this->origin_request.params = params;
+    this->origin_ext = ext;
+}
+
+void InputHandler::set_origin_group(std::shared_ptr<OriginGroup> group) {
+    origin_group = group;
 }
 
 std::shared_ptr<IContext> InputHandler::get_context() {
@@ -140,6 +252,7 @@ void InputHandler::set_type(EInputType type) {
 int InputHandler::init_input() {
     int in_buf_size = 1024 * 8;
     uint8_t* in_buf = new uint8_t[in_buf_size];
+    demux->set_read_buf(read_buf);
     return demux->init_input(in_buf, in_buf_size,
         this, read_packet, static_cast<void*>(context.get()));
 }
@@ -160,11 +273,18 @@ int InputHandler::set_stop() {
 int InputHandler::cycle() {
     tmss_info("input running");
     int ret = error_success;
-    for (int cnt = 0; cnt < 2; cnt++) {
+    while (true) {
         ret = cycle_interleave();
         if (ret != error_success) {
             tmss_error("cycle error, {}", ret);
-            continue;
+        }
+        // the pushed stream ends with the connection, the origin fails over
+        // when it is broken after started, so the channel and the outputs are kept
+        if (is_stop || input_type != EInputOrigin || status != ESourceStart) {
+            break;
+        }
+        if ((ret = origin_failover()) != error_success) {
+            break;
         }
     }
 
@@ -208,6 +328,14 @@ int InputHandler::probe() {
         }
     } else {
     // publish
+        if (status == ESourceInit) {
+            // the pushed stream is demuxed as the origin stream
+            ret = demux->on_ingest(0, "");
+            if (ret != error_success) {
+                tmss_error("publish ingest error, {}", ret);
+                return ret;
+            }
+        }
         status = ESourceStart;
     }
     client->io_buffer->set_no_cache();
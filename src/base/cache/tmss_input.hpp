@@ -6,6 +6,7 @@
 #pragma once
 
 #include "tmss_cache.hpp"
+#include "tmss_origin.hpp"
 #include <format/base/context.hpp>
 #include <format/base/mux.hpp>
 #include <format/base/demux.hpp>
@@ -22,8 +23,11 @@ class InputHandler : public PacketQueue, public ICoroutineHandler {
  private:
     std::weak_ptr<Channel>    channel;
     Address     origin_address;
+    // the origins to fail over, null if only origin_address
+    std::shared_ptr<OriginGroup> origin_group;
 
     Request origin_request;
+    std::string origin_ext;
     EInputType         input_type;
 
     // to do, maybe there are multiple transport, such as rtsp over rtp and rtcp
@@ -45,6 +49,7 @@ class InputHandler : public PacketQueue, public ICoroutineHandler {
     int set_connection(std::shared_ptr<IClientConn> conn);
     bool can_use() override;
     int fetch_stream(char* buff, int wanted_size);
+    int fetch_stream(IOBuf& buf, int wanted_size);
     void init_conn(std::shared_ptr<IClientConn> conn);
     void init_format(std::shared_ptr<IDeMux> demux);
     void init_origin_client(std::shared_ptr<IClient> origin_client);
@@ -55,6 +60,7 @@ class InputHandler : public PacketQueue, public ICoroutineHandler {
         const std::string& stream,
         const std::string& ext,
         const std::string& params);
+    void set_origin_group(std::shared_ptr<OriginGroup> group);
     std::shared_ptr<IContext> get_context();
     void set_context(std::shared_ptr<IContext> ctx);
     EInputType get_type();
@@ -72,9 +78,19 @@ class InputHandler : public PacketQueue, public ICoroutineHandler {
 
  private:
     int origin_start();
+    int origin_connect(const std::string& exclude);
+    // the origin is broken in the middle of stream, switch to another one
+    int origin_failover();
+    // the new origin starts with the flv header, which is sent already
+    int skip_stream_header();
     std::shared_ptr<Pool<InputHandler>> input_pool;
 
     int origin_try_count;
+    // the stream is resumed on another origin
+    bool is_resume;
+    // the origin address broken
+    std::string failed_address;
+    utime_t failover_at;
 };
 
 }  // namespace tmss
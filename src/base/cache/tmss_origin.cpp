@@ -0,0 +1,260 @@
+/*
+ * TMSS
+ * Copyright (c) 2020 rainwu
+ */
+
+#include "tmss_origin.hpp"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include <defs/err.hpp>
+#include <log/log.hpp>
+#include <util/timer.hpp>
+#include <transport/tmss_trans_tcp.hpp>
+#include <st_trans/st_dns.hpp>
+
+namespace tmss {
+// the delay to start the next connect, RFC 8305 section 5
+const utime_t origin_attempt_delay_us = 250 * 1000;
+const int origin_connect_timeout_ms = 3000;
+// the addresses raced for one connect
+const int origin_max_attempts = 8;
+// the score of the origin not tried yet
+const int64_t origin_default_latency_us = 100 * 1000;
+// each recent failure counts as a slow origin
+const int64_t origin_failure_penalty_us = 1000 * 1000;
+const int origin_max_failures = 8;
+// the failures are forgotten after it
+const utime_t origin_failure_hold_us = 30 * 1000 * 1000;
+
+OriginHealth::OriginHealth() {
+    connect_latency = -1;
+    first_byte_latency = -1;
+    failures = 0;
+    fail_at = 0;
+}
+
+void OriginHealth::on_connect(utime_t latency) {
+    int64_t sample = static_cast<int64_t>(latency);
+    connect_latency = (connect_latency < 0) ? sample : (connect_latency * 7 + sample) / 8;
+}
+
+void OriginHealth::on_first_byte(utime_t latency) {
+    int64_t sample = static_cast<int64_t>(latency);
+    first_byte_latency = (first_byte_latency < 0) ? sample : (first_byte_latency * 7 + sample) / 8;
+    failures = 0;
+}
+
+void OriginHealth::on_failure() {
+    failures = std::min(failures + 1, origin_max_failures);
+    fail_at = get_cache_time();
+}
+
+int64_t OriginHealth::score() {
+    int64_t score = (connect_latency < 0) ? origin_default_latency_us : connect_latency;
+    score += (first_byte_latency < 0) ? origin_default_latency_us : first_byte_latency;
+    if (failures > 0 && get_cache_time() - fail_at < origin_failure_hold_us) {
+        score += failures * origin_failure_penalty_us;
+    }
+    return score;
+}
+
+OriginAttempt::OriginAttempt(const Address& address, st_cond_t notify) :
+        ICoroutineHandler("origin_attempt"), address(address), notify(notify) {
+    ret = error_success;
+    done = false;
+    latency = 0;
+}
+
+int OriginAttempt::cycle() {
+    utime_t start_at = st_utime();
+    conn = std::make_shared<TcpStreamConn>(nullptr);
+    conn->set_connect_timeout(origin_connect_timeout_ms);
+    ret = conn->connect(address);
+    latency = st_utime() - start_at;
+    done = true;
+    st_cond_signal(notify);
+    return ret;
+}
+
+OriginGroup::OriginGroup() {
+}
+
+void OriginGroup::set_origins(const std::string& origins, int default_port) {
+    this->origins.clear();
+    size_t pos = 0;
+    while (pos <= origins.length()) {
+        size_t end = origins.find(',', pos);
+        if (end == std::string::npos) {
+            end = origins.length();
+        }
+        std::string origin = origins.substr(pos, end - pos);
+        pos = end + 1;
+        if (origin.empty()) {
+            continue;
+        }
+        int port = default_port;
+        size_t colon = origin.find(':');
+        if (colon != std::string::npos) {
+            port = atoi(origin.c_str() + colon + 1);
+            origin = origin.substr(0, colon);
+        }
+        this->origins.push_back(std::make_pair(origin, port));
+    }
+}
+
+int OriginGroup::resolve(std::vector<Address>& addresses, const std::string& exclude) {
+    // the addresses of each host
+    std::vector<std::vector<Address>> groups;
+    for (auto& origin : origins) {
+        std::vector<std::string> ips;
+        error_t ret = StDnsResolver::get_instance()->resolve(origin.first, ips);
+        if (ret != error_success) {
+            tmss_error("resolve origin failed, host={}, ret={}", origin.first, ret);
+            continue;
+        }
+        std::vector<Address> group;
+        for (auto& ip : ips) {
+            group.push_back(Address(ip, origin.second));
+        }
+        groups.push_back(group);
+    }
+
+    // take one address of each host in turn, so the next try is another host
+    for (size_t i = 0; ; i++) {
+        bool found = false;
+        for (auto& group : groups) {
+            if (i < group.size()) {
+                addresses.push_back(group[i]);
+                found = true;
+            }
+        }
+        if (!found) {
+            break;
+        }
+    }
+
+    // the address just broken is the last, the same score keeps the order above
+    std::vector<std::pair<int64_t, Address>> scored;
+    for (auto& address : addresses) {
+        std::string key = address.str();
+        int64_t score = (key == exclude) ? INT64_MAX : healths[key].score();
+        scored.push_back(std::make_pair(score, address));
+    }
+    std::stable_sort(scored.begin(), scored.end(),
+        [](const std::pair<int64_t, Address>& a, const std::pair<int64_t, Address>& b) {
+            return a.first < b.first;
+        });
+    addresses.clear();
+    for (auto& item : scored) {
+        addresses.push_back(item.second);
+    }
+    if (static_cast<int>(addresses.size()) > origin_max_attempts) {
+        addresses.resize(origin_max_attempts);
+    }
+
+    return addresses.empty() ? error_origin_no_address : error_success;
+}
+
+int OriginGroup::connect(std::shared_ptr<IClientConn>& conn, Address& address,
+        const std::string& exclude) {
+    std::vector<Address> addresses;
+    int ret = resolve(addresses, exclude);
+    if (ret != error_success) {
+        tmss_error("no origin address, ret={}", ret);
+        return ret;
+    }
+
+    st_cond_t notify = st_cond_new();
+    std::vector<std::shared_ptr<OriginAttempt>> attempts;
+    std::shared_ptr<OriginAttempt> winner;
+    size_t running = 0;
+    size_t failed = 0;
+    bool slow = false;
+    bool fail = false;
+    while (true) {
+        // start the next one, when the running ones are slow or failed
+        if (attempts.size() < addresses.size() && (running == 0 || slow || fail)) {
+            std::shared_ptr<OriginAttempt> attempt =
+                std::make_shared<OriginAttempt>(addresses[attempts.size()], notify);
+            attempts.push_back(attempt);
+            tmss_info("connect origin, {}, running={}", attempt->address.str(), running);
+            attempt->start();
+        }
+
+        utime_t timeout = (attempts.size() < addresses.size()) ?
+            origin_attempt_delay_us : ST_UTIME_NO_TIMEOUT;
+        slow = (st_cond_timedwait(notify, timeout) != 0);
+
+        size_t last_failed = failed;
+        running = failed = 0;
+        for (auto& attempt : attempts) {
+            if (!attempt->done) {
+                running++;
+            } else if (attempt->ret == error_success) {
+                winner = attempt;
+            } else {
+                failed++;
+            }
+        }
+        fail = (failed > last_failed);
+        if (winner || failed == addresses.size()) {
+            break;
+        }
+    }
+
+    // stop the losers, the connected ones are closed
+    for (auto& attempt : attempts) {
+        if (attempt == winner) {
+            continue;
+        }
+        if (!attempt->done) {
+            // slower than the winner at least
+            attempt->stop();
+            attempt->conn->close();
+            healths[attempt->address.str()].on_connect(attempt->latency);
+            continue;
+        }
+        if (attempt->ret == error_success) {
+            healths[attempt->address.str()].on_connect(attempt->latency);
+            attempt->conn->close();
+        } else {
+            tmss_error("connect origin failed, {}, ret={}", attempt->address.str(), attempt->ret);
+            healths[attempt->address.str()].on_failure();
+        }
+    }
+    st_cond_destroy(notify);
+
+    if (!winner) {
+        ret = error_origin_connect;
+        tmss_error("connect all origins failed, count={}, ret={}", addresses.size(), ret);
+        return ret;
+    }
+    healths[winner->address.str()].on_connect(winner->latency);
+    conn = winner->conn;
+    address = winner->address;
+    tmss_info("connect origin success, {}, latency={}us", address.str(), winner->latency);
+    return error_success;
+}
+
+void OriginGroup::on_first_byte(Address& address, utime_t latency) {
+    healths[address.str()].on_first_byte(latency);
+}
+
+void OriginGroup::on_failure(Address& address) {
+    healths[address.str()].on_failure();
+}
+
+std::shared_ptr<OriginGroup> OriginGroup::fetch(const std::string& vhost) {
+    thread_local std::map<std::string, std::shared_ptr<OriginGroup>> groups;
+    std::shared_ptr<OriginGroup>& group = groups[vhost];
+    if (!group) {
+        group = std::make_shared<OriginGroup>();
+    }
+    return group;
+}
+
+}  // namespace tmss
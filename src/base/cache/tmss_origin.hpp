@@ -0,0 +1,106 @@
+/*
+ * TMSS
+ * Copyright (c) 2020 rainwu
+ */
+
+#pragma once
+
+#include <st.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <coroutine/coroutine.hpp>
+#include <net/tmss_conn.hpp>
+
+namespace tmss {
+/*
+*   the recent connect and first byte latency of an origin address,
+*   the address with lower score is tried first.
+*/
+class OriginHealth {
+ public:
+    OriginHealth();
+
+ public:
+    void on_connect(utime_t latency);
+    void on_first_byte(utime_t latency);
+    void on_failure();
+    // us, the expected time to the first byte, the recent failures are punished
+    int64_t score();
+
+ private:
+    // us, smoothed as the srtt of tcp, -1 if no sample
+    int64_t connect_latency;
+    int64_t first_byte_latency;
+    // the failures since the last success
+    int failures;
+    utime_t fail_at;
+};
+
+/*
+*   one connect of the race, on its own coroutine
+*/
+class OriginAttempt : public ICoroutineHandler {
+ public:
+    OriginAttempt(const Address& address, st_cond_t notify);
+    virtual ~OriginAttempt() = default;
+
+ public:
+    int cycle() override;
+
+ public:
+    Address address;
+    std::shared_ptr<IClientConn> conn;
+    int ret;
+    bool done;
+    utime_t latency;
+
+ private:
+    // signal the race when done
+    st_cond_t notify;
+};
+
+/*
+*   the origins of a vhost, host[:port] separated by comma, each host may
+*   resolve to several addresses.
+*   the addresses are raced in the way of happy eyeballs (RFC 8305), the best
+*   scored one starts first, the next starts when it is not connected in a
+*   short delay or it fails, the first connected wins and the others are stopped.
+*/
+class OriginGroup {
+ public:
+    OriginGroup();
+    virtual ~OriginGroup() = default;
+
+ public:
+    void set_origins(const std::string& origins, int default_port);
+    /*
+    *   connect to the best origin.
+    *   @param exclude the address just broken, tried last.
+    */
+    int connect(std::shared_ptr<IClientConn>& conn, Address& address,
+        const std::string& exclude);
+    // the response of origin is received after the request is sent
+    void on_first_byte(Address& address, utime_t latency);
+    // the request is failed, or the stream is broken
+    void on_failure(Address& address);
+
+ public:
+    // the group of vhost
+    static std::shared_ptr<OriginGroup> fetch(const std::string& vhost);
+
+ private:
+    // the addresses of all origins, ordered by score
+    int resolve(std::vector<Address>& addresses, const std::string& exclude);
+
+ private:
+    // host and port
+    std::vector<std::pair<std::string, int>> origins;
+    // by address
+    std::map<std::string, OriginHealth> healths;
+};
+
+}  // namespace tmss
@@ -4,6 +4,8 @@
  */
 #include <fcntl.h>
 #include <unistd.h>
+#include <algorithm>
+#include <vector>
 #include "tmss_output.hpp"
 #include <util/timer.hpp>
 #include "tmss_channel.hpp"
@@ -13,11 +15,19 @@
 
 namespace tmss {
 const int max_output_queue_size = 1000;
+// the backoff of forward reconnect, double for each retry.
+const int64_t forward_backoff_min_us = 1 * 1000 * 1000;
+const int64_t forward_backoff_max_us = 30 * 1000 * 1000;
 int write_packet(void *opaque, uint8_t *buf, int buf_size) {
     OutputHandler* output = static_cast<OutputHandler*>(opaque);
     return output->write_msg(reinterpret_cast<char*>(buf), buf_size);
 }
 
+int writev_packet(void *opaque, const iovec* iov, int iov_size) {
+    OutputHandler* output = static_cast<OutputHandler*>(opaque);
+    return output->write_msgv(iov, iov_size);
+}
+
 OutputHandler::OutputHandler(std::shared_ptr<Pool<OutputHandler>> pool,
             std::shared_ptr<Channel> channel) :
         PacketQueue(max_output_queue_size), ICoroutineHandler("output"),
@@ -25,6 +35,9 @@ OutputHandler::OutputHandler(std::shared_ptr<Pool<OutputHandler>> pool,
     is_stop = false;
     status = EOutputInit;
     this->channel = channel;
+    forward_retry_count = 0;
+    wait_key_frame = false;
+    dropped_count = 0;
 }
 
 OutputHandler::~OutputHandler() {
@@ -38,6 +51,11 @@ int OutputHandler::write_msg(char* buff, int size) {
     return client->write_data(buff, size);
 }
 
+int OutputHandler::write_msgv(const iovec* iov, int iov_size) {
+    tmss_info("write data, connid={}, iov_size={}", output_conn->get_id(), iov_size);
+    return client->writev_data(iov, iov_size);
+}
+
 void OutputHandler::init_conn(std::shared_ptr<IClientConn> conn) {
     output_conn = conn;
 }
@@ -79,6 +97,7 @@ int OutputHandler::init_output(std::shared_ptr<IContext> input_context) {
     int out_buf_size = 1024 * 16;
     uint8_t* out_buf = new uint8_t[out_buf_size];
 
+    mux->set_writev(writev_packet);
     return mux->init_output(out_buf, out_buf_size,
         this, write_packet,
         static_cast<void*>(input_context.get()), static_cast<void*>(output_context.get()));
@@ -103,18 +122,11 @@ int OutputHandler::cycle() {
     int ret = error_success;
     if (output_type == EOutputForawrd) {
         if (status == EOutputInit) {
-            int ret = output_conn->connect(forward_address);
-            if (ret != 0) {
-                tmss_error("connect forward error, {}", ret);
-                return ret;
-            }
-
-            ret = mux->forward(forward_url, output_conn);
-            if (ret != 0) {
-                tmss_error("request forward error, {}", ret);
+            ret = forward_start();
+            if (ret != error_success) {
+                tmss_error("forward start error, {}", ret);
                 return ret;
             }
-            status = EOutputStart;
         } else {
         }
     } else {
@@ -128,12 +140,12 @@ int OutputHandler::cycle() {
     while (true) {
         if (is_stop) {
             tmss_info("output stop");
-            mux->send_status(404);
+            send_status(404);
             break;
         }
         if (output_conn->is_stop()) {
             tmss_info("output conn stop");
-            mux->send_status(404);
+            send_status(404);
             break;
         }
         std::shared_ptr<IPacket> packet;
@@ -155,21 +167,125 @@ int OutputHandler::cycle() {
         if (packet) {
         //  if (frame) {
             // tmss_info("get the packet, size={}", packet->get_size());
-            mux->send_status(200);
+            send_status(200);
+            if (should_drop(packet)) {
+                continue;
+            }
             ret = mux->handle_output(packet);
             //  ret = mux->handle_output(frame);
+            if (ret != error_success && output_type == EOutputForawrd) {
+                tmss_warn("forward packet failed, reconnect, {}", ret);
+                status = EOutputInit;
+                ret = forward_start();
+            }
             if (ret != error_success) {
                 tmss_info("send packet to output failed, {}", ret);
                 break;
             }
         } else {
             tmss_info("send 404");
-            mux->send_status(404);
+            send_status(404);
             break;
         }
         last_send_at = get_cache_time();
     }
 
+    if (output_type == EOutputPlay && client && !output_conn->is_stop()) {
+        client->send_eof();
+    }
+
+    return ret;
+}
+
+int OutputHandler::send_status(int status) {
+    // the play client sends the response, the body may be framed by it
+    if (output_type == EOutputPlay && client) {
+        return client->send_status(status);
+    }
+    return mux->send_status(status);
+}
+
+bool OutputHandler::should_drop(std::shared_ptr<IPacket> packet) {
+    if (packet->get_media_type() != EMediaVideo || packet->is_sequence_header()) {
+        return false;
+    }
+
+    int congestion = output_conn->get_congestion();
+    if (congestion == ECongestionHeavy && !wait_key_frame) {
+        tmss_warn("output congested, drop video until key frame, connid={}", output_conn->get_id());
+        wait_key_frame = true;
+    }
+    if (wait_key_frame) {
+        if (packet->is_key_frame() && congestion != ECongestionHeavy) {
+            tmss_info("output resume at key frame, connid={}, dropped={}",
+                output_conn->get_id(), dropped_count);
+            wait_key_frame = false;
+            return false;
+        }
+        dropped_count++;
+        return true;
+    }
+    if (congestion == ECongestionLight && packet->is_disposable()) {
+        dropped_count++;
+        return true;
+    }
+    return false;
+}
+
+int OutputHandler::forward_start() {
+    int ret = error_success;
+    while (!is_stop) {
+        if (forward_retry_count > 0) {
+            int64_t backoff = forward_backoff_min_us << std::min(forward_retry_count - 1, 5);
+            backoff = std::min(backoff, forward_backoff_max_us);
+            tmss_info("forward retry {} after {} us", forward_retry_count, backoff);
+            st_usleep(backoff);
+            if (is_stop) {
+                break;
+            }
+        }
+        forward_retry_count++;
+
+        output_conn->close();
+        ret = output_conn->connect(forward_address);
+        if (ret != error_success) {
+            tmss_error("connect forward error, {}, {}", forward_address.str(), ret);
+            continue;
+        }
+        ret = mux->forward(forward_url, output_conn);
+        if (ret != error_success) {
+            tmss_error("request forward error, {}, {}", forward_url, ret);
+            continue;
+        }
+
+        forward_retry_count = 0;
+        status = EOutputStart;
+
+        // the queued packets are stale, start from the key frame in gop cache
+        clear();
+        std::vector<std::shared_ptr<IPacket>> packets;
+        if (channel.lock()) {
+            channel.lock()->dump_gop_cache(packets);
+        }
+        for (auto packet : packets) {
+            ret = mux->handle_output(packet);
+            if (ret != error_success) {
+                tmss_error("replay gop cache error, {}", ret);
+                status = EOutputInit;
+                break;
+            }
+        }
+        if (ret != error_success) {
+            continue;
+        }
+        tmss_info("forward start, url={}, replay {} packets", forward_url, packets.size());
+        return ret;
+    }
+
+    ret = error_success;
+    if (status != EOutputStart) {
+        ret = error_socket_connect;
+    }
     return ret;
 }
 
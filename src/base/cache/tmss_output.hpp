@@ -50,8 +50,16 @@ class OutputHandler : public PacketQueue, public ICoroutineHandler {
     int64_t     start_at;
     int64_t     last_send_at;
 
+    // the retry count of forward, reset when connected
+    int         forward_retry_count;
+
+    // the video is dropped until the next key frame, after heavy congestion
+    bool        wait_key_frame;
+    int64_t     dropped_count;
+
  public:
     int write_msg(char* buff, int size);
+    int write_msgv(const iovec* iov, int iov_size);
     void init_conn(std::shared_ptr<IClientConn> conn);
     void init_format(std::shared_ptr<IMux> mux);
     void init_play_client(std::shared_ptr<IClient> play_client);
@@ -70,6 +78,20 @@ class OutputHandler : public PacketQueue, public ICoroutineHandler {
     int set_stop();
     int cycle() override;
     int on_thread_stop() override;
+
+ private:
+    /*
+    *   connect and request the forward, retry with backoff until success or stop,
+    *   then replay the gop cache of channel.
+    */
+    int forward_start();
+    int send_status(int status);
+    /*
+    *   drop the video by the congestion of output conn, the audio and sequence
+    *   headers are always sent. the disposable frames are dropped when light,
+    *   all video until the next key frame when heavy.
+    */
+    bool should_drop(std::shared_ptr<IPacket> packet);
 };
 
 }  // namespace tmss
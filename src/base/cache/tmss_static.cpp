@@ -3,7 +3,10 @@
  * Copyright (c) 2020 rainwu
  */
 #include "tmss_static.hpp"
+#include <fcntl.h>
+#include <unistd.h>
 #include <algorithm>
+#include <atomic>
 #include "defs/err.hpp"
 #include <log/log.hpp>
 #include <util/timer.hpp>
@@ -11,16 +14,37 @@
 
 
 namespace tmss {
+// the files on disk of all threads, for the unique names in the cache dir
+std::atomic<int64_t> disk_file_seq(0);
+
 int file_read_packet(void *opaque, uint8_t *buf, int buf_size) {
     FileInputHandler* input = static_cast<FileInputHandler*>(opaque);
     return input->fetch_stream(reinterpret_cast<char*>(buf), buf_size);   // client_conn
 }
 
+static int disk_write(int fd, const char* buffer, int size, int offset) {
+    int written = 0;
+    while (written < size) {
+        ssize_t n = ::pwrite(fd, buffer + written, size - written, offset + written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            tmss_error("disk write error, size={}, offset={}, errno={}", size, offset, errno);
+            return error_file_disk_write;
+        }
+        written += n;
+    }
+    return error_success;
+}
+
 File::File() {
     this->data = nullptr;
     size = pos = total_length = 0;
     cond = st_cond_new();
     update_time_ms = 0;
+    fd = -1;
+    disk_min_size = 0;
 }
 
 File::File(const std::string & file_name) {
@@ -29,10 +53,16 @@ File::File(const std::string & file_name) {
     name = file_name;
     cond = st_cond_new();
     update_time_ms = 0;
+    fd = -1;
+    disk_min_size = 0;
 }
 
 File::~File() {
     st_cond_destroy(cond);
+    if (fd >= 0) {
+        ::close(fd);
+        ::unlink(disk_path.c_str());
+    }
 }
 
 std::shared_ptr<File> File::copy() {
@@ -58,6 +88,16 @@ int File::left_size() {
 int File::init_buffer(int new_size) {
     int ret = error_success;
     tmss_info("reset buffer, old_size={}, new_size={}", size, new_size);
+    if (fd >= 0) {
+        // no buffer for the file on disk
+        return ret;
+    }
+    if (!disk_path.empty() && new_size >= disk_min_size) {
+        if (spill() == error_success) {
+            return ret;
+        }
+        // the disk is not available, keep it in memory
+    }
     if (new_size >= 1024 * 1024 * 1024) {
         tmss_error("reset error, ret={}", ret);
         return error_file_buffer_too_large;
@@ -70,6 +110,8 @@ int File::init_buffer(int new_size) {
         char* new_data = new char[new_size + 1];
         size = new_size;
         memcpy(new_data, data, pos);    // copy data to new buffer
+        delete []data;
+        data = new_data;
     } else {
         this->data = new char[new_size + 1];
         size = new_size;
@@ -77,6 +119,31 @@ int File::init_buffer(int new_size) {
     return ret;
 }
 
+void File::set_disk(const std::string& path, int min_size) {
+    disk_path = path;
+    disk_min_size = min_size;
+}
+
+int File::spill() {
+    int disk_fd = ::open(disk_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (disk_fd < 0) {
+        tmss_warn("open disk file error, path={}, errno={}", disk_path.c_str(), errno);
+        return error_file_disk_open;
+    }
+    int ret = disk_write(disk_fd, data, pos, 0);
+    if (ret != error_success) {
+        ::close(disk_fd);
+        ::unlink(disk_path.c_str());
+        return ret;
+    }
+    fd = disk_fd;
+    delete []data;
+    data = nullptr;
+    size = 0;
+    tmss_info("file spill to disk, path={}, current_length={}", disk_path.c_str(), pos);
+    return ret;
+}
+
 int File::append(std::shared_ptr<IPacket> packet) {
     return append(packet->buffer(), packet->get_size());
 }
@@ -84,15 +151,23 @@ int File::append(std::shared_ptr<IPacket> packet) {
 int File::append(const char* buffer, int append_size) {
     int ret = error_success;
 
-    if (append_size > left_size()) {
+    if (fd < 0 && append_size > left_size()) {
         // return error_file_buffer_not_enough;
         init_buffer(16 * (Max(size, append_size) + 1));   // to do
-        if (append_size > left_size()) {
+        if (fd < 0 && append_size > left_size()) {
             tmss_error("file too large, append_size={}, left_size={}", append_size, left_size());
             return error_file_buffer_not_enough;
         }
     }
-    memcpy(data, buffer, append_size);
+    if (fd >= 0) {
+        // to the page cache, written back by kernel
+        ret = disk_write(fd, buffer, append_size, pos);
+        if (ret != error_success) {
+            return ret;
+        }
+    } else {
+        memcpy(data + pos, buffer, append_size);
+    }
     pos += append_size;
 
     // if (total_length < pos) {
@@ -122,13 +197,52 @@ int File::seek_range(char* buffer, int& wanted_size,
         tmss_info("wanted_size={}", wanted_size);
     }
     // char * start = static_cast<char*>(this->data + offset);
-    memcpy(buffer, this->data + offset, wanted_size);
+    if (fd >= 0) {
+        int read_size = 0;
+        while (read_size < wanted_size) {
+            ssize_t n = ::pread(fd, buffer + read_size, wanted_size - read_size,
+                offset + read_size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                tmss_error("disk read error, offset={}, errno={}", offset + read_size, errno);
+                return error_file_disk_read;
+            }
+            read_size += n;
+        }
+    } else {
+        memcpy(buffer, this->data + offset, wanted_size);
+    }
 
     return ret;
 }
 
+int File::wait_range(int offset, int timeout_us) {
+    if (offset >= pos) {
+        // no new data
+        st_cond_timedwait(cond, timeout_us);
+    }
+    return Max(get_current_length() - offset, 0);
+}
+
+FileCache::FileCache() {
+    disk_min_size = 0;
+}
+
+void FileCache::set_disk_dir(const std::string& dir, int min_size) {
+    disk_dir = dir;
+    disk_min_size = min_size;
+    tmss_info("file cache disk, dir={}, min_size={}", dir.c_str(), min_size);
+}
+
 int FileCache::add_file(const std::string& name, std::shared_ptr<File> file) {
     int ret = error_success;
+    if (!disk_dir.empty()) {
+        // the names of url are not unique among threads and processes sharing the dir
+        file->set_disk(disk_dir + "/tmss_" + std::to_string(getpid()) + "_"
+            + std::to_string(disk_file_seq++), disk_min_size);
+    }
     auto iter = file_cache.find(name);
     if (iter == file_cache.end()) {
         file_cache.insert(std::make_pair(name, file));
@@ -166,10 +280,13 @@ FileInputHandler::FileInputHandler(std::shared_ptr<File> file,
     this->file = file;
     this->pool = pool;
     status = ESourceInit;
+    total_size = 0;
+    handle_size = 0;
 }
 
 int FileInputHandler::fetch_stream(char* buff, int &wanted_size) {
-    int read_size = input_conn->read(buff, wanted_size);
+    // the body may be read to the buffer of client with the header
+    int read_size = client->read_data(buff, wanted_size);
     tmss_info("read data_size={}", read_size);
     return read_size;
 }
@@ -182,6 +299,10 @@ void FileInputHandler::init_format(std::shared_ptr<IDeMux> demux) {
     this->demux = demux;
 }
 
+void FileInputHandler::init_origin_client(std::shared_ptr<IClient> origin_client) {
+    this->client = origin_client;
+}
+
 void FileInputHandler::set_origin_address(Address& origin_address) {
     this->origin_address = origin_address;
 }
@@ -232,7 +353,8 @@ int FileInputHandler::cycle() {
     tmss_info("file input start");
     if (input_type == EInputOrigin) {
         if (status == ESourceInit) {
-            int ret = input_conn->connect(origin_address);
+            // the idle connection to origin is reused if any
+            int ret = client->connect_origin(origin_address);
             if (ret != 0) {
                 tmss_error("origin connect error, {}", ret);
                 return ret;
@@ -246,6 +368,7 @@ int FileInputHandler::cycle() {
                 tmss_error("origin ingest error, {}", ret);
                 return ret;
             }
+            input_conn = client->conn;
             status = ESourceStart;
 
             total_size = demux->get_total_length();
@@ -291,6 +414,7 @@ int FileInputHandler::cycle() {
         if ((total_size > 0) && (handle_size >= total_size)) {
             // complete
             tmss_info("file complete, file_size={}", total_size);
+            client->release_conn();
             break;
         }
         // if chunk end
@@ -29,6 +29,11 @@ class File {
     st_cond_t cond;
     int64_t  update_time_ms;
 
+    // the disk tier, the data is in the file of disk_path instead of memory when fd is valid
+    int         fd;
+    std::string disk_path;
+    int         disk_min_size;
+
  public:
     File();
     explicit File(const std::string & file_name);
@@ -40,6 +45,13 @@ class File {
 
     int init_buffer(int new_size);
     /*
+    *   spill to the file of path when the buffer grows to min_size,
+    *   the file is removed with this.
+    */
+    void set_disk(const std::string& path, int min_size);
+    // the file on disk, -1 if the data is in memory
+    int get_fd() { return fd; }
+    /*
     *   write new data to file cache
     */
     int append(std::shared_ptr<IPacket> packet);
@@ -56,6 +68,10 @@ class File {
     */
     int seek_range(char* buffer, int& wanted_size,
         int offset = 0, int timeout_us = -1);
+    /*
+    *   wait for the data after offset as seek_range, return the size of it
+    */
+    int wait_range(int offset = 0, int timeout_us = -1);
 
     // int add_input(std::shared_ptr<FileInputHandler> input);
     // int del_input(std::shared_ptr<FileInputHandler> input);
@@ -65,13 +81,22 @@ class File {
     int get_current_length() { return pos; }
 
     int64_t get_update_time()   { return update_time_ms; }
+
+ private:
+    // move the data in memory to the disk file
+    int spill();
 };
 
 class FileCache {
  public:
-    FileCache() = default;
+    FileCache();
     virtual ~FileCache() = default;
 
+    /*
+    *   the files larger than min_size are spilled to dir, served from the page cache,
+    *   all files are in memory if dir is empty.
+    */
+    void set_disk_dir(const std::string& dir, int min_size);
     int add_file(const std::string& name, std::shared_ptr<File> file);
     std::shared_ptr<File> get_file(const std::string& file_name);
     int del_file(const std::string& file_name);
@@ -79,6 +104,8 @@ class FileCache {
 
  private:
     std::map<std::string, std::shared_ptr<File>> file_cache;
+    std::string disk_dir;
+    int disk_min_size;
 };
 
 class FileInputHandler : public ICoroutineHandler {
@@ -89,6 +116,7 @@ class FileInputHandler : public ICoroutineHandler {
     int fetch_stream(char* buff, int &wanted_size);
     void init_conn(std::shared_ptr<IClientConn> conn);
     void init_format(std::shared_ptr<IDeMux> demux);
+    void init_origin_client(std::shared_ptr<IClient> origin_client);
     void set_origin_address(Address& origin_address);
     void set_origin_info(Address& origin_address,
         const std::string& origin_host,
@@ -168,6 +168,11 @@ error_t STCoroutine::cycle() {
 
     disposed = true;
     cycle_done = true;
+    // Set the err for function pull to fetch it, before on_thread_stop,
+    // which may release the handler and this coroutine.
+    if (err != error_success) {
+        trd_err = err;
+    }
     if (!handler.lock()) {
         return err;
     }
@@ -181,14 +186,9 @@ error_t STCoroutine::cycle() {
 void* STCoroutine::pfn(void* arg) {
     auto p = static_cast<STCoroutine*>(arg);
 
-    error_t err = p->cycle();
-
-    // Set the err for function pull to fetch it.
+    // The err is set in cycle, p may be freed after it returns.
     // @see https://github.com/ossrs/srs/pull/1304#issuecomment-480484151
-    if (err != error_success) {
-        // It's ok to directly use it, because it's returned by st_thread_join.
-        p->trd_err = err;
-    }
+    p->cycle();
 
     return nullptr;
 }
@@ -35,6 +35,9 @@ typedef uint64_t utime_t;
 #define error_socket_set_resuse    10010
 #define error_socket_connect     10011
 #define error_system_ip_invalid 10012
+#define error_dns_resolve       10013
+#define error_dns_timeout       10014
+#define error_dns_no_answer     10015
 #define error_cothread_start    10020
 #define error_cothread_interrupt 10021
 #define error_cothread_stop     10022
@@ -53,7 +56,12 @@ typedef uint64_t utime_t;
 #define error_srt_socket_noexist     10114
 #define error_srt_socket_other       10115
 #define error_srt_socket_eintr       10116
+#define error_srt_streamid_invalid   10117
+#define error_uring_setup            10201
+#define error_uring_register         10202
+#define error_uring_submit           10203
 #define error_config_load            10500
+#define error_config_conflict        10501
 
 //  cache
 #define error_channel_killed  11001
@@ -62,6 +70,8 @@ typedef uint64_t utime_t;
 #define error_buffer_not_enough  12003
 #define error_ingest_no_input    13001
 #define error_ingest_no_client   13002
+#define error_origin_no_address  13003
+#define error_origin_connect     13004
 #define error_queue_is_empty     13101
 
 // protocol
@@ -76,14 +86,29 @@ typedef uint64_t utime_t;
 #define error_rtmp_amf0_invalid 14106
 #define error_rtmp_message_encode 14107
 #define error_rtmp_chunk_size 14108
+#define error_rtmp_forward_input 14109
+#define error_rtmp_publish_rejected 14110
 #define error_tag_type_invalid 14200
 #define error_rtmp_message_decode 14201
+#define error_flv_header_invalid 14202
+
+//  http
+#define error_http_request_invalid      15001
+#define error_http_header_too_large     15002
+#define error_http2_preface_invalid     15101
+#define error_http2_protocol            15102
+#define error_http2_hpack_decode        15103
+#define error_http2_flow_control        15104
+#define error_http2_frame_size          15105
 
 //  file
 #define error_file_buffer_not_enough    16001
 #define error_file_read_not_complete    16002
 #define error_file_buffer_init_small    16003
 #define error_file_buffer_too_large     16004
+#define error_file_disk_open            16005
+#define error_file_disk_write           16006
+#define error_file_disk_read            16007
 
 //  ffmpeg
 #define error_ffmpeg_init_input         17001
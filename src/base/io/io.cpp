@@ -8,4 +8,63 @@
  * =====================================================================================
  */
 
-#include <io/io.hpp>
\ No newline at end of file
+#include <io/io.hpp>
+
+#include <limits.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <io/io_buf.hpp>
+
+namespace tmss {
+int IReader::readv(const iovec *iov, int iov_size) {
+    for (int i = 0; i < iov_size; i++) {
+        if (iov[i].iov_len > 0) {
+            return read(static_cast<char*>(iov[i].iov_base), static_cast<int>(iov[i].iov_len));
+        }
+    }
+    return 0;
+}
+
+int IReader::read_buf(IOBuf& buf, int size) {
+    char* p = buf.prepare(size);
+    int read_size = read(p, size);
+    buf.commit((read_size > 0) ? read_size : 0);
+    return read_size;
+}
+
+int IWriter::writev(const iovec *iov, int iov_size) {
+    int write_size = 0;
+    for (int i = 0; i < iov_size; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+        int ret = write(static_cast<const char*>(iov[i].iov_base), static_cast<int>(iov[i].iov_len));
+        if (ret < 0) {
+            return ret;
+        }
+        write_size += ret;
+    }
+    return write_size;
+}
+
+int IWriter::write_buf(const IOBuf& buf) {
+    if (buf.empty()) {
+        return 0;
+    }
+    std::vector<iovec> iovs;
+    buf.to_iovec(iovs);
+    int write_size = 0;
+    for (size_t pos = 0; pos < iovs.size(); pos += IOV_MAX) {
+        int count = static_cast<int>(std::min(iovs.size() - pos, static_cast<size_t>(IOV_MAX)));
+        int ret = writev(iovs.data() + pos, count);
+        if (ret < 0) {
+            return ret;
+        }
+        write_size += ret;
+    }
+    return write_size;
+}
+
+}  // namespace tmss
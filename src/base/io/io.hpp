@@ -12,19 +12,26 @@
 #include <sys/uio.h>
 
 namespace tmss {
+class IOBuf;
 
 class IReader {
  public:
     virtual ~IReader() = default;
     virtual int read(char* buf, int size) = 0;
-    virtual int readv(const iovec *iov, int iov_size) { return 0;}
+    // read once to the iovecs in order, the default reads to the first one
+    virtual int readv(const iovec *iov, int iov_size);
+    // read once to the tail of buf, at most size bytes
+    virtual int read_buf(IOBuf& buf, int size);
 };
 
 class IWriter {
  public:
     virtual ~IWriter() = default;
     virtual int write(const char* buf, int size) = 0;
-    virtual int writev(const iovec *iov, int iov_size) { return 0;}
+    // write all iovecs, the default writes them one by one
+    virtual int writev(const iovec *iov, int iov_size);
+    // write all slices of buf by writev
+    virtual int write_buf(const IOBuf& buf);
 };
 
 class IReaderWriter : public IReader, public IWriter {
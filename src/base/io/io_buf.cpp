@@ -0,0 +1,216 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  weideng.
+ *
+ * =====================================================================================
+ */
+
+#include <io/io_buf.hpp>
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace tmss {
+// 16MB for each st thread
+const int max_free_io_blocks = 1024;
+// the space less than it is left, not to read a few bytes
+const int min_io_block_space = 1024;
+
+IOBlock::IOBlock(int capacity) {
+    data = new char[capacity];
+    this->capacity = capacity;
+    used = 0;
+    reserved = false;
+}
+
+IOBlock::~IOBlock() {
+    delete []data;
+}
+
+IOBlockPool::IOBlockPool() {
+}
+
+IOBlockPool::~IOBlockPool() {
+    for (auto block : free_blocks) {
+        delete block;
+    }
+    free_blocks.clear();
+}
+
+std::shared_ptr<IOBlock> IOBlockPool::alloc() {
+    IOBlock* block = nullptr;
+    if (!free_blocks.empty()) {
+        block = free_blocks.back();
+        free_blocks.pop_back();
+        block->used = 0;
+        block->reserved = false;
+    } else {
+        block = new IOBlock(TMSS_IO_BLOCK_SIZE);
+    }
+
+    // the pool may be released before the block, at the exit of thread
+    std::weak_ptr<IOBlockPool> pool = get_instance();
+    return std::shared_ptr<IOBlock>(block, [pool](IOBlock* block) {
+        std::shared_ptr<IOBlockPool> owner = pool.lock();
+        if (owner) {
+            owner->release(block);
+        } else {
+            delete block;
+        }
+    });
+}
+
+void IOBlockPool::release(IOBlock* block) {
+    if (static_cast<int>(free_blocks.size()) >= max_free_io_blocks) {
+        delete block;
+        return;
+    }
+    free_blocks.push_back(block);
+}
+
+std::shared_ptr<IOBlockPool> IOBlockPool::get_instance() {
+    thread_local std::shared_ptr<IOBlockPool> ins = nullptr;
+    if (!ins) {
+        ins = std::make_shared<IOBlockPool>();
+    }
+    return ins;
+}
+
+IOBuf::IOBuf() {
+    length = 0;
+}
+
+void IOBuf::clear() {
+    slices.clear();
+    length = 0;
+    tail = nullptr;
+}
+
+char* IOBuf::prepare(int& size) {
+    std::shared_ptr<IOBlock> block = slices.empty() ? tail : slices.back().block;
+    if (!block || block->reserved
+            || block->capacity - block->used < std::min(size, min_io_block_space)) {
+        block = IOBlockPool::get_instance()->alloc();
+    }
+
+    // the bytes after used are not in any slice, write on them,
+    // the new slice starts if the last slice does not end at used
+    if (slices.empty() || slices.back().block != block
+            || slices.back().offset + slices.back().size != block->used) {
+        Slice slice;
+        slice.block = block;
+        slice.offset = block->used;
+        slice.size = 0;
+        slices.push_back(slice);
+    }
+    tail = nullptr;
+    block->reserved = true;
+
+    size = std::min(size, block->capacity - block->used);
+    return block->data + block->used;
+}
+
+void IOBuf::commit(int size) {
+    if (slices.empty()) {
+        return;
+    }
+    Slice& slice = slices.back();
+    slice.block->reserved = false;
+    if (size > 0) {
+        slice.size += size;
+        slice.block->used += size;
+        length += size;
+    }
+    if (slice.size == 0) {
+        // nothing is written, keep the block for the next prepare
+        tail = slice.block;
+        slices.pop_back();
+    }
+}
+
+void IOBuf::append(const char* data, int size) {
+    while (size > 0) {
+        int wanted = size;
+        char* p = prepare(wanted);
+        memcpy(p, data, wanted);
+        commit(wanted);
+        data += wanted;
+        size -= wanted;
+    }
+}
+
+void IOBuf::append(const IOBuf& other) {
+    for (auto& slice : other.slices) {
+        slices.push_back(slice);
+    }
+    length += other.length;
+}
+
+int IOBuf::cut(IOBuf& out, int size) {
+    int cut_size = 0;
+    while (cut_size < size && !slices.empty()) {
+        Slice& slice = slices.front();
+        int wanted = std::min(size - cut_size, slice.size);
+        Slice part = slice;
+        part.size = wanted;
+        out.slices.push_back(part);
+        out.length += wanted;
+        cut_size += wanted;
+        pop_front(wanted);
+    }
+    return cut_size;
+}
+
+void IOBuf::pop_front(int size) {
+    while (size > 0 && !slices.empty()) {
+        Slice& slice = slices.front();
+        if (size < slice.size) {
+            slice.offset += size;
+            slice.size -= size;
+            length -= size;
+            return;
+        }
+        size -= slice.size;
+        length -= slice.size;
+        if (slices.size() == 1) {
+            tail = slice.block;
+        }
+        slices.pop_front();
+    }
+}
+
+int IOBuf::copy_to(char* dst, int size) const {
+    int copied = 0;
+    for (auto& slice : slices) {
+        if (copied >= size) {
+            break;
+        }
+        int wanted = std::min(size - copied, slice.size);
+        memcpy(dst + copied, slice.block->data + slice.offset, wanted);
+        copied += wanted;
+    }
+    return copied;
+}
+
+void IOBuf::to_iovec(std::vector<iovec>& iovs) const {
+    for (auto& slice : slices) {
+        iovec iov;
+        iov.iov_base = slice.block->data + slice.offset;
+        iov.iov_len = slice.size;
+        iovs.push_back(iov);
+    }
+}
+
+const char* IOBuf::front_data() const {
+    return slices.empty() ? nullptr : slices.front().block->data + slices.front().offset;
+}
+
+int IOBuf::front_size() const {
+    return slices.empty() ? 0 : slices.front().size;
+}
+
+}  // namespace tmss
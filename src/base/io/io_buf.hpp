@@ -0,0 +1,110 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  weideng.
+ *
+ * =====================================================================================
+ */
+#pragma once
+
+#include <sys/uio.h>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace tmss {
+#define TMSS_IO_BLOCK_SIZE (16 * 1024)
+
+/*
+*   a fixed size block, the bytes before used are never changed,
+*   so they can be shared by the slices of many IOBuf.
+*/
+class IOBlock {
+ public:
+    explicit IOBlock(int capacity);
+    ~IOBlock();
+
+ public:
+    char* data;
+    int capacity;
+    // the bytes written, the next write starts from it
+    int used;
+    // an IOBuf is writing after used, between prepare and commit
+    bool reserved;
+};
+
+/*
+*   the free blocks of st thread, the block returns here when not referenced.
+*/
+class IOBlockPool {
+ public:
+    IOBlockPool();
+    virtual ~IOBlockPool();
+
+ public:
+    std::shared_ptr<IOBlock> alloc();
+
+ public:
+    static std::shared_ptr<IOBlockPool> get_instance();
+
+ private:
+    void release(IOBlock* block);
+
+ private:
+    std::vector<IOBlock*> free_blocks;
+};
+
+/*
+*   the refcounted chained buffer, a list of slices over the pooled blocks.
+*   copy or cut of IOBuf shares the blocks, never copy the bytes, so the bytes
+*   read from the socket are written to all outputs by writev.
+*/
+class IOBuf {
+ public:
+    IOBuf();
+
+ public:
+    int size() const { return length; }
+    bool empty() const { return length == 0; }
+    void clear();
+
+    /*
+    *   the space to write at tail, in the last block or a new block.
+    *   @param size the wanted size, set to the size of space, which may be less.
+    */
+    char* prepare(int& size);
+    // the size bytes are written to the space of prepare
+    void commit(int size);
+
+    // copy the bytes to tail
+    void append(const char* data, int size);
+    // share the bytes of other, never copy
+    void append(const IOBuf& other);
+    // move the first size bytes to out, the blocks are shared
+    int cut(IOBuf& out, int size);
+    void pop_front(int size);
+
+    // copy the first size bytes to dst, return the copied size
+    int copy_to(char* dst, int size) const;
+    // the slices as iovecs, for writev
+    void to_iovec(std::vector<iovec>& iovs) const;
+    int slice_count() const { return static_cast<int>(slices.size()); }
+    // the continuous bytes of the first slice
+    const char* front_data() const;
+    int front_size() const;
+
+ private:
+    struct Slice {
+        std::shared_ptr<IOBlock> block;
+        int offset;
+        int size;
+    };
+    std::deque<Slice> slices;
+    int length;
+    // the last block after all bytes are cut, the next prepare writes on
+    std::shared_ptr<IOBlock> tail;
+};
+
+}  // namespace tmss
@@ -9,24 +9,38 @@
  */
 
 #include <io/io_buffer.hpp>
+
+#include <limits.h>
+
+#include <algorithm>
+
 #include <defs/err.hpp>
 #include <log/log.hpp>
 #include <util/util.hpp>
 
 namespace tmss {
+// not to read a few bytes, which makes many small reads
+const int default_read_low_water = 4 * 1024;
+const int default_read_max_size = 1024 * 1024;
+
 Buffer::Buffer() {
     buf = nullptr;
     size = 0;
     rpos = wpos = 0;
+    owned = false;
 }
 
 Buffer::Buffer(char* buffer, int size) {
     this->buf = buffer;
     this->size = size;
     rpos = wpos = 0;
+    owned = false;
 }
 
 Buffer::~Buffer() {
+    if (owned) {
+        delete []buf;
+    }
 }
 
 int Buffer::get_size() {
@@ -108,71 +122,50 @@ int8_t Buffer::read_1byte() {
 
 int16_t Buffer::read_2bytes() {
     assert(read_left() >= 2);
-
-    int16_t value = 0;
-    char* pp = reinterpret_cast<char*>(&value);
-    pp[1] = *(buf + rpos);
-    seek_read(1);
-    pp[0] = *(buf + rpos);
-    seek_read(1);
-
+    if (rpos + 2 > size) {
+        return static_cast<int16_t>(read_wrapped(2));
+    }
+    int16_t value = load_be16(buf + rpos);
+    rpos = (rpos + 2 == size) ? 0 : rpos + 2;
     return value;
 }
 
 int32_t Buffer::read_3bytes() {
     assert(read_left() >= 3);
-
-    int32_t value = 0;
-    char* pp = reinterpret_cast<char*>(&value);
-    pp[2] = *(buf + rpos);
-    seek_read(1);
-    pp[1] = *(buf + rpos);
-    seek_read(1);
-    pp[0] = *(buf + rpos);
-    seek_read(1);
-
+    if (rpos + 3 > size) {
+        return static_cast<int32_t>(read_wrapped(3));
+    }
+    int32_t value = load_be24(buf + rpos);
+    rpos = (rpos + 3 == size) ? 0 : rpos + 3;
     return value;
 }
 
 int32_t Buffer::read_4bytes() {
     assert(read_left() >= 4);
-
-    int32_t value = 0;
-    char* pp = reinterpret_cast<char*>(&value);
-    pp[3] = *(buf + rpos);
-    seek_read(1);
-    pp[2] = *(buf + rpos);
-    seek_read(1);
-    pp[1] = *(buf + rpos);
-    seek_read(1);
-    pp[0] = *(buf + rpos);
-    seek_read(1);
-
+    if (rpos + 4 > size) {
+        return static_cast<int32_t>(read_wrapped(4));
+    }
+    int32_t value = load_be32(buf + rpos);
+    rpos = (rpos + 4 == size) ? 0 : rpos + 4;
     return value;
 }
 
 int64_t Buffer::read_8bytes() {
     assert(read_left() >= 8);
+    if (rpos + 8 > size) {
+        return static_cast<int64_t>(read_wrapped(8));
+    }
+    int64_t value = load_be64(buf + rpos);
+    rpos = (rpos + 8 == size) ? 0 : rpos + 8;
+    return value;
+}
 
-    int64_t value = 0;
-    char* pp = reinterpret_cast<char*>(&value);
-    pp[7] = *(buf + rpos);
-    seek_read(1);
-    pp[6] = *(buf + rpos);
-    seek_read(1);
-    pp[5] = *(buf + rpos);
-    seek_read(1);
-    pp[4] = *(buf + rpos);
-    seek_read(1);
-    pp[3] = *(buf + rpos);
-    seek_read(1);
-    pp[2] = *(buf + rpos);
-    seek_read(1);
-    pp[1] = *(buf + rpos);
-    seek_read(1);
-    pp[0] = *(buf + rpos);
-    seek_read(1);
-
+uint64_t Buffer::read_wrapped(int len) {
+    uint64_t value = 0;
+    for (int i = 0; i < len; i++) {
+        value = (value << 8) | static_cast<uint8_t>(buf[rpos]);
+        rpos = (rpos + 1) % size;
+    }
     return value;
 }
 
@@ -229,12 +222,12 @@ int Buffer::write_2bytes(int16_t value) {
     assert(write_left() >= 2);
 
     int ret = error_success;
-
-    char* pp = reinterpret_cast<char*>(&value);
-    *(buf + wpos) = pp[1];
-    seek_write(1);
-    *(buf + wpos) = pp[0];
-    seek_write(1);
+    if (wpos + 2 > size) {
+        write_wrapped(static_cast<uint16_t>(value), 2);
+        return ret;
+    }
+    store_be16(buf + wpos, value);
+    wpos = (wpos + 2 == size) ? 0 : wpos + 2;
     return ret;
 }
 
@@ -242,14 +235,12 @@ int Buffer::write_3bytes(int32_t value) {
     assert(write_left() >= 3);
 
     int ret = error_success;
-
-    char* pp = reinterpret_cast<char*>(&value);
-    *(buf + wpos) = pp[2];
-    seek_write(1);
-    *(buf + wpos) = pp[1];
-    seek_write(1);
-    *(buf + wpos) = pp[0];
-    seek_write(1);
+    if (wpos + 3 > size) {
+        write_wrapped(static_cast<uint32_t>(value), 3);
+        return ret;
+    }
+    store_be24(buf + wpos, value);
+    wpos = (wpos + 3 == size) ? 0 : wpos + 3;
     return ret;
 }
 
@@ -257,16 +248,12 @@ int Buffer::write_4bytes(int32_t value) {
     assert(write_left() >= 4);
 
     int ret = error_success;
-
-    char* pp = reinterpret_cast<char*>(&value);
-    *(buf + wpos) = pp[3];
-    seek_write(1);
-    *(buf + wpos) = pp[2];
-    seek_write(1);
-    *(buf + wpos) = pp[1];
-    seek_write(1);
-    *(buf + wpos) = pp[0];
-    seek_write(1);
+    if (wpos + 4 > size) {
+        write_wrapped(static_cast<uint32_t>(value), 4);
+        return ret;
+    }
+    store_be32(buf + wpos, value);
+    wpos = (wpos + 4 == size) ? 0 : wpos + 4;
     return ret;
 }
 
@@ -274,27 +261,22 @@ int Buffer::write_8bytes(int64_t value) {
     assert(write_left() >= 8);
 
     int ret = error_success;
-
-    char* pp = reinterpret_cast<char*>(&value);
-    *(buf + wpos) = pp[7];
-    seek_write(1);
-    *(buf + wpos) = pp[6];
-    seek_write(1);
-    *(buf + wpos) = pp[5];
-    seek_write(1);
-    *(buf + wpos) = pp[4];
-    seek_write(1);
-    *(buf + wpos) = pp[3];
-    seek_write(1);
-    *(buf + wpos) = pp[2];
-    seek_write(1);
-    *(buf + wpos) = pp[1];
-    seek_write(1);
-    *(buf + wpos) = pp[0];
-    seek_write(1);
+    if (wpos + 8 > size) {
+        write_wrapped(static_cast<uint64_t>(value), 8);
+        return ret;
+    }
+    store_be64(buf + wpos, value);
+    wpos = (wpos + 8 == size) ? 0 : wpos + 8;
     return ret;
 }
 
+void Buffer::write_wrapped(uint64_t value, int len) {
+    for (int i = len - 1; i >= 0; i--) {
+        buf[wpos] = static_cast<char>(value >> (i * 8));
+        wpos = (wpos + 1) % size;
+    }
+}
+
 int Buffer::seek_read(int len) {
     int ret = error_success;
     if (len <= 0) {
@@ -338,6 +320,43 @@ void Buffer::reset() {
     rpos = wpos = 0;
 }
 
+void Buffer::compact() {
+    if (rpos == 0) {
+        return;
+    }
+    int left = read_left();
+    if (rpos <= wpos) {
+        memmove(buf, buf + rpos, left);
+    } else {
+        // wrapped, [rpos, size) is moved before [0, wpos)
+        std::rotate(buf, buf + rpos, buf + size);
+    }
+    rpos = 0;
+    wpos = left;
+}
+
+int Buffer::resize(int new_size) {
+    int left = read_left();
+    if (new_size <= left) {
+        tmss_error("resize too small, size={}, read_left={}", new_size, left);
+        return error_buffer_not_enough;
+    }
+
+    char* data = new char[new_size];
+    int continuous_left = continuous_read_left();
+    memcpy(data, buf + rpos, continuous_left);
+    memcpy(data + continuous_left, buf, left - continuous_left);
+    if (owned) {
+        delete []buf;
+    }
+    buf = data;
+    size = new_size;
+    rpos = 0;
+    wpos = left;
+    owned = true;
+    return error_success;
+}
+
 bool Buffer::read_require(int required_size) {
     //  srs_assert(required_size >= 0);
     if (required_size < 0) {
@@ -352,8 +371,43 @@ bool Buffer::read_empty() {
 
 IOBuffer::IOBuffer(std::shared_ptr<IReaderWriter> reader, std::shared_ptr<Buffer> buffer) {
     this->reader = reader;
+    this->writer = reader;
     this->buffer = buffer;
     no_cache = false;
+    low_water = default_read_low_water;
+    max_size = default_read_max_size;
+}
+
+void IOBuffer::set_read_water(int low_water, int max_size) {
+    this->low_water = low_water;
+    this->max_size = max_size;
+}
+
+int IOBuffer::ensure(int size) {
+    int ret = error_success;
+    // one byte of ring is never used
+    if (buffer->get_size() <= size) {
+        if (size >= max_size) {
+            ret = error_buffer_not_enough;
+            tmss_error("message too large, size={}, max_size={}, ret={}", size, max_size, ret);
+            return ret;
+        }
+        if ((ret = buffer->resize(std::min(max_size, std::max(buffer->get_size() * 2, size + 1))))
+                != error_success) {
+            return ret;
+        }
+    }
+    while (buffer->read_left() < size) {
+        int read_size = read_to_cache();
+        if (read_size <= 0) {
+            tmss_error("read to cache error, {}/{}, ret={}", buffer->read_left(), size, read_size);
+            return (read_size < 0) ? read_size : error_socket_read;
+        }
+    }
+    if (buffer->continuous_read_left() < size) {
+        buffer->compact();
+    }
+    return ret;
 }
 
 int IOBuffer::read_bytes(char* dst, int len) {
@@ -364,44 +418,69 @@ int IOBuffer::read_bytes(char* dst, int len) {
     read_size += wanted_size;
 
     // read left data
-    if (no_cache) {
+    int need_read_size = len - read_size;
+    if (need_read_size == 0) {
+        tmss_info("enough, read_size={}", read_size);
+        return read_size;
+    }
+
+    if (no_cache && need_read_size >= low_water) {
         // for no copy
-        // read left directly from connection
-        int read_from_reader = reader->read(dst + read_size, len - read_size);
+        // the large read is directly from connection, the small one is by cache
+        int read_from_reader = reader->read(dst + read_size, need_read_size);
+        if (read_from_reader < 0) {
+            tmss_error("read from connection error,ret={}", read_from_reader);
+            return (read_size > 0) ? read_size : read_from_reader;
+        }
         read_size += read_from_reader;
         tmss_info("read from connection, read_size={}", read_size);
-    } else {
-        int need_read_size = len - read_size;
-        if (need_read_size == 0) {
-            tmss_info("enough, read_size={}", read_size);
-            return read_size;
-        }
+        return read_size;
+    }
 
-        // read to buffer
-        int continuous_write_left_size = buffer->continuous_write_left();
-        int read_size_from_reader = reader->read(buffer->wcurrent(),
-            continuous_write_left_size);
-        if (read_size_from_reader < 0) {
-            tmss_error("read from connection error,ret={}", read_size_from_reader);
-            return read_size_from_reader;
-        }
-        tmss_info("read from reader, {}/{}",
-            read_size_from_reader, continuous_write_left_size);
-        buffer->seek_write(read_size_from_reader);
+    // read to buffer
+    int read_size_from_reader = read_to_cache();
+    if (read_size_from_reader < 0) {
+        tmss_error("read from connection error,ret={}", read_size_from_reader);
+        return (read_size > 0) ? read_size : read_size_from_reader;
+    }
 
-        wanted_size = need_read_size;
-        read_from_cache(dst + read_size, wanted_size);
-        read_size += wanted_size;
+    wanted_size = need_read_size;
+    read_from_cache(dst + read_size, wanted_size);
+    read_size += wanted_size;
 
-        tmss_info("write to cache and read, write={},need_read={}, once_read={}, read={}",
-            read_size_from_reader, need_read_size, wanted_size, read_size);
-    }
+    tmss_info("write to cache and read, write={},need_read={}, once_read={}, read={}",
+        read_size_from_reader, need_read_size, wanted_size, read_size);
     tmss_info("read_size={}/{}", read_size, len);
     return read_size;
 }
 
 int IOBuffer::write_bytes(const char *src, int size) {
-    return 0;
+    if (size <= 0) {
+        return error_success;
+    }
+    iovec iov;
+    iov.iov_base = const_cast<char*>(src);
+    iov.iov_len = size;
+    pending.push_back(iov);
+    if (static_cast<int>(pending.size()) >= IOV_MAX) {
+        int ret = flush();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return error_success;
+}
+
+int IOBuffer::flush() {
+    if (pending.empty()) {
+        return 0;
+    }
+    int write_size = writer->writev(pending.data(), static_cast<int>(pending.size()));
+    if (write_size < 0) {
+        tmss_error("flush error, iov_size={}, ret={}", pending.size(), write_size);
+    }
+    pending.clear();
+    return write_size;
 }
 
 int IOBuffer::seek_read(int len) {
@@ -412,6 +491,58 @@ int IOBuffer::seek_write(int len) {
     return buffer->seek_write(len);
 }
 
+int IOBuffer::fill() {
+    return read_to_cache();
+}
+
+void IOBuffer::prepare_cache() {
+    if (buffer->read_left() == 0) {
+        buffer->reset();
+    }
+    if (buffer->continuous_write_left() >= low_water) {
+        return;
+    }
+    // not to read a few bytes at the end, move the bytes to read to the start
+    buffer->compact();
+    if (buffer->write_left() >= low_water || buffer->get_size() >= max_size) {
+        return;
+    }
+    // the large message fills the cache
+    int new_size = std::min(max_size, std::max(buffer->get_size() * 2,
+        buffer->read_left() + low_water + 1));
+    buffer->resize(new_size);
+    tmss_info("cache grows, size={}, read_left={}", new_size, buffer->read_left());
+}
+
+int IOBuffer::read_to_cache() {
+    prepare_cache();
+    if (buffer->write_left() <= 0) {
+        tmss_error("no buffer to fill, read_left={}", buffer->read_left());
+        return -1;
+    }
+
+    // the free space is at tail and head of the ring
+    iovec iovs[2];
+    int iov_size = 1;
+    int write_left = buffer->write_left();
+    int continuous_write_left = buffer->continuous_write_left();
+    iovs[0].iov_base = buffer->wcurrent();
+    iovs[0].iov_len = continuous_write_left;
+    if (write_left > continuous_write_left) {
+        iovs[1].iov_base = buffer->start();
+        iovs[1].iov_len = write_left - continuous_write_left;
+        iov_size = 2;
+    }
+
+    int read_size = (iov_size == 1) ? reader->read(buffer->wcurrent(), continuous_write_left)
+        : reader->readv(iovs, iov_size);
+    if (read_size > 0) {
+        buffer->seek_write(read_size);
+    }
+    tmss_info("read from reader, {}/{}", read_size, write_left);
+    return read_size;
+}
+
 int IOBuffer::read_from_cache(char* dst, int& len) {
     int ret = error_success;
     int read_size = 0;
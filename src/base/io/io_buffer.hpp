@@ -8,11 +8,101 @@
  * =====================================================================================
  */
 #pragma once
+#include <stdint.h>
+#include <string.h>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <io.hpp>
 
 namespace tmss {
+/*
+*   the unaligned big-endian load and store, one move and one bswap,
+*   the host is little-endian.
+*/
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+    "load_be and store_be swap the bytes, only for the little-endian host");
+
+inline uint16_t load_be16(const char* p) {
+    uint16_t value;
+    memcpy(&value, p, 2);
+    return __builtin_bswap16(value);
+}
+
+inline uint32_t load_be24(const char* p) {
+    return (static_cast<uint32_t>(load_be16(p)) << 8) | static_cast<uint8_t>(p[2]);
+}
+
+inline uint32_t load_be32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return __builtin_bswap32(value);
+}
+
+inline uint64_t load_be64(const char* p) {
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return __builtin_bswap64(value);
+}
+
+inline void store_be16(char* p, uint16_t value) {
+    value = __builtin_bswap16(value);
+    memcpy(p, &value, 2);
+}
+
+inline void store_be24(char* p, uint32_t value) {
+    store_be16(p, static_cast<uint16_t>(value >> 8));
+    p[2] = static_cast<char>(value);
+}
+
+inline void store_be32(char* p, uint32_t value) {
+    value = __builtin_bswap32(value);
+    memcpy(p, &value, 4);
+}
+
+inline void store_be64(char* p, uint64_t value) {
+    value = __builtin_bswap64(value);
+    memcpy(p, &value, 8);
+}
+
+/*
+*   read and write the big-endian fields of continuous bytes, such as a message
+*   header or payload. the bounds are checked once for a message by require,
+*   the reads and writes after it never check.
+*/
+class BufferCursor {
+ public:
+    BufferCursor(char* data, int size) : start(data), p(data), end(data + size) {}
+
+ public:
+    bool require(int size) const { return size >= 0 && size <= end - p; }
+    int left() const { return static_cast<int>(end - p); }
+    int pos() const { return static_cast<int>(p - start); }
+    char* current() const { return p; }
+    void skip(int size) { p += size; }
+
+    int8_t read_1byte() { return *p++; }
+    int16_t read_2bytes() { int16_t value = load_be16(p); p += 2; return value; }
+    int32_t read_3bytes() { int32_t value = load_be24(p); p += 3; return value; }
+    int32_t read_4bytes() { int32_t value = load_be32(p); p += 4; return value; }
+    int64_t read_8bytes() { int64_t value = load_be64(p); p += 8; return value; }
+    void read_bytes(char* dst, int size) { memcpy(dst, p, size); p += size; }
+    std::string read_string(int size) { std::string value(p, size); p += size; return value; }
+
+    void write_1byte(int8_t value) { *p++ = value; }
+    void write_2bytes(int16_t value) { store_be16(p, value); p += 2; }
+    void write_3bytes(int32_t value) { store_be24(p, value); p += 3; }
+    void write_4bytes(int32_t value) { store_be32(p, value); p += 4; }
+    void write_8bytes(int64_t value) { store_be64(p, value); p += 8; }
+    void write_bytes(const char* src, int size) { memcpy(p, src, size); p += size; }
+
+ private:
+    char* start;
+    char* p;
+    char* end;
+};
+
 /*
 *   simple ring buffer
 */
@@ -54,15 +144,25 @@ class Buffer {
     int continuous_read_left();
 
     void reset();
+    // move the bytes to read to the start, the space to write is continuous after them
+    void compact();
+    // move the bytes to read to the new memory of new_size, owned by the buffer
+    int resize(int new_size);
 
     bool read_require(int required_size);
     bool read_empty();
 
+ private:
+    // the slow path of the field across the end of ring, byte by byte
+    uint64_t read_wrapped(int len);
+    void write_wrapped(uint64_t value, int len);
+
  private:
     char* buf;      // buffer begin
     int wpos;       // write pos
     int rpos;       // read pos
     int size;       // buffer size
+    bool owned;     // buf is allocated by resize
 };
 
 class IOBuffer {
@@ -75,20 +175,52 @@ class IOBuffer {
     */
     int read_bytes(char* dst, int len);  // read to dst
 
-    int write_bytes(const char *src, int size);    // write from src
+    /*
+    *   gather the bytes to write, not copied, src must be kept until flush,
+    *   flushed when the iovecs are full.
+    */
+    int write_bytes(const char *src, int size);
+    // write all gathered bytes by one writev, return the written size
+    int flush();
 
     void set_no_cache() { no_cache = true; }
+    /*
+    *   each read from reader offers low_water bytes at least, the cache is
+    *   compacted instead of reading a few bytes at the end, and grows to
+    *   max_size when the bytes to read fill it.
+    */
+    void set_read_water(int low_water, int max_size);
+    /*
+    *   read until size continuous bytes are in cache, from rcurrent of buffer,
+    *   the cache grows for the large message.
+    */
+    int ensure(int size);
 
     int seek_read(int len);
     int seek_write(int len);
 
+    /*
+    *   read once from reader to cache, return the read size
+    */
+    int fill();
+    std::shared_ptr<Buffer> get_buffer() { return buffer; }
+
  private:
     std::shared_ptr<Buffer> buffer;
     std::shared_ptr<IReader> reader;
+    std::shared_ptr<IWriter> writer;
+    // the bytes to write
+    std::vector<iovec> pending;
 
     bool no_cache;  // to do
+    int low_water;
+    int max_size;
 
     int read_from_cache(char* dst, int& len);
+    // read once to all free space of cache, by readv if it wraps
+    int read_to_cache();
+    // the space to read is low_water at least, compact or grow if not
+    void prepare_cache();
 };
 
 
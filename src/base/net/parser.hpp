@@ -42,6 +42,13 @@ class Request {
 
     bool is_transcode;
     std::string ext;
+
+    // the connection can serve the next request after the response
+    bool keep_alive = false;
+    // the response is streamed by another coroutine until the connection closes
+    bool streaming = false;
+    // the connection is read by another coroutine, the server leaves it
+    bool detached = false;
 };
 
 class Response {
@@ -7,14 +7,20 @@
  *
  * =====================================================================================
  */
+#include <unistd.h>
+#include <algorithm>
 #include <sstream>
+#include <vector>
 #include <tmss_conn.hpp>
+#include <defs/err.hpp>
 #include <log/log.hpp>
 namespace tmss {
 int conn_id = 0;
 const int default_connect_timeout_ms = 3 * 1000;
 const int default_send_timeout_ms = 3 * 1000;
 const int default_recv_timeout_ms = 3 * 1000;
+// the buffer of sendfile by read and write
+const int sendfile_copy_size = 64 * 1024;
 IConn::IConn() {
     id = conn_id++;
 }
@@ -51,6 +57,27 @@ bool IClientConn::is_stop() {
     return stop;
 }
 
+int IClientConn::sendfile(int in_fd, int64_t offset, int size) {
+    std::vector<char> buf(std::min(size, sendfile_copy_size));
+    int sent = 0;
+    while (sent < size) {
+        int wanted = std::min(size - sent, static_cast<int>(buf.size()));
+        ssize_t n = ::pread(in_fd, buf.data(), wanted, offset + sent);
+        if (n <= 0) {
+            tmss_error("sendfile read error, id={}, errno={}", get_id(), errno);
+            return -1;
+        }
+        // the positive error code is returned if the conn is closed
+        int ret = write(buf.data(), static_cast<int>(n));
+        if (ret != n) {
+            tmss_error("sendfile write error, id={}, ret={}, {}/{}", get_id(), ret, sent, size);
+            return -1;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
 void IClientConn::set_handler(std::shared_ptr<IConnHandler> conn_handler) {
     handler = conn_handler;
 }
@@ -64,6 +91,9 @@ void IClientConn::set_send_timeout(int32_t timeout_ms) {
 void IClientConn::set_recv_timeout(int32_t timeout_ms) {
     recv_timeout_ms = timeout_ms;
 }
+int32_t IClientConn::get_recv_timeout() {
+    return recv_timeout_ms;
+}
 
 Address::Address() {
 }
@@ -22,6 +22,15 @@ enum CONN_TYPE {
     CONN_SRT
 };
 
+// the congestion of the sending side, by the stats of transport
+enum ECongestionLevel {
+    ECongestionNone = 0,
+    // drop the frames not referenced by others
+    ECongestionLight = 1,
+    // drop the video until the next key frame
+    ECongestionHeavy = 2
+};
+
 class Address {
  public:
     Address();
@@ -79,14 +88,22 @@ class IClientConn : public IConn, public ICoroutineHandler {
     virtual int read_fully(char* buf, int size) { return 0; }
     virtual int write(const char* buf, int size) { return 0;}
     virtual int write_fully(const char* buf, int size) { return 0; }
+    /*
+    *   send size bytes of the file from offset, return the sent size, <0 if error.
+    *   read from the file and write by default, without the copy if the transport can.
+    */
+    virtual int sendfile(int in_fd, int64_t offset, int size);
     virtual void set_stop();
     virtual bool is_stop();
+    // ECongestionLevel, always none if the transport has no stats
+    virtual int get_congestion() { return ECongestionNone; }
     // to do
     virtual void set_handler(std::shared_ptr<IConnHandler> conn_handler);
 
     void set_connect_timeout(int32_t timeout_ms);
     void set_send_timeout(int32_t timeout_ms);
     void set_recv_timeout(int32_t timeout_ms);
+    int32_t get_recv_timeout();
 
  protected:
     bool stop;
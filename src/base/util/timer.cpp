@@ -66,71 +66,6 @@ bool MonitorTimer::next() {
     }
     return false;
 }
-#if 0
-StatTimer * StatTimer::get_stat_timer() {
-    thread_local StatTimer* instance = nullptr;
-
-    if (instance == nullptr) {
-        instance = new StatTimer();
-        instance->run();
-    }
-    return instance;
-}
-
-StatTimer::StatTimer() {
-    co    = std::make_shared<STCoroutine>("stat-timer", this, get_ctx_id());
-    perf  = std::make_shared<SRT_TRACEBSTATS>();
-    *perf = {0};
-}
-
-error_t StatTimer::cycle() {
-    while (true) {
-        if (true) {
-            std::string tmp;
-            st_srt_stat_print(tmp, perf.get());
-
-            // 重传率
-            double re_send = st_srt_stat_retrans(perf.get(), true);
-            double re_rcv  = st_srt_stat_retrans(perf.get(), false);
-
-            // 丢包率
-            double send_loss = st_srt_stat_loss(perf.get(), true);
-            double recv_loss = st_srt_stat_loss(perf.get(), false);
-
-            //  tmss_info("total srt trace:{}", tmp);
-
-            const int MB = 1024 * 1024;
-
-            *perf = {0};
-        }
-        st_sleep(60);
-    }
-}
-
-error_t StatTimer::run() {
-    return co->start();
-}
-#if 0
-error_t StatTimer::stat(SRT_TRACEBSTATS *f) {
-    perf->byteSentUnique      += f->byteSentUnique;
-    perf->byteRecvUnique      += f->byteRecvUnique;
-
-    perf->byteSentUniqueTotal += f->byteSentUniqueTotal;
-    perf->byteRecvUniqueTotal += f->byteRecvUniqueTotal;
-
-    perf->byteSent            += f->byteSent;
-    perf->byteRecv            += f->byteRecv;
-
-    perf->byteSndDropTotal    += f->byteSndDropTotal;
-    perf->byteRcvDropTotal    += f->byteRcvDropTotal;
-
-    perf->byteRcvDrop         += f->byteRcvDrop;
-    perf->byteSndDrop         += f->byteSndDrop;
-
-    return error_success;
-}
-#endif
-#endif
 
 }   // namespace tmss
 
@@ -13,7 +13,6 @@
 #include <memory>
 #include "defs/err.hpp"
 #include "coroutine/coroutine.hpp"
-// #include "stnet/st_srt.hpp"
 namespace tmss {
 #define MONITOR_EVERY_MIN 60 * 1000 * 1000
 
@@ -47,30 +46,6 @@ class MonitorTimer {
     utime_t interval;
     utime_t last_report;
 };
-#if 0
-class StatTimer : public ICoroutineHandler {
- public:
-    static StatTimer* get_stat_timer();
-
- public:
-    StatTimer();
-
- public:
-    error_t cycle() override;
-
- public:
-    error_t run();
-
- public:
-    // error_t stat(SRT_TRACEBSTATS* f);
-
- private:
-    // std::shared_ptr<SRT_TRACEBSTATS> perf;
-    std::shared_ptr<STCoroutine> co;
-    utime_t interval;
-};
-#endif
-
 
 }   // namespace tmss
 
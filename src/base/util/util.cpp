@@ -12,6 +12,7 @@
 #include "util/util.hpp"
 #include <sys/time.h>
 #include <unistd.h>
+#include <string.h>
 #include <defs/tmss_def.hpp>
 #include <log/log.hpp>
 
@@ -191,5 +192,120 @@ std::string url_decode(const std::string &sIn) {
     }
     return sOut;
 }
+
+std::string json_escape(const std::string& value) {
+    std::string out;
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char ch = value[i];
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += ch;
+        } else if (ch < 0x20) {
+            // the control characters are \u escaped, RFC 8259 7
+            char hex[8];
+            snprintf(hex, sizeof(hex), "\\u%04x", ch);
+            out += hex;
+        } else {
+            out += ch;
+        }
+    }
+    return out;
+}
+
+static inline uint32_t sha1_rol(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void sha1_block(uint32_t state[5], const uint8_t block[64]) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (block[i * 4 + 1] << 16)
+            | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = sha1_rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = sha1_rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = sha1_rol(b, 30);
+        b = a;
+        a = temp;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void sha1(const char* data, int size, uint8_t digest[20]) {
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    int left = size;
+    while (left >= 64) {
+        sha1_block(state, p);
+        p += 64;
+        left -= 64;
+    }
+
+    // pad with 0x80, zeros and the bit length in big-endian
+    uint8_t block[128] = {0};
+    memcpy(block, p, left);
+    block[left] = 0x80;
+    int block_size = (left < 56) ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+    for (int i = 0; i < 8; i++) {
+        block[block_size - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+    }
+    sha1_block(state, block);
+    if (block_size == 128) {
+        sha1_block(state, block + 64);
+    }
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
+
+std::string base64_encode(const uint8_t* data, int size) {
+    static const char* table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+    result.reserve((size + 2) / 3 * 4);
+    for (int i = 0; i < size; i += 3) {
+        uint32_t value = data[i] << 16;
+        if (i + 1 < size) {
+            value |= data[i + 1] << 8;
+        }
+        if (i + 2 < size) {
+            value |= data[i + 2];
+        }
+        result += table[(value >> 18) & 0x3F];
+        result += table[(value >> 12) & 0x3F];
+        result += (i + 1 < size) ? table[(value >> 6) & 0x3F] : '=';
+        result += (i + 2 < size) ? table[value & 0x3F] : '=';
+    }
+    return result;
+}
 }   // namespace tmss
 
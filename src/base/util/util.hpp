@@ -58,6 +58,14 @@ unsigned char from_hex(const unsigned char &x);
 
 std::string url_decode(const std::string &sIn);
 
+// the string value of json, without the quotes
+std::string json_escape(const std::string& value);
+
+// the 20 bytes sha1 digest, for the websocket handshake
+void sha1(const char* data, int size, uint8_t digest[20]);
+
+std::string base64_encode(const uint8_t* data, int size);
+
 
 }   // namespace tmss
 
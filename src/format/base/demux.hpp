@@ -43,6 +43,12 @@ class IDeMux {
 
     virtual int on_ingest(int content_length, const std::string& data_header) = 0;
 
+    /*
+    *   the input is switched to another origin in the middle of stream,
+    *   the bytes of new origin follow the old ones, the streams are kept.
+    */
+    virtual int on_resume() { return 0;}
+
     virtual int publish(std::shared_ptr<IClientConn> conn) = 0;
 
     virtual int get_total_length() { return -1;}
@@ -53,6 +59,13 @@ class IDeMux {
     virtual std::shared_ptr<IContext> get_context();
     virtual void set_context(std::shared_ptr<IContext> context);
     virtual std::shared_ptr<Buffer> get_buffer() { return buffer; }
+    /*
+    *   read to the pooled blocks, the packet shares them without copy,
+    *   used instead of read_packet if the demux supports.
+    */
+    virtual void set_read_buf(int (*read_buf)(void *opaque, IOBuf& buf, int size)) {
+        read_buf_func = read_buf;
+    }
 
  protected:
     std::shared_ptr<IContext> ctx;
@@ -60,6 +73,7 @@ class IDeMux {
     //  buffer
     std::shared_ptr<Buffer> buffer;
     int (*read_packet_func)(void *opaque, uint8_t *buf, int buf_size);  // io
+    int (*read_buf_func)(void *opaque, IOBuf& buf, int size) = nullptr;
 };
 
 }  // namespace tmss
@@ -42,6 +42,13 @@ class IMux {
  public:
     virtual std::shared_ptr<IContext> get_context();
     virtual void set_context(std::shared_ptr<IContext> context);
+    /*
+    *   write the buffer and the bytes of packet by one call without copy,
+    *   used instead of write_packet if the mux supports.
+    */
+    virtual void set_writev(int (*writev_packet)(void *opaque, const iovec* iov, int iov_size)) {
+        writev_packet_func = writev_packet;
+    }
 
  protected:
     std::shared_ptr<IContext> ctx;
@@ -49,6 +56,7 @@ class IMux {
     //  buffer
     std::shared_ptr<Buffer> buffer;
     int (*write_packet_func)(void *opaque, uint8_t *buf, int buf_size);  // io
+    int (*writev_packet_func)(void *opaque, const iovec* iov, int iov_size) = nullptr;
 };
 
 }  // namespace tmss
@@ -8,3 +8,37 @@
  * =====================================================================================
  */
 
+#include <format/base/packet.hpp>
+
+namespace tmss {
+IOBufPacket::IOBufPacket() {
+}
+
+char* IOBufPacket::buffer() {
+    if (data.slice_count() == 1) {
+        return const_cast<char*>(data.front_data());
+    }
+    if (static_cast<int>(flat.size()) != data.size()) {
+        flat.resize(data.size());
+        data.copy_to(flat.data(), data.size());
+    }
+    return flat.data();
+}
+
+int IOBufPacket::get_size() {
+    return data.size();
+}
+
+int64_t IOBufPacket::timestamp() {
+    return 0;
+}
+
+bool IOBufPacket::is_key_frame() {
+    return false;
+}
+
+const IOBuf* IOBufPacket::get_buf() {
+    return &data;
+}
+
+}  // namespace tmss
@@ -10,7 +10,17 @@
 
 #pragma once
 
+#include <vector>
+#include <io/io_buf.hpp>
+
 namespace tmss {
+enum EMediaType {
+    EMediaUnknown = 0,
+    EMediaAudio = 1,
+    EMediaVideo = 2,
+    EMediaScript = 3
+};
+
 class IPacket {
  public:
     virtual ~IPacket() = default;
@@ -20,5 +30,35 @@ class IPacket {
     virtual int     get_size()  = 0;
     virtual int64_t timestamp() = 0;
     virtual bool is_key_frame() = 0;
+    virtual bool is_sequence_header() { return false; }
+    virtual int get_media_type() { return EMediaUnknown; }
+    // no frame refers to it, can be dropped when the output is congested
+    virtual bool is_disposable() { return false; }
+    // the chained bytes to write without copy, null if only buffer()
+    virtual const IOBuf* get_buf() { return nullptr; }
+};
+
+/*
+*   the bytes in the pooled blocks, shared by all outputs,
+*   such as the raw bytes read from the socket.
+*/
+class IOBufPacket : public IPacket {
+ public:
+    IOBufPacket();
+    virtual ~IOBufPacket() = default;
+
+ public:
+    // the chained bytes are copied to continuous once, only for the old users
+    virtual char*  buffer();
+    virtual int     get_size();
+    virtual int64_t timestamp();
+    virtual bool is_key_frame();
+    virtual const IOBuf* get_buf();
+
+ public:
+    IOBuf data;
+
+ private:
+    std::vector<char> flat;
 };
 }  // namespace tmss
@@ -10,6 +10,7 @@
 
 
 #include <format/ffmpeg/tmss_format_base.hpp>
+#include <format/flv/tmss_format_flv.hpp>
 #include "http_stack.hpp"
 #include <log/log.hpp>
 #include <util/util.hpp>
@@ -22,6 +23,7 @@ extern "C" {
 namespace tmss {
 const int max_bufer_size = 1 * 1024 * 1024;
 BaseDeMux::BaseDeMux() {
+    is_resume = false;
 }
 BaseDeMux::~BaseDeMux() {
 }
@@ -59,6 +61,15 @@ int BaseDeMux::handle_input(std::shared_ptr<IPacket>& packet) {
     // set packet
     std::shared_ptr<TmssAVPacket> tmss_packet = std::make_shared<TmssAVPacket>(av_packet);
     tmss_packet->stream_index = av_packet.stream_index;
+    if (av_packet.stream_index >= 0
+            && av_packet.stream_index < static_cast<int>(ifmt_ctx->fmt_ctx->nb_streams)) {
+        AVMediaType type = ifmt_ctx->fmt_ctx->streams[av_packet.stream_index]->codecpar->codec_type;
+        if (type == AVMEDIA_TYPE_VIDEO) {
+            tmss_packet->media_type = EMediaVideo;
+        } else if (type == AVMEDIA_TYPE_AUDIO) {
+            tmss_packet->media_type = EMediaAudio;
+        }
+    }
     packet = tmss_packet;
     return 0;
 }
@@ -120,6 +131,11 @@ int open_bitstream_filter(AVStream *stream, AVBSFContext **bsf_ctx, const char *
 
 int BaseDeMux::on_ingest(int content_length, const std::string& data_header) {
     int ret = error_success;
+    if (is_resume) {
+        // the streams are known, the outputs are inited by them
+        tmss_info("resume input, format={}", format);
+        return ret;
+    }
     tmss_info("init avformat");
     // init avformat
     AVDictionary* opts = NULL;
@@ -194,6 +210,16 @@ int BaseDeMux::on_ingest(int content_length, const std::string& data_header) {
     return ret;
 }
 
+int BaseDeMux::on_resume() {
+    // the broken connection left eof or error on the avio, clear it to read on,
+    // the demuxer resyncs at the next tag or ts packet
+    AVIOContext* pb = ifmt_ctx->fmt_ctx->pb;
+    pb->eof_reached = 0;
+    pb->error = 0;
+    is_resume = true;
+    return error_success;
+}
+
 int BaseDeMux::publish(std::shared_ptr<IClientConn> conn) {
     int ret = error_success;
     // handshake
@@ -486,6 +512,8 @@ void BaseMux::set_format(const std::string& format) {
 
 TmssAVPacket::TmssAVPacket(AVPacket packet) {
     this->packet = packet;
+    stream_index = packet.stream_index;
+    media_type = EMediaUnknown;
 }
 
 char* TmssAVPacket::buffer() {
@@ -505,6 +533,14 @@ bool TmssAVPacket::is_key_frame() {
     return packet.flags & AV_PKT_FLAG_KEY;
 }
 
+int TmssAVPacket::get_media_type() {
+    return media_type;
+}
+
+bool TmssAVPacket::is_disposable() {
+    return packet.flags & AV_PKT_FLAG_DISPOSABLE;
+}
+
 TmssAVFrame::TmssAVFrame(AVFrame frame) {
     this->frame = frame;
 }
@@ -550,6 +586,8 @@ std::shared_ptr<IDeMux> create_demux_by_format(const std::string& format) {
         demuxer = std::make_shared<FlvDeMux>();
     } else if (format == "ts") {
         demuxer = std::make_shared<MpegTsDeMux>();
+    } else if (format == "rtmp") {
+        demuxer = std::make_shared<RtmpDeMux>();
     } else {
         demuxer = std::make_shared<RawDeMux>();
     }
@@ -44,6 +44,7 @@ class BaseDeMux : virtual public RawDeMux {
         const std::string& param,
         std::shared_ptr<IClientConn> conn);     //  */
     virtual int on_ingest(int content_length, const std::string& data_header);
+    virtual int on_resume();
     virtual int publish(std::shared_ptr<IClientConn> conn);
     void set_format(const std::string& format);
 
@@ -51,6 +52,8 @@ class BaseDeMux : virtual public RawDeMux {
     TmssAVFormatContext* ifmt_ctx;
     //  TmssAVCodecContext* codec_ctx;
     std::string format;
+    // the input is opened, the next origin is read on
+    bool is_resume;
 };
 
 /*
@@ -92,9 +95,14 @@ class TmssAVPacket : public IPacket {
     virtual int     get_size();
     virtual int64_t timestamp();
     virtual bool is_key_frame();
+    virtual int get_media_type();
+    // marked by the demuxer, such as the non-reference frame of h264 and hevc in ts
+    virtual bool is_disposable();
 
     AVPacket    packet;
     int         stream_index;
+    // EMediaType of the stream
+    int         media_type;
 };
 
 class TmssAVFrame : public IFrame {
@@ -0,0 +1,583 @@
+/* Copyright [2021] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021.
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+
+#include <string.h>
+
+#include <flv/tmss_format_flv.hpp>
+#include <rtmp/rtmp_def.hpp>
+#include <defs/err.hpp>
+#include <log/log.hpp>
+
+namespace tmss {
+// the amf0 string "@setDataFrame" before onMetaData, sent by publisher.
+static const char set_data_frame[] = "\x02\x00\x0d@setDataFrame";
+static const int set_data_frame_size = sizeof(set_data_frame) - 1;
+
+FlvTagPacket::FlvTagPacket(std::shared_ptr<RtmpMessage> msg) {
+    this->msg = msg;
+    tag_type = CodecFlvTagReserved;
+    key_frame = false;
+    sequence_header = false;
+    disposable = false;
+    enhanced = false;
+    video_fourcc = 0;
+
+    parse();
+}
+
+FlvTagPacket::~FlvTagPacket() {
+}
+
+char* FlvTagPacket::buffer() {
+    return msg->payload;
+}
+
+int FlvTagPacket::get_size() {
+    return msg->size;
+}
+
+int64_t FlvTagPacket::timestamp() {
+    return msg->header.timestamp;
+}
+
+bool FlvTagPacket::is_key_frame() {
+    return key_frame;
+}
+
+char FlvTagPacket::get_tag_type() {
+    return tag_type;
+}
+
+bool FlvTagPacket::is_audio() {
+    return tag_type == CodecFlvTagAudio;
+}
+
+bool FlvTagPacket::is_video() {
+    return tag_type == CodecFlvTagVideo;
+}
+
+bool FlvTagPacket::is_script() {
+    return tag_type == CodecFlvTagScript;
+}
+
+bool FlvTagPacket::is_sequence_header() {
+    return sequence_header;
+}
+
+int FlvTagPacket::get_media_type() {
+    if (tag_type == CodecFlvTagAudio) {
+        return EMediaAudio;
+    } else if (tag_type == CodecFlvTagVideo) {
+        return EMediaVideo;
+    }
+    return EMediaScript;
+}
+
+bool FlvTagPacket::is_disposable() {
+    return disposable;
+}
+
+bool FlvTagPacket::is_enhanced() {
+    return enhanced;
+}
+
+uint32_t FlvTagPacket::get_video_fourcc() {
+    return video_fourcc;
+}
+
+std::shared_ptr<RtmpMessage> FlvTagPacket::get_message() {
+    return msg;
+}
+
+void FlvTagPacket::parse() {
+    char* p = msg->payload;
+    int size = msg->size;
+
+    if (msg->header.is_audio()) {
+        tag_type = CodecFlvTagAudio;
+        // SoundFormat UB [4], then AACPacketType UI8 if aac
+        if (size >= 2 && ((p[0] >> 4) & 0x0f) == CodecAudioAAC) {
+            sequence_header = p[1] == CodecAudioTypeSequenceHeader;
+        }
+    } else if (msg->header.is_video()) {
+        tag_type = CodecFlvTagVideo;
+        parse_video();
+    } else {
+        tag_type = CodecFlvTagScript;
+        // the metadata is cached as the sequence header.
+        sequence_header = true;
+    }
+}
+
+void FlvTagPacket::parse_video() {
+    char* p = msg->payload;
+    int size = msg->size;
+
+    if (size < 1) {
+        return;
+    }
+
+    // enhanced rtmp: IsExHeader UB [1], FrameType UB [3], PacketType UB [4], FourCC UI32
+    if (p[0] & TMSS_FLV_VIDEO_EX_HEADER) {
+        enhanced = true;
+        key_frame = ((p[0] >> 4) & 0x07) == CodecVideoAVCFrameKeyFrame;
+        int packet_type = p[0] & 0x0f;
+        sequence_header = packet_type == CodecVideoPacketTypeSequenceStart
+            || packet_type == CodecVideoPacketTypeMPEG2TSSequenceStart;
+        if (size >= 5) {
+            video_fourcc = TMSS_FOURCC(static_cast<uint8_t>(p[1]), static_cast<uint8_t>(p[2]),
+                static_cast<uint8_t>(p[3]), static_cast<uint8_t>(p[4]));
+        }
+        // CodedFrames has SI24 composition time after FourCC, CodedFramesX has not
+        if (!key_frame && packet_type == CodecVideoPacketTypeCodedFrames && size > 8) {
+            disposable = parse_disposable(p + 8, size - 8);
+        } else if (!key_frame && packet_type == CodecVideoPacketTypeCodedFramesX && size > 5) {
+            disposable = parse_disposable(p + 5, size - 5);
+        }
+        return;
+    }
+
+    // FrameType UB [4], CodecID UB [4], then AVCPacketType UI8
+    key_frame = ((p[0] >> 4) & 0x0f) == CodecVideoAVCFrameKeyFrame;
+    int codec = p[0] & 0x0f;
+    if (codec == CodecVideoAVC) {
+        video_fourcc = TMSS_FOURCC_AVC;
+    } else if (codec == CodecVideoHEVC) {
+        video_fourcc = TMSS_FOURCC_HEVC;
+    } else if (codec == CodecVideoAV1) {
+        video_fourcc = TMSS_FOURCC_AV1;
+    } else {
+        return;
+    }
+    if (size >= 2) {
+        sequence_header = key_frame && p[1] == CodecVideoAVCTypeSequenceHeader;
+    }
+    if (((p[0] >> 4) & 0x0f) == CodecVideoAVCFrameDisposableInterFrame) {
+        disposable = true;
+    } else if (!key_frame && size > 5 && p[1] == CodecVideoAVCTypeNALU) {
+        // AVCPacketType UI8, CompositionTime SI24, then the nalus
+        disposable = parse_disposable(p + 5, size - 5);
+    }
+}
+
+bool FlvTagPacket::parse_disposable(char* p, int size) {
+    if (video_fourcc != TMSS_FOURCC_AVC && video_fourcc != TMSS_FOURCC_HEVC) {
+        return false;
+    }
+
+    bool found = false;
+    while (size > 4) {
+        uint32_t nalu_size = (static_cast<uint8_t>(p[0]) << 24) | (static_cast<uint8_t>(p[1]) << 16)
+            | (static_cast<uint8_t>(p[2]) << 8) | static_cast<uint8_t>(p[3]);
+        p += 4;
+        size -= 4;
+        if (nalu_size == 0 || nalu_size > static_cast<uint32_t>(size)) {
+            return false;
+        }
+        uint8_t header = static_cast<uint8_t>(p[0]);
+        if (video_fourcc == TMSS_FOURCC_AVC) {
+            // the slices, nal_ref_idc is 0 if not referenced
+            int type = header & 0x1f;
+            if (type >= 1 && type <= 5) {
+                if ((header & 0x60) != 0) {
+                    return false;
+                }
+                found = true;
+            }
+        } else {
+            // the even vcl types below 16 are the sub-layer non-reference pictures
+            int type = (header >> 1) & 0x3f;
+            if (type < 32) {
+                if (type > 14 || (type & 0x01) != 0) {
+                    return false;
+                }
+                found = true;
+            }
+        }
+        p += nalu_size;
+        size -= nalu_size;
+    }
+    return found;
+}
+
+RtmpDeMux::RtmpDeMux() {
+}
+
+RtmpDeMux::~RtmpDeMux() {
+}
+
+void RtmpDeMux::attach(std::shared_ptr<RtmpProtocolHandler> protocol) {
+    this->protocol = protocol;
+}
+
+int RtmpDeMux::handle_input(std::shared_ptr<IPacket>& packet) {
+    int ret = error_success;
+
+    if (!protocol) {
+        ret = error_ingest_no_client;
+        tmss_error("rtmp protocol null, ret={}", ret);
+        return ret;
+    }
+
+    std::shared_ptr<RtmpMessage> msg;
+    if ((ret = protocol->recv_rtmp_message(msg)) != error_success) {
+        tmss_error("recv rtmp message failed, ret={}", ret);
+        return ret;
+    }
+
+    // amf3 data is prefixed with one byte 0x00, the body is amf0.
+    if (msg->header.is_amf3_data() && msg->size > 1) {
+        std::shared_ptr<RtmpMessage> data = std::make_shared<RtmpMessage>();
+        data->header = msg->header;
+        data->header.message_type = RTMP_MSG_AMF0DataMessage;
+        data->header.payload_length = msg->size - 1;
+        data->create_slice(msg, msg->payload + 1, msg->size - 1);
+        msg = data;
+    }
+
+    // remove the @setDataFrame, the flv metadata is onMetaData.
+    if (msg->header.is_amf0_data() && msg->size > set_data_frame_size
+            && memcmp(msg->payload, set_data_frame, set_data_frame_size) == 0) {
+        std::shared_ptr<RtmpMessage> data = std::make_shared<RtmpMessage>();
+        data->header = msg->header;
+        data->header.payload_length = msg->size - set_data_frame_size;
+        data->create_slice(msg, msg->payload + set_data_frame_size, msg->size - set_data_frame_size);
+        msg = data;
+    }
+
+    packet = std::make_shared<FlvTagPacket>(msg);
+
+    return ret;
+}
+
+int RtmpDeMux::handle_input(std::shared_ptr<IFrame>& frame) {
+    return 0;
+}
+
+FlvTagDeMux::FlvTagDeMux() {
+    is_read_flv_header = false;
+}
+
+FlvTagDeMux::~FlvTagDeMux() {
+}
+
+int FlvTagDeMux::read_fully(char* buf, int size) {
+    int ret = error_success;
+
+    if (read_packet_func == nullptr) {
+        ret = error_ingest_no_client;
+        tmss_error("read handler null, ret={}", ret);
+        return ret;
+    }
+
+    int nread = 0;
+    while (nread < size) {
+        int n = read_packet_func(opaque, reinterpret_cast<uint8_t*>(buf + nread), size - nread);
+        if (n <= 0) {
+            ret = error_socket_read;
+            tmss_error("read flv failed, read={}/{}, ret={}", nread, size, ret);
+            return ret;
+        }
+        nread += n;
+    }
+    return ret;
+}
+
+int FlvTagDeMux::read_flv_header() {
+    int ret = error_success;
+
+    char header[TMSS_FLV_HEADER_SIZE];
+    if ((ret = read_fully(header, TMSS_FLV_HEADER_SIZE)) != error_success) {
+        return ret;
+    }
+    if (header[0] != 'F' || header[1] != 'L' || header[2] != 'V') {
+        ret = error_flv_header_invalid;
+        tmss_error("invalid flv signature, ret={}", ret);
+        return ret;
+    }
+
+    // DataOffset is 9 for version 1, skip the extended header if any
+    uint32_t data_offset = load_be32(header + 5);
+    if (data_offset < 9) {
+        ret = error_flv_header_invalid;
+        tmss_error("invalid flv header size={}, ret={}", data_offset, ret);
+        return ret;
+    }
+    char skip[64];
+    for (int left = static_cast<int>(data_offset - 9); left > 0;) {
+        int n = (left > static_cast<int>(sizeof(skip))) ? static_cast<int>(sizeof(skip)) : left;
+        if ((ret = read_fully(skip, n)) != error_success) {
+            return ret;
+        }
+        left -= n;
+    }
+    return ret;
+}
+
+int FlvTagDeMux::handle_input(std::shared_ptr<IPacket>& packet) {
+    int ret = error_success;
+
+    if (!is_read_flv_header) {
+        if ((ret = read_flv_header()) != error_success) {
+            tmss_error("read flv header failed, ret={}", ret);
+            return ret;
+        }
+        is_read_flv_header = true;
+    }
+
+    while (true) {
+        char header[TMSS_FLV_TAG_HEADER_SIZE];
+        if ((ret = read_fully(header, TMSS_FLV_TAG_HEADER_SIZE)) != error_success) {
+            return ret;
+        }
+        // TagType UI5, the filter bit is not supported
+        char tag_type = header[0] & 0x1f;
+        int size = static_cast<int>(load_be24(header + 1));
+        // Timestamp UI24, TimestampExtended UI8 as the upper bits
+        int64_t timestamp = static_cast<int64_t>(load_be24(header + 4)
+            | (static_cast<uint32_t>(static_cast<uint8_t>(header[7])) << 24));
+
+        std::shared_ptr<RtmpMessage> msg = std::make_shared<RtmpMessage>();
+        msg->create_payload(size);
+        if ((ret = read_fully(msg->payload, size)) != error_success) {
+            return ret;
+        }
+        char tail[TMSS_FLV_PREVIOUS_TAG_SIZE];
+        if ((ret = read_fully(tail, TMSS_FLV_PREVIOUS_TAG_SIZE)) != error_success) {
+            return ret;
+        }
+
+        if (tag_type != CodecFlvTagAudio && tag_type != CodecFlvTagVideo
+                && tag_type != CodecFlvTagScript) {
+            tmss_info("drop flv tag, type={}, size={}", tag_type, size);
+            continue;
+        }
+        // the payload is owned by the message, shared by all the outputs
+        if ((ret = msg->create(tag_type, timestamp, msg->payload, size)) != error_success) {
+            return ret;
+        }
+        packet = std::make_shared<FlvTagPacket>(msg);
+        break;
+    }
+    return ret;
+}
+
+int FlvTagDeMux::handle_input(std::shared_ptr<IFrame>& frame) {
+    return 0;
+}
+
+FlvTagMux::FlvTagMux() {
+    is_send_flv_header = false;
+}
+
+FlvTagMux::~FlvTagMux() {
+}
+
+int FlvTagMux::handle_output(std::shared_ptr<IPacket> packet) {
+    int ret = error_success;
+
+    std::shared_ptr<FlvTagPacket> tag = std::dynamic_pointer_cast<FlvTagPacket>(packet);
+    if (!tag) {
+        // already flv bytes, such as from the http-flv origin
+        return RawMux::handle_output(packet);
+    }
+
+    if (!is_send_flv_header) {
+        if ((ret = write_flv_header()) != error_success) {
+            tmss_error("write flv header failed, ret={}", ret);
+            return ret;
+        }
+        is_send_flv_header = true;
+    }
+
+    if ((ret = write_tag(tag)) != error_success) {
+        tmss_error("write flv tag failed, ret={}", ret);
+        return ret;
+    }
+
+    if ((ret = flush_write()) != error_success) {
+        tmss_error("flush flv tag failed, ret={}", ret);
+        return ret;
+    }
+    return ret;
+}
+
+int FlvTagMux::handle_output(std::shared_ptr<IFrame> frame) {
+    return 0;
+}
+
+int FlvTagMux::write_flv_header() {
+    int ret = error_success;
+
+    // 'FLV', version 1, audio and video, header size 9, previous tag size 0
+    static const char flv_header[TMSS_FLV_HEADER_SIZE] = {
+        'F', 'L', 'V', 0x01, 0x05,
+        0x00, 0x00, 0x00, 0x09,
+        0x00, 0x00, 0x00, 0x00
+    };
+
+    if (buffer->write_left() < TMSS_FLV_HEADER_SIZE
+            && (ret = flush_write()) != error_success) {
+        return ret;
+    }
+    buffer->write_bytes(flv_header, TMSS_FLV_HEADER_SIZE);
+
+    return ret;
+}
+
+int FlvTagMux::write_tag(std::shared_ptr<FlvTagPacket> tag) {
+    int ret = error_success;
+
+    int size = tag->get_size();
+    int64_t timestamp = tag->timestamp();
+
+    char header[TMSS_FLV_TAG_HEADER_SIZE];
+    BufferCursor cursor(header, TMSS_FLV_TAG_HEADER_SIZE);
+    cursor.write_1byte(tag->get_tag_type());
+    // DataSize UI24
+    cursor.write_3bytes(size);
+    // Timestamp UI24, TimestampExtended UI8
+    cursor.write_3bytes(static_cast<int32_t>(timestamp));
+    cursor.write_1byte(static_cast<int8_t>(timestamp >> 24));
+    // StreamID UI24, always 0
+    cursor.write_3bytes(0);
+
+    int tag_size = TMSS_FLV_TAG_HEADER_SIZE + size;
+    char tail[TMSS_FLV_PREVIOUS_TAG_SIZE];
+    store_be32(tail, tag_size);
+
+    int total_size = tag_size + TMSS_FLV_PREVIOUS_TAG_SIZE;
+
+    // the small tag is merged to one write with header and tail.
+    if (total_size < buffer->get_size()) {
+        if (buffer->write_left() < total_size && (ret = flush_write()) != error_success) {
+            return ret;
+        }
+        buffer->write_bytes(header, TMSS_FLV_TAG_HEADER_SIZE);
+        buffer->write_bytes(tag->buffer(), size);
+        buffer->write_bytes(tail, TMSS_FLV_PREVIOUS_TAG_SIZE);
+        return ret;
+    }
+
+    // the big tag, such as the key frame, write the payload after the buffer without copy.
+    iovec iovs[3];
+    iovs[0].iov_base = header;
+    iovs[0].iov_len = TMSS_FLV_TAG_HEADER_SIZE;
+    iovs[1].iov_base = tag->buffer();
+    iovs[1].iov_len = size;
+    iovs[2].iov_base = tail;
+    iovs[2].iov_len = TMSS_FLV_PREVIOUS_TAG_SIZE;
+    if ((ret = flush_write(iovs, 3)) != error_success) {
+        tmss_error("write flv tag failed, size={}, ret={}", size, ret);
+        return ret;
+    }
+
+    return ret;
+}
+
+RtmpMux::RtmpMux() {
+    aggregate_size = 0;
+    aggregate_delay_ms = 0;
+}
+
+RtmpMux::~RtmpMux() {
+}
+
+int RtmpMux::handle_output(std::shared_ptr<IPacket> packet) {
+    int ret = error_success;
+
+    if (!client) {
+        ret = error_ingest_no_client;
+        tmss_error("rtmp forward not start, ret={}", ret);
+        return ret;
+    }
+
+    std::shared_ptr<FlvTagPacket> tag = std::dynamic_pointer_cast<FlvTagPacket>(packet);
+    if (!tag) {
+        // refused by create_forward, only the rtmp origin is forwarded
+        ret = error_rtmp_forward_input;
+        tmss_error("rtmp forward needs flv tag, size={}, ret={}", packet->get_size(), ret);
+        return ret;
+    }
+
+    if ((ret = client->send_message(tag->get_message())) != error_success) {
+        tmss_error("forward rtmp message failed, ret={}", ret);
+        return ret;
+    }
+
+    return ret;
+}
+
+int RtmpMux::handle_output(std::shared_ptr<IFrame> frame) {
+    return 0;
+}
+
+int RtmpMux::forward(const std::string& forward_url,
+        std::shared_ptr<IClientConn> conn) {
+    int ret = error_success;
+
+    // rtmp://host[:port]/app/stream[?param]
+    std::string url = forward_url;
+    std::size_t pos = url.find("://");
+    if (pos != std::string::npos) {
+        url = url.substr(pos + 3);
+    }
+    std::string param;
+    if ((pos = url.find("?")) != std::string::npos) {
+        param = url.substr(pos);
+        url = url.substr(0, pos);
+    }
+    std::size_t host_end = url.find("/");
+    std::size_t app_end = url.rfind("/");
+    if (host_end == std::string::npos || app_end == host_end) {
+        ret = error_rtmp_no_request;
+        tmss_error("invalid forward url={}, ret={}", forward_url, ret);
+        return ret;
+    }
+    std::string host = url.substr(0, host_end);
+    std::string port = CONSTS_RTMP_DEFAULT_PORT;
+    if ((pos = host.find(":")) != std::string::npos) {
+        port = host.substr(pos + 1);
+        host = host.substr(0, pos);
+    }
+    std::string app = url.substr(host_end + 1, app_end - host_end - 1);
+    std::string stream = url.substr(app_end + 1);
+
+    // a new client for each connection, the old one is discard when reconnect
+    client = std::make_shared<RtmpClient>();
+    if ((ret = client->init(conn)) != error_success) {
+        tmss_error("init rtmp client failed, ret={}", ret);
+        return ret;
+    }
+    if ((ret = client->request_publish(host, port, app, stream, param)) != error_success) {
+        tmss_error("rtmp forward publish failed, url={}, ret={}", forward_url, ret);
+        client = nullptr;
+        return ret;
+    }
+
+    if (aggregate_size > 0) {
+        client->get_protocol()->set_aggregate_output(aggregate_size, aggregate_delay_ms);
+    }
+
+    tmss_info("rtmp forward start, url={}", forward_url);
+    return ret;
+}
+
+void RtmpMux::set_aggregate_output(int max_size, int max_delay_ms) {
+    aggregate_size = max_size;
+    aggregate_delay_ms = max_delay_ms;
+}
+
+int RtmpMux::send_status(int status) {
+    // no http status for rtmp
+    return error_success;
+}
+
+}  // namespace tmss
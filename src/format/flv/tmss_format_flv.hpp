@@ -0,0 +1,155 @@
+/* Copyright [2021] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021.
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+#include <format/base/context.hpp>
+#include <format/base/mux.hpp>
+#include <format/base/demux.hpp>
+#include <format/base/packet.hpp>
+#include <format/raw/tmss_format_raw.hpp>
+#include <rtmp/rtmp_message.hpp>
+#include <rtmp/rtmp_stack.hpp>
+#include <rtmp/rtmp_client.hpp>
+
+namespace tmss {
+/*
+*   a flv tag over the rtmp message, the payload is shared with message,
+*   the tag semantics are parsed once when created.
+*/
+class FlvTagPacket : public IPacket {
+ private:
+    std::shared_ptr<RtmpMessage> msg;
+    char tag_type;
+    bool key_frame;
+    bool sequence_header;
+    // the non-reference frame, by the frame type or the nal header
+    bool disposable;
+    // whether the video is enhanced rtmp with ExVideoTagHeader
+    bool enhanced;
+    uint32_t video_fourcc;
+
+ public:
+    explicit FlvTagPacket(std::shared_ptr<RtmpMessage> msg);
+    ~FlvTagPacket();
+    // the tag body, without tag header and previous tag size
+    char* buffer();
+    int get_size();
+    int64_t timestamp();
+    virtual bool is_key_frame();
+
+ public:
+    // CodecFlvTagAudio, CodecFlvTagVideo or CodecFlvTagScript
+    char get_tag_type();
+    bool is_audio();
+    bool is_video();
+    bool is_script();
+    // avc or aac sequence header, or the metadata
+    virtual bool is_sequence_header();
+    virtual int get_media_type();
+    virtual bool is_disposable();
+    bool is_enhanced();
+    // TMSS_FOURCC_AVC, TMSS_FOURCC_HEVC or TMSS_FOURCC_AV1, also for the legacy codec id
+    uint32_t get_video_fourcc();
+    std::shared_ptr<RtmpMessage> get_message();
+
+ private:
+    void parse();
+    void parse_video();
+    // whether all the vcl nalus of the length prefixed frame are non-reference
+    bool parse_disposable(char* p, int size);
+};
+
+/*
+*   turn the rtmp messages to flv tags directly, without libavformat,
+*   the messages are read from the protocol of RtmpClient.
+*/
+class RtmpDeMux : public RawDeMux {
+ public:
+    RtmpDeMux();
+    virtual ~RtmpDeMux();
+    virtual int handle_input(std::shared_ptr<IPacket>& packet);
+    virtual int handle_input(std::shared_ptr<IFrame>& frame);
+
+    // attach to the protocol after the play is started
+    void attach(std::shared_ptr<RtmpProtocolHandler> protocol);
+
+ private:
+    std::shared_ptr<RtmpProtocolHandler> protocol;
+};
+
+/*
+*   parse the pushed flv bytes to flv tags, without libavformat,
+*   the tags are relayed to the rtmp upstreams as they are.
+*/
+class FlvTagDeMux : public RawDeMux {
+ public:
+    FlvTagDeMux();
+    virtual ~FlvTagDeMux();
+    virtual int handle_input(std::shared_ptr<IPacket>& packet);
+    virtual int handle_input(std::shared_ptr<IFrame>& frame);
+
+ private:
+    int read_flv_header();
+    // read the size bytes, the read of input may return less
+    int read_fully(char* buf, int size);
+
+ private:
+    bool is_read_flv_header;
+};
+
+/*
+*   write the flv tags to http-flv, without libavformat.
+*   the packets not FlvTagPacket are already flv bytes, write as raw.
+*/
+class FlvTagMux : public RawMux {
+ public:
+    FlvTagMux();
+    virtual ~FlvTagMux();
+    virtual int handle_output(std::shared_ptr<IPacket> packet);
+    virtual int handle_output(std::shared_ptr<IFrame> frame);
+
+ private:
+    int write_flv_header();
+    int write_tag(std::shared_ptr<FlvTagPacket> tag);
+
+ private:
+    bool is_send_flv_header;
+};
+
+/*
+*   push the flv tags to rtmp origin, the messages are shared
+*   with the other outputs, never copy the payload.
+*/
+class RtmpMux : public RawMux {
+ public:
+    RtmpMux();
+    virtual ~RtmpMux();
+    virtual int handle_output(std::shared_ptr<IPacket> packet);
+    virtual int handle_output(std::shared_ptr<IFrame> frame);
+    /*
+    *   connect app and publish over the connected conn,
+    *   forward_url is rtmp://host[:port]/app/stream[?param]
+    */
+    virtual int forward(const std::string& forward_url,
+        std::shared_ptr<IClientConn> conn);
+    virtual int send_status(int status);
+    /*
+    *   send the audio/video as aggregate messages, for the relay between our servers,
+    *   applied to the connection of next forward.
+    */
+    void set_aggregate_output(int max_size, int max_delay_ms);
+
+ private:
+    std::shared_ptr<RtmpClient> client;
+    int aggregate_size;
+    int aggregate_delay_ms;
+};
+
+}  // namespace tmss
@@ -10,6 +10,7 @@
 
 
 #include <raw/tmss_format_raw.hpp>
+#include <vector>
 #include "http_stack.hpp"
 #include <log/log.hpp>
 namespace tmss {
@@ -38,6 +39,20 @@ int RawDeMux::handle_input(std::shared_ptr<IPacket>& packet) {
     //  CommonData* data = (CommonData*)packet->buffer();
     // read from buffer
 
+    if (read_buf_func && buffer->read_left() <= 0) {
+        // the packet shares the blocks read from socket, never copy
+        int read_size = read_buf_func(opaque, input_buf, TMSS_IO_BLOCK_SIZE);
+        if (read_size <= 0) {
+            tmss_error("read error, ret={}", read_size);
+            packet = nullptr;
+            return 0;
+        }
+        std::shared_ptr<IOBufPacket> buf_packet = std::make_shared<IOBufPacket>();
+        input_buf.cut(buf_packet->data, input_buf.size());
+        packet = buf_packet;
+        return 0;
+    }
+
     if (read_packet_func == nullptr) {
         tmss_error("read handler null");
         return -2;
@@ -121,6 +136,8 @@ int RawDeMux::flush_read(std::shared_ptr<IPacket>& packet) {
 
 RawMux::RawMux() {
     is_send_header = false;
+    content_length = -1;
+    keep_alive = false;
 }
 
 RawMux::~RawMux() {
@@ -141,11 +158,25 @@ int RawMux::init_output(unsigned char *buffer,
 
 int RawMux::handle_output(std::shared_ptr<IPacket> packet) {
     //  CommonData* data = (CommonData*)packet->data();
+    const IOBuf* buf = packet->get_buf();
+    if (buf) {
+        // the blocks are shared by all outputs, write them after the buffer by writev
+        std::vector<iovec> iovs;
+        buf->to_iovec(iovs);
+        int ret = flush_write(iovs.data(), static_cast<int>(iovs.size()));
+        if (ret != error_success) {
+            tmss_error("write buf error, ret={}", ret);
+            return -1;
+        }
+        return 0;
+    }
     int left_size = buffer->write_left();
     if (left_size < packet->get_size()) {
         // not enough
         // flush
-        flush_write();
+        if (flush_write() != error_success) {
+            return -1;
+        }
         left_size = buffer->write_left();
         if (left_size < packet->get_size()) {
             // to do
@@ -160,7 +191,9 @@ int RawMux::handle_output(std::shared_ptr<IPacket> packet) {
     }
 
     // flush
-    flush_write();
+    if (flush_write() != error_success) {
+        return -1;
+    }
     return 0;
 }
 
@@ -193,11 +226,11 @@ int RawMux::send_status(int status) {
     if (is_send_header) {
         return ret;
     }
-    // send 200 or 404
+    // send 200 or 404, without the length, the client reads the body until close
     std::string result;
-    result = "HTTP/1.1 ";
-    result += http_status_detail[status];
-    result += "\r\n\r\n";
+    CHttp http;
+    http.buildResponseHeader(status, content_type, content_length,
+        false, keep_alive && content_length >= 0, result);
     char *temp = const_cast<char*>(result.c_str());
     if (write_packet_func) {
         write_packet_func(opaque, reinterpret_cast<uint8_t*>(temp), result.length());
@@ -210,23 +243,93 @@ int RawMux::send_status(int status) {
     return ret;
 }
 
+void RawMux::set_content_length(int64_t length) {
+    content_length = length;
+}
+
+void RawMux::set_content_type(const std::string& content_type) {
+    this->content_type = content_type;
+}
+
+void RawMux::set_keep_alive(bool keep_alive) {
+    this->keep_alive = keep_alive;
+}
+
 int RawMux::flush_write() {
+    return flush_write(nullptr, 0);
+}
+
+int RawMux::flush_write(const iovec* iov, int iov_size) {
     int ret = error_success;
     // to do, flow control
-    if (write_packet_func == nullptr) {
-        tmss_error("write handler null");
+    if (writev_packet_func) {
+        // the wrapped buffer is two iovecs, all is written by one call
+        std::vector<iovec> iovs;
+        int continuous_read_left = buffer->continuous_read_left();
+        if (continuous_read_left > 0) {
+            iovec part;
+            part.iov_base = buffer->rcurrent();
+            part.iov_len = continuous_read_left;
+            iovs.push_back(part);
+            if (buffer->read_left() > continuous_read_left) {
+                part.iov_base = buffer->start();
+                part.iov_len = buffer->read_left() - continuous_read_left;
+                iovs.push_back(part);
+            }
+        }
+        iovs.insert(iovs.end(), iov, iov + iov_size);
+        if (iovs.empty()) {
+            return ret;
+        }
+
+        tmss_info("flush write buffer={}, iov_size={}", buffer->read_left(), iovs.size());
+        int write_size = writev_packet_func(opaque, iovs.data(), static_cast<int>(iovs.size()));
+        buffer->reset();
+        if (write_size < 0) {
+            ret = error_socket_write;
+            tmss_error("flush write failed, iov_size={}, ret={}", iovs.size(), write_size);
+        }
         return ret;
     }
 
-    tmss_info("flush write buffer={},{}", buffer->rcurrent(), buffer->read_left());
+    if (write_packet_func == nullptr) {
+        ret = error_socket_write;
+        tmss_error("write handler null, ret={}", ret);
+        return ret;
+    }
 
-    int write_size = write_packet_func(opaque,
-        reinterpret_cast<uint8_t*>(buffer->rcurrent()), buffer->continuous_read_left());
-    buffer->seek_read(write_size);
     if (buffer->read_left() > 0) {
-        write_size = write_packet_func(opaque,
-            reinterpret_cast<uint8_t*>(buffer->rcurrent()), buffer->read_left());
-        buffer->reset();
+        tmss_info("flush write buffer={},{}", buffer->rcurrent(), buffer->read_left());
+
+        int write_size = write_packet_func(opaque,
+            reinterpret_cast<uint8_t*>(buffer->rcurrent()), buffer->continuous_read_left());
+        if (write_size < 0) {
+            buffer->reset();
+            ret = error_socket_write;
+            tmss_error("flush write failed, ret={}", write_size);
+            return ret;
+        }
+        buffer->seek_read(write_size);
+        if (buffer->read_left() > 0) {
+            write_size = write_packet_func(opaque,
+                reinterpret_cast<uint8_t*>(buffer->rcurrent()), buffer->read_left());
+            buffer->reset();
+            if (write_size < 0) {
+                ret = error_socket_write;
+                tmss_error("flush write failed, ret={}", write_size);
+                return ret;
+            }
+        }
+    }
+
+    for (int i = 0; i < iov_size; i++) {
+        int write_size = write_packet_func(opaque,
+            reinterpret_cast<uint8_t*>(iov[i].iov_base), iov[i].iov_len);
+        if (write_size < 0) {
+            ret = error_socket_write;
+            tmss_error("write failed, size={}, ret={}", iov[i].iov_len, ret);
+            return ret;
+        }
     }
 
     return ret;
@@ -9,6 +9,7 @@
  */
 
 #pragma once
+#include <string>
 #include <format/base/context.hpp>
 #include <format/base/mux.hpp>
 #include <format/base/demux.hpp>
@@ -32,6 +33,8 @@ class RawDeMux : virtual public IDeMux {
 
  protected:
     int content_length;     // when it is a static file, it is the file size
+    // the bytes read by read_buf, the last block is filled on
+    IOBuf input_buf;
 
     // flush all data to packet
     int flush_read(std::shared_ptr<IPacket>& packet);
@@ -55,10 +58,23 @@ class RawMux : virtual public IMux {
         std::shared_ptr<IClientConn> conn);
     int send_status(int status);
 
- private:
+ public:
+    // the body length of response, -1 means the body ends with the connection
+    void set_content_length(int64_t length);
+    void set_content_type(const std::string& content_type);
+    void set_keep_alive(bool keep_alive);
+
+ protected:
     // flush all data to output
     int flush_write();
+    // flush all data and the iovecs after it, by one writev if supported
+    int flush_write(const iovec* iov, int iov_size);
+
+ private:
     bool is_send_header;
+    int64_t content_length;
+    std::string content_type;
+    bool keep_alive;
 };
 
 class CommonPacket : public IPacket {
@@ -11,6 +11,7 @@
 #include <protocol/client.hpp>
 
 #include <utility>
+#include <vector>
 
 #include <defs/err.hpp>
 #include <log/log.hpp>
@@ -30,9 +31,53 @@ int IClient::init(std::shared_ptr<IClientConn> conn) {
     return ret;
 }
 
+int IClient::reset_conn(std::shared_ptr<IClientConn> conn) {
+    this->conn = conn;
+    std::shared_ptr<Buffer> buffer = io_buffer->get_buffer();
+    buffer->reset();
+    io_buffer = std::make_shared<IOBuffer>(this->conn, buffer);
+
+    return error_success;
+}
+
 int IClient::cycle() {
     int ret = error_success;
     return ret;
 }
 
+int IClient::read_buf(IOBuf& buf, int size) {
+    char* p = buf.prepare(size);
+    int read_size = read_data(p, size);
+    buf.commit((read_size > 0) ? read_size : 0);
+    return read_size;
+}
+
+int IClient::writev_data(const iovec* iov, int iov_size) {
+    if (iov_size == 1) {
+        return write_data(static_cast<const char*>(iov[0].iov_base), iov[0].iov_len);
+    }
+    // the client frames each write_data, the iovecs are copied to one
+    std::vector<char> data;
+    for (int i = 0; i < iov_size; i++) {
+        const char* p = static_cast<const char*>(iov[i].iov_base);
+        data.insert(data.end(), p, p + iov[i].iov_len);
+    }
+    return write_data(data.data(), data.size());
+}
+
+int IClient::connect_origin(Address& address) {
+    return conn->connect(address);
+}
+
+void IClient::release_conn() {
+}
+
+int IClient::send_status(int status) {
+    return error_success;
+}
+
+int IClient::send_eof() {
+    return error_success;
+}
+
 }   // namespace tmss
@@ -15,6 +15,7 @@
 #include <coroutine/coroutine.hpp>
 #include <parser.hpp>
 #include <io/io_buffer.hpp>
+#include <io/io_buf.hpp>
 
 namespace tmss {
 class IDeMux;
@@ -28,6 +29,10 @@ class IClient : public ICoroutineHandler {
 
  public:
     virtual int init(std::shared_ptr<IClientConn> conn);
+    /*
+    *   switch to another connected conn, the buffer is kept
+    */
+    virtual int reset_conn(std::shared_ptr<IClientConn> conn);
     virtual int cycle();
     virtual int request(const std::string& origin_host,
         const std::string& origin_path,
@@ -41,6 +46,33 @@ class IClient : public ICoroutineHandler {
 
     virtual int write_data(const char* buf, int size) = 0;
 
+    /*
+    *   read to the tail of buf, return read length
+    */
+    virtual int read_buf(IOBuf& buf, int size);
+    /*
+    *   write the iovecs as one write_data, return the written length
+    */
+    virtual int writev_data(const iovec* iov, int iov_size);
+
+    /*
+    *   connect to the origin, the client may reuse an idle connection
+    */
+    virtual int connect_origin(Address& address);
+    /*
+    *   the response is read completely, the client may keep the connection
+    */
+    virtual void release_conn();
+
+    /*
+    *   the response header of play, sent once before the data
+    */
+    virtual int send_status(int status);
+    /*
+    *   end the response body of play
+    */
+    virtual int send_eof();
+
  public:
     std::shared_ptr<IClientConn> conn;
 
@@ -0,0 +1,468 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+
+#include <http2_hpack.hpp>
+#include <defs/err.hpp>
+#include <log/log.hpp>
+
+namespace tmss {
+// RFC 7541 appendix A
+static const Http2Header hpack_static_table[] = {
+    Http2Header(":authority", ""),
+    Http2Header(":method", "GET"),
+    Http2Header(":method", "POST"),
+    Http2Header(":path", "/"),
+    Http2Header(":path", "/index.html"),
+    Http2Header(":scheme", "http"),
+    Http2Header(":scheme", "https"),
+    Http2Header(":status", "200"),
+    Http2Header(":status", "204"),
+    Http2Header(":status", "206"),
+    Http2Header(":status", "304"),
+    Http2Header(":status", "400"),
+    Http2Header(":status", "404"),
+    Http2Header(":status", "500"),
+    Http2Header("accept-charset", ""),
+    Http2Header("accept-encoding", "gzip, deflate"),
+    Http2Header("accept-language", ""),
+    Http2Header("accept-ranges", ""),
+    Http2Header("accept", ""),
+    Http2Header("access-control-allow-origin", ""),
+    Http2Header("age", ""),
+    Http2Header("allow", ""),
+    Http2Header("authorization", ""),
+    Http2Header("cache-control", ""),
+    Http2Header("content-disposition", ""),
+    Http2Header("content-encoding", ""),
+    Http2Header("content-language", ""),
+    Http2Header("content-length", ""),
+    Http2Header("content-location", ""),
+    Http2Header("content-range", ""),
+    Http2Header("content-type", ""),
+    Http2Header("cookie", ""),
+    Http2Header("date", ""),
+    Http2Header("etag", ""),
+    Http2Header("expect", ""),
+    Http2Header("expires", ""),
+    Http2Header("from", ""),
+    Http2Header("host", ""),
+    Http2Header("if-match", ""),
+    Http2Header("if-modified-since", ""),
+    Http2Header("if-none-match", ""),
+    Http2Header("if-range", ""),
+    Http2Header("if-unmodified-since", ""),
+    Http2Header("last-modified", ""),
+    Http2Header("link", ""),
+    Http2Header("location", ""),
+    Http2Header("max-forwards", ""),
+    Http2Header("proxy-authenticate", ""),
+    Http2Header("proxy-authorization", ""),
+    Http2Header("range", ""),
+    Http2Header("referer", ""),
+    Http2Header("refresh", ""),
+    Http2Header("retry-after", ""),
+    Http2Header("server", ""),
+    Http2Header("set-cookie", ""),
+    Http2Header("strict-transport-security", ""),
+    Http2Header("transfer-encoding", ""),
+    Http2Header("user-agent", ""),
+    Http2Header("vary", ""),
+    Http2Header("via", ""),
+    Http2Header("www-authenticate", ""),
+};
+
+static const uint32_t hpack_static_table_size =
+    sizeof(hpack_static_table) / sizeof(hpack_static_table[0]);
+
+// the entry overhead, RFC 7541 4.1
+static const uint32_t hpack_entry_overhead = 32;
+
+// code and bits of each symbol, RFC 7541 appendix B
+static const struct {
+    uint32_t code;
+    uint8_t bits;
+} hpack_huffman_codes[256] = {
+    {0x00001ff8, 13}, {0x007fffd8, 23}, {0x0fffffe2, 28}, {0x0fffffe3, 28},
+    {0x0fffffe4, 28}, {0x0fffffe5, 28}, {0x0fffffe6, 28}, {0x0fffffe7, 28},
+    {0x0fffffe8, 28}, {0x00ffffea, 24}, {0x3ffffffc, 30}, {0x0fffffe9, 28},
+    {0x0fffffea, 28}, {0x3ffffffd, 30}, {0x0fffffeb, 28}, {0x0fffffec, 28},
+    {0x0fffffed, 28}, {0x0fffffee, 28}, {0x0fffffef, 28}, {0x0ffffff0, 28},
+    {0x0ffffff1, 28}, {0x0ffffff2, 28}, {0x3ffffffe, 30}, {0x0ffffff3, 28},
+    {0x0ffffff4, 28}, {0x0ffffff5, 28}, {0x0ffffff6, 28}, {0x0ffffff7, 28},
+    {0x0ffffff8, 28}, {0x0ffffff9, 28}, {0x0ffffffa, 28}, {0x0ffffffb, 28},
+    {0x00000014,  6}, {0x000003f8, 10}, {0x000003f9, 10}, {0x00000ffa, 12},
+    {0x00001ff9, 13}, {0x00000015,  6}, {0x000000f8,  8}, {0x000007fa, 11},
+    {0x000003fa, 10}, {0x000003fb, 10}, {0x000000f9,  8}, {0x000007fb, 11},
+    {0x000000fa,  8}, {0x00000016,  6}, {0x00000017,  6}, {0x00000018,  6},
+    {0x00000000,  5}, {0x00000001,  5}, {0x00000002,  5}, {0x00000019,  6},
+    {0x0000001a,  6}, {0x0000001b,  6}, {0x0000001c,  6}, {0x0000001d,  6},
+    {0x0000001e,  6}, {0x0000001f,  6}, {0x0000005c,  7}, {0x000000fb,  8},
+    {0x00007ffc, 15}, {0x00000020,  6}, {0x00000ffb, 12}, {0x000003fc, 10},
+    {0x00001ffa, 13}, {0x00000021,  6}, {0x0000005d,  7}, {0x0000005e,  7},
+    {0x0000005f,  7}, {0x00000060,  7}, {0x00000061,  7}, {0x00000062,  7},
+    {0x00000063,  7}, {0x00000064,  7}, {0x00000065,  7}, {0x00000066,  7},
+    {0x00000067,  7}, {0x00000068,  7}, {0x00000069,  7}, {0x0000006a,  7},
+    {0x0000006b,  7}, {0x0000006c,  7}, {0x0000006d,  7}, {0x0000006e,  7},
+    {0x0000006f,  7}, {0x00000070,  7}, {0x00000071,  7}, {0x00000072,  7},
+    {0x000000fc,  8}, {0x00000073,  7}, {0x000000fd,  8}, {0x00001ffb, 13},
+    {0x0007fff0, 19}, {0x00001ffc, 13}, {0x00003ffc, 14}, {0x00000022,  6},
+    {0x00007ffd, 15}, {0x00000003,  5}, {0x00000023,  6}, {0x00000004,  5},
+    {0x00000024,  6}, {0x00000005,  5}, {0x00000025,  6}, {0x00000026,  6},
+    {0x00000027,  6}, {0x00000006,  5}, {0x00000074,  7}, {0x00000075,  7},
+    {0x00000028,  6}, {0x00000029,  6}, {0x0000002a,  6}, {0x00000007,  5},
+    {0x0000002b,  6}, {0x00000076,  7}, {0x0000002c,  6}, {0x00000008,  5},
+    {0x00000009,  5}, {0x0000002d,  6}, {0x00000077,  7}, {0x00000078,  7},
+    {0x00000079,  7}, {0x0000007a,  7}, {0x0000007b,  7}, {0x00007ffe, 15},
+    {0x000007fc, 11}, {0x00003ffd, 14}, {0x00001ffd, 13}, {0x0ffffffc, 28},
+    {0x000fffe6, 20}, {0x003fffd2, 22}, {0x000fffe7, 20}, {0x000fffe8, 20},
+    {0x003fffd3, 22}, {0x003fffd4, 22}, {0x003fffd5, 22}, {0x007fffd9, 23},
+    {0x003fffd6, 22}, {0x007fffda, 23}, {0x007fffdb, 23}, {0x007fffdc, 23},
+    {0x007fffdd, 23}, {0x007fffde, 23}, {0x00ffffeb, 24}, {0x007fffdf, 23},
+    {0x00ffffec, 24}, {0x00ffffed, 24}, {0x003fffd7, 22}, {0x007fffe0, 23},
+    {0x00ffffee, 24}, {0x007fffe1, 23}, {0x007fffe2, 23}, {0x007fffe3, 23},
+    {0x007fffe4, 23}, {0x001fffdc, 21}, {0x003fffd8, 22}, {0x007fffe5, 23},
+    {0x003fffd9, 22}, {0x007fffe6, 23}, {0x007fffe7, 23}, {0x00ffffef, 24},
+    {0x003fffda, 22}, {0x001fffdd, 21}, {0x000fffe9, 20}, {0x003fffdb, 22},
+    {0x003fffdc, 22}, {0x007fffe8, 23}, {0x007fffe9, 23}, {0x001fffde, 21},
+    {0x007fffea, 23}, {0x003fffdd, 22}, {0x003fffde, 22}, {0x00fffff0, 24},
+    {0x001fffdf, 21}, {0x003fffdf, 22}, {0x007fffeb, 23}, {0x007fffec, 23},
+    {0x001fffe0, 21}, {0x001fffe1, 21}, {0x003fffe0, 22}, {0x001fffe2, 21},
+    {0x007fffed, 23}, {0x003fffe1, 22}, {0x007fffee, 23}, {0x007fffef, 23},
+    {0x000fffea, 20}, {0x003fffe2, 22}, {0x003fffe3, 22}, {0x003fffe4, 22},
+    {0x007ffff0, 23}, {0x003fffe5, 22}, {0x003fffe6, 22}, {0x007ffff1, 23},
+    {0x03ffffe0, 26}, {0x03ffffe1, 26}, {0x000fffeb, 20}, {0x0007fff1, 19},
+    {0x003fffe7, 22}, {0x007ffff2, 23}, {0x003fffe8, 22}, {0x01ffffec, 25},
+    {0x03ffffe2, 26}, {0x03ffffe3, 26}, {0x03ffffe4, 26}, {0x07ffffde, 27},
+    {0x07ffffdf, 27}, {0x03ffffe5, 26}, {0x00fffff1, 24}, {0x01ffffed, 25},
+    {0x0007fff2, 19}, {0x001fffe3, 21}, {0x03ffffe6, 26}, {0x07ffffe0, 27},
+    {0x07ffffe1, 27}, {0x03ffffe7, 26}, {0x07ffffe2, 27}, {0x00fffff2, 24},
+    {0x001fffe4, 21}, {0x001fffe5, 21}, {0x03ffffe8, 26}, {0x03ffffe9, 26},
+    {0x0ffffffd, 28}, {0x07ffffe3, 27}, {0x07ffffe4, 27}, {0x07ffffe5, 27},
+    {0x000fffec, 20}, {0x00fffff3, 24}, {0x000fffed, 20}, {0x001fffe6, 21},
+    {0x003fffe9, 22}, {0x001fffe7, 21}, {0x001fffe8, 21}, {0x007ffff3, 23},
+    {0x003fffea, 22}, {0x003fffeb, 22}, {0x01ffffee, 25}, {0x01ffffef, 25},
+    {0x00fffff4, 24}, {0x00fffff5, 24}, {0x03ffffea, 26}, {0x007ffff4, 23},
+    {0x03ffffeb, 26}, {0x07ffffe6, 27}, {0x03ffffec, 26}, {0x03ffffed, 26},
+    {0x07ffffe7, 27}, {0x07ffffe8, 27}, {0x07ffffe9, 27}, {0x07ffffea, 27},
+    {0x07ffffeb, 27}, {0x0ffffffe, 28}, {0x07ffffec, 27}, {0x07ffffed, 27},
+    {0x07ffffee, 27}, {0x07ffffef, 27}, {0x07fffff0, 27}, {0x03ffffee, 26},
+};
+
+/**
+ * the decode tree of huffman code, built once,
+ * the leaf is the symbol, EOS is 256.
+ */
+class HpackHuffmanTree {
+ public:
+    struct Node {
+        int16_t children[2];
+        int16_t symbol;
+    };
+    std::vector<Node> nodes;
+
+ public:
+    HpackHuffmanTree() {
+        nodes.reserve(512);
+        nodes.push_back(Node{{-1, -1}, -1});
+        for (int i = 0; i < 256; i++) {
+            insert(hpack_huffman_codes[i].code, hpack_huffman_codes[i].bits, i);
+        }
+        // EOS, 30 bits of 1
+        insert(0x3fffffff, 30, 256);
+    }
+
+ private:
+    void insert(uint32_t code, int bits, int symbol) {
+        int node = 0;
+        for (int i = bits - 1; i >= 0; i--) {
+            int bit = (code >> i) & 1;
+            if (nodes[node].children[bit] < 0) {
+                nodes[node].children[bit] = nodes.size();
+                nodes.push_back(Node{{-1, -1}, -1});
+            }
+            node = nodes[node].children[bit];
+        }
+        nodes[node].symbol = symbol;
+    }
+};
+
+int hpack_huffman_decode(const uint8_t* data, int size, std::string& value) {
+    int ret = error_success;
+    static const HpackHuffmanTree tree;
+
+    value.clear();
+    value.reserve(size * 8 / 5);
+    int node = 0;
+    // the bits since the last symbol, and whether they are all 1
+    int pending_bits = 0;
+    bool pending_ones = true;
+    for (int i = 0; i < size; i++) {
+        for (int shift = 7; shift >= 0; shift--) {
+            int bit = (data[i] >> shift) & 1;
+            node = tree.nodes[node].children[bit];
+            if (node < 0) {
+                ret = error_http2_hpack_decode;
+                tmss_error("hpack huffman code invalid, ret={}", ret);
+                return ret;
+            }
+            pending_bits++;
+            pending_ones = pending_ones && bit;
+
+            int symbol = tree.nodes[node].symbol;
+            if (symbol < 0) {
+                continue;
+            }
+            if (symbol == 256) {
+                ret = error_http2_hpack_decode;
+                tmss_error("hpack huffman EOS in string, ret={}", ret);
+                return ret;
+            }
+            value.push_back(static_cast<char>(symbol));
+            node = 0;
+            pending_bits = 0;
+            pending_ones = true;
+        }
+    }
+
+    // the padding is the most significant bits of EOS, less than 8 bits
+    if (pending_bits > 7 || !pending_ones) {
+        ret = error_http2_hpack_decode;
+        tmss_error("hpack huffman padding invalid, bits={}, ret={}", pending_bits, ret);
+        return ret;
+    }
+    return ret;
+}
+
+HpackTable::HpackTable() {
+    size = 0;
+    max_size = TMSS_HPACK_DEFAULT_TABLE_SIZE;
+}
+
+void HpackTable::add(const std::string& name, const std::string& value) {
+    uint32_t entry_size = name.size() + value.size() + hpack_entry_overhead;
+    // the entry larger than table empties the table, RFC 7541 4.4
+    if (entry_size > max_size) {
+        entries.clear();
+        size = 0;
+        return;
+    }
+    evict(entry_size);
+    entries.push_front(Http2Header(name, value));
+    size += entry_size;
+}
+
+void HpackTable::set_max_size(uint32_t max_size) {
+    this->max_size = max_size;
+    evict(0);
+}
+
+const Http2Header* HpackTable::get(uint32_t index) {
+    if (index == 0) {
+        return NULL;
+    }
+    if (index <= hpack_static_table_size) {
+        return &hpack_static_table[index - 1];
+    }
+    index -= hpack_static_table_size + 1;
+    if (index >= entries.size()) {
+        return NULL;
+    }
+    return &entries[index];
+}
+
+void HpackTable::evict(uint32_t wanted) {
+    while (!entries.empty() && size + wanted > max_size) {
+        const Http2Header& entry = entries.back();
+        size -= entry.first.size() + entry.second.size() + hpack_entry_overhead;
+        entries.pop_back();
+    }
+}
+
+HpackDecoder::HpackDecoder() {
+    pos = NULL;
+    end = NULL;
+    max_table_size = TMSS_HPACK_DEFAULT_TABLE_SIZE;
+}
+
+void HpackDecoder::set_max_table_size(uint32_t size) {
+    max_table_size = size;
+}
+
+int HpackDecoder::decode(const char* data, int size, std::vector<Http2Header>& headers) {
+    int ret = error_success;
+    pos = reinterpret_cast<const uint8_t*>(data);
+    end = pos + size;
+
+    while (pos < end) {
+        uint8_t type = *pos;
+        uint32_t index = 0;
+        if (type & 0x80) {
+            // indexed header field
+            if ((ret = read_integer(7, index)) != error_success) {
+                return ret;
+            }
+            const Http2Header* entry = table.get(index);
+            if (!entry) {
+                ret = error_http2_hpack_decode;
+                tmss_error("hpack index invalid, index={}, ret={}", index, ret);
+                return ret;
+            }
+            headers.push_back(*entry);
+            continue;
+        }
+
+        if ((type & 0xe0) == 0x20) {
+            // dynamic table size update
+            uint32_t table_size = 0;
+            if ((ret = read_integer(5, table_size)) != error_success) {
+                return ret;
+            }
+            if (table_size > max_table_size) {
+                ret = error_http2_hpack_decode;
+                tmss_error("hpack table size too large, size={}, ret={}", table_size, ret);
+                return ret;
+            }
+            table.set_max_size(table_size);
+            continue;
+        }
+
+        // literal with incremental indexing, without indexing, never indexed
+        bool indexing = (type & 0xc0) == 0x40;
+        if ((ret = read_integer(indexing ? 6 : 4, index)) != error_success) {
+            return ret;
+        }
+        Http2Header header;
+        if (index > 0) {
+            const Http2Header* entry = table.get(index);
+            if (!entry) {
+                ret = error_http2_hpack_decode;
+                tmss_error("hpack name index invalid, index={}, ret={}", index, ret);
+                return ret;
+            }
+            header.first = entry->first;
+        } else if ((ret = read_string(header.first)) != error_success) {
+            return ret;
+        }
+        if ((ret = read_string(header.second)) != error_success) {
+            return ret;
+        }
+        if (indexing) {
+            table.add(header.first, header.second);
+        }
+        headers.push_back(header);
+    }
+
+    return ret;
+}
+
+int HpackDecoder::read_integer(int prefix, uint32_t& value) {
+    int ret = error_success;
+    uint32_t mask = (1 << prefix) - 1;
+    value = *pos++ & mask;
+    if (value < mask) {
+        return ret;
+    }
+
+    int shift = 0;
+    while (true) {
+        // 4 bytes after prefix is enough for uint32
+        if (pos >= end || shift > 21) {
+            ret = error_http2_hpack_decode;
+            tmss_error("hpack integer invalid, ret={}", ret);
+            return ret;
+        }
+        uint8_t b = *pos++;
+        value += static_cast<uint32_t>(b & 0x7f) << shift;
+        shift += 7;
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+    return ret;
+}
+
+int HpackDecoder::read_string(std::string& value) {
+    int ret = error_success;
+    if (pos >= end) {
+        ret = error_http2_hpack_decode;
+        tmss_error("hpack string no length, ret={}", ret);
+        return ret;
+    }
+    bool huffman = (*pos & 0x80) != 0;
+    uint32_t length = 0;
+    if ((ret = read_integer(7, length)) != error_success) {
+        return ret;
+    }
+    if (length > static_cast<uint32_t>(end - pos)) {
+        ret = error_http2_hpack_decode;
+        tmss_error("hpack string too long, length={}, ret={}", length, ret);
+        return ret;
+    }
+
+    if (huffman) {
+        ret = hpack_huffman_decode(pos, length, value);
+    } else {
+        value.assign(reinterpret_cast<const char*>(pos), length);
+    }
+    pos += length;
+    return ret;
+}
+
+void HpackEncoder::encode(const std::vector<Http2Header>& headers, std::string& block) {
+    for (auto& header : headers) {
+        uint32_t name_index = 0;
+        uint32_t index = 0;
+        for (uint32_t i = 0; i < hpack_static_table_size; i++) {
+            if (hpack_static_table[i].first != header.first) {
+                continue;
+            }
+            if (!name_index) {
+                name_index = i + 1;
+            }
+            if (hpack_static_table[i].second == header.second) {
+                index = i + 1;
+                break;
+            }
+        }
+
+        if (index) {
+            write_integer(0x80, 7, index, block);
+            continue;
+        }
+        // literal without indexing
+        write_integer(0x00, 4, name_index, block);
+        if (!name_index) {
+            write_string(header.first, block);
+        }
+        write_string(header.second, block);
+    }
+}
+
+void HpackEncoder::write_integer(uint8_t flags, int prefix, uint32_t value, std::string& block) {
+    uint32_t mask = (1 << prefix) - 1;
+    if (value < mask) {
+        block.push_back(static_cast<char>(flags | value));
+        return;
+    }
+    block.push_back(static_cast<char>(flags | mask));
+    value -= mask;
+    while (value >= 0x80) {
+        block.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    block.push_back(static_cast<char>(value));
+}
+
+void HpackEncoder::write_string(const std::string& value, std::string& block) {
+    write_integer(0x00, 7, value.size(), block);
+    block.append(value);
+}
+
+}  // namespace tmss
@@ -0,0 +1,89 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tmss {
+typedef std::pair<std::string, std::string> Http2Header;
+
+// the default SETTINGS_HEADER_TABLE_SIZE, RFC 7540 6.5.2
+#define TMSS_HPACK_DEFAULT_TABLE_SIZE 4096
+
+/**
+ * the dynamic table of HPACK, RFC 7541 2.3.2,
+ * the newest entry is at front, the index starts after the static table.
+ */
+class HpackTable {
+ public:
+    HpackTable();
+
+ public:
+    void add(const std::string& name, const std::string& value);
+    void set_max_size(uint32_t max_size);
+    // index starts from 1, the static table then the dynamic table
+    const Http2Header* get(uint32_t index);
+
+ private:
+    void evict(uint32_t wanted);
+
+ private:
+    std::deque<Http2Header> entries;
+    // the entry size is name + value + 32
+    uint32_t size;
+    uint32_t max_size;
+};
+
+/**
+ * decode the header block of HEADERS and CONTINUATION.
+ * one decoder for each connection, the dynamic table is kept between blocks.
+ */
+class HpackDecoder {
+ public:
+    HpackDecoder();
+
+ public:
+    int decode(const char* data, int size, std::vector<Http2Header>& headers);
+    // the SETTINGS_HEADER_TABLE_SIZE we sent, the upper bound of size update
+    void set_max_table_size(uint32_t size);
+
+ private:
+    int read_integer(int prefix, uint32_t& value);
+    int read_string(std::string& value);
+
+ private:
+    const uint8_t* pos;
+    const uint8_t* end;
+    uint32_t max_table_size;
+    HpackTable table;
+};
+
+/**
+ * encode the response headers.
+ * never add to the dynamic table, so the peer table is always empty,
+ * the names in static table are indexed, the values are raw literals.
+ */
+class HpackEncoder {
+ public:
+    void encode(const std::vector<Http2Header>& headers, std::string& block);
+
+ private:
+    void write_integer(uint8_t flags, int prefix, uint32_t value, std::string& block);
+    void write_string(const std::string& value, std::string& block);
+};
+
+// decode the huffman coded string, RFC 7541 appendix B
+extern int hpack_huffman_decode(const uint8_t* data, int size, std::string& value);
+
+}  // namespace tmss
@@ -0,0 +1,823 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include <http2_server.hpp>
+#include <http_server.hpp>
+#include <http/http_stack.hpp>
+#include <defs/err.hpp>
+#include <log/log.hpp>
+
+namespace tmss {
+// the client connection preface, RFC 7540 3.5
+static const char* http2_preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+// the rest of preface after it is parsed as a http/1.1 request
+static const char* http2_preface_left = "SM\r\n\r\n";
+
+static const int http2_frame_header_size = 9;
+static const uint8_t http2_flag_end_stream = 0x1;
+static const uint8_t http2_flag_ack = 0x1;
+static const uint8_t http2_flag_end_headers = 0x4;
+static const uint8_t http2_flag_padded = 0x8;
+static const uint8_t http2_flag_priority = 0x20;
+
+static const uint16_t http2_settings_max_concurrent_streams = 0x3;
+static const uint16_t http2_settings_initial_window_size = 0x4;
+static const uint16_t http2_settings_max_frame_size = 0x5;
+static const uint16_t http2_settings_max_header_list_size = 0x6;
+
+static const int64_t http2_default_window = 65535;
+static const int64_t http2_max_window = 0x7fffffff;
+// the frame size we accept, SETTINGS_MAX_FRAME_SIZE is never raised
+static const uint32_t http2_default_frame_size = 16384;
+static const uint32_t http2_max_frame_size = 16777215;
+static const uint32_t http2_max_concurrent_streams = 128;
+// the header block with its CONTINUATION, and the decoded header list
+static const uint32_t http2_max_header_list_size = 64 * 1024;
+// one frame with the largest payload fits in the read buffer
+static const int http2_read_buffer_size = 32 * 1024;
+
+static uint32_t http2_read_uint32(const char* p) {
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    return (u[0] << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+}
+
+static void http2_write_uint32(char* p, uint32_t value) {
+    p[0] = static_cast<char>(value >> 24);
+    p[1] = static_cast<char>(value >> 16);
+    p[2] = static_cast<char>(value >> 8);
+    p[3] = static_cast<char>(value);
+}
+
+Http2Stream::Http2Stream(std::shared_ptr<Http2Session> session,
+        uint32_t stream_id,
+        std::shared_ptr<HttpRequest> req,
+        std::shared_ptr<IServer> server) {
+    this->session = session;
+    this->stream_id = stream_id;
+    this->req = req;
+    this->server = server;
+    send_window = http2_default_window;
+    is_send_header = false;
+    is_send_end = false;
+    stop_cond = st_cond_new();
+}
+
+Http2Stream::~Http2Stream() {
+    st_cond_destroy(stop_cond);
+}
+
+int Http2Stream::cycle() {
+    int ret = HttpMux::get_instance()->serve_http(
+        std::dynamic_pointer_cast<IClientConn>(shared_from_this()), req, server);
+    if (ret != error_success) {
+        tmss_error("http2 serve failed, stream_id={}, ret={}", stream_id, ret);
+        if (!is_send_header && !is_stop()) {
+            std::string response;
+            CHttp http;
+            http.buildResponseHeader(404, "", 0, false, false, response);
+            write(response.c_str(), response.length());
+        }
+    } else if (req->streaming) {
+        // the output sends the stream until the client resets it
+        while (!is_stop()) {
+            st_cond_wait(stop_cond);
+        }
+        return ret;
+    }
+
+    if (!is_stop()) {
+        finish();
+    }
+    return ret;
+}
+
+int Http2Stream::on_thread_stop() {
+    session->remove_stream(stream_id);
+    return error_success;
+}
+
+int Http2Stream::connect(Address address) {
+    return error_socket_connect;
+}
+
+int Http2Stream::close() {
+    if (!is_send_end && !is_stop()) {
+        session->send_rst_stream(stream_id, EHttp2Cancel);
+    }
+    set_stop();
+    return error_success;
+}
+
+int Http2Stream::write(const char* buf, int size) {
+    int ret = error_success;
+    if (is_stop()) {
+        tmss_info("http2 stream already stop, stream_id={}", stream_id);
+        return error_socket_already_closed;
+    }
+
+    std::shared_ptr<Http2Stream> self =
+        std::dynamic_pointer_cast<Http2Stream>(shared_from_this());
+    if (is_send_header) {
+        if ((ret = session->send_data(self, buf, size, false)) != error_success) {
+            return ret;
+        }
+        return size;
+    }
+
+    // the handler writes the http/1.1 header first
+    header.append(buf, size);
+    size_t end = header.find("\r\n\r\n");
+    if (end == std::string::npos) {
+        return size;
+    }
+    std::string body = header.substr(end + 4);
+    header.resize(end + 4);
+    if ((ret = send_header(header)) != error_success) {
+        return ret;
+    }
+    header.clear();
+    if (!body.empty()
+        && (ret = session->send_data(self, body.data(), body.size(), false)) != error_success) {
+        return ret;
+    }
+    return size;
+}
+
+int Http2Stream::writev(const iovec *iov, int iov_size) {
+    int total = 0;
+    for (int i = 0; i < iov_size; i++) {
+        int size = iov[i].iov_len;
+        int ret = write(static_cast<const char*>(iov[i].iov_base), size);
+        if (ret != size) {
+            return ret;
+        }
+        total += size;
+    }
+    return total;
+}
+
+void Http2Stream::set_stop() {
+    stop = true;
+    st_cond_broadcast(stop_cond);
+}
+
+bool Http2Stream::is_stop() {
+    return stop || session->is_stop();
+}
+
+int Http2Stream::send_header(const std::string& header) {
+    int ret = error_success;
+
+    // HTTP/1.1 200 OK
+    std::vector<Http2Header> headers;
+    size_t line_end = header.find("\r\n");
+    size_t space = header.find(' ');
+    if (space == std::string::npos || space > line_end) {
+        ret = error_http_request_invalid;
+        tmss_error("http2 response status invalid, stream_id={}, ret={}", stream_id, ret);
+        return ret;
+    }
+    headers.push_back(Http2Header(":status", header.substr(space + 1, 3)));
+
+    size_t pos = line_end + 2;
+    while (pos < header.size()) {
+        line_end = header.find("\r\n", pos);
+        if (line_end == pos || line_end == std::string::npos) {
+            break;
+        }
+        size_t colon = header.find(':', pos);
+        if (colon != std::string::npos && colon < line_end) {
+            std::string name = header.substr(pos, colon - pos);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            size_t value = header.find_first_not_of(' ', colon + 1);
+            // the connection specific headers are not allowed, RFC 7540 8.1.2.2
+            if (name != "connection" && name != "keep-alive" && name != "transfer-encoding"
+                && name != "upgrade" && name != "proxy-connection") {
+                headers.push_back(Http2Header(name,
+                    (value < line_end) ? header.substr(value, line_end - value) : ""));
+            }
+        }
+        pos = line_end + 2;
+    }
+
+    if ((ret = session->send_headers(stream_id, headers, false)) != error_success) {
+        return ret;
+    }
+    is_send_header = true;
+    return ret;
+}
+
+int Http2Stream::finish() {
+    int ret = error_success;
+    if (is_send_end) {
+        return ret;
+    }
+    is_send_end = true;
+
+    if (!is_send_header) {
+        // no response from handler
+        std::vector<Http2Header> headers;
+        headers.push_back(Http2Header(":status", "200"));
+        is_send_header = true;
+        return session->send_headers(stream_id, headers, true);
+    }
+    return session->send_data(std::dynamic_pointer_cast<Http2Stream>(shared_from_this()),
+        NULL, 0, true);
+}
+
+Http2Session::Http2Session(std::shared_ptr<IClientConn> conn,
+        std::shared_ptr<IServer> server) {
+    this->conn = conn;
+    this->server = server;
+    input.resize(http2_read_buffer_size);
+    input_pos = 0;
+    input_size = 0;
+    stop = false;
+    last_stream_id = 0;
+    header_stream_id = 0;
+    initial_window = http2_default_window;
+    max_frame_size = http2_default_frame_size;
+    send_window = http2_default_window;
+    window_waiters = 0;
+    window_cond = st_cond_new();
+    write_lock = st_mutex_new();
+}
+
+Http2Session::~Http2Session() {
+    st_cond_destroy(window_cond);
+    st_mutex_destroy(write_lock);
+}
+
+int Http2Session::serve(std::shared_ptr<HttpRequest> req, const std::string& left) {
+    int ret = error_success;
+
+    if (left.size() > input.size()) {
+        input.resize(left.size());
+    }
+    memcpy(input.data(), left.data(), left.size());
+    input_size = left.size();
+
+    // the streams are long, the connection is closed by client
+    conn->set_recv_timeout(-1);
+
+    if (req->http2_upgrade) {
+        static const char* switching = "HTTP/1.1 101 Switching Protocols\r\n"
+            "Connection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+        if ((ret = conn->write(switching, strlen(switching))) < 0) {
+            tmss_error("send h2c upgrade failed, ret={}", ret);
+            return ret;
+        }
+    }
+
+    // the server preface is SETTINGS, sent without waiting for the client preface
+    if ((ret = send_settings()) != error_success) {
+        return ret;
+    }
+    if ((ret = read_preface(req->http2_upgrade ? http2_preface : http2_preface_left))
+            != error_success) {
+        return ret;
+    }
+    tmss_info("http2 session start, upgrade={}", req->http2_upgrade);
+
+    if (req->http2_upgrade) {
+        // the upgraded request is stream 1, half closed, RFC 7540 3.2
+        req->keep_alive = false;
+        last_stream_id = 1;
+        create_stream(1, req);
+    }
+
+    while (!stop && !conn->is_stop()) {
+        Http2Frame frame;
+        if ((ret = read_frame(frame)) != error_success) {
+            break;
+        }
+        if ((ret = on_frame(frame)) != error_success) {
+            break;
+        }
+    }
+
+    tmss_info("http2 session stop, streams={}, ret={}", streams.size(), ret);
+    stop = true;
+    st_cond_broadcast(window_cond);
+    std::map<uint32_t, std::shared_ptr<Http2Stream>> stopped;
+    stopped.swap(streams);
+    for (auto& stream : stopped) {
+        stream.second->set_stop();
+    }
+    return ret;
+}
+
+bool Http2Session::is_stop() {
+    return stop || conn->is_stop();
+}
+
+int Http2Session::send_frame(uint8_t type, uint8_t flags, uint32_t stream_id,
+        const char* payload, int size) {
+    st_mutex_lock(write_lock);
+    int ret = write_frame(type, flags, stream_id, payload, size);
+    st_mutex_unlock(write_lock);
+    return ret;
+}
+
+int Http2Session::write_frame(uint8_t type, uint8_t flags, uint32_t stream_id,
+        const char* payload, int size) {
+    char header[http2_frame_header_size];
+    header[0] = static_cast<char>(size >> 16);
+    header[1] = static_cast<char>(size >> 8);
+    header[2] = static_cast<char>(size);
+    header[3] = static_cast<char>(type);
+    header[4] = static_cast<char>(flags);
+    http2_write_uint32(header + 5, stream_id);
+
+    iovec iovs[2];
+    iovs[0].iov_base = header;
+    iovs[0].iov_len = http2_frame_header_size;
+    iovs[1].iov_base = const_cast<char*>(payload);
+    iovs[1].iov_len = size;
+    // the positive error code is returned if the conn is closed
+    int ret = conn->writev(iovs, (size > 0) ? 2 : 1);
+    if (ret != http2_frame_header_size + size) {
+        tmss_error("http2 write frame failed, type={}, stream_id={}, ret={}",
+            type, stream_id, ret);
+        stop = true;
+        return (ret < 0) ? ret : error_socket_write;
+    }
+    return error_success;
+}
+
+int Http2Session::send_headers(uint32_t stream_id,
+        const std::vector<Http2Header>& headers, bool end_stream) {
+    int ret = error_success;
+    std::string block;
+    encoder.encode(headers, block);
+
+    st_mutex_lock(write_lock);
+    int pos = 0;
+    int block_size = block.size();
+    do {
+        int size = std::min(block_size - pos, static_cast<int>(max_frame_size));
+        uint8_t flags = (pos + size == block_size) ? http2_flag_end_headers : 0;
+        uint8_t type = EHttp2FrameContinuation;
+        if (pos == 0) {
+            type = EHttp2FrameHeaders;
+            flags |= end_stream ? http2_flag_end_stream : 0;
+        }
+        ret = write_frame(type, flags, stream_id, block.data() + pos, size);
+        if (ret != error_success) {
+            break;
+        }
+        pos += size;
+    } while (pos < block_size);
+    st_mutex_unlock(write_lock);
+
+    return ret;
+}
+
+int Http2Session::send_data(std::shared_ptr<Http2Stream> stream,
+        const char* data, int size, bool end_stream) {
+    int ret = error_success;
+    int pos = 0;
+    do {
+        // only this stream waits when its window is used up
+        while (pos < size && !stream->is_stop()
+            && (stream->send_window <= 0 || send_window <= 0)) {
+            window_waiters++;
+            int r0 = st_cond_wait(window_cond);
+            window_waiters--;
+            if (r0 != 0) {
+                ret = error_socket_already_closed;
+                tmss_error("http2 wait window interrupted, stream_id={}", stream->get_stream_id());
+                return ret;
+            }
+        }
+        if (stream->is_stop()) {
+            return error_socket_already_closed;
+        }
+
+        int wanted = std::min(size - pos, static_cast<int>(max_frame_size));
+        wanted = std::min(static_cast<int64_t>(wanted), std::min(stream->send_window, send_window));
+        uint8_t flags = (end_stream && pos + wanted == size) ? http2_flag_end_stream : 0;
+        ret = send_frame(EHttp2FrameData, flags, stream->get_stream_id(), data + pos, wanted);
+        if (ret != error_success) {
+            return ret;
+        }
+        stream->send_window -= wanted;
+        send_window -= wanted;
+        pos += wanted;
+
+        // the woken streams share the connection window, a large segment
+        // does not take it all before a playlist gets a frame
+        if (window_waiters > 0 && pos < size) {
+            st_usleep(0);
+        }
+    } while (pos < size);
+
+    return ret;
+}
+
+int Http2Session::send_rst_stream(uint32_t stream_id, uint32_t error_code) {
+    char payload[4];
+    http2_write_uint32(payload, error_code);
+    return send_frame(EHttp2FrameRstStream, 0, stream_id, payload, sizeof(payload));
+}
+
+void Http2Session::remove_stream(uint32_t stream_id) {
+    streams.erase(stream_id);
+}
+
+int Http2Session::fill(int size) {
+    int ret = error_success;
+    if (input_size - input_pos >= size) {
+        return ret;
+    }
+
+    if (input_pos > 0) {
+        memmove(input.data(), input.data() + input_pos, input_size - input_pos);
+        input_size -= input_pos;
+        input_pos = 0;
+    }
+    if (static_cast<int>(input.size()) < size) {
+        input.resize(size);
+    }
+    while (input_size < size) {
+        int read_size = conn->read(input.data() + input_size, input.size() - input_size);
+        if (read_size < 0) {
+            ret = error_socket_read;
+            tmss_error("http2 read error, ret={}", read_size);
+            return ret;
+        } else if (read_size == 0) {
+            ret = error_socket_already_closed;
+            tmss_info("http2 read stop");
+            return ret;
+        }
+        input_size += read_size;
+    }
+    return ret;
+}
+
+int Http2Session::read_preface(const char* preface) {
+    int ret = error_success;
+    int size = strlen(preface);
+    if ((ret = fill(size)) != error_success) {
+        return ret;
+    }
+    if (memcmp(input.data() + input_pos, preface, size) != 0) {
+        ret = error_http2_preface_invalid;
+        tmss_error("http2 preface invalid, ret={}", ret);
+        return ret;
+    }
+    input_pos += size;
+    return ret;
+}
+
+int Http2Session::read_frame(Http2Frame& frame) {
+    int ret = error_success;
+    if ((ret = fill(http2_frame_header_size)) != error_success) {
+        return ret;
+    }
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(input.data() + input_pos);
+    uint32_t size = (p[0] << 16) | (p[1] << 8) | p[2];
+    frame.type = p[3];
+    frame.flags = p[4];
+    frame.stream_id = http2_read_uint32(input.data() + input_pos + 5) & 0x7fffffff;
+    input_pos += http2_frame_header_size;
+
+    if (size > http2_default_frame_size) {
+        ret = error_http2_frame_size;
+        tmss_error("http2 frame too large, size={}, ret={}", size, ret);
+        send_goaway(EHttp2FrameSizeError);
+        return ret;
+    }
+    if ((ret = fill(size)) != error_success) {
+        return ret;
+    }
+    frame.payload.assign(input.data() + input_pos, size);
+    input_pos += size;
+    return ret;
+}
+
+int Http2Session::on_frame(Http2Frame& frame) {
+    int ret = error_success;
+
+    // nothing between HEADERS and its CONTINUATION, RFC 7540 6.10
+    if (header_stream_id
+        && (frame.type != EHttp2FrameContinuation || frame.stream_id != header_stream_id)) {
+        return on_protocol_error(EHttp2ProtocolError, error_http2_protocol);
+    }
+
+    switch (frame.type) {
+    case EHttp2FrameData:
+        return on_data(frame);
+    case EHttp2FrameHeaders:
+        return on_headers(frame);
+    case EHttp2FrameContinuation: {
+        if (!header_stream_id) {
+            return on_protocol_error(EHttp2ProtocolError, error_http2_protocol);
+        }
+        if (header_block.size() + frame.payload.size() > http2_max_header_list_size) {
+            return on_protocol_error(EHttp2EnhanceYourCalm, error_http_header_too_large);
+        }
+        header_block.append(frame.payload);
+        if (!(frame.flags & http2_flag_end_headers)) {
+            return ret;
+        }
+        uint32_t stream_id = header_stream_id;
+        header_stream_id = 0;
+        std::string block;
+        block.swap(header_block);
+        return on_request(stream_id, block);
+    }
+    case EHttp2FrameRstStream: {
+        auto it = streams.find(frame.stream_id);
+        if (it != streams.end()) {
+            tmss_info("http2 stream reset, stream_id={}", frame.stream_id);
+            it->second->set_stop();
+            st_cond_broadcast(window_cond);
+        }
+        return ret;
+    }
+    case EHttp2FrameSettings:
+        return on_settings(frame);
+    case EHttp2FramePing:
+        if (frame.payload.size() != 8) {
+            return on_protocol_error(EHttp2FrameSizeError, error_http2_frame_size);
+        }
+        if (frame.flags & http2_flag_ack) {
+            return ret;
+        }
+        return send_frame(EHttp2FramePing, http2_flag_ack, 0,
+            frame.payload.data(), frame.payload.size());
+    case EHttp2FrameGoaway:
+        tmss_info("http2 goaway from client");
+        stop = true;
+        return ret;
+    case EHttp2FrameWindowUpdate:
+        return on_window_update(frame);
+    case EHttp2FramePushPromise:
+        // the client never pushes
+        return on_protocol_error(EHttp2ProtocolError, error_http2_protocol);
+    default:
+        // PRIORITY and the unknown frames are ignored
+        return ret;
+    }
+}
+
+int Http2Session::on_headers(Http2Frame& frame) {
+    int ret = error_success;
+    // the client stream is odd and increasing, no trailers of request
+    if (frame.stream_id == 0 || !(frame.stream_id & 1) || frame.stream_id <= last_stream_id) {
+        return on_protocol_error(EHttp2ProtocolError, error_http2_protocol);
+    }
+
+    const char* p = frame.payload.data();
+    int size = frame.payload.size();
+    int padding = 0;
+    if (frame.flags & http2_flag_padded) {
+        if (size < 1) {
+            return on_protocol_error(EHttp2FrameSizeError, error_http2_frame_size);
+        }
+        padding = static_cast<uint8_t>(p[0]);
+        p++;
+        size--;
+    }
+    if (frame.flags & http2_flag_priority) {
+        // the dependency and weight
+        if (size < 5) {
+            return on_protocol_error(EHttp2FrameSizeError, error_http2_frame_size);
+        }
+        p += 5;
+        size -= 5;
+    }
+    if (padding > size) {
+        return on_protocol_error(EHttp2ProtocolError, error_http2_protocol);
+    }
+    size -= padding;
+
+    last_stream_id = frame.stream_id;
+    if (!(frame.flags & http2_flag_end_headers)) {
+        header_stream_id = frame.stream_id;
+        header_block.assign(p, size);
+        return ret;
+    }
+    return on_request(frame.stream_id, std::string(p, size));
+}
+
+int Http2Session::on_request(uint32_t stream_id, const std::string& block) {
+    int ret = error_success;
+
+    std::vector<Http2Header> headers;
+    if ((ret = decoder.decode(block.data(), block.size(), headers)) != error_success) {
+        // the dynamic table is broken, the connection can not continue
+        return on_protocol_error(EHttp2CompressionError, ret);
+    }
+    // the small block can index the large entries of dynamic table
+    uint32_t list_size = 0;
+    for (auto& header : headers) {
+        list_size += header.first.size() + header.second.size() + 32;
+    }
+    if (list_size > http2_max_header_list_size) {
+        return on_protocol_error(EHttp2EnhanceYourCalm, error_http_header_too_large);
+    }
+
+    std::shared_ptr<HttpRequest> req = std::make_shared<HttpRequest>();
+    std::string method;
+    std::string path;
+    for (auto& header : headers) {
+        if (header.first == ":method") {
+            method = header.second;
+        } else if (header.first == ":path") {
+            path = header.second;
+        } else if (header.first == ":authority") {
+            req->vhost = header.second;
+        } else if (header.first == "host") {
+            if (req->vhost.empty()) {
+                req->vhost = header.second;
+            }
+        } else if (header.first == "x-codec") {
+            req->is_transcode = true;
+        }
+        if (header.first[0] != ':') {
+            req->headers.push_back(header);
+        }
+    }
+
+    if (method.empty() || path.empty()) {
+        tmss_error("http2 request no method or path, stream_id={}", stream_id);
+        return send_rst_stream(stream_id, EHttp2ProtocolError);
+    }
+    if (method != "GET") {
+        // the push is served by http/1.1
+        tmss_error("http2 method not supported, stream_id={}, method={}", stream_id, method);
+        return send_rst_stream(stream_id, EHttp2RefusedStream);
+    }
+    req->type = ERequestTypePlay;
+
+    size_t question = path.find('?');
+    if (question == std::string::npos) {
+        http_parse_uri(path.data(), path.size(), NULL, 0, req);
+    } else {
+        http_parse_uri(path.data(), question,
+            path.data() + question + 1, path.size() - question - 1, req);
+    }
+    // one response for each stream, never chunked
+    req->keep_alive = false;
+
+    tmss_info("http2 req=stream_id={},vhost={},path={},streamid={},ext={}",
+        stream_id, req->vhost, req->path, req->name, req->ext);
+    return create_stream(stream_id, req);
+}
+
+int Http2Session::create_stream(uint32_t stream_id, std::shared_ptr<HttpRequest> req) {
+    int ret = error_success;
+    if (streams.size() >= http2_max_concurrent_streams) {
+        tmss_error("http2 too many streams, stream_id={}", stream_id);
+        return send_rst_stream(stream_id, EHttp2RefusedStream);
+    }
+
+    std::shared_ptr<Http2Stream> stream =
+        std::make_shared<Http2Stream>(shared_from_this(), stream_id, req, server);
+    stream->send_window = initial_window;
+    streams[stream_id] = stream;
+    if ((ret = stream->run()) != error_success) {
+        tmss_error("http2 stream run failed, stream_id={}, ret={}", stream_id, ret);
+        streams.erase(stream_id);
+        return send_rst_stream(stream_id, EHttp2InternalError);
+    }
+    return ret;
+}
+
+int Http2Session::on_settings(Http2Frame& frame) {
+    int ret = error_success;
+    if (frame.stream_id != 0) {
+        return on_protocol_error(EHttp2ProtocolError, error_http2_protocol);
+    }
+    if (frame.flags & http2_flag_ack) {
+        return ret;
+    }
+    if (frame.payload.size() % 6 != 0) {
+        return on_protocol_error(EHttp2FrameSizeError, error_http2_frame_size);
+    }
+
+    const char* p = frame.payload.data();
+    for (size_t pos = 0; pos < frame.payload.size(); pos += 6) {
+        uint16_t id = (static_cast<uint8_t>(p[pos]) << 8) | static_cast<uint8_t>(p[pos + 1]);
+        uint32_t value = http2_read_uint32(p + pos + 2);
+        if (id == http2_settings_initial_window_size) {
+            if (value > http2_max_window) {
+                return on_protocol_error(EHttp2FlowControlError, error_http2_flow_control);
+            }
+            // the windows of open streams are adjusted by the delta, RFC 7540 6.9.2
+            int64_t delta = static_cast<int64_t>(value) - initial_window;
+            for (auto& stream : streams) {
+                stream.second->send_window += delta;
+            }
+            initial_window = value;
+        } else if (id == http2_settings_max_frame_size) {
+            if (value < http2_default_frame_size || value > http2_max_frame_size) {
+                return on_protocol_error(EHttp2ProtocolError, error_http2_protocol);
+            }
+            max_frame_size = value;
+        }
+        // the encoder never indexes, SETTINGS_HEADER_TABLE_SIZE is not used
+    }
+
+    st_cond_broadcast(window_cond);
+    return send_frame(EHttp2FrameSettings, http2_flag_ack, 0, NULL, 0);
+}
+
+int Http2Session::on_window_update(Http2Frame& frame) {
+    int ret = error_success;
+    if (frame.payload.size() != 4) {
+        return on_protocol_error(EHttp2FrameSizeError, error_http2_frame_size);
+    }
+    uint32_t increment = http2_read_uint32(frame.payload.data()) & 0x7fffffff;
+
+    if (frame.stream_id == 0) {
+        if (increment == 0 || send_window + increment > http2_max_window) {
+            return on_protocol_error(increment ? EHttp2FlowControlError : EHttp2ProtocolError,
+                error_http2_flow_control);
+        }
+        send_window += increment;
+    } else {
+        auto it = streams.find(frame.stream_id);
+        if (it == streams.end()) {
+            // the stream is closed
+            return ret;
+        }
+        std::shared_ptr<Http2Stream> stream = it->second;
+        if (increment == 0 || stream->send_window + increment > http2_max_window) {
+            tmss_error("http2 stream window invalid, stream_id={}", frame.stream_id);
+            stream->set_stop();
+            ret = send_rst_stream(frame.stream_id,
+                increment ? EHttp2FlowControlError : EHttp2ProtocolError);
+        } else {
+            stream->send_window += increment;
+        }
+    }
+
+    st_cond_broadcast(window_cond);
+    return ret;
+}
+
+int Http2Session::on_data(Http2Frame& frame) {
+    int ret = error_success;
+    if (frame.stream_id == 0) {
+        return on_protocol_error(EHttp2ProtocolError, error_http2_protocol);
+    }
+
+    // the request body is not used, give the window back at once
+    uint32_t size = frame.payload.size();
+    if (size == 0) {
+        return ret;
+    }
+    if ((ret = send_window_update(0, size)) != error_success) {
+        return ret;
+    }
+    if (!(frame.flags & http2_flag_end_stream) && streams.count(frame.stream_id)) {
+        ret = send_window_update(frame.stream_id, size);
+    }
+    return ret;
+}
+
+int Http2Session::on_protocol_error(uint32_t error_code, int ret) {
+    tmss_error("http2 connection error, code={}, ret={}", error_code, ret);
+    send_goaway(error_code);
+    return ret;
+}
+
+int Http2Session::send_settings() {
+    char payload[12];
+    payload[0] = 0;
+    payload[1] = static_cast<char>(http2_settings_max_concurrent_streams);
+    http2_write_uint32(payload + 2, http2_max_concurrent_streams);
+    payload[6] = 0;
+    payload[7] = static_cast<char>(http2_settings_max_header_list_size);
+    http2_write_uint32(payload + 8, http2_max_header_list_size);
+    return send_frame(EHttp2FrameSettings, 0, 0, payload, sizeof(payload));
+}
+
+int Http2Session::send_window_update(uint32_t stream_id, uint32_t increment) {
+    char payload[4];
+    http2_write_uint32(payload, increment);
+    return send_frame(EHttp2FrameWindowUpdate, 0, stream_id, payload, sizeof(payload));
+}
+
+int Http2Session::send_goaway(uint32_t error_code) {
+    char payload[8];
+    http2_write_uint32(payload, last_stream_id);
+    http2_write_uint32(payload + 4, error_code);
+    return send_frame(EHttp2FrameGoaway, 0, 0, payload, sizeof(payload));
+}
+
+}  // namespace tmss
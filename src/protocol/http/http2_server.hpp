@@ -0,0 +1,188 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+#pragma once
+
+#include <st.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <http_parser.hpp>
+#include <http2_hpack.hpp>
+#include <server.hpp>
+#include <net/tmss_conn.hpp>
+
+/**
+ * cleartext http/2 (h2c) of RFC 7540, by prior knowledge or by Upgrade: h2c.
+ * each stream is an IClientConn served by HttpMux on its own coroutine,
+ * the user handler writes the http/1.1 response as before, the stream
+ * converts the header to HEADERS frame and the body to DATA frames.
+ */
+
+namespace tmss {
+enum EHttp2FrameType {
+    EHttp2FrameData = 0x0,
+    EHttp2FrameHeaders = 0x1,
+    EHttp2FramePriority = 0x2,
+    EHttp2FrameRstStream = 0x3,
+    EHttp2FrameSettings = 0x4,
+    EHttp2FramePushPromise = 0x5,
+    EHttp2FramePing = 0x6,
+    EHttp2FrameGoaway = 0x7,
+    EHttp2FrameWindowUpdate = 0x8,
+    EHttp2FrameContinuation = 0x9,
+};
+
+enum EHttp2Error {
+    EHttp2NoError = 0x0,
+    EHttp2ProtocolError = 0x1,
+    EHttp2InternalError = 0x2,
+    EHttp2FlowControlError = 0x3,
+    EHttp2StreamClosed = 0x5,
+    EHttp2FrameSizeError = 0x6,
+    EHttp2RefusedStream = 0x7,
+    EHttp2Cancel = 0x8,
+    EHttp2CompressionError = 0x9,
+    EHttp2EnhanceYourCalm = 0xb,
+};
+
+class Http2Session;
+
+class Http2Frame {
+ public:
+    uint8_t type = 0;
+    uint8_t flags = 0;
+    uint32_t stream_id = 0;
+    std::string payload;
+};
+
+/**
+ * one request and response, the response is limited by the stream window
+ * and the connection window, so a slow stream only blocks itself.
+ */
+class Http2Stream : public IClientConn {
+ public:
+    Http2Stream(std::shared_ptr<Http2Session> session,
+        uint32_t stream_id,
+        std::shared_ptr<HttpRequest> req,
+        std::shared_ptr<IServer> server);
+    virtual ~Http2Stream();
+
+ public:
+    int cycle() override;
+    int on_thread_stop() override;
+    int connect(Address address) override;
+    // reset the stream if the response is not complete
+    int close() override;
+    int write(const char* buf, int size) override;
+    int writev(const iovec *iov, int iov_size) override;
+    void set_stop() override;
+    bool is_stop() override;
+
+ public:
+    uint32_t get_stream_id() { return stream_id; }
+    // the peer window of this stream
+    int64_t send_window;
+
+ private:
+    // convert the http/1.1 response header to HEADERS frame
+    int send_header(const std::string& header);
+    // send END_STREAM, the response is complete
+    int finish();
+
+ private:
+    std::shared_ptr<Http2Session> session;
+    uint32_t stream_id;
+    std::shared_ptr<HttpRequest> req;
+    std::shared_ptr<IServer> server;
+    // the response header not complete
+    std::string header;
+    bool is_send_header;
+    bool is_send_end;
+    st_cond_t stop_cond;
+};
+
+class Http2Session : public std::enable_shared_from_this<Http2Session> {
+ public:
+    Http2Session(std::shared_ptr<IClientConn> conn, std::shared_ptr<IServer> server);
+    virtual ~Http2Session();
+
+ public:
+    /**
+     * serve the connection until it is closed.
+     * @param req the PRI request of prior knowledge, or the request to upgrade,
+     *      which is served as stream 1.
+     * @param left the bytes read after the request.
+     */
+    int serve(std::shared_ptr<HttpRequest> req, const std::string& left);
+    bool is_stop();
+
+ public:
+    int send_frame(uint8_t type, uint8_t flags, uint32_t stream_id,
+        const char* payload, int size);
+    // HEADERS and CONTINUATION of one block are sent together
+    int send_headers(uint32_t stream_id, const std::vector<Http2Header>& headers, bool end_stream);
+    // wait for the windows, split to DATA frames
+    int send_data(std::shared_ptr<Http2Stream> stream, const char* data, int size, bool end_stream);
+    int send_rst_stream(uint32_t stream_id, uint32_t error_code);
+    void remove_stream(uint32_t stream_id);
+
+ private:
+    // write the frame, the caller holds the write lock
+    int write_frame(uint8_t type, uint8_t flags, uint32_t stream_id,
+        const char* payload, int size);
+    // read until size bytes are in the read buffer
+    int fill(int size);
+    int read_preface(const char* preface);
+    int read_frame(Http2Frame& frame);
+    int on_frame(Http2Frame& frame);
+    int on_headers(Http2Frame& frame);
+    int on_request(uint32_t stream_id, const std::string& block);
+    int on_settings(Http2Frame& frame);
+    int on_window_update(Http2Frame& frame);
+    int on_data(Http2Frame& frame);
+    int on_protocol_error(uint32_t error_code, int ret);
+    int create_stream(uint32_t stream_id, std::shared_ptr<HttpRequest> req);
+    int send_settings();
+    int send_window_update(uint32_t stream_id, uint32_t increment);
+    int send_goaway(uint32_t error_code);
+
+ private:
+    std::shared_ptr<IClientConn> conn;
+    std::shared_ptr<IServer> server;
+    // [input_pos, input_size) are the bytes not parsed
+    std::vector<char> input;
+    int input_pos;
+    int input_size;
+    bool stop;
+
+    HpackDecoder decoder;
+    HpackEncoder encoder;
+    std::map<uint32_t, std::shared_ptr<Http2Stream>> streams;
+    uint32_t last_stream_id;
+    // the header block waiting for CONTINUATION
+    uint32_t header_stream_id;
+    std::string header_block;
+
+    // the peer settings
+    int64_t initial_window;
+    uint32_t max_frame_size;
+    // the peer window of connection
+    int64_t send_window;
+    // broadcast when the windows or settings are updated
+    st_cond_t window_cond;
+    // the streams waiting for window
+    int window_waiters;
+    // the frames of streams are not interleaved
+    st_mutex_t write_lock;
+};
+
+}  // namespace tmss
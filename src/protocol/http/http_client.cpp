@@ -10,16 +10,103 @@
 
 #include <protocol/http/http_client.hpp>
 
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+
+#include <algorithm>
 #include <utility>
 
 #include <defs/err.hpp>
 #include <log/log.hpp>
 #include <format/base/demux.hpp>
 #include <util/util.hpp>
+#include <util/timer.hpp>
 #include <http_stack.hpp>
 
 namespace tmss {
+// the idle connections kept for each origin
+const int max_idle_conns_per_origin = 8;
+const int64_t idle_conn_timeout_us = 15 * 1000 * 1000;
+const char* http_header_end = "\r\n\r\n";
+const int websocket_opcode_binary = 0x2;
+const int websocket_opcode_close = 0x8;
+const int websocket_opcode_ping = 0x9;
+const int websocket_opcode_pong = 0xA;
+const int websocket_max_control_size = 125;
+// the chunk size line with the extensions, or a trailer field
+const size_t max_chunk_line_size = 1024;
+
+HttpConnPool::HttpConnPool() {
+}
+
+std::shared_ptr<IClientConn> HttpConnPool::fetch(Address& address) {
+    auto it = idle_conns.find(address.str());
+    if (it == idle_conns.end()) {
+        return nullptr;
+    }
+
+    std::list<IdleConn>& conns = it->second;
+    int64_t now = get_cache_time();
+    while (!conns.empty()) {
+        // the newest is the most likely alive
+        IdleConn idle = conns.back();
+        conns.pop_back();
+        if (idle.conn->is_stop() || now - idle.idle_at > idle_conn_timeout_us) {
+            idle.conn->close();
+            continue;
+        }
+        tmss_info("reuse origin conn, origin={}, id={}", address.str(), idle.conn->get_id());
+        return idle.conn;
+    }
+    idle_conns.erase(it);
+    return nullptr;
+}
+
+void HttpConnPool::release(Address& address, std::shared_ptr<IClientConn> conn) {
+    std::list<IdleConn>& conns = idle_conns[address.str()];
+    if (static_cast<int>(conns.size()) >= max_idle_conns_per_origin) {
+        conns.front().conn->close();
+        conns.pop_front();
+    }
+    IdleConn idle;
+    idle.conn = conn;
+    idle.idle_at = get_cache_time();
+    conns.push_back(idle);
+    tmss_info("keep origin conn, origin={}, id={}, idle={}",
+        address.str(), conn->get_id(), conns.size());
+}
+
+std::shared_ptr<HttpConnPool> HttpConnPool::get_instance() {
+    thread_local std::shared_ptr<HttpConnPool> ins = nullptr;
+    if (!ins) {
+        ins = std::make_shared<HttpConnPool>();
+    }
+    return ins;
+}
+
 HttpClient::HttpClient() {
+    chunked = false;
+    websocket = false;
+    write_lock = NULL;
+    is_send_header = false;
+    is_send_eof = false;
+    is_reused = false;
+    response_keep_alive = false;
+    has_body = false;
+    body_chunked = false;
+    body_left = -1;
+    chunk_left = 0;
+    chunk_crlf_left = false;
+}
+
+HttpClient::~HttpClient() {
+    if (write_lock) {
+        st_mutex_destroy(write_lock);
+    }
 }
 
 int HttpClient::cycle() {
@@ -27,6 +114,33 @@ int HttpClient::cycle() {
     return ret;
 }
 
+int HttpClient::connect_origin(Address& address) {
+    origin_address = address;
+    first_conn = conn;
+
+    std::shared_ptr<IClientConn> idle_conn = HttpConnPool::get_instance()->fetch(address);
+    if (idle_conn) {
+        use_conn(idle_conn);
+        is_reused = true;
+        return error_success;
+    }
+    is_reused = false;
+    return conn->connect(address);
+}
+
+void HttpClient::release_conn() {
+    if (!response_keep_alive || conn->is_stop()) {
+        return;
+    }
+    response_keep_alive = false;
+    HttpConnPool::get_instance()->release(origin_address, conn);
+}
+
+void HttpClient::use_conn(std::shared_ptr<IClientConn> new_conn) {
+    conn = new_conn;
+    io_buffer = std::make_shared<IOBuffer>(conn, io_buffer->get_buffer());
+}
+
 int HttpClient::request(const std::string& origin_host,
         const std::string& origin_path,
         const std::string& stream,
@@ -41,70 +155,88 @@ int HttpClient::request(const std::string& origin_host,
         origin_path,
         stream);
     tmss_info("request={}", request);
-    // to do
-    ret = conn->write(request.c_str(), request.length());
+
+    ret = send_request(request, demux);
+    if (ret != error_success && ret != error_ingest_no_input && is_reused && first_conn) {
+        // the idle connection may be closed by origin, retry on a new one
+        tmss_warn("request on idle conn failed, reconnect, {}", ret);
+        conn->close();
+        use_conn(first_conn);
+        is_reused = false;
+        if ((ret = conn->connect(origin_address)) != error_success) {
+            tmss_error("origin reconnect error, {}", ret);
+            return ret;
+        }
+        ret = send_request(request, demux);
+    }
+    return ret;
+}
+
+int HttpClient::send_request(const std::string& request, std::shared_ptr<IDeMux> demux) {
+    int ret = conn->write(request.c_str(), request.length());
     if (ret < 0) {
         tmss_error("ingest send error, {}", ret);
         return ret;
     }
-    // to do
-    char response[1024] = {0};
-    int buffer_size = sizeof(response);
-    int once_read_size = 0;
-    int total_read_size = 0;
-    // parse response
-    CHttp http_response;
-    char * pos_response = response;
-    //  while ((once_read_size = conn->read(pos_response, 1)) > 0) {
-    while ((once_read_size = demux->read_packet(pos_response, 1)) > 0) {
-        pos_response += once_read_size;
-        // response[total_read_size] = '\0';
-        buffer_size -= once_read_size;
-        if (buffer_size <= 0) {
-            tmss_error("no buffer");
-            ret = error_socket_read;
-            return ret;
-        }
-        total_read_size += once_read_size;
-        if (http_response.checkResponse(response) > 0) {
-            tmss_info("http response complete,{}", response);
+
+    // read the header to the buffer of client, it must fit in the buffer,
+    // the body left in the buffer is read by read_data
+    std::shared_ptr<Buffer> cache = io_buffer->get_buffer();
+    cache->reset();
+    int header_size = 0;
+    while (true) {
+        const char* data = cache->rcurrent();
+        int size = cache->continuous_read_left();
+        const char* end = static_cast<const char*>(memmem(data, size, http_header_end, 4));
+        if (end) {
+            header_size = end + 4 - data;
             break;
         }
-        //  tmss_info("response, {}, {}",
-            //  total_read_size, PrintBuffer(response, total_read_size));
-    }
-    if (once_read_size < 0) {
-        tmss_error("ingest read error, {}", once_read_size);
-        ret = error_socket_read;
-        return ret;
-    } else if (once_read_size == 0) {
-        tmss_info("read stop");
-        if (total_read_size == 0) {
-            tmss_warn("read none");
+
+        if (cache->continuous_write_left() <= 0) {
+            ret = error_http_header_too_large;
+            tmss_error("origin response header too large, {}", size);
+            return ret;
+        }
+        int read_size = io_buffer->fill();
+        if (read_size < 0) {
+            tmss_error("ingest read error, {}", read_size);
+            ret = error_socket_read;
+            return ret;
+        } else if (read_size == 0) {
+            tmss_warn("read stop, read={}", size);
             ret = error_socket_already_closed;
             return ret;
         }
     }
 
-    tmss_info("http_first_packet, {}, {}",
-        total_read_size, PrintBuffer(response, (total_read_size > 100) ? 100 : total_read_size));
+    std::string header(cache->rcurrent(), header_size);
+    cache->seek_read(header_size);
+    tmss_info("http response header, {}, {}", header_size, header);
 
-    std::string http_first_packet(response, total_read_size);
-    http_response.parseHttpResponse(http_first_packet);
-    int status = http_response.get_response_status(http_first_packet);
+    CHttp http_response;
+    http_response.parseHttpResponse(header);
+    int status = http_response.get_response_status(header);
     tmss_info("origin response {}", status);
     if (status != 200) {
         ret = error_ingest_no_input;
         tmss_error("origin response error {}", status);
         return ret;
     }
-    // this have some data, (no need, can be delete)`
-    std::string data_header = http_response.Data();
-    demux->on_ingest(http_response.getContentLen(), data_header);
+
+    // the connection is reusable only when the body is length-delimited
+    response_keep_alive = header.compare(0, 8, "HTTP/1.1") == 0
+        && strcasestr(header.c_str(), "\r\nConnection: close") == NULL
+        && strcasestr(header.c_str(), "\r\nContent-Length:") != NULL;
+
+    demux->on_ingest(http_response.getContentLen(), "");
     return error_success;
 }
 
 int HttpClient::read_data(char* buf, int size) {
+    if (has_body) {
+        return read_body(buf, size);
+    }
     // int read_size = input_conn->read(buff, wanted_size);
     int read_size = io_buffer->read_bytes(buf, size);
     if (read_size < 0) {
@@ -117,7 +249,394 @@ int HttpClient::read_data(char* buf, int size) {
 }
 
 int HttpClient::write_data(const char* buf, int size) {
-    return conn->write(buf, size);
+    iovec iov;
+    iov.iov_base = const_cast<char*>(buf);
+    iov.iov_len = size;
+    return writev_data(&iov, 1);
+}
+
+int HttpClient::writev_data(const iovec* iov, int iov_size) {
+    if (websocket) {
+        return write_frame(websocket_opcode_binary, iov, iov_size);
+    }
+    if (!chunked) {
+        return conn->writev(iov, iov_size);
+    }
+    int size = 0;
+    for (int i = 0; i < iov_size; i++) {
+        size += iov[i].iov_len;
+    }
+    if (size <= 0) {
+        // the empty chunk is the end of body
+        return 0;
+    }
+
+    // chunk-size CRLF chunk-data CRLF, no copy of the data
+    char size_line[16];
+    int size_line_length = snprintf(size_line, sizeof(size_line), "%x\r\n", size);
+    io_buffer->write_bytes(size_line, size_line_length);
+    for (int i = 0; i < iov_size; i++) {
+        io_buffer->write_bytes(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+    }
+    io_buffer->write_bytes("\r\n", 2);
+
+    int ret = io_buffer->flush();
+    if (ret < 0) {
+        tmss_error("write chunk failed, ret={}", ret);
+        return ret;
+    }
+    return size;
+}
+
+int HttpClient::set_request_body(const std::string& data, int64_t content_length, bool chunked) {
+    int ret = error_success;
+    has_body = true;
+    body_chunked = chunked;
+    body_left = chunked ? -1 : content_length;
+    chunk_left = 0;
+    chunk_crlf_left = false;
+
+    // the bytes are read first, the parser buffer is smaller than client buffer
+    if (!data.empty()) {
+        ret = io_buffer->get_buffer()->write_bytes(data.c_str(), data.length());
+        if (ret != error_success) {
+            tmss_error("no buffer for body, size={}, ret={}", data.length(), ret);
+            return ret;
+        }
+    }
+    return ret;
+}
+
+int HttpClient::read_body(char* buf, int size) {
+    if (body_left == 0) {
+        tmss_info("body end");
+        return 0;
+    }
+
+    int wanted_size = size;
+    if (body_chunked) {
+        if (chunk_left == 0) {
+            int ret = read_chunk_size();
+            if (ret != error_success) {
+                tmss_error("read chunk size failed, ret={}", ret);
+                return -1;
+            }
+            if (chunk_left == 0) {
+                // the last chunk, the trailer is read and ignored
+                body_left = 0;
+                tmss_info("body end");
+                return 0;
+            }
+        }
+        wanted_size = std::min(static_cast<int64_t>(wanted_size), chunk_left);
+    } else if (body_left > 0) {
+        wanted_size = std::min(static_cast<int64_t>(wanted_size), body_left);
+    }
+
+    int read_size = io_buffer->read_bytes(buf, wanted_size);
+    if (read_size <= 0) {
+        return read_size;
+    }
+    if (body_chunked) {
+        chunk_left -= read_size;
+    } else if (body_left > 0) {
+        body_left -= read_size;
+    }
+    return read_size;
+}
+
+int HttpClient::read_chunk_size() {
+    int ret = error_success;
+    std::string line;
+
+    // chunk-data CRLF, the data of last chunk must be ended by CRLF
+    if (chunk_crlf_left) {
+        if ((ret = read_chunk_line(line)) != error_success) {
+            return ret;
+        }
+        if (!line.empty()) {
+            ret = error_http_request_invalid;
+            tmss_error("no CRLF after chunk data, ret={}", ret);
+            return ret;
+        }
+        chunk_crlf_left = false;
+    }
+
+    // chunk-size [ BWS ; chunk-ext ] CRLF
+    if ((ret = read_chunk_line(line)) != error_success) {
+        return ret;
+    }
+    const char* start = line.c_str();
+    char* end = NULL;
+    errno = 0;
+    chunk_left = isxdigit(static_cast<unsigned char>(*start)) ? strtoll(start, &end, 16) : -1;
+    if (chunk_left < 0 || errno == ERANGE) {
+        ret = error_http_request_invalid;
+        tmss_error("invalid chunk size line={}, ret={}", line, ret);
+        return ret;
+    }
+    while (*end == ' ' || *end == '\t') {
+        end++;
+    }
+    if (*end != '\0' && *end != ';') {
+        ret = error_http_request_invalid;
+        tmss_error("invalid chunk size line={}, ret={}", line, ret);
+        return ret;
+    }
+
+    if (chunk_left > 0) {
+        chunk_crlf_left = true;
+        return ret;
+    }
+
+    // the last chunk, the trailer fields are ignored until the empty line
+    do {
+        if ((ret = read_chunk_line(line)) != error_success) {
+            return ret;
+        }
+    } while (!line.empty());
+    return ret;
+}
+
+int HttpClient::read_chunk_line(std::string& line) {
+    int ret = error_success;
+    std::shared_ptr<Buffer> cache = io_buffer->get_buffer();
+
+    line.clear();
+    while (true) {
+        if (cache->read_left() == 0) {
+            int read_size = io_buffer->fill();
+            if (read_size < 0) {
+                ret = error_socket_read;
+                return ret;
+            } else if (read_size == 0) {
+                ret = error_socket_already_closed;
+                return ret;
+            }
+        }
+        char c = cache->read_1byte();
+        if (c == '\n') {
+            if (line.empty() || line.back() != '\r') {
+                ret = error_http_request_invalid;
+                tmss_error("chunk line not ended by CRLF, ret={}", ret);
+                return ret;
+            }
+            line.pop_back();
+            return ret;
+        }
+        // the chunk-ext is not limited by RFC, but by us
+        if (line.size() >= max_chunk_line_size) {
+            ret = error_http_request_invalid;
+            tmss_error("chunk line too long, ret={}", ret);
+            return ret;
+        }
+        line.push_back(c);
+    }
+    return ret;
+}
+
+int HttpClient::write_frame(int opcode, const iovec* iov, int iov_size) {
+    int size = 0;
+    for (int i = 0; i < iov_size; i++) {
+        size += iov[i].iov_len;
+    }
+
+    // FIN, opcode, and the unmasked payload length of server frame, see RFC6455
+    char header[10];
+    int header_size = 2;
+    header[0] = static_cast<char>(0x80 | opcode);
+    if (size < 126) {
+        header[1] = static_cast<char>(size);
+    } else if (size <= 0xFFFF) {
+        header[1] = 126;
+        header[2] = static_cast<char>(size >> 8);
+        header[3] = static_cast<char>(size);
+        header_size = 4;
+    } else {
+        header[1] = 127;
+        uint64_t length = size;
+        for (int i = 0; i < 8; i++) {
+            header[2 + i] = static_cast<char>(length >> ((7 - i) * 8));
+        }
+        header_size = 10;
+    }
+
+    if (write_lock) {
+        st_mutex_lock(write_lock);
+    }
+    io_buffer->write_bytes(header, header_size);
+    for (int i = 0; i < iov_size; i++) {
+        io_buffer->write_bytes(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+    }
+    int ret = io_buffer->flush();
+    if (write_lock) {
+        st_mutex_unlock(write_lock);
+    }
+    if (ret < 0) {
+        tmss_error("write websocket frame failed, ret={}", ret);
+        return ret;
+    }
+    return size;
+}
+
+int HttpClient::write_control(int opcode, const char* payload, int size) {
+    iovec iov;
+    iov.iov_base = const_cast<char*>(payload);
+    iov.iov_len = size;
+    int ret = write_frame(opcode, &iov, 1);
+    return (ret < 0) ? ret : error_success;
+}
+
+int HttpClient::read_fully(char* buf, int size) {
+    int pos = 0;
+    while (pos < size) {
+        int read_size = conn->read(buf + pos, size - pos);
+        if (read_size <= 0) {
+            tmss_info("websocket conn closed, ret={}", read_size);
+            return error_socket_already_closed;
+        }
+        pos += read_size;
+    }
+    return error_success;
+}
+
+void HttpClient::set_websocket() {
+    websocket = true;
+    // the handshake is the response header
+    is_send_header = true;
+    if (!write_lock) {
+        write_lock = st_mutex_new();
+    }
+}
+
+int HttpClient::wait_websocket_close() {
+    int ret = error_success;
+    char header[8];
+    char payload[1024];
+    while (!conn->is_stop()) {
+        if ((ret = read_fully(header, 2)) != error_success) {
+            return ret;
+        }
+        bool fin = header[0] & 0x80;
+        int opcode = header[0] & 0x0F;
+        bool masked = header[1] & 0x80;
+        uint64_t size = header[1] & 0x7F;
+        int length_size = (size == 126) ? 2 : ((size == 127) ? 8 : 0);
+        if (length_size > 0) {
+            if ((ret = read_fully(header, length_size)) != error_success) {
+                return ret;
+            }
+            size = 0;
+            for (int i = 0; i < length_size; i++) {
+                size = (size << 8) | static_cast<uint8_t>(header[i]);
+            }
+        }
+        // the client frames are masked, the control frames are short and not fragmented, see RFC6455
+        bool control = opcode & 0x08;
+        if (!masked || (control && (!fin || size > websocket_max_control_size))) {
+            ret = error_http_request_invalid;
+            tmss_error("websocket frame invalid, opcode={}, size={}, ret={}", opcode, size, ret);
+            // 1002, protocol error
+            const char status[] = {0x03, static_cast<char>(0xEA)};
+            is_send_eof = true;
+            write_control(websocket_opcode_close, status, sizeof(status));
+            return ret;
+        }
+        char mask[4];
+        if ((ret = read_fully(mask, sizeof(mask))) != error_success) {
+            return ret;
+        }
+
+        if (!control) {
+            // the data of player is not used
+            while (size > 0) {
+                int read_size = std::min<uint64_t>(size, sizeof(payload));
+                if ((ret = read_fully(payload, read_size)) != error_success) {
+                    return ret;
+                }
+                size -= read_size;
+            }
+            continue;
+        }
+
+        if ((ret = read_fully(payload, size)) != error_success) {
+            return ret;
+        }
+        for (uint64_t i = 0; i < size; i++) {
+            payload[i] ^= mask[i % 4];
+        }
+        if (opcode == websocket_opcode_ping) {
+            if ((ret = write_control(websocket_opcode_pong, payload, size)) != error_success) {
+                tmss_error("send websocket pong failed, ret={}", ret);
+                return ret;
+            }
+        } else if (opcode == websocket_opcode_close) {
+            // echo the status code, then the connection is closed
+            tmss_info("websocket closed by client");
+            if (!is_send_eof) {
+                is_send_eof = true;
+                write_control(websocket_opcode_close, payload, (size >= 2) ? 2 : 0);
+            }
+            return error_success;
+        }
+    }
+    return ret;
+}
+
+void HttpClient::set_response_info(const std::string& content_type, bool chunked) {
+    this->content_type = content_type;
+    this->chunked = chunked;
+}
+
+int HttpClient::send_status(int status) {
+    int ret = error_success;
+    if (is_send_header) {
+        return ret;
+    }
+
+    std::string header;
+    CHttp http_response;
+    if (status == 200) {
+        // the length of live stream is unknown
+        http_response.buildResponseHeader(status, content_type, -1, chunked, chunked, header);
+    } else {
+        http_response.buildResponseHeader(status, "", 0, false, false, header);
+        // no body
+        chunked = false;
+        is_send_eof = true;
+    }
+    is_send_header = true;
+
+    ret = conn->write(header.c_str(), header.length());
+    if (ret < 0) {
+        tmss_error("send response header failed, ret={}", ret);
+        return ret;
+    }
+    return error_success;
+}
+
+int HttpClient::send_eof() {
+    int ret = error_success;
+    if (websocket) {
+        if (is_send_eof) {
+            return ret;
+        }
+        is_send_eof = true;
+        ret = write_frame(websocket_opcode_close, NULL, 0);
+        return (ret < 0) ? ret : error_success;
+    }
+    if (!chunked || !is_send_header || is_send_eof) {
+        return ret;
+    }
+    is_send_eof = true;
+
+    const char* last_chunk = "0\r\n\r\n";
+    ret = conn->write(last_chunk, strlen(last_chunk));
+    if (ret < 0) {
+        tmss_error("send last chunk failed, ret={}", ret);
+        return ret;
+    }
+    return error_success;
 }
 
 }   // namespace tmss
@@ -9,7 +9,10 @@
  */
 #pragma once
 
+#include <list>
+#include <map>
 #include <memory>
+#include <string>
 #include <protocol/client.hpp>
 #include <net/tmss_conn.hpp>
 #include <coroutine/coroutine.hpp>
@@ -19,10 +22,37 @@
 
 namespace tmss {
 class IDeMux;
+
+/**
+ * the idle keep-alive connections to origins, keyed by origin address.
+ * HttpClient borrows one in connect_origin and returns it in release_conn.
+ */
+class HttpConnPool {
+ public:
+    HttpConnPool();
+    virtual ~HttpConnPool() = default;
+
+ public:
+    // get an idle connection of origin, null if none
+    std::shared_ptr<IClientConn> fetch(Address& address);
+    void release(Address& address, std::shared_ptr<IClientConn> conn);
+
+ public:
+    static std::shared_ptr<HttpConnPool> get_instance();
+
+ private:
+    struct IdleConn {
+        std::shared_ptr<IClientConn> conn;
+        int64_t idle_at;
+    };
+    // the oldest connection is at front
+    std::map<std::string, std::list<IdleConn>> idle_conns;
+};
+
 class HttpClient : public IClient {
  public:
     HttpClient();
-    virtual ~HttpClient() = default;
+    virtual ~HttpClient();
 
  public:
     virtual int cycle() override;
@@ -34,6 +64,76 @@ class HttpClient : public IClient {
     int read_data(char* buf, int size) override;
 
     int write_data(const char* buf, int size) override;
+    // as write_data, the iovecs are sent as one chunk or frame
+    int writev_data(const iovec* iov, int iov_size) override;
+
+    int connect_origin(Address& address) override;
+    void release_conn() override;
+
+    /**
+     * read_data returns the request body of push, the chunked body is decoded.
+     * @param data the body bytes read with the header.
+     * @param content_length -1 if the body ends with the connection.
+     */
+    int set_request_body(const std::string& data, int64_t content_length, bool chunked);
+
+ public:
+    /**
+     * the response of play, when chunked, each write_data is sent as a chunk,
+     * the chunk size line and CRLF are written with the data by writev.
+     */
+    void set_response_info(const std::string& content_type, bool chunked);
+    /**
+     * the connection is upgraded, each write_data is sent as a binary frame,
+     * the frame header is written with the data by writev.
+     */
+    void set_websocket();
+    /**
+     * read the frames of client until it closes, the ping is answered by pong,
+     * the close is answered by close, the data frames are discarded.
+     */
+    int wait_websocket_close();
+    int send_status(int status) override;
+    int send_eof() override;
+
+ private:
+    std::string content_type;
+    bool chunked;
+    bool websocket;
+    // the frames of output and the answers of control frames are not interleaved
+    st_mutex_t write_lock;
+    bool is_send_header;
+    bool is_send_eof;
+
+ private:
+    int send_request(const std::string& request, std::shared_ptr<IDeMux> demux);
+    void use_conn(std::shared_ptr<IClientConn> new_conn);
+    int read_body(char* buf, int size);
+    // the header and payload are written by one writev
+    int write_frame(int opcode, const iovec* iov, int iov_size);
+    // the control frame with a payload of at most 125 bytes
+    int write_control(int opcode, const char* payload, int size);
+    // read exactly size bytes of websocket frame
+    int read_fully(char* buf, int size);
+    int read_chunk_size();
+    // read a line ended by CRLF, without the CRLF
+    int read_chunk_line(std::string& line);
+
+ private:
+    Address origin_address;
+    // the connection given by init, used when the idle one is closed by origin
+    std::shared_ptr<IClientConn> first_conn;
+    bool is_reused;
+    // the response can be followed by next request on the connection
+    bool response_keep_alive;
+
+    bool has_body;
+    bool body_chunked;
+    // -1 if unknown
+    int64_t body_left;
+    int64_t chunk_left;
+    // the chunk data is followed by CRLF before the next chunk size
+    bool chunk_crlf_left;
 };
 
 }  // namespace tmss
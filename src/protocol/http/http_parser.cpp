@@ -8,12 +8,105 @@
  * =====================================================================================
  */
 
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
 #include <http_parser.hpp>
 #include <http_stack.hpp>
 #include <defs/err.hpp>
 #include <log/log.hpp>
 
 namespace tmss {
+HttpStrView::HttpStrView() {
+    data = NULL;
+    size = 0;
+}
+
+HttpStrView::HttpStrView(const char* data, int size) {
+    this->data = data;
+    this->size = size;
+}
+
+bool HttpStrView::empty() const {
+    return size <= 0;
+}
+
+bool HttpStrView::equals(const char* value) const {
+    int len = strlen(value);
+    return len == size && memcmp(data, value, len) == 0;
+}
+
+bool HttpStrView::iequals(const char* value) const {
+    int len = strlen(value);
+    return len == size && strncasecmp(data, value, len) == 0;
+}
+
+bool HttpStrView::has_token(const char* token) const {
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+        const char* token_end = comma ? comma : end;
+        while (p < token_end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+        const char* q = token_end;
+        while (q > p && (q[-1] == ' ' || q[-1] == '\t')) {
+            q--;
+        }
+        if (HttpStrView(p, q - p).iequals(token)) {
+            return true;
+        }
+        p = token_end + 1;
+    }
+    return false;
+}
+
+std::string HttpStrView::to_str() const {
+    if (size <= 0) {
+        return "";
+    }
+    return std::string(data, size);
+}
+
+HttpRequestView::HttpRequestView() {
+    reset();
+}
+
+void HttpRequestView::reset() {
+    method = HttpStrView();
+    uri = HttpStrView();
+    path = HttpStrView();
+    query = HttpStrView();
+    version = HttpStrView();
+    nb_headers = 0;
+    content_length = -1;
+    chunked = false;
+    keep_alive = false;
+    header_size = 0;
+}
+
+const HttpStrView* HttpRequestView::get_header(const char* name) const {
+    for (int i = 0; i < nb_headers; i++) {
+        if (headers[i].name.iequals(name)) {
+            return &headers[i].value;
+        }
+    }
+    return NULL;
+}
+
+HttpParser::HttpParser() {
+    buffer.resize(TMSS_HTTP_READ_BUFFER_SIZE);
+    write_pos = 0;
+    line_pos = 0;
+    scan_pos = 0;
+    state = EHttpParseRequestLine;
+}
+
+HttpParser::~HttpParser() {
+}
+
 int HttpParser::parse_response(std::shared_ptr<IReader> reader,
         std::shared_ptr<HttpResponse> &response) {
     int ret = error_success;
@@ -22,70 +115,341 @@ int HttpParser::parse_response(std::shared_ptr<IReader> reader,
 
 int HttpParser::parse_request(std::shared_ptr<IReader> reader,
         std::shared_ptr<HttpRequest> &req) {
+    int ret = error_success;
+
+    const HttpRequestView* view = NULL;
+    if ((ret = read_request(reader, view)) != error_success) {
+        return ret;
+    }
+
     std::shared_ptr<HttpRequest> new_req = std::make_shared<HttpRequest>();
+    // the body of POST/PUT is the pushed stream
+    if (view->method.equals("POST") || view->method.equals("PUT")) {
+        new_req->type = ERequestTypePublish;
+    } else {
+        new_req->type = ERequestTypePlay;
+    }
+    // the body of other methods is never read, it must not be taken as the next request
+    if (new_req->type != ERequestTypePublish && (view->content_length > 0 || view->chunked)) {
+        ret = error_http_request_invalid;
+        tmss_error("http body of {} not supported, ret={}", view->method.to_str(), ret);
+        return ret;
+    }
+    new_req->content_length = view->content_length;
+    new_req->chunked = view->chunked;
+
+    http_parse_uri(view->path.data, view->path.size,
+        view->query.data, view->query.size, new_req);
+
+    const HttpStrView* host = view->get_header("Host");
+    if (host) {
+        new_req->vhost.assign(host->data, host->size);
+    }
+    new_req->is_transcode = view->get_header("X-Codec") != NULL;
+    new_req->keep_alive = view->keep_alive;
+
+    const HttpStrView* upgrade = view->get_header("Upgrade");
+    if (upgrade && upgrade->iequals("websocket")) {
+        new_req->websocket_upgrade = true;
+        const HttpStrView* connection = view->get_header("Connection");
+        new_req->connection_upgrade = connection && connection->has_token("upgrade");
+        const HttpStrView* websocket_key = view->get_header("Sec-WebSocket-Key");
+        if (websocket_key) {
+            new_req->websocket_key = websocket_key->to_str();
+        }
+        const HttpStrView* websocket_version = view->get_header("Sec-WebSocket-Version");
+        if (websocket_version) {
+            new_req->websocket_version = websocket_version->to_str();
+        }
+    }
+
+    // the preface is parsed as a request line, RFC 7540 3.5
+    new_req->http2 = view->method.equals("PRI") && view->uri.equals("*")
+        && view->version.equals("HTTP/2.0");
+    // the request with body is not upgraded, RFC 7540 3.2
+    if (upgrade && upgrade->iequals("h2c") && view->get_header("HTTP2-Settings")
+        && new_req->type == ERequestTypePlay) {
+        new_req->http2_upgrade = true;
+    }
+
+    consume();
+
+    if (new_req->type == ERequestTypePublish && write_pos > 0) {
+        // the bytes after header are the body, not the next request
+        int body_size = write_pos;
+        if (new_req->content_length >= 0 && new_req->content_length < body_size) {
+            body_size = new_req->content_length;
+        }
+        new_req->body.assign(buffer.data(), body_size);
+        if (body_size < write_pos) {
+            memmove(buffer.data(), buffer.data() + body_size, write_pos - body_size);
+        }
+        write_pos -= body_size;
+    }
+
+    req = new_req;
+
+    tmss_info("create new request");
+    return ret;
+}
+
+int HttpParser::read_request(std::shared_ptr<IReader> reader, const HttpRequestView*& view) {
     int ret = error_success;
-    char buff[1024];
-    int size = sizeof(buff);
-
-    CHttp http;
-    int read_size = 0;
-    int total_size = 0;
-    while ((read_size = reader->read(buff, size - 1)) > 0) {
-        if (read_size > sizeof(buff)) {
-            // error
-            tmss_error("read buffer error,read_size={}", read_size);
+
+    while (true) {
+        if ((ret = parse()) != error_success) {
+            tmss_error("http parse request failed, ret={}", ret);
+            return ret;
+        }
+        if (state == EHttpParseDone) {
+            view = &this->view;
+            return ret;
+        }
+
+        int buffer_size = buffer.size();
+        if (write_pos >= buffer_size) {
+            ret = error_http_header_too_large;
+            tmss_error("http request header too large, size={}, ret={}", write_pos, ret);
+            return ret;
+        }
+
+        int read_size = reader->read(buffer.data() + write_pos, buffer_size - write_pos);
+        if (read_size < 0) {
+            tmss_error("read error,ret={}", read_size);
             ret = error_socket_read;
             return ret;
+        } else if (read_size == 0) {
+            tmss_info("read stop, left={}", write_pos);
+            ret = error_socket_already_closed;
+            return ret;
         }
-        buff[read_size] = '\0';
-        size -= read_size;
-        total_size += read_size;
-        if (http.checkRequest(std::string(buff)) > 0) {
-            tmss_info("http request complete,{}", buff);
-            break;
+        write_pos += read_size;
+    }
+
+    return ret;
+}
+
+void HttpParser::consume() {
+    int consumed = (state == EHttpParseDone) ? view.header_size : 0;
+    int left_size = write_pos - consumed;
+    if (consumed > 0 && left_size > 0) {
+        memmove(buffer.data(), buffer.data() + consumed, left_size);
+    }
+
+    write_pos = left_size;
+    line_pos = 0;
+    scan_pos = 0;
+    state = EHttpParseRequestLine;
+    view.reset();
+}
+
+int HttpParser::left() {
+    int consumed = (state == EHttpParseDone) ? view.header_size : 0;
+    return write_pos - consumed;
+}
+
+void HttpParser::take_left(std::string& data) {
+    consume();
+    data.assign(buffer.data(), write_pos);
+    write_pos = 0;
+}
+
+int HttpParser::parse() {
+    int ret = error_success;
+    char* p = buffer.data();
+
+    while (state != EHttpParseDone) {
+        // only scan the new bytes for line end
+        char* lf = static_cast<char*>(memchr(p + scan_pos, '\n', write_pos - scan_pos));
+        if (!lf) {
+            scan_pos = write_pos;
+            return ret;
+        }
+
+        char* line = p + line_pos;
+        int size = lf - line;
+        if (size > 0 && line[size - 1] == '\r') {
+            size--;
+        }
+        scan_pos = lf - p + 1;
+        line_pos = scan_pos;
+
+        if (state == EHttpParseRequestLine) {
+            // ignore the empty lines before request line, RFC 7230 3.5
+            if (size == 0) {
+                continue;
+            }
+            if ((ret = parse_request_line(line, size)) != error_success) {
+                return ret;
+            }
+            state = EHttpParseHeaderLine;
+        } else {
+            if (size == 0) {
+                // the body length is ambiguous, RFC 7230 3.3.3
+                if (view.chunked && view.content_length >= 0) {
+                    ret = error_http_request_invalid;
+                    tmss_error("http both content length and chunked, ret={}", ret);
+                    return ret;
+                }
+                view.header_size = line_pos;
+                state = EHttpParseDone;
+                break;
+            }
+            if ((ret = parse_header_line(line, size)) != error_success) {
+                return ret;
+            }
         }
     }
 
-    if (read_size < 0) {
-        tmss_error("read error,ret={}", read_size);
-        ret = error_socket_read;
+    return ret;
+}
+
+int HttpParser::parse_request_line(char* line, int size) {
+    int ret = error_success;
+
+    // method SP request-target SP HTTP-version
+    char* end = line + size;
+    char* sp1 = static_cast<char*>(memchr(line, ' ', size));
+    if (!sp1 || sp1 == line) {
+        ret = error_http_request_invalid;
+        tmss_error("http request line invalid, no method, ret={}", ret);
         return ret;
-    } else if (read_size == 0) {
-        tmss_info("read stop");
-        if (total_size == 0) {
-            tmss_warn("read none");
-            ret = error_socket_already_closed;
+    }
+    char* uri = sp1 + 1;
+    char* sp2 = static_cast<char*>(memchr(uri, ' ', end - uri));
+    if (!sp2 || sp2 == uri) {
+        ret = error_http_request_invalid;
+        tmss_error("http request line invalid, no uri, ret={}", ret);
+        return ret;
+    }
+
+    view.method = HttpStrView(line, sp1 - line);
+    view.uri = HttpStrView(uri, sp2 - uri);
+    view.version = HttpStrView(sp2 + 1, end - sp2 - 1);
+
+    char* question = static_cast<char*>(memchr(uri, '?', sp2 - uri));
+    if (question) {
+        view.path = HttpStrView(uri, question - uri);
+        view.query = HttpStrView(question + 1, sp2 - question - 1);
+    } else {
+        view.path = view.uri;
+    }
+
+    // HTTP/1.1 is keep-alive by default
+    view.keep_alive = view.version.equals("HTTP/1.1");
+
+    return ret;
+}
+
+int HttpParser::parse_header_line(char* line, int size) {
+    int ret = error_success;
+
+    char* end = line + size;
+    char* colon = static_cast<char*>(memchr(line, ':', size));
+    if (!colon || colon == line) {
+        ret = error_http_request_invalid;
+        tmss_error("http header invalid, ret={}", ret);
+        return ret;
+    }
+
+    char* value = colon + 1;
+    while (value < end && (*value == ' ' || *value == '\t')) {
+        value++;
+    }
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+
+    HttpStrView name_view(line, colon - line);
+    HttpStrView value_view(value, end - value);
+
+    if (name_view.iequals("Content-Length")) {
+        int64_t length = 0;
+        for (const char* p = value; p < end; p++) {
+            if (*p < '0' || *p > '9' || length > (INT64_MAX - (*p - '0')) / 10) {
+                ret = error_http_request_invalid;
+                tmss_error("http content length invalid, ret={}", ret);
+                return ret;
+            }
+            length = length * 10 + (*p - '0');
+        }
+        // the repeated length must agree, RFC 7230 3.3.2
+        if (value == end || (view.content_length >= 0 && view.content_length != length)) {
+            ret = error_http_request_invalid;
+            tmss_error("http content length invalid, ret={}", ret);
+            return ret;
+        }
+        view.content_length = length;
+    } else if (name_view.iequals("Transfer-Encoding")) {
+        // chunked must be the last coding, RFC 7230 3.3.3
+        const char* coding = value;
+        for (const char* p = end; p > value; p--) {
+            if (p[-1] == ',') {
+                coding = p;
+                break;
+            }
+        }
+        while (coding < end && (*coding == ' ' || *coding == '\t')) {
+            coding++;
+        }
+        if (!HttpStrView(coding, end - coding).iequals("chunked")) {
+            ret = error_http_request_invalid;
+            tmss_error("http transfer encoding not chunked, ret={}", ret);
             return ret;
         }
+        view.chunked = true;
+    } else if (name_view.iequals("Connection")) {
+        if (value_view.has_token("close")) {
+            view.keep_alive = false;
+        } else if (value_view.has_token("keep-alive")) {
+            view.keep_alive = true;
+        }
     }
 
-    // complete
-    // default, to do
-    new_req->type = ERequestTypePlay;
+    if (view.nb_headers >= TMSS_HTTP_MAX_HEADERS) {
+        tmss_warn("too many http headers, ignore {}", name_view.to_str());
+        return ret;
+    }
+    view.headers[view.nb_headers].name = name_view;
+    view.headers[view.nb_headers].value = value_view;
+    view.nb_headers++;
 
-    http.parse_request(std::string(buff));
-    new_req->vhost = http.Host();
-    new_req->name = http.Name();
-    new_req->path = http.Folder();
-    new_req->params = http.QueryString();
-    new_req->ext = http.ext();
-    new_req->is_transcode = http.is_transcode();
+    return ret;
+}
+
+void http_parse_uri(const char* path, int path_size,
+        const char* query, int query_size, std::shared_ptr<HttpRequest> req) {
+    // /folder/name.ext?params
+    const char* name = path;
+    for (int i = path_size - 1; i >= 0; i--) {
+        if (path[i] == '/') {
+            name = path + i + 1;
+            if (i > 0) {
+                req->path.assign(path + 1, i - 1);
+            }
+            break;
+        }
+    }
+    int name_size = path + path_size - name;
+    req->name.assign(name, name_size);
+    const char* ext = static_cast<const char*>(memrchr(name, '.', name_size));
+    if (ext) {
+        req->ext.assign(ext + 1, name + name_size - ext - 1);
+    } else {
+        req->ext = req->name;
+    }
+    req->params.assign(query ? query : "", query_size);
 
     std::vector<std::string> tmp_querys;
-    split_string(new_req->params, "&", tmp_querys);
+    split_string(req->params, "&", tmp_querys);
 
     for (auto & key_value : tmp_querys) {
         std::vector<std::string> kv;
         split_string(key_value, "=", kv);
 
         if (kv.size() == 2) {
-            new_req->params_map[kv[0]] = url_decode(kv[1]);
+            req->params_map[kv[0]] = url_decode(kv[1]);
         }
     }
-
-    req = new_req;
-
-    tmss_info("create new request");
-    return ret;
 }
-}  // namespace tmss
\ No newline at end of file
+}  // namespace tmss
@@ -13,15 +13,37 @@
 #include <list>
 #include <utility>
 #include <string>
+#include <vector>
 
 #include <io/io.hpp>
 #include <parser.hpp>
 
 namespace tmss {
+class HttpClient;
+
 class HttpRequest : public Request {
  public:
     std::list<std::pair<std::string, std::string> > headers;
     bool ip_domain = false;
+    // -1 if no Content-Length
+    int64_t content_length = -1;
+    bool chunked = false;
+    // the body bytes read with the header
+    std::string body;
+    // Upgrade: websocket, the handshake headers are checked by the handler
+    bool websocket_upgrade = false;
+    // Connection has the upgrade token
+    bool connection_upgrade = false;
+    std::string websocket_key;
+    std::string websocket_version;
+    // the connection is upgraded to websocket
+    bool websocket = false;
+    // writes the frames of upgraded connection, answers the control frames of client
+    std::shared_ptr<HttpClient> websocket_client;
+    // PRI * HTTP/2.0, the http/2 connection preface
+    bool http2 = false;
+    // Upgrade: h2c, served as stream 1 after the 101 response
+    bool http2_upgrade = false;
 };
 
 class HttpResponse : public Response {
@@ -30,7 +52,76 @@ class HttpResponse : public Response {
     std::list<std::pair<std::string, std::string> > headers;
 };
 
+// the read buffer of parser, the request header must fit in it.
+#define TMSS_HTTP_READ_BUFFER_SIZE 8192
+#define TMSS_HTTP_MAX_HEADERS 32
+
+/**
+ * read-only string view over the read buffer of parser,
+ * valid until the request is consumed.
+ */
+class HttpStrView {
+ public:
+    const char* data;
+    int size;
+
+ public:
+    HttpStrView();
+    HttpStrView(const char* data, int size);
+
+ public:
+    bool empty() const;
+    bool equals(const char* value) const;
+    // case insensitive, for header name and token value
+    bool iequals(const char* value) const;
+    // case insensitive, the value is a comma separated list, like Connection
+    bool has_token(const char* token) const;
+    std::string to_str() const;
+};
+
+class HttpHeaderView {
+ public:
+    HttpStrView name;
+    HttpStrView value;
+};
+
+/**
+ * the request line and headers parsed in place, never copy.
+ */
+class HttpRequestView {
+ public:
+    HttpStrView method;
+    HttpStrView uri;
+    HttpStrView path;
+    HttpStrView query;
+    HttpStrView version;
+    HttpHeaderView headers[TMSS_HTTP_MAX_HEADERS];
+    int nb_headers;
+    // -1 if no Content-Length
+    int64_t content_length;
+    bool chunked;
+    bool keep_alive;
+    // bytes of request line and headers, include the empty line
+    int header_size;
+
+ public:
+    HttpRequestView();
+    void reset();
+    // get header by name, case insensitive, null if not found
+    const HttpStrView* get_header(const char* name) const;
+};
+
+enum EHttpParseState {
+    EHttpParseRequestLine = 0,
+    EHttpParseHeaderLine = 1,
+    EHttpParseDone = 2
+};
+
 class HttpParser {
+ public:
+    HttpParser();
+    ~HttpParser();
+
  public:
     /**
      * 从io中解析http response内容
@@ -44,6 +135,46 @@ class HttpParser {
      * @return
      */
     int parse_request(std::shared_ptr<IReader> reader, std::shared_ptr<HttpRequest> &req);
+
+ public:
+    /**
+     * read until the request header is complete, the bytes are appended to
+     * the read buffer and only the new bytes are scanned.
+     * @remark the view is valid until consume().
+     */
+    int read_request(std::shared_ptr<IReader> reader, const HttpRequestView*& view);
+    /**
+     * drop the parsed request header, keep the pipelined bytes for next request.
+     */
+    void consume();
+    // the bytes read but not parsed, the body or the next request
+    int left();
+    // move the bytes not parsed out, when the connection is not http/1.1 any more
+    void take_left(std::string& data);
+
+ private:
+    // parse the new bytes in buffer, return error or set state to done
+    int parse();
+    int parse_request_line(char* line, int size);
+    int parse_header_line(char* line, int size);
+
+ private:
+    std::vector<char> buffer;
+    // [0, write_pos) is the bytes not consumed
+    int write_pos;
+    // the start of the line not parsed
+    int line_pos;
+    // the bytes before scan_pos have no line end
+    int scan_pos;
+    EHttpParseState state;
+    HttpRequestView view;
 };
 
+/**
+ * parse the path and query to path, name, ext and params of request,
+ * like /folder/name.ext?params
+ */
+extern void http_parse_uri(const char* path, int path_size,
+    const char* query, int query_size, std::shared_ptr<HttpRequest> req);
+
 };  // namespace tmss
@@ -11,10 +11,16 @@
 #include <http_server.hpp>
 #include <defs/err.hpp>
 #include <http/http_parser.hpp>
+#include <http/http_stack.hpp>
+#include <http/http_client.hpp>
+#include <http/http2_server.hpp>
 #include <log/log.hpp>
 
 namespace tmss {
+const int default_keep_alive_timeout_ms = 15 * 1000;
+
 HttpMuxEntry::HttpMuxEntry() {
+    level = LOW;
 }
 
 bool HttpMuxEntry::can_server(std::shared_ptr<HttpRequest> req) {
@@ -26,58 +32,142 @@ std::shared_ptr<IUserHandler> HttpMuxEntry::get_user_handler() {
 }
 
 HttpMux::HttpMux() {
-    last_level = 0;
+    root = std::make_shared<HttpRouteNode>();
+}
+
+std::shared_ptr<HttpRouteNode> HttpMux::find_node(const std::string& pattern, bool create) {
+    std::shared_ptr<HttpRouteNode> node = root;
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        size_t end = pattern.find('/', pos);
+        if (end == std::string::npos) {
+            end = pattern.size();
+        }
+        if (end > pos) {
+            std::string segment = pattern.substr(pos, end - pos);
+            auto child = node->children.find(segment);
+            if (child != node->children.end()) {
+                node = child->second;
+            } else if (create) {
+                std::shared_ptr<HttpRouteNode> new_node = std::make_shared<HttpRouteNode>();
+                node->children.insert(std::make_pair(segment, new_node));
+                node = new_node;
+            } else {
+                return nullptr;
+            }
+        }
+        pos = end + 1;
+    }
+    return node;
 }
 
 int HttpMux::register_handler(std::string pattern,
         int level,
         std::shared_ptr<IUserHandler> user_handler) {
-    std::shared_ptr<HttpLevelMux> http_level_mux = std::make_shared<HttpLevelMux>();
-    http_level_mux->muxer.handler = user_handler;
-    http_level_mux->muxer.pattern = pattern;
-    level_handlers.insert(std::make_pair(last_level++, http_level_mux));
+    int ret = error_success;
+    if (pattern.empty() || !user_handler) {
+        ret = error_system_handler_not_found;
+        tmss_error("register handler invalid, pattern={}", pattern);
+        return ret;
+    }
 
-    tmss_error("register handler, pattern={}", pattern);
-    return error_success;
+    HttpMuxEntry entry;
+    entry.handler = user_handler;
+    entry.pattern = pattern;
+    entry.level = level;
+
+    if (pattern[0] == '.') {
+        // extension route, .m3u8 matches /live/stream.m3u8
+        ext_handlers[pattern.substr(1)] = entry;
+    } else {
+        find_node(pattern, true)->entry = entry;
+    }
+
+    tmss_info("register handler, pattern={}, level={}", pattern, level);
+    return ret;
 }
+
 int HttpMux::delete_handler(std::string& pattern, int level) {
-    auto http_level_mux = level_handlers.find(level);
-    if (http_level_mux != level_handlers.end()) {
-        level_handlers.erase(http_level_mux);
+    if (!pattern.empty() && pattern[0] == '.') {
+        ext_handlers.erase(pattern.substr(1));
+    } else {
+        std::shared_ptr<HttpRouteNode> node = find_node(pattern, false);
+        if (node) {
+            node->entry = HttpMuxEntry();
+        }
     }
 
-    tmss_error("delete handler, pattern={}", pattern);
+    tmss_info("delete handler, pattern={}", pattern);
 
     return error_success;
 }
 
-int HttpMux::get_handler(std::string pattern, std::shared_ptr<IUserHandler>& handler) {
-    // level_handlers
+int HttpMux::get_handler(std::string path, std::shared_ptr<IUserHandler>& handler) {
     int ret = error_success;
-    if (level_handlers.empty()) {
-        //  error
-        tmss_error("no handler, pattern={}", pattern);
-        ret = error_system_handler_not_found;
-        return ret;
+
+    // the longest prefix, the root is only the default
+    const HttpMuxEntry* prefix_entry = NULL;
+    std::shared_ptr<HttpRouteNode> node = root;
+    size_t pos = 0;
+    size_t last_segment = 0;
+    while (pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (end > pos) {
+            last_segment = pos;
+            if (node) {
+                auto child = node->children.find(path.substr(pos, end - pos));
+                if (child != node->children.end()) {
+                    node = child->second;
+                    if (node->entry.handler) {
+                        prefix_entry = &node->entry;
+                    }
+                } else {
+                    node.reset();
+                }
+            }
+        }
+        pos = end + 1;
     }
-    for (auto& http_mux : level_handlers) {
-        HttpMuxEntry mux_entry = http_mux.second->muxer;  // to do
-        tmss_info("check handler, pattern={}", mux_entry.pattern);
-        if (mux_entry.pattern == pattern) {     // to do
-            handler = mux_entry.get_user_handler();
-            tmss_info("get handler, pattern={}", mux_entry.pattern);
+
+    const HttpMuxEntry* ext_entry = NULL;
+    size_t dot = path.rfind('.');
+    if (dot != std::string::npos && dot >= last_segment) {
+        auto ext = ext_handlers.find(path.substr(dot + 1));
+        if (ext != ext_handlers.end()) {
+            ext_entry = &ext->second;
         }
     }
+
+    if (ext_entry && (!prefix_entry || ext_entry->level < prefix_entry->level)) {
+        handler = ext_entry->handler;
+    } else if (prefix_entry) {
+        handler = prefix_entry->handler;
+    } else {
+        handler = root->entry.handler;
+    }
+
+    if (!handler) {
+        ret = error_system_handler_not_found;
+        tmss_error("no handler, path={}", path);
+        return ret;
+    }
     return ret;
 }
 
 int HttpMux::serve_http(std::shared_ptr<IClientConn> conn,
         std::shared_ptr<HttpRequest> req,
         std::shared_ptr<IServer> server) {
-    // to do , maybe there are many request during connectino
     int ret = error_success;
     std::shared_ptr<IUserHandler> user_handler;
-    ret = get_handler("/", user_handler);
+    std::string path = "/" + req->path;
+    if (!req->path.empty()) {
+        path += "/";
+    }
+    path += req->name;
+    ret = get_handler(path, user_handler);
     if (ret != error_success) {
         tmss_error("get handler failed, ret={}", ret);
         return ret;
@@ -90,8 +180,10 @@ int HttpMux::serve_http(std::shared_ptr<IClientConn> conn,
             tmss_error("serve_http failed, server null");
             return ret;
         }
-        if (user_handler->handle_request(conn, req, server) != 0) {
-        } else {
+        ret = user_handler->handle_request(conn, req, server);
+        if (ret != error_success) {
+            tmss_error("handle request failed, ret={}", ret);
+            return ret;
         }
     } else {
         // error
@@ -100,27 +192,41 @@ int HttpMux::serve_http(std::shared_ptr<IClientConn> conn,
         return ret;
     }
 
-    // read connection, if error, return and stop thread
-    conn->set_recv_timeout(-1);     // no timeout
-    while (true) {
-        if (conn->is_stop()) {
-            tmss_info("conn stop");
-            break;
-        }
-        std::shared_ptr<HttpRequest> new_req = std::make_shared<HttpRequest>();
-        HttpParser parser;
-        // to do
-        ret = parser.parse_request(conn, new_req);
-        if (ret != error_success) {
-            tmss_error("http parse failed, ret={}", ret);
-            break;
-        }
+    return ret;
+}
+
+int HttpMux::upgrade_websocket(std::shared_ptr<IClientConn> conn,
+        std::shared_ptr<HttpRequest> req) {
+    int ret = error_success;
+    std::string response;
+    CHttp http;
+    // the handshake of RFC6455 4.2.1, only version 13 is supported
+    if (!req->connection_upgrade || req->websocket_key.empty()) {
+        http.buildResponseHeader(400, "", 0, false, false, response);
+        conn->write(response.c_str(), response.length());
+        ret = error_http_request_invalid;
+        tmss_error("websocket handshake invalid, ret={}", ret);
+        return ret;
     }
-    if (!conn->is_stop()) {
-        tmss_info("conn stop by http_server");
-        conn->set_stop();
+    if (req->websocket_version != "13") {
+        http.buildResponseHeader(426, "", 0, false, false, response);
+        response.insert(response.length() - 2, "Sec-WebSocket-Version: 13\r\n");
+        conn->write(response.c_str(), response.length());
+        ret = error_http_request_invalid;
+        tmss_error("websocket version {} not supported, ret={}", req->websocket_version, ret);
+        return ret;
     }
-    return ret;
+    http.buildWebSocketResponse(req->websocket_key, response);
+    if ((ret = conn->write(response.c_str(), response.length())) < 0) {
+        tmss_error("send websocket upgrade failed, ret={}", ret);
+        return ret;
+    }
+
+    // the handler sends the stream in websocket frames, no more request
+    req->websocket = true;
+    req->keep_alive = false;
+    tmss_info("upgrade to websocket, path={}, name={}", req->path, req->name);
+    return error_success;
 }
 
 std::shared_ptr<HttpMux> HttpMux::get_instance() {
@@ -133,35 +239,100 @@ std::shared_ptr<HttpMux> HttpMux::get_instance() {
 
 HttpConnHandler::HttpConnHandler(std::shared_ptr<IClientConn> conn,
         std::shared_ptr<HttpServer> server) : IConnHandler(conn, server) {
+    keep_alive_timeout_ms = server ? server->get_keep_alive_timeout() : default_keep_alive_timeout_ms;
 }
 
 int HttpConnHandler::cycle() {
-    HttpParser parser;
-    std::shared_ptr<HttpRequest> req;
+    int ret = error_success;
 
-    int ret = parser.parse_request(conn, req);
-    if (ret != error_success) {
-        tmss_error("http parse failed, ret={}", ret);
-        return ret;
+    // keep-alive, the requests are served in order on this coroutine,
+    // the pipelined requests wait in the read buffer of parser.
+    int32_t recv_timeout_ms = conn->get_recv_timeout();
+    while (!conn->is_stop()) {
+        std::shared_ptr<HttpRequest> req;
+        // the idle connection is closed if no request in time
+        conn->set_recv_timeout(keep_alive_timeout_ms);
+        ret = parser.parse_request(conn, req);
+        conn->set_recv_timeout(recv_timeout_ms);
+        if (ret == error_http_request_invalid) {
+            std::string response;
+            CHttp http;
+            http.buildResponseHeader(400, "", 0, false, false, response);
+            conn->write(response.c_str(), response.length());
+            tmss_error("http request invalid, ret={}", ret);
+            break;
+        }
+        if (ret != error_success) {
+            tmss_info("http parse stop, ret={}", ret);
+            break;
+        }
+        tmss_info("req=vhost={},path={},streamid={},ext={},keep_alive={}",
+            req->vhost,
+            req->path,
+            req->name,
+            req->ext,
+            req->keep_alive);
+
+        if (req->http2 || req->http2_upgrade) {
+            ret = serve_http2(req);
+            break;
+        }
+
+        ret = HttpMux::get_instance()->serve_http(conn, req, server);
+        if (ret != error_success) {
+            tmss_error("serve http failed, ret={}", ret);
+            break;
+        }
+
+        if (req->detached) {
+            // the input reads the body, it stops the connection when done
+            tmss_info("conn detached");
+            return ret;
+        }
+        if (req->streaming) {
+            // the output owns the connection now, wait for the client to close
+            ret = wait_close(req);
+            break;
+        }
+        if (!req->keep_alive) {
+            tmss_info("conn close after response");
+            break;
+        }
     }
-    tmss_info("req=vhost={},path={},streamid={},ext={}",
-        req->vhost,
-        req->path,
-        req->name,
-        req->ext);
-    // set format
-    /*if (req->ext == "flv") {     // test
-        req->format = "flv";
-        // req->format = "RAW";
-    } else if (req->ext == "ts") {
-        req->format = "mpegts";
-    } else {
-        req->format = "RAW";
-    }   //*/
 
-    // tmss_info("output_conn ref_count={}", conn.use_count());
+    if (!conn->is_stop()) {
+        tmss_info("conn stop by http_server");
+        conn->set_stop();
+    }
+    return ret;
+}
+
+int HttpConnHandler::wait_close(std::shared_ptr<HttpRequest> req) {
+    int ret = error_success;
 
-    return HttpMux::get_instance()->serve_http(conn, req, server);
+    // read connection, if error, return and stop thread
+    conn->set_recv_timeout(-1);     // no timeout
+    if (req->websocket_client) {
+        return req->websocket_client->wait_websocket_close();
+    }
+    char buffer[1024];
+    while (!conn->is_stop()) {
+        int read_size = conn->read(buffer, sizeof(buffer));
+        if (read_size <= 0) {
+            tmss_info("conn closed, ret={}", read_size);
+            break;
+        }
+    }
+    return ret;
+}
+
+int HttpConnHandler::serve_http2(std::shared_ptr<HttpRequest> req) {
+    // the frames read with the request are in parser
+    std::string left;
+    parser.take_left(left);
+
+    std::shared_ptr<Http2Session> session = std::make_shared<Http2Session>(conn, server);
+    return session->serve(req, left);
 }
 
 int HttpConnHandler::on_thread_stop() {
@@ -194,11 +365,20 @@ HttpServer::HttpServer(std::shared_ptr<IServerConn> server_conn,
         std::shared_ptr<ChannelPool> channel_pool,
         std::shared_ptr<FileCache> file_cache) :
     IServer(server_conn, channel_pool, file_cache) {
+    keep_alive_timeout_ms = default_keep_alive_timeout_ms;
 }
 
 HttpServer::~HttpServer() {
 }
 
+void HttpServer::set_keep_alive_timeout(int timeout_ms) {
+    keep_alive_timeout_ms = timeout_ms;
+}
+
+int HttpServer::get_keep_alive_timeout() {
+    return keep_alive_timeout_ms;
+}
+
 int HttpServer::listen(const std::string &ip, int port) {
     return server_conn->listen(ip, port);
 }
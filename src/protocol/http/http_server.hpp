@@ -44,6 +44,7 @@ class HttpMuxEntry {
  public:
     std::shared_ptr<IUserHandler> handler;
     std::string pattern;
+    int level;
 };
 
 enum HttpMuxLevel {
@@ -52,31 +53,51 @@ enum HttpMuxLevel {
     LOW    = 100,
 };
 
-class HttpLevelMux {
+/**
+ * the node of route trie, one node for each path segment,
+ * the entry is the handler of the prefix ends at this node.
+ */
+class HttpRouteNode {
  public:
-    friend class HttpMux;
-
- private:
-    int level;
-    //  std::list<HttpMuxEntry> muxer;    // to do
-    HttpMuxEntry muxer;
+    std::map<std::string, std::shared_ptr<HttpRouteNode>> children;
+    HttpMuxEntry entry;
 };
 
+/**
+ * the pattern is a path prefix like "/", "/api", "/live/",
+ * or an extension like ".m3u8", ".ts", ".flv".
+ * the longest prefix is matched over the path segments, the extension route
+ * is used when it has higher level (smaller value) than the prefix route,
+ * "/" is the default when no other route matches.
+ * @remark lookup walks the path once, O(path length).
+ */
 class HttpMux {
  public:
     HttpMux();
     int register_handler(std::string pattern, int level, std::shared_ptr<IUserHandler> h);
     int delete_handler(std::string& pattern, int level = -1);
-    int get_handler(std::string pattern, std::shared_ptr<IUserHandler>& handler);
+    // get the handler by request path, like /live/stream.flv
+    int get_handler(std::string path, std::shared_ptr<IUserHandler>& handler);
 
  public:
     int serve_http(std::shared_ptr<IClientConn> conn,
         std::shared_ptr<HttpRequest> req,
         std::shared_ptr<IServer> server);
 
+ private:
+    // find the node of prefix pattern, create the nodes when create is true
+    std::shared_ptr<HttpRouteNode> find_node(const std::string& pattern, bool create);
+
+ public:
+    /**
+     * answer the websocket handshake of the stream play, the request is served
+     * over websocket frames. the invalid handshake is answered by 400 or 426.
+     */
+    int upgrade_websocket(std::shared_ptr<IClientConn> conn, std::shared_ptr<HttpRequest> req);
+
  public:
-    std::map<int, std::shared_ptr<HttpLevelMux>> level_handlers;
-    int last_level;
+    std::shared_ptr<HttpRouteNode> root;
+    std::map<std::string, HttpMuxEntry> ext_handlers;
 
  public:
     static std::shared_ptr<HttpMux> get_instance();
@@ -91,6 +112,19 @@ class HttpConnHandler : public IConnHandler {
     int on_accept(std::shared_ptr<IClientConn> conn) override;
     int on_stop() { return error_success;  /*return manager->remove_conn(this);*/ }
     int on_init();
+
+ private:
+    // discard the input until the client closes the connection,
+    // the control frames of websocket are answered
+    int wait_close(std::shared_ptr<HttpRequest> req);
+    // the connection is http/2 from now on, by prior knowledge or upgrade
+    int serve_http2(std::shared_ptr<HttpRequest> req);
+
+ private:
+    // the read buffer is kept for the connection
+    HttpParser parser;
+    // wait for the next request at most this long
+    int keep_alive_timeout_ms;
 };
 
 /**
@@ -107,6 +141,12 @@ class HttpServer : public IServer {
     int listen(const std::string &ip, int port) override;
     std::shared_ptr<IConnHandler> create_conn_handler(std::shared_ptr<IClientConn> conn) override;
     std::shared_ptr<IClientConn> accept() override;
+    // the idle time a keep-alive connection waits for the next request
+    void set_keep_alive_timeout(int timeout_ms);
+    int get_keep_alive_timeout();
+
+ private:
+    int keep_alive_timeout_ms;
 };
 
 }  // namespace tmss
@@ -8,10 +8,13 @@
 
 namespace tmss {
 std::map<int, std::string> http_status_detail = {
-        {200, "HTTP 200 OK"}, {404, "404 Not Found"}
+        {200, "200 OK"}, {400, "400 Bad Request"}, {403, "403 Forbidden"},
+        {404, "404 Not Found"}, {426, "426 Upgrade Required"},
+        {500, "500 Internal Server Error"}
 };
 
 CHttp::CHttp() {
+    content_len_ = 0;
     response_status = 0;
 }
 
@@ -539,6 +542,64 @@ int CHttp::buildRawResponse(int code, std::string & str_rsp) {
     }
     return 0;
 }
+int CHttp::buildResponseHeader(int code,
+        const std::string& content_type,
+        int64_t content_length,
+        bool chunked,
+        bool keep_alive,
+        std::string& str_rsp) {
+    str_rsp = "HTTP/1.1 ";
+    auto status = http_status_detail.find(code);
+    if (status != http_status_detail.end()) {
+        str_rsp += status->second;
+    } else {
+        str_rsp += std::to_string(code);
+    }
+    str_rsp += "\r\n";
+    if (!content_type.empty()) {
+        str_rsp += "Content-Type: " + content_type + "\r\n";
+    }
+    if (chunked) {
+        str_rsp += "Transfer-Encoding: chunked\r\n";
+    } else if (content_length >= 0) {
+        str_rsp += "Content-Length: " + std::to_string(content_length) + "\r\n";
+    }
+    if (keep_alive) {
+        str_rsp += "Connection: keep-alive\r\n";
+    } else {
+        str_rsp += "Connection: close\r\n";
+    }
+    str_rsp += "\r\n";
+    return 0;
+}
+
+std::string CHttp::getContentType(const std::string& ext) {
+    if (ext == "flv") {
+        return "video/x-flv";
+    } else if (ext == "ts") {
+        return "video/MP2T";
+    } else if (ext == "m3u8") {
+        return "application/vnd.apple.mpegurl";
+    } else if (ext == "mp4") {
+        return "video/mp4";
+    }
+    return "application/octet-stream";
+}
+
+int CHttp::buildWebSocketResponse(const std::string& key, std::string& str_rsp) {
+    // Sec-WebSocket-Accept is base64(sha1(key + GUID)), see RFC6455
+    std::string accept_key = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    uint8_t digest[20];
+    sha1(accept_key.c_str(), accept_key.length(), digest);
+
+    str_rsp = "HTTP/1.1 101 Switching Protocols\r\n";
+    str_rsp += "Upgrade: websocket\r\n";
+    str_rsp += "Connection: Upgrade\r\n";
+    str_rsp += "Sec-WebSocket-Accept: " + base64_encode(digest, sizeof(digest)) + "\r\n";
+    str_rsp += "\r\n";
+    return 0;
+}
+
 int CHttp::get_response_status(const std::string& data) {
     if (response_status > 0) {
         return response_status;
@@ -68,6 +68,19 @@ class CHttp {
     int parseHttpResponse(const std::string& data);
     void DomainPolicy(std::string& crossdomain_info);
     int buildRawResponse(int code, std::string& str_rsp);
+    /**
+     * build the response header, Transfer-Encoding is chunked when chunked,
+     * otherwise Content-Length is set when content_length >= 0.
+     */
+    int buildResponseHeader(int code,
+        const std::string& content_type,
+        int64_t content_length,
+        bool chunked,
+        bool keep_alive,
+        std::string& str_rsp);
+    static std::string getContentType(const std::string& ext);
+    // the 101 response of websocket upgrade
+    int buildWebSocketResponse(const std::string& key, std::string& str_rsp);
 
     int get_response_status(const std::string& data);
 };  //  end of CHttp
@@ -0,0 +1,160 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  weideng.
+ *
+ * =====================================================================================
+ */
+
+#include <protocol/listener_group.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include <defs/err.hpp>
+#include <log/log.hpp>
+#include <transport/tmss_trans_tcp.hpp>
+#include <transport/tmss_trans_uring.hpp>
+
+namespace tmss {
+const int listener_back_log = 1024;
+
+ListenerWorker::ListenerWorker(int index, int fd, const std::string& ip, int port,
+        ServerCreator creator, bool pin_cpu, bool use_uring)
+        : ip(ip), creator(std::move(creator)) {
+    this->index = index;
+    this->fd = fd;
+    this->port = port;
+    this->pin_cpu = pin_cpu;
+    this->use_uring = use_uring;
+}
+
+void ListenerWorker::on_start() {
+    if (!pin_cpu) {
+        return;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index, &cpus);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (ret != 0) {
+        tmss_warn("pin listener worker failed, index={}, ret={}", index, ret);
+    }
+}
+
+void ListenerWorker::run() {
+    std::shared_ptr<IServerConn> server_conn;
+    int ret = error_success;
+    if (use_uring && StUring::get_instance()) {
+        std::shared_ptr<UringServerConn> conn = std::make_shared<UringServerConn>(true);
+        ret = conn->open(fd);
+        server_conn = conn;
+    } else {
+        if (use_uring) {
+            tmss_warn("listener worker no io_uring, use st epoll, index={}", index);
+        }
+        std::shared_ptr<TcpServerConn> conn = std::make_shared<TcpServerConn>(true);
+        ret = conn->open(fd);
+        server_conn = conn;
+    }
+    if (ret != error_success) {
+        tmss_error("listener worker open failed, index={}, ret={}", index, ret);
+        return;
+    }
+
+    server = creator(server_conn);
+    if (!server) {
+        tmss_error("listener worker create server failed, index={}", index);
+        return;
+    }
+    if ((ret = server->init(ip, port)) != error_success
+            || (ret = server->serve()) != error_success) {
+        tmss_error("listener worker run failed, index={}, ret={}", index, ret);
+        return;
+    }
+    tmss_info("listener worker start, index={}, {}:{}", index, ip.c_str(), port);
+
+    while (true) {
+        st_usleep(1000 * 1000);
+    }
+}
+
+ListenerGroup::ListenerGroup() {
+    port = 0;
+    cpu_steering = false;
+    use_uring = false;
+}
+
+ListenerGroup::~ListenerGroup() {
+    // the fds opened by workers are closed by them
+    for (size_t i = threads.size(); i < fds.size(); i++) {
+        ::close(fds[i]);
+    }
+}
+
+int ListenerGroup::init(const std::string& ip, int port, int workers, bool cpu_steering) {
+    int ret = error_success;
+    this->ip = ip;
+    this->port = port;
+    this->cpu_steering = cpu_steering;
+
+    int cpu_count = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (workers <= 0) {
+        workers = (cpu_count > 0) ? cpu_count : 1;
+    }
+    if (cpu_steering && workers > cpu_count) {
+        tmss_warn("more workers than cpus, no cpu steering, workers={}, cpus={}",
+            workers, cpu_count);
+        this->cpu_steering = false;
+    }
+
+    for (int i = 0; i < workers; i++) {
+        int fd = -1;
+        if ((ret = st_tcp_listen_fd(ip, port, listener_back_log, fd, true)) != error_success) {
+            tmss_error("listener group listen failed, index={}, {}:{}, ret={}",
+                i, ip.c_str(), port, ret);
+            return ret;
+        }
+        fds.push_back(fd);
+    }
+
+    if (this->cpu_steering) {
+        // the program is shared by the whole reuseport group
+        if ((ret = st_tcp_fd_reuseport_cpu(fds[0], workers)) != error_success) {
+            tmss_warn("attach reuseport cpu steering failed, ret={}", ret);
+            this->cpu_steering = false;
+            ret = error_success;
+        }
+    }
+
+    tmss_info("listener group listen success, {}:{}, workers={}, cpu_steering={}",
+        ip.c_str(), port, workers, this->cpu_steering);
+    return ret;
+}
+
+void ListenerGroup::set_uring(bool use_uring) {
+    this->use_uring = use_uring;
+}
+
+int ListenerGroup::run(ServerCreator creator) {
+    for (size_t i = 0; i < fds.size(); i++) {
+        std::shared_ptr<ListenerWorker> worker = std::make_shared<ListenerWorker>(
+            static_cast<int>(i), fds[i], ip, port, creator, cpu_steering, use_uring);
+        std::shared_ptr<CoThread> thread = std::make_shared<CoThread>(
+            "listener-" + std::to_string(i), worker);
+        int ret = thread->run();
+        if (ret != error_success) {
+            tmss_error("listener group start thread failed, index={}, ret={}", i, ret);
+            return ret;
+        }
+        threads.push_back(thread);
+    }
+    return error_success;
+}
+
+}  // namespace tmss
@@ -0,0 +1,87 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  weideng.
+ *
+ * =====================================================================================
+ */
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <coroutine/co_threads.hpp>
+#include <protocol/server.hpp>
+
+namespace tmss {
+/*
+*   create the server of a worker thread, called on the thread, so the channels,
+*   pools and handlers of the server belong to its st thread.
+*/
+typedef std::function<std::shared_ptr<IServer>(std::shared_ptr<IServerConn> server_conn)>
+    ServerCreator;
+
+/*
+*   a thread of the listener group, accepts on its own socket of the port.
+*/
+class ListenerWorker : public ICoThreadHandler {
+ public:
+    ListenerWorker(int index, int fd, const std::string& ip, int port,
+        ServerCreator creator, bool pin_cpu, bool use_uring);
+    virtual ~ListenerWorker() = default;
+
+ public:
+    void on_start() override;
+    void run() override;
+
+ private:
+    int index;
+    // listened by the group, opened on this thread
+    int fd;
+    std::string ip;
+    int port;
+    ServerCreator creator;
+    bool pin_cpu;
+    // accept and serve on io_uring, the st epoll if not supported
+    bool use_uring;
+    std::shared_ptr<IServer> server;
+};
+
+/*
+*   the listeners of one port, each worker thread owns a SO_REUSEPORT socket and
+*   its accept coroutine, the kernel spreads the connections over the sockets,
+*   no single acceptor to wait for when many clients reconnect at once.
+*   with cpu steering, the connection goes to the socket of the cpu handling
+*   its packets, and the worker i is pinned to the cpu i.
+*/
+class ListenerGroup {
+ public:
+    ListenerGroup();
+    virtual ~ListenerGroup();
+
+ public:
+    /*
+    *   listen all sockets of the group in order, the order is the index of
+    *   socket in the reuseport group.
+    *   @param workers the threads, the cpu count if not positive.
+    */
+    int init(const std::string& ip, int port, int workers, bool cpu_steering);
+    // the workers accept on io_uring, checked on each worker thread
+    void set_uring(bool use_uring);
+    // start the worker threads
+    int run(ServerCreator creator);
+
+ private:
+    std::string ip;
+    int port;
+    bool cpu_steering;
+    bool use_uring;
+    std::vector<int> fds;
+    std::vector<std::shared_ptr<CoThread>> threads;
+};
+
+}  // namespace tmss
@@ -0,0 +1,488 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/6
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+
+#include <rtmp/rtmp_amf_view.hpp>
+
+#include <string.h>
+
+#include <log/log.hpp>
+
+namespace tmss {
+// max nested level of object/array, avoid stack overflow by bad payload.
+#define TMSS_AMF0_VIEW_MAX_DEPTH    32
+
+Amf0StrView::Amf0StrView() {
+    data = nullptr;
+    size = 0;
+}
+
+Amf0StrView::Amf0StrView(const char* data, int size) {
+    this->data = data;
+    this->size = size;
+}
+
+bool Amf0StrView::empty() const {
+    return size <= 0;
+}
+
+bool Amf0StrView::equals(const char* value) const {
+    int len = value ? strlen(value) : 0;
+    if (len != size) {
+        return false;
+    }
+    return size == 0 || memcmp(data, value, size) == 0;
+}
+
+bool Amf0StrView::equals(const std::string& value) const {
+    if (static_cast<int>(value.length()) != size) {
+        return false;
+    }
+    return size == 0 || memcmp(data, value.data(), size) == 0;
+}
+
+std::string Amf0StrView::to_str() const {
+    if (size <= 0) {
+        return "";
+    }
+    return std::string(data, size);
+}
+
+Amf0ViewNode::Amf0ViewNode() {
+    marker = RTMP_AMF0_Invalid;
+    number = 0;
+    time_zone = 0;
+    first_child = -1;
+    next = -1;
+    count = 0;
+    offset = 0;
+    length = 0;
+}
+
+Amf0View::Amf0View() {
+    payload = nullptr;
+    size = 0;
+    pos = 0;
+}
+
+Amf0View::~Amf0View() {
+}
+
+void Amf0View::reset() {
+    payload = nullptr;
+    size = 0;
+    pos = 0;
+    // clear keeps the capacity, the arena is reused by next message.
+    nodes.clear();
+    values.clear();
+}
+
+int Amf0View::decode(const char* payload, int size, int max_values) {
+    int ret = error_success;
+
+    reset();
+    this->payload = payload;
+    this->size = size;
+
+    while (pos < size) {
+        if (max_values >= 0 && static_cast<int>(values.size()) >= max_values) {
+            break;
+        }
+
+        int index = -1;
+        if ((ret = read_value(0, index)) != error_success) {
+            tmss_error("amf0 view decode value failed. pos={}, size={}, ret={}",
+                pos, size, ret);
+            return ret;
+        }
+        values.push_back(index);
+    }
+
+    return ret;
+}
+
+int Amf0View::count() {
+    return values.size();
+}
+
+int Amf0View::at(int index) {
+    if (index < 0 || index >= static_cast<int>(values.size())) {
+        return -1;
+    }
+    return values[index];
+}
+
+const Amf0ViewNode& Amf0View::node(int index) {
+    static Amf0ViewNode invalid;
+    if (index < 0 || index >= static_cast<int>(nodes.size())) {
+        return invalid;
+    }
+    return nodes[index];
+}
+
+int Amf0View::consumed() {
+    return pos;
+}
+
+const char* Amf0View::raw(int index) {
+    if (index < 0 || index >= static_cast<int>(nodes.size())) {
+        return nullptr;
+    }
+    return payload + nodes[index].offset;
+}
+
+bool Amf0View::is_string(int index) {
+    char marker = node(index).marker;
+    return marker == RTMP_AMF0_String || marker == RTMP_AMF0_LongString;
+}
+
+bool Amf0View::is_number(int index) {
+    return node(index).marker == RTMP_AMF0_Number;
+}
+
+bool Amf0View::is_object(int index) {
+    return node(index).marker == RTMP_AMF0_Object;
+}
+
+int Amf0View::get_property(int index, const char* name) {
+    const Amf0ViewNode& parent = node(index);
+    if (parent.marker != RTMP_AMF0_Object && parent.marker != RTMP_AMF0_EcmaArray) {
+        return -1;
+    }
+
+    for (int child = parent.first_child; child >= 0; child = nodes[child].next) {
+        if (nodes[child].key.equals(name)) {
+            return child;
+        }
+    }
+    return -1;
+}
+
+bool Amf0View::get_string(int index, const char* name, Amf0StrView& value) {
+    int prop = get_property(index, name);
+    if (!is_string(prop)) {
+        return false;
+    }
+    value = nodes[prop].str;
+    return true;
+}
+
+bool Amf0View::get_number(int index, const char* name, double& value) {
+    int prop = get_property(index, name);
+    if (!is_number(prop)) {
+        return false;
+    }
+    value = nodes[prop].number;
+    return true;
+}
+
+int Amf0View::to_any(int index, std::shared_ptr<Amf0Any>& value) {
+    int ret = error_success;
+
+    if (index < 0 || index >= static_cast<int>(nodes.size())) {
+        ret = error_rtmp_amf0_invalid;
+        tmss_error("amf0 view invalid node. index={}, ret={}", index, ret);
+        return ret;
+    }
+
+    // copy the node, the children never change it.
+    Amf0ViewNode n = nodes[index];
+    switch (n.marker) {
+        case RTMP_AMF0_String:
+        case RTMP_AMF0_LongString: {
+            value = Amf0Any::str(n.str.to_str().c_str());
+            return ret;
+        }
+        case RTMP_AMF0_Boolean: {
+            value = Amf0Any::boolean(n.number != 0);
+            return ret;
+        }
+        case RTMP_AMF0_Number: {
+            value = Amf0Any::number(n.number);
+            return ret;
+        }
+        case RTMP_AMF0_Null: {
+            value = Amf0Any::null();
+            return ret;
+        }
+        case RTMP_AMF0_Undefined: {
+            value = Amf0Any::undefined();
+            return ret;
+        }
+        case RTMP_AMF0_Date: {
+            // Amf0Date keeps the raw bits of the double.
+            int64_t date = 0;
+            memcpy(&date, &n.number, 8);
+            value = Amf0Any::date(date);
+            return ret;
+        }
+        case RTMP_AMF0_Object:
+        case RTMP_AMF0_EcmaArray: {
+            std::shared_ptr<Amf0Object> obj;
+            if (n.marker == RTMP_AMF0_Object) {
+                obj = Amf0Any::object();
+            } else {
+                obj = Amf0Any::ecma_array();
+            }
+            for (int child = n.first_child; child >= 0; child = nodes[child].next) {
+                std::shared_ptr<Amf0Any> prop;
+                if ((ret = to_any(child, prop)) != error_success) {
+                    return ret;
+                }
+                obj->set(nodes[child].key.to_str(), prop);
+            }
+            value = obj;
+            return ret;
+        }
+        case RTMP_AMF0_StrictArray: {
+            std::shared_ptr<Amf0StrictArray> arr = Amf0Any::strict_array();
+            for (int child = n.first_child; child >= 0; child = nodes[child].next) {
+                std::shared_ptr<Amf0Any> elem;
+                if ((ret = to_any(child, elem)) != error_success) {
+                    return ret;
+                }
+                arr->append(elem);
+            }
+            value = arr;
+            return ret;
+        }
+        default: {
+            ret = error_rtmp_amf0_invalid;
+            tmss_error("amf0 view invalid marker. marker={}, ret={}", n.marker, ret);
+            return ret;
+        }
+    }
+}
+
+int Amf0View::read_value(int depth, int& index) {
+    int ret = error_success;
+
+    if (depth > TMSS_AMF0_VIEW_MAX_DEPTH) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view too deep. depth={}, ret={}", depth, ret);
+        return ret;
+    }
+
+    if (pos + 1 > size) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view read marker failed. ret={}", ret);
+        return ret;
+    }
+
+    // @remark never keep the reference of node, the arena may grow.
+    index = nodes.size();
+    nodes.emplace_back();
+    char marker = payload[pos];
+    nodes[index].marker = marker;
+    nodes[index].offset = pos;
+    pos++;
+
+    switch (marker) {
+        case RTMP_AMF0_Number: {
+            if (pos + 8 > size) {
+                ret = error_rtmp_amf0_decode;
+                break;
+            }
+            nodes[index].number = read_double();
+            break;
+        }
+        case RTMP_AMF0_Boolean: {
+            if (pos + 1 > size) {
+                ret = error_rtmp_amf0_decode;
+                break;
+            }
+            nodes[index].number = (payload[pos++] != 0) ? 1 : 0;
+            break;
+        }
+        case RTMP_AMF0_String: {
+            Amf0StrView str;
+            ret = read_utf8(str);
+            nodes[index].str = str;
+            break;
+        }
+        case RTMP_AMF0_LongString: {
+            if (pos + 4 > size) {
+                ret = error_rtmp_amf0_decode;
+                break;
+            }
+            int len = read_uint(4);
+            if (len < 0 || len > size - pos) {
+                ret = error_rtmp_amf0_decode;
+                break;
+            }
+            nodes[index].str = Amf0StrView(payload + pos, len);
+            pos += len;
+            break;
+        }
+        case RTMP_AMF0_Null:
+        case RTMP_AMF0_Undefined: {
+            break;
+        }
+        case RTMP_AMF0_Object: {
+            ret = read_properties(depth, index);
+            break;
+        }
+        case RTMP_AMF0_EcmaArray: {
+            // the count is not reliable, always read until object-eof.
+            if (pos + 4 > size) {
+                ret = error_rtmp_amf0_decode;
+                break;
+            }
+            pos += 4;
+            ret = read_properties(depth, index);
+            break;
+        }
+        case RTMP_AMF0_StrictArray: {
+            if (pos + 4 > size) {
+                ret = error_rtmp_amf0_decode;
+                break;
+            }
+            uint32_t count = read_uint(4);
+            int last = -1;
+            for (uint32_t i = 0; i < count && ret == error_success; i++) {
+                int child = -1;
+                if ((ret = read_value(depth + 1, child)) == error_success) {
+                    link(index, last, child);
+                }
+            }
+            break;
+        }
+        case RTMP_AMF0_Date: {
+            if (pos + 10 > size) {
+                ret = error_rtmp_amf0_decode;
+                break;
+            }
+            nodes[index].number = read_double();
+            nodes[index].time_zone = read_uint(2);
+            break;
+        }
+        default: {
+            ret = error_rtmp_amf0_invalid;
+            tmss_error("amf0 view invalid marker. marker={}, ret={}", marker, ret);
+            return ret;
+        }
+    }
+
+    if (ret != error_success) {
+        tmss_error("amf0 view read value failed. marker={}, ret={}", marker, ret);
+        return ret;
+    }
+
+    nodes[index].length = pos - nodes[index].offset;
+
+    return ret;
+}
+
+int Amf0View::read_properties(int depth, int parent) {
+    int ret = error_success;
+
+    int last = -1;
+    while (pos < size) {
+        // object-eof, 0x00 0x00 0x09
+        if (pos + 3 <= size && payload[pos] == 0x00 && payload[pos + 1] == 0x00
+                && payload[pos + 2] == RTMP_AMF0_ObjectEnd) {
+            pos += 3;
+            break;
+        }
+
+        Amf0StrView key;
+        if ((ret = read_utf8(key)) != error_success) {
+            tmss_error("amf0 view read property name failed. ret={}", ret);
+            return ret;
+        }
+
+        int child = -1;
+        if ((ret = read_value(depth + 1, child)) != error_success) {
+            tmss_error("amf0 view read property value failed. ret={}", ret);
+            return ret;
+        }
+        nodes[child].key = key;
+        link(parent, last, child);
+    }
+
+    return ret;
+}
+
+int Amf0View::read_utf8(Amf0StrView& value) {
+    int ret = error_success;
+
+    if (pos + 2 > size) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view read string length failed. ret={}", ret);
+        return ret;
+    }
+
+    int len = read_uint(2);
+    if (len > size - pos) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view read string data failed. len={}, ret={}", len, ret);
+        return ret;
+    }
+
+    value = Amf0StrView(payload + pos, len);
+    pos += len;
+
+    return ret;
+}
+
+double Amf0View::read_double() {
+    uint64_t temp = 0;
+    for (int i = 0; i < 8; i++) {
+        temp = (temp << 8) | static_cast<uint8_t>(payload[pos++]);
+    }
+
+    double value = 0;
+    memcpy(&value, &temp, 8);
+    return value;
+}
+
+uint32_t Amf0View::read_uint(int len) {
+    uint32_t value = 0;
+    for (int i = 0; i < len; i++) {
+        value = (value << 8) | static_cast<uint8_t>(payload[pos++]);
+    }
+    return value;
+}
+
+void Amf0View::link(int parent, int& last, int child) {
+    if (last < 0) {
+        nodes[parent].first_child = child;
+    } else {
+        nodes[last].next = child;
+    }
+    last = child;
+    nodes[parent].count++;
+}
+
+int amf0_view_read_object(const char* data, int size, std::shared_ptr<Amf0Object>& value) {
+    int ret = error_success;
+
+    Amf0View view;
+    if ((ret = view.decode(data, size, 1)) != error_success) {
+        tmss_error("amf0 view decode object failed. ret={}", ret);
+        return ret;
+    }
+
+    std::shared_ptr<Amf0Any> any;
+    if ((ret = view.to_any(view.at(0), any)) != error_success) {
+        tmss_error("amf0 view build object failed. ret={}", ret);
+        return ret;
+    }
+
+    if (!any->is_object()) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view value is not object. marker={}, ret={}", any->marker, ret);
+        return ret;
+    }
+    value = any->to_object();
+
+    return ret;
+}
+
+}  // namespace tmss
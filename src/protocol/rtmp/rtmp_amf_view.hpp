@@ -0,0 +1,138 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/6
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <defs/err.hpp>
+#include <rtmp/rtmp_amf.hpp>
+
+namespace tmss {
+/**
+ * read-only string view over the message payload,
+ * valid only while the payload is alive.
+ */
+class Amf0StrView {
+ public:
+    const char* data;
+    int size;
+
+ public:
+    Amf0StrView();
+    Amf0StrView(const char* data, int size);
+
+ public:
+    bool empty() const;
+    bool equals(const char* value) const;
+    bool equals(const std::string& value) const;
+    std::string to_str() const;
+};
+
+/**
+ * a decoded AMF0 value in the flat view.
+ * children of object/ecma-array/strict-array are linked by index,
+ * so the whole message is described by one node array.
+ */
+class Amf0ViewNode {
+ public:
+    char marker;
+    // property name when the node is a property of object/ecma-array.
+    Amf0StrView key;
+    // string value for string and long string.
+    Amf0StrView str;
+    // number value, also the boolean and the date.
+    double number;
+    int16_t time_zone;
+    // index of the first child, -1 if none.
+    int first_child;
+    // index of the next sibling, -1 if none.
+    int next;
+    // children count.
+    int count;
+    // the raw AMF0 bytes of this value in payload.
+    int offset;
+    int length;
+
+ public:
+    Amf0ViewNode();
+};
+
+/**
+ * arena-backed AMF0 decoder, decode the payload to a flat read-only view,
+ * never copy the strings and never create Amf0Any.
+ * the nodes arena is reused between messages, so decode does not allocate
+ * after warm up.
+ * @remark use to_any() to build the owning Amf0Any only when re-encode.
+ */
+class Amf0View {
+ public:
+    Amf0View();
+    virtual ~Amf0View();
+
+ public:
+    /**
+     * decode the top-level values of payload.
+     * @param max_values, stop after max_values top-level values, -1 for all.
+     */
+    virtual int decode(const char* payload, int size, int max_values = -1);
+    virtual void reset();
+
+ public:
+    // count of top-level values.
+    virtual int count();
+    // the node index of top-level value at index, -1 if not exists.
+    virtual int at(int index);
+    virtual const Amf0ViewNode& node(int index);
+    // bytes consumed by decode.
+    virtual int consumed();
+    virtual const char* raw(int index);
+
+ public:
+    virtual bool is_string(int index);
+    virtual bool is_number(int index);
+    virtual bool is_object(int index);
+    /**
+     * find the property of object/ecma-array by name.
+     * @return the node index of property value, -1 if not found.
+     */
+    virtual int get_property(int index, const char* name);
+    virtual bool get_string(int index, const char* name, Amf0StrView& value);
+    virtual bool get_number(int index, const char* name, double& value);
+
+ public:
+    /**
+     * build the owning AMF0 instance from the view.
+     */
+    virtual int to_any(int index, std::shared_ptr<Amf0Any>& value);
+
+ private:
+    int read_value(int depth, int& index);
+    int read_properties(int depth, int parent);
+    int read_utf8(Amf0StrView& value);
+    double read_double();
+    uint32_t read_uint(int len);
+    void link(int parent, int& last, int child);
+
+ private:
+    const char* payload;
+    int size;
+    int pos;
+    std::vector<Amf0ViewNode> nodes;
+    std::vector<int> values;
+};
+
+/**
+* build the owning amf0 object from the raw bytes,
+* used to re-encode the packet decoded by Amf0View.
+*/
+extern int amf0_view_read_object(const char* data, int size, std::shared_ptr<Amf0Object>& value);
+
+}  // namespace tmss
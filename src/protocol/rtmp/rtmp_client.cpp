@@ -15,11 +15,36 @@
 #include <defs/err.hpp>
 #include <log/log.hpp>
 #include <format/base/demux.hpp>
+#include <format/flv/tmss_format_flv.hpp>
 #include <util/util.hpp>
 #include <rtmp_stack.hpp>
 
 namespace tmss {
 RtmpClient::RtmpClient() {
+    publish_stream_id = 0;
+}
+
+int RtmpClient::init(std::shared_ptr<IClientConn> conn) {
+    int ret = IClient::init(conn);
+    if (ret != error_success) {
+        return ret;
+    }
+    protocol = std::make_shared<RtmpProtocolHandler>(conn);
+    protocol->set_io_buffer(io_buffer);
+
+    return ret;
+}
+
+int RtmpClient::reset_conn(std::shared_ptr<IClientConn> conn) {
+    int ret = IClient::reset_conn(conn);
+    if (ret != error_success) {
+        return ret;
+    }
+    // the chunk streams of the old connection are dropped
+    protocol = std::make_shared<RtmpProtocolHandler>(conn);
+    protocol->set_io_buffer(io_buffer);
+
+    return ret;
 }
 
 int RtmpClient::cycle() {
@@ -52,11 +77,51 @@ int RtmpClient::request(const std::string& origin_host,
         tmss_error("play failed, ret:%d", ret);
         return ret;
     }
+    // the rtmp demux read the messages from protocol, no byte stream.
+    std::shared_ptr<RtmpDeMux> rtmp_demux = std::dynamic_pointer_cast<RtmpDeMux>(demux);
+    if (rtmp_demux) {
+        rtmp_demux->attach(protocol);
+    }
     std::string data_header;
     demux->on_ingest(0, data_header);
     return ret;
 }
 
+int RtmpClient::request_publish(const std::string& origin_host,
+        const std::string& origin_port,
+        const std::string& origin_path,
+        const std::string& stream,
+        const std::string& param) {
+    int ret = error_success;
+
+    std::string request_url = generate_tc_url(origin_host,
+        origin_host, origin_path, origin_port,
+        param);
+
+    ret = handshake(conn);
+    if (ret != error_success) {
+        tmss_error("handshake failed ret={}", ret);
+        return ret;
+    }
+    ret = connect_app(origin_path, request_url);
+    if (ret != error_success) {
+        tmss_error("conect_app failed ret={}", ret);
+        return ret;
+    }
+    ret = fmle_publish(stream, publish_stream_id);
+    if (ret != error_success) {
+        tmss_error("fmle publish failed, stream={}, ret={}", stream, ret);
+        return ret;
+    }
+
+    tmss_info("publish success, stream={}, stream_id={}", stream, publish_stream_id);
+    return ret;
+}
+
+int RtmpClient::send_message(std::shared_ptr<RtmpMessage> msg) {
+    return protocol->send_rtmp_message(msg, publish_stream_id);
+}
+
 int RtmpClient::read_data(char* buf, int size) {
     return protocol->recv_message(buf, size);
 }
@@ -66,6 +131,10 @@ int RtmpClient::write_data(const char* buf, int size) {
     return protocol->send_message(buf, size);
 }
 
+std::shared_ptr<RtmpProtocolHandler> RtmpClient::get_protocol() {
+    return protocol;
+}
+
 int RtmpClient::connect(const std::string& origin_host,
         const std::string& request_url,
         int& stream_id,
@@ -167,6 +236,11 @@ int RtmpClient::connect_app(std::string path, std::string tc_url) {
     pkt_connect_app->command_object->set("videoFunction", Amf0Any::number(1));
     pkt_connect_app->command_object->set("pageUrl", Amf0Any::str());
     pkt_connect_app->command_object->set("objectEncoding", Amf0Any::number(0));
+    // enhanced rtmp, the video codecs supported besides the legacy codec id
+    std::shared_ptr<Amf0StrictArray> fourcc_list = Amf0Any::strict_array();
+    fourcc_list->append(Amf0Any::str("hvc1"));
+    fourcc_list->append(Amf0Any::str("av01"));
+    pkt_connect_app->command_object->set("fourCcList", fourcc_list);
 
     // the debug_upnode is config in vhost and default to true.
     std::shared_ptr<Amf0Object> args = pkt_connect_app->args;
@@ -230,7 +304,8 @@ int RtmpClient::connect_app(std::string path, std::string tc_url) {
 int RtmpClient::create_stream(int& stream_id) {
     int ret = error_success;
     // CreateStream
-    std::shared_ptr<RtmpCreateStreamPacket> pkt_create_stream;
+    std::shared_ptr<RtmpCreateStreamPacket> pkt_create_stream =
+        std::make_shared<RtmpCreateStreamPacket>();
     if ((ret = protocol->send_packet(pkt_create_stream, 0)) != error_success) {
         tmss_error("send create_stream failed,ret={}", ret);
         return ret;
@@ -267,7 +342,7 @@ int RtmpClient::play(const std::string& stream, int stream_id) {
     // SetBufferLength(1000ms)
     int buffer_length_ms = 1000;
     std::shared_ptr<RtmpUserControlPacket> pkt_user_control =
-        std::shared_ptr<RtmpUserControlPacket>();
+        std::make_shared<RtmpUserControlPacket>();
 
     pkt_user_control->event_type = SrcPCUCSetBufferLength;
     pkt_user_control->event_data = stream_id;
@@ -282,7 +357,7 @@ int RtmpClient::play(const std::string& stream, int stream_id) {
 
     // SetChunkSize
     std::shared_ptr<RtmpSetChunkSizePacket> pkt_set_chunk_size =
-        std::shared_ptr<RtmpSetChunkSizePacket>();
+        std::make_shared<RtmpSetChunkSizePacket>();
     pkt_set_chunk_size->chunk_size = TMSS_CONSTS_RTMP_TMSS_CHUNK_SIZE;
     if ((ret = protocol->send_packet(pkt_set_chunk_size, 0)) != error_success) {
         tmss_error("send set chunk size failed. "
@@ -297,14 +372,86 @@ int RtmpClient::play(const std::string& stream, int stream_id) {
 int RtmpClient::publish(std::string stream, int stream_id) {
     int ret = error_success;
 
-    // to do
+    // publish(stream)
+    std::shared_ptr<RtmpPublishPacket> pkt_publish = std::make_shared<RtmpPublishPacket>();
+    pkt_publish->stream_name = stream;
+    if ((ret = protocol->send_packet(pkt_publish, stream_id)) != error_success) {
+        tmss_error("send publish message failed. "
+            "stream={}, stream_id={}, ret={}", stream.c_str(), stream_id, ret);
+        return ret;
+    }
+
     return ret;
 }
 
 int RtmpClient::fmle_publish(std::string stream, int& stream_id) {
     int ret = error_success;
 
-    // to do
+    // releaseStream
+    std::shared_ptr<RtmpFMLEStartPacket> pkt_release_stream(
+        RtmpFMLEStartPacket::create_release_stream(stream));
+    if ((ret = protocol->send_packet(pkt_release_stream, 0)) != error_success) {
+        tmss_error("send FMLE publish release stream failed. "
+            "stream={}, ret={}", stream.c_str(), ret);
+        return ret;
+    }
+
+    // FCPublish
+    std::shared_ptr<RtmpFMLEStartPacket> pkt_fc_publish(
+        RtmpFMLEStartPacket::create_FC_publish(stream));
+    if ((ret = protocol->send_packet(pkt_fc_publish, 0)) != error_success) {
+        tmss_error("send FMLE publish FCPublish failed. "
+            "stream={}, ret={}", stream.c_str(), ret);
+        return ret;
+    }
+
+    // CreateStream
+    std::shared_ptr<RtmpCreateStreamPacket> pkt_create_stream =
+        std::make_shared<RtmpCreateStreamPacket>();
+    pkt_create_stream->transaction_id = 4;
+    if ((ret = protocol->send_packet(pkt_create_stream, 0)) != error_success) {
+        tmss_error("send FMLE publish createStream failed. "
+            "stream={}, ret={}", stream.c_str(), ret);
+        return ret;
+    }
+
+    // expect result of CreateStream
+    std::shared_ptr<RtmpCreateStreamResPacket> pkt_response;
+    if ((ret = protocol->expect_packet<RtmpCreateStreamResPacket>(pkt_response))
+            != error_success) {
+        tmss_error("expect create stream response message failed. ret={}", ret);
+        return ret;
+    }
+    stream_id = static_cast<int>(pkt_response->stream_id);
+
+    // publish(stream)
+    if ((ret = publish(stream, stream_id)) != error_success) {
+        return ret;
+    }
+
+    // never send the media before the server accepts the publish,
+    // the other status(e.g. onFCPublish) is ignored until the error level.
+    while (true) {
+        std::shared_ptr<RtmpOnStatusCallPacket> pkt_status;
+        if ((ret = protocol->expect_packet<RtmpOnStatusCallPacket>(pkt_status))
+                != error_success) {
+            tmss_error("expect publish onStatus failed. stream={}, ret={}", stream, ret);
+            return ret;
+        }
+        if (pkt_status->on_status_str == StatusCodePublishStart) {
+            break;
+        }
+
+        std::shared_ptr<Amf0Any> level = pkt_status->data->get_property(StatusLevel);
+        if (level && level->is_string() && level->to_str() == StatusLevelError) {
+            ret = error_rtmp_publish_rejected;
+            tmss_error("publish rejected. stream={}, code={}, ret={}",
+                stream, pkt_status->on_status_str, ret);
+            return ret;
+        }
+        tmss_info("ignore the publish onStatus. code={}", pkt_status->on_status_str);
+    }
+
     return ret;
 }
 
@@ -26,6 +26,8 @@ class RtmpClient : public IClient {
     virtual ~RtmpClient() = default;
 
  public:
+    virtual int init(std::shared_ptr<IClientConn> conn) override;
+    virtual int reset_conn(std::shared_ptr<IClientConn> conn) override;
     virtual int cycle() override;
     virtual int request(const std::string& origin_host,
         const std::string& origin_path,
@@ -36,6 +38,25 @@ class RtmpClient : public IClient {
 
     int write_data(const char* buf, int size) override;
 
+    /**
+     * the protocol stack, to recv the rtmp messages directly.
+     */
+    virtual std::shared_ptr<RtmpProtocolHandler> get_protocol();
+
+    /**
+     * push stream to the origin, use FMLE publish workflow.
+     * @param origin_port the port in tcUrl, the connected port of origin.
+     */
+    virtual int request_publish(const std::string& origin_host,
+        const std::string& origin_port,
+        const std::string& origin_path,
+        const std::string& stream,
+        const std::string& param);
+    /**
+     * send the audio/video/data message to the published stream, without copy.
+     */
+    virtual int send_message(std::shared_ptr<RtmpMessage> msg);
+
  private:
     virtual int connect(const std::string &origin_host,
             const std::string &request_url,
@@ -82,6 +103,8 @@ class RtmpClient : public IClient {
 
  private:
      std::shared_ptr<RtmpProtocolHandler> protocol;
+     // the stream id of publish
+     int publish_stream_id;
 };
 
 }  // namespace tmss
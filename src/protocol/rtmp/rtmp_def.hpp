@@ -171,6 +171,118 @@ enum CodecFlvTag {
     CodecFlvTagScript = 18,
 };
 
+/**
+* E.4.3.1 VIDEODATA
+* Frame Type UB [4]
+*/
+enum CodecVideoAVCFrame {
+    // set to the zero to reserved, for array map.
+    CodecVideoAVCFrameReserved = 0,
+    CodecVideoAVCFrameReserved1 = 6,
+
+    CodecVideoAVCFrameKeyFrame = 1,
+    CodecVideoAVCFrameInterFrame = 2,
+    CodecVideoAVCFrameDisposableInterFrame = 3,
+    CodecVideoAVCFrameGeneratedKeyFrame = 4,
+    CodecVideoAVCFrameVideoInfoFrame = 5,
+};
+
+/**
+* E.4.3.1 VIDEODATA
+* CodecID UB [4]
+*/
+enum CodecVideo {
+    // set to the zero to reserved, for array map.
+    CodecVideoReserved = 0,
+
+    CodecVideoSorensonH263 = 2,
+    CodecVideoScreenVideo = 3,
+    CodecVideoOn2VP6 = 4,
+    CodecVideoOn2VP6WithAlphaChannel = 5,
+    CodecVideoScreenVideoVersion2 = 6,
+    CodecVideoAVC = 7,
+    // the legacy extension for hevc and av1, before enhanced rtmp
+    CodecVideoHEVC = 12,
+    CodecVideoAV1 = 13,
+};
+
+/**
+* E.4.3.1 VIDEODATA
+* AVCPacketType IF CodecID == 7 UI8
+*/
+enum CodecVideoAVCType {
+    // set to the max value to reserved, for array map.
+    CodecVideoAVCTypeReserved = 3,
+
+    CodecVideoAVCTypeSequenceHeader = 0,
+    CodecVideoAVCTypeNALU = 1,
+    CodecVideoAVCTypeSequenceHeaderEOF = 2,
+};
+
+/**
+* Enhanced RTMP, ExVideoTagHeader
+* IsExHeader UB [1], FrameType UB [3], PacketType UB [4], then FourCC UI32
+*/
+#define TMSS_FLV_VIDEO_EX_HEADER 0x80
+
+enum CodecVideoPacketType {
+    CodecVideoPacketTypeSequenceStart = 0,
+    CodecVideoPacketTypeCodedFrames = 1,
+    CodecVideoPacketTypeSequenceEnd = 2,
+    // the composition time is 0, not present
+    CodecVideoPacketTypeCodedFramesX = 3,
+    CodecVideoPacketTypeMetadata = 4,
+    CodecVideoPacketTypeMPEG2TSSequenceStart = 5,
+};
+
+#define TMSS_FOURCC(a, b, c, d) ((static_cast<uint32_t>(a) << 24) \
+    | (static_cast<uint32_t>(b) << 16) | (static_cast<uint32_t>(c) << 8) \
+    | static_cast<uint32_t>(d))
+#define TMSS_FOURCC_AVC TMSS_FOURCC('a', 'v', 'c', '1')
+#define TMSS_FOURCC_HEVC TMSS_FOURCC('h', 'v', 'c', '1')
+#define TMSS_FOURCC_AV1 TMSS_FOURCC('a', 'v', '0', '1')
+
+/**
+* E.4.2.1 AUDIODATA
+* SoundFormat UB [4]
+*/
+enum CodecAudio {
+    CodecAudioLinearPCMPlatformEndian = 0,
+    CodecAudioADPCM = 1,
+    CodecAudioMP3 = 2,
+    CodecAudioLinearPCMLittleEndian = 3,
+    CodecAudioNellymoser16kHzMono = 4,
+    CodecAudioNellymoser8kHzMono = 5,
+    CodecAudioNellymoser = 6,
+    CodecAudioReservedG711AlawLogarithmicPCM = 7,
+    CodecAudioReservedG711MuLawLogarithmicPCM = 8,
+    CodecAudioReserved = 9,
+    CodecAudioAAC = 10,
+    CodecAudioSpeex = 11,
+    CodecAudioReserved1 = 12,
+    CodecAudioReservedMP3_8kHz = 14,
+    CodecAudioReservedDeviceSpecificSound = 15,
+};
+
+/**
+* E.4.2.1 AUDIODATA
+* AACPacketType IF SoundFormat == 10 UI8
+*/
+enum CodecAudioType {
+    // set to the max value to reserved, for array map.
+    CodecAudioTypeReserved = 2,
+
+    CodecAudioTypeSequenceHeader = 0,
+    CodecAudioTypeRawData = 1,
+};
+
+// the flv header, 9 bytes header and 4 bytes previous tag size 0.
+#define TMSS_FLV_HEADER_SIZE 13
+// the flv tag header, type, size, timestamp and stream id.
+#define TMSS_FLV_TAG_HEADER_SIZE 11
+// the previous tag size after each flv tag.
+#define TMSS_FLV_PREVIOUS_TAG_SIZE 4
+
 /**
  * 6.1.2. Chunk Message Header
  * There are four different formats for the chunk message header,
@@ -10,10 +10,12 @@
 
 
 #include <protocol/rtmp/rtmp_message.hpp>
+#include <algorithm>
 #include <utility>
 #include <defs/err.hpp>
 #include <log/log.hpp>
 #include <util/util.hpp>
+#include <io/io_buffer.hpp>
 #include <defs/tmss_def.hpp>
 #include <rtmp_def.hpp>
 
@@ -124,17 +126,24 @@ void MessageHeader::initialize_video(int size, uint32_t time, int stream) {
 RtmpMessage::RtmpMessage() {
     payload = NULL;
     size = 0;
+    own_payload = true;
 }
 
 RtmpMessage::~RtmpMessage() {
-    freepa(payload);
+    if (own_payload) {
+        freepa(payload);
+    }
 }
 
 
 void RtmpMessage::create_payload(int size) {
-    freepa(payload);
+    if (own_payload) {
+        freepa(payload);
+    }
+    parent.reset();
 
     payload = new char[size];
+    own_payload = true;
     tmss_info("create payload for RTMP message. size=%d", size);
 }
 
@@ -170,9 +179,125 @@ int RtmpMessage::create(char type, int64_t timestamp, char * payload, int size)
 }
 
 void RtmpMessage::set_payload(char* buf) {
-    freepa(payload);
+    if (own_payload && payload != buf) {
+        freepa(payload);
+    }
+    parent.reset();
 
     payload = buf;
+    own_payload = false;
+}
+
+void RtmpMessage::create_slice(std::shared_ptr<RtmpMessage> parent, char* payload, int size) {
+    if (own_payload) {
+        freepa(this->payload);
+    }
+
+    this->parent = parent;
+    this->payload = payload;
+    this->size = size;
+    own_payload = false;
+}
+
+/**
+ * aggregate message payload is a list of flv tags:
+ *      tag type, 1byte
+ *      data size, 3bytes
+ *      timestamp, 3bytes, and timestamp extended 1byte
+ *      stream id, 3bytes
+ *      data, data size bytes
+ *      previous tag size, 4bytes
+ */
+int rtmp_aggregate_split(std::shared_ptr<RtmpMessage> msg,
+        std::vector<std::shared_ptr<RtmpMessage>>& msgs) {
+    int ret = error_success;
+
+    char* p = msg->payload;
+    char* end = msg->payload + msg->size;
+
+    bool first = true;
+    int64_t base_time = 0;
+    while (p < end) {
+        if (end - p < RTMP_AGGREGATE_TAG_HEADER_SIZE) {
+            ret = error_rtmp_message_decode;
+            tmss_error("aggregate tag header not enough. left={}, ret={}", end - p, ret);
+            return ret;
+        }
+
+        BufferCursor h(p, RTMP_AGGREGATE_TAG_HEADER_SIZE);
+        int8_t type = h.read_1byte();
+        int32_t data_size = h.read_3bytes();
+        uint32_t time = h.read_3bytes();
+        time |= static_cast<uint32_t>(static_cast<uint8_t>(h.read_1byte())) << 24;
+        int32_t stream_id = h.read_3bytes();
+        p += RTMP_AGGREGATE_TAG_HEADER_SIZE;
+
+        if (end - p < data_size) {
+            ret = error_rtmp_message_decode;
+            tmss_error("aggregate tag data not enough. size={}, left={}, ret={}",
+                data_size, end - p, ret);
+            return ret;
+        }
+
+        // the timestamp of tags is relative to the first tag.
+        if (first) {
+            base_time = time;
+            first = false;
+        }
+
+        // only the media and data are in aggregate, see: flv tag
+        if (type != RTMP_MSG_AudioMessage && type != RTMP_MSG_VideoMessage
+                && type != RTMP_MSG_AMF0DataMessage && type != RTMP_MSG_AMF3DataMessage) {
+            tmss_warn("drop aggregate sub message, type={}, size={}", type, data_size);
+            p += data_size;
+            p += std::min(static_cast<int>(end - p), RTMP_AGGREGATE_TAG_TAIL_SIZE);
+            continue;
+        }
+
+        std::shared_ptr<RtmpMessage> sub = std::make_shared<RtmpMessage>();
+        sub->header = msg->header;
+        sub->header.message_type = type;
+        sub->header.payload_length = data_size;
+        sub->header.timestamp = msg->header.timestamp + (time - base_time);
+        sub->header.timestamp_delta = 0;
+        sub->header.stream_id = stream_id ? stream_id : msg->header.stream_id;
+        if (type == RTMP_MSG_AudioMessage) {
+            sub->header.perfer_cid = RTMP_CID_Audio;
+        } else if (type == RTMP_MSG_VideoMessage) {
+            sub->header.perfer_cid = RTMP_CID_Video;
+        }
+        sub->create_slice(msg, p, data_size);
+        msgs.push_back(sub);
+
+        p += data_size;
+
+        // previous tag size, some encoder never write it for the last tag.
+        if (end - p >= RTMP_AGGREGATE_TAG_TAIL_SIZE) {
+            p += RTMP_AGGREGATE_TAG_TAIL_SIZE;
+        } else {
+            p = end;
+        }
+    }
+
+    tmss_info("split aggregate message, size={}, time={}, count={}",
+        msg->size, msg->header.timestamp, msgs.size());
+
+    return ret;
+}
+
+void rtmp_aggregate_tag(std::shared_ptr<RtmpMessage> sub, char* header, char* tail) {
+    uint32_t time = static_cast<uint32_t>(sub->header.timestamp);
+    int32_t data_size = sub->size;
+
+    BufferCursor h(header, RTMP_AGGREGATE_TAG_HEADER_SIZE);
+    h.write_1byte(sub->header.message_type);
+    h.write_3bytes(data_size);
+    h.write_3bytes(time);
+    h.write_1byte(time >> 24);
+    // stream id, always 0 in tag.
+    h.write_3bytes(0);
+
+    store_be32(tail, RTMP_AGGREGATE_TAG_HEADER_SIZE + data_size);
 }
 
 RtmpChunkStream::RtmpChunkStream(int _cid) {
@@ -12,6 +12,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 #include "util/util.hpp"
 #include <defs/err.hpp>
 
@@ -145,9 +146,43 @@ class RtmpMessage {
 
     //  virtual int reset_paload(const char *input, int size);
 
+    /**
+     * use the external buffer as payload, the message never free it.
+     */
     virtual void set_payload(char* buf);
+
+    /**
+     * make the message a slice of parent payload, without copy.
+     * the parent is kept alive by the slice.
+     */
+    virtual void create_slice(std::shared_ptr<RtmpMessage> parent, char* payload, int size);
+
+ private:
+    // whether the payload is alloced by message.
+    bool own_payload;
+    // the message which holds the payload of slice.
+    std::shared_ptr<RtmpMessage> parent;
 };
 
+/**
+ * split the aggregate message(type 22) in place, to audio/video/data messages.
+ * the sub messages share the payload of aggregate, and the timestamp
+ * is rebased to the timestamp of aggregate.
+ */
+extern int rtmp_aggregate_split(std::shared_ptr<RtmpMessage> msg,
+    std::vector<std::shared_ptr<RtmpMessage>>& msgs);
+
+#define RTMP_AGGREGATE_TAG_HEADER_SIZE  11
+#define RTMP_AGGREGATE_TAG_TAIL_SIZE    4
+
+/**
+ * write the tag header and previous tag size of sub message in aggregate,
+ * the sub message payload is sent between them, never copy it.
+ * @param header, RTMP_AGGREGATE_TAG_HEADER_SIZE bytes.
+ * @param tail, RTMP_AGGREGATE_TAG_TAIL_SIZE bytes.
+ */
+extern void rtmp_aggregate_tag(std::shared_ptr<RtmpMessage> sub, char* header, char* tail);
+
 /**
  * incoming chunk stream maybe interlaced,
  * use the chunk stream to cache the input RTMP chunk streams.
@@ -14,6 +14,7 @@
 
 #include <defs/err.hpp>
 #include <log/log.hpp>
+#include <util/timer.hpp>
 #include <util/util.hpp>
 
 namespace tmss {
@@ -161,19 +162,22 @@ int RtmpPacket::encode(int& size, char*& payload) {
     int wanted_size = get_size();
     char* wanted_payload = NULL;
 
-    if (size > 0) {
+    if (wanted_size > 0) {
         wanted_payload = new char[wanted_size];
     }
 
     Buffer stream(wanted_payload, wanted_size);
     if ((ret = encode_packet(&stream)) != error_success) {
         tmss_error("encode the packet failed. ret={}", ret);
+        delete[] wanted_payload;
         return ret;
     }
 
     size = wanted_size;
     payload = wanted_payload;
     tmss_info("encode the packet success. size={}", size);
+
+    return ret;
 }
 
 int RtmpPacket::decode(Buffer* stream) {
@@ -187,6 +191,17 @@ int RtmpPacket::decode(Buffer* stream) {
     return ret;
 }
 
+int RtmpPacket::decode_view(Amf0View* view) {
+    int ret = error_success;
+
+    assert(view != NULL);
+
+    ret = error_rtmp_packet_invalid;
+    tmss_error("current packet is not support to decode by view. ret={}", ret);
+
+    return ret;
+}
+
 int RtmpPacket::get_prefer_cid() {
     return 0;
 }
@@ -210,6 +225,57 @@ int RtmpPacket::encode_packet(Buffer* stream) {
     return ret;
 }
 
+/**
+ * read the command name and transaction id, the first two values of command.
+ */
+static int view_read_command(Amf0View* view, std::string& command_name, double& transaction_id) {
+    int ret = error_success;
+
+    int index = view->at(0);
+    if (!view->is_string(index)) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view decode command_name failed. ret={}", ret);
+        return ret;
+    }
+    command_name = view->node(index).str.to_str();
+
+    index = view->at(1);
+    if (!view->is_number(index)) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view decode transaction_id failed. command_name={}, ret={}",
+            command_name.c_str(), ret);
+        return ret;
+    }
+    transaction_id = view->node(index).number;
+
+    return ret;
+}
+
+static int view_read_null(Amf0View* view, int index) {
+    int ret = error_success;
+
+    if (view->node(view->at(index)).marker != RTMP_AMF0_Null) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view decode command_object failed. ret={}", ret);
+        return ret;
+    }
+
+    return ret;
+}
+
+static int view_read_string(Amf0View* view, int index, std::string& value) {
+    int ret = error_success;
+
+    if (!view->is_string(view->at(index))) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view decode string failed. index={}, ret={}", index, ret);
+        return ret;
+    }
+    value = view->node(view->at(index)).str.to_str();
+
+    return ret;
+}
+
 RtmpConnectAppPacket::RtmpConnectAppPacket() {
     command_name = RTMP_AMF0_COMMAND_CONNECT;
     transaction_id = 1;
@@ -285,6 +351,84 @@ int RtmpConnectAppPacket::decode(Buffer* stream) {
     return ret;
 }
 
+int RtmpConnectAppPacket::decode_view(Amf0View* view) {
+    int ret = error_success;
+
+    if ((ret = view_read_command(view, command_name, transaction_id)) != error_success) {
+        tmss_error("amf0 view decode connect command failed. ret={}", ret);
+        return ret;
+    }
+    if (command_name != RTMP_AMF0_COMMAND_CONNECT) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error(
+                "amf0 view decode connect command_name failed.command_name={}, ret={}",
+                command_name.c_str(), ret);
+        return ret;
+    }
+
+    // some client donot send id=1.0, so we only warn user if not match.
+    if (transaction_id != 1.0) {
+        tmss_warn("amf0 view decode connect transaction_id not match, actual={}",
+                transaction_id);
+    }
+
+    int object = view->at(2);
+    if (!view->is_object(object)) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view decode connect command_object failed. ret={}", ret);
+        return ret;
+    }
+
+    // only copy what the server need, keep others in raw bytes.
+    Amf0StrView value;
+    if (view->get_string(object, "tcUrl", value)) {
+        tc_url = value.to_str();
+    }
+    if (view->get_string(object, "app", value)) {
+        app = value.to_str();
+    }
+    command_object->clear();
+    raw_command_object.assign(view->raw(object), view->node(object).length);
+
+    // the args maybe any amf0, we should drop if not object.
+    int any = view->at(3);
+    if (any >= 0) {
+        if (!view->is_object(any)) {
+            tmss_warn("drop the args, see: '4.1.1. connect', marker={}",
+                    view->node(any).marker);
+        } else {
+            raw_args.assign(view->raw(any), view->node(any).length);
+        }
+    }
+
+    tmss_info("amf0 view decode connect packet success");
+
+    return ret;
+}
+
+int RtmpConnectAppPacket::materialize() {
+    int ret = error_success;
+
+    if (!raw_command_object.empty()) {
+        if ((ret = amf0_view_read_object(raw_command_object.data(),
+                raw_command_object.size(), command_object)) != error_success) {
+            tmss_error("build connect command_object failed. ret={}", ret);
+            return ret;
+        }
+        raw_command_object.clear();
+    }
+
+    if (!raw_args.empty()) {
+        if ((ret = amf0_view_read_object(raw_args.data(), raw_args.size(), args)) != error_success) {
+            tmss_error("build connect args failed. ret={}", ret);
+            return ret;
+        }
+        raw_args.clear();
+    }
+
+    return ret;
+}
+
 int RtmpConnectAppPacket::get_prefer_cid() {
     return RTMP_CID_OverConnection;
 }
@@ -293,6 +437,18 @@ int RtmpConnectAppPacket::get_message_type() {
     return RTMP_MSG_AMF0CommandMessage;
 }
 
+int RtmpConnectAppPacket::encode(int& size, char*& payload) {
+    int ret = error_success;
+
+    // the owning object is only built when re-encode.
+    if ((ret = materialize()) != error_success) {
+        tmss_error("connect packet materialize failed. ret={}", ret);
+        return ret;
+    }
+
+    return RtmpPacket::encode(size, payload);
+}
+
 int RtmpConnectAppPacket::get_size() {
     int size = 0;
 
@@ -584,6 +740,64 @@ int RtmpPlayPacket::decode(Buffer* stream) {
     return ret;
 }
 
+int RtmpPlayPacket::decode_view(Amf0View* view) {
+    int ret = error_success;
+
+    if ((ret = view_read_command(view, command_name, transaction_id)) != error_success) {
+        tmss_error("amf0 view decode play command failed. ret={}", ret);
+        return ret;
+    }
+    if (command_name != RTMP_AMF0_COMMAND_PLAY) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view decode play command_name failed. command_name={}, ret={}",
+                command_name.c_str(), ret);
+        return ret;
+    }
+
+    if ((ret = view_read_null(view, 2)) != error_success) {
+        return ret;
+    }
+
+    if ((ret = view_read_string(view, 3, stream_name)) != error_success) {
+        tmss_error("amf0 view decode play stream_name failed. ret={}", ret);
+        return ret;
+    }
+
+    if (view->count() > 4) {
+        if (!view->is_number(view->at(4))) {
+            ret = error_rtmp_amf0_decode;
+            tmss_error("amf0 view decode play start failed. ret={}", ret);
+            return ret;
+        }
+        start = view->node(view->at(4)).number;
+    }
+    if (view->count() > 5) {
+        if (!view->is_number(view->at(5))) {
+            ret = error_rtmp_amf0_decode;
+            tmss_error("amf0 view decode play duration failed. ret={}", ret);
+            return ret;
+        }
+        duration = view->node(view->at(5)).number;
+    }
+
+    if (view->count() > 6) {
+        // check if the value is bool or number
+        const Amf0ViewNode& reset_value = view->node(view->at(6));
+        if (reset_value.marker == RTMP_AMF0_Boolean || reset_value.marker == RTMP_AMF0_Number) {
+            reset = (reset_value.number != 0);
+        } else {
+            ret = error_rtmp_amf0_decode;
+            tmss_error("amf0 invalid type={}, requires number or bool, ret={}",
+                    reset_value.marker, ret);
+            return ret;
+        }
+    }
+
+    tmss_info("amf0 view decode play packet success");
+
+    return ret;
+}
+
 int RtmpPlayPacket::get_prefer_cid() {
     return RTMP_CID_OverStream;
 }
@@ -942,6 +1156,29 @@ int RtmpCreateStreamPacket::decode(Buffer* stream) {
     return ret;
 }
 
+int RtmpCreateStreamPacket::decode_view(Amf0View* view) {
+    int ret = error_success;
+
+    if ((ret = view_read_command(view, command_name, transaction_id)) != error_success) {
+        tmss_error("amf0 view decode createBuffer command failed. ret={}", ret);
+        return ret;
+    }
+    if (command_name != RTMP_AMF0_COMMAND_CREATE_STREAM) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view decode createBuffer command_name failed. command_name={}, ret={}",
+                command_name.c_str(), ret);
+        return ret;
+    }
+
+    if ((ret = view_read_null(view, 2)) != error_success) {
+        return ret;
+    }
+
+    tmss_info("amf0 view decode createBuffer packet success");
+
+    return ret;
+}
+
 int RtmpCreateStreamPacket::get_prefer_cid() {
     return RTMP_CID_OverConnection;
 }
@@ -1114,6 +1351,36 @@ int RtmpFMLEStartPacket::decode(Buffer* stream) {
     return ret;
 }
 
+int RtmpFMLEStartPacket::decode_view(Amf0View* view) {
+    int ret = error_success;
+
+    if ((ret = view_read_command(view, command_name, transaction_id)) != error_success) {
+        tmss_error("amf0 view decode FMLE start command failed. ret={}", ret);
+        return ret;
+    }
+    if (command_name != RTMP_AMF0_COMMAND_RELEASE_STREAM
+            && command_name != RTMP_AMF0_COMMAND_FC_PUBLISH
+            && command_name != RTMP_AMF0_COMMAND_UNPUBLISH) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view decode FMLE start command_name failed. command_name={}, ret={}",
+                command_name.c_str(), ret);
+        return ret;
+    }
+
+    if ((ret = view_read_null(view, 2)) != error_success) {
+        return ret;
+    }
+
+    if ((ret = view_read_string(view, 3, stream_name)) != error_success) {
+        tmss_error("amf0 view decode FMLE start stream_name failed. ret={}", ret);
+        return ret;
+    }
+
+    tmss_info("amf0 view decode FMLE start packet success");
+
+    return ret;
+}
+
 int RtmpFMLEStartPacket::get_prefer_cid() {
     return RTMP_CID_OverConnection;
 }
@@ -1317,6 +1584,39 @@ int RtmpPublishPacket::decode(Buffer* stream) {
     return ret;
 }
 
+int RtmpPublishPacket::decode_view(Amf0View* view) {
+    int ret = error_success;
+
+    if ((ret = view_read_command(view, command_name, transaction_id)) != error_success) {
+        tmss_error("amf0 view decode publish command failed. ret={}", ret);
+        return ret;
+    }
+    if (command_name != RTMP_AMF0_COMMAND_PUBLISH) {
+        ret = error_rtmp_amf0_decode;
+        tmss_error("amf0 view decode publish command_name failed. command_name={}, ret={}",
+                command_name.c_str(), ret);
+        return ret;
+    }
+
+    if ((ret = view_read_null(view, 2)) != error_success) {
+        return ret;
+    }
+
+    if ((ret = view_read_string(view, 3, stream_name)) != error_success) {
+        tmss_error("amf0 view decode publish stream_name failed. ret={}", ret);
+        return ret;
+    }
+
+    if (view->count() > 4 && (ret = view_read_string(view, 4, type)) != error_success) {
+        tmss_error("amf0 view decode publish type failed. ret={}", ret);
+        return ret;
+    }
+
+    tmss_info("amf0 view decode publish packet success");
+
+    return ret;
+}
+
 int RtmpPublishPacket::get_prefer_cid() {
     return RTMP_CID_OverStream;
 }
@@ -1466,8 +1766,8 @@ int RtmpOnStatusCallPacket::decode(Buffer* stream) {
         return ret;
     }
 
-    std::shared_ptr<Amf0Any> status_content = data->get_property("code");
-    if (status_content->is_string()) {
+    std::shared_ptr<Amf0Any> status_content = data->get_property(StatusCode);
+    if (status_content && status_content->is_string()) {
         on_status_str = status_content->to_str();
     }
 
@@ -2123,6 +2423,14 @@ AckWindowSize::AckWindowSize() {
 RtmpProtocolHandler::RtmpProtocolHandler(std::shared_ptr<IConn> io, bool fix_timestamp) {
     this->conn = io;
     this->fix_rtmp_timestamp = fix_timestamp;
+    in_chunk_size = TMSS_CONSTS_RTMP_PROTOCOL_CHUNK_SIZE;
+    out_chunk_size = TMSS_CONSTS_RTMP_PROTOCOL_CHUNK_SIZE;
+    in_buffer_length = 0;
+    auto_response_when_recv = true;
+    out_aggregate_size = 0;
+    out_aggregate_delay_ms = 0;
+    out_aggregate_bytes = 0;
+    out_aggregate_start_us = 0;
 
     for (int cid = 0; cid < TMSS_PERF_CHUNK_STREAM_CACHE; cid++) {
         std::shared_ptr<RtmpChunkStream> cs = std::make_shared<RtmpChunkStream>(cid);
@@ -2137,6 +2445,10 @@ RtmpProtocolHandler::RtmpProtocolHandler(std::shared_ptr<IConn> io, bool fix_tim
 RtmpProtocolHandler::~RtmpProtocolHandler() {
 }
 
+void RtmpProtocolHandler::set_io_buffer(std::shared_ptr<IOBuffer> buffer) {
+    io_buffer = buffer;
+}
+
 int RtmpProtocolHandler::send_packet(std::shared_ptr<RtmpPacket> pkt, int streamid) {
     int ret = error_success;
 
@@ -2162,36 +2474,14 @@ int RtmpProtocolHandler::send_packet(std::shared_ptr<RtmpPacket> pkt, int stream
     header.stream_id = streamid;
     header.perfer_cid = pkt->get_prefer_cid();
 
-    // we directly send out the packet,
-    // use very simple algorithm, not very fast,
-    // but it's ok.
-    char* p = payload;
-    char* end = p + size;
-    char c0c3[TMSS_CONSTS_RTMP_MAX_FMT0_HEADER_SIZE];
-    while (p < end) {
-        int nbh = 0;
-        if (p == payload) {
-            nbh = chunk_header_c0(header.perfer_cid, header.timestamp,
-                    header.payload_length, header.message_type, header.stream_id, c0c3,
-                    sizeof(c0c3));
-        } else {
-            nbh = chunk_header_c3(header.perfer_cid, header.timestamp, c0c3,
-                    sizeof(c0c3));
-        }
-
-        iovec iovs[2];
-        iovs[0].iov_base = c0c3;
-        iovs[0].iov_len = nbh;
-
-        int payload_size = Min(end - p, out_chunk_size);
-        iovs[1].iov_base = p;
-        iovs[1].iov_len = payload_size;
-        p += payload_size;
-
-        if ((ret = conn->writev(iovs, 2)) != error_success) {
-            tmss_error("send packet with writev failed. ret={}", ret);
-            return ret;
-        }
+    iovec seg;
+    seg.iov_base = payload;
+    seg.iov_len = size;
+    ret = send_chunks(header, &seg, 1);
+    freepa(payload);
+    if (ret != error_success) {
+        tmss_error("send packet failed. ret={}", ret);
+        return ret;
     }
 
     // ignore raw bytes oriented RTMP message.
@@ -2294,6 +2584,20 @@ int RtmpProtocolHandler::recv_message(char* buf, int size) {
     int ret = error_success;
 
     while (true) {
+        // consume the sub messages of aggregate first.
+        if (!aggregate_msgs.empty()) {
+            std::shared_ptr<RtmpMessage> sub = aggregate_msgs.front();
+            if (sub->size > size) {
+                ret = error_buffer_not_enough;
+                tmss_info("buffer may be too small. buf_size={},payload_length={},ret={}",
+                    size, sub->size, ret);
+                return ret;
+            }
+            aggregate_msgs.pop_front();
+            memcpy(buf, sub->payload, sub->size);
+            return sub->size;
+        }
+
         std::shared_ptr<RtmpMessage> msg;
 
         if ((ret = recv_interlaced_message(msg, buf, size)) != error_success) {
@@ -2327,6 +2631,24 @@ int RtmpProtocolHandler::recv_message(char* buf, int size) {
                 msg->header.perfer_cid, msg->header.message_type,
                 msg->header.payload_length, msg->header.timestamp);
 
+        // the payload is in buf which is reused by sub messages,
+        // so hold the aggregate in its own payload before split.
+        if (msg->header.is_aggregate()) {
+            std::shared_ptr<RtmpMessage> aggregate = std::make_shared<RtmpMessage>();
+            aggregate->header = msg->header;
+            aggregate->create_payload(msg->size);
+            memcpy(aggregate->payload, msg->payload, msg->size);
+            aggregate->size = msg->size;
+
+            std::vector<std::shared_ptr<RtmpMessage>> msgs;
+            if ((ret = rtmp_aggregate_split(aggregate, msgs)) != error_success) {
+                tmss_error("split aggregate message failed. ret={}", ret);
+                return ret;
+            }
+            aggregate_msgs.insert(aggregate_msgs.end(), msgs.begin(), msgs.end());
+            continue;
+        }
+
         ret = msg->size;
         break;
     }
@@ -2338,6 +2660,218 @@ int RtmpProtocolHandler::send_message(const char* buf, int size) {
     return ret;
 }
 
+int RtmpProtocolHandler::recv_rtmp_message(std::shared_ptr<RtmpMessage>& msg) {
+    int ret = error_success;
+
+    while (true) {
+        // consume the sub messages of aggregate first.
+        if (!aggregate_msgs.empty()) {
+            msg = aggregate_msgs.front();
+            aggregate_msgs.pop_front();
+            return ret;
+        }
+
+        std::shared_ptr<RtmpMessage> entire;
+        if ((ret = recv_interlaced_message(entire)) != error_success) {
+            if (ret != error_socket_timeout) {
+                tmss_error("recv interlaced message failed. ret={}", ret);
+            }
+            return ret;
+        }
+
+        if (!entire) {
+            continue;
+        }
+
+        if (entire->size <= 0 || entire->header.payload_length <= 0) {
+            tmss_info("ignore empty message(type={}, size={}, time={}, sid={}).",
+                    entire->header.message_type, entire->header.payload_length,
+                    entire->header.timestamp, entire->header.stream_id);
+            continue;
+        }
+
+        std::shared_ptr<RtmpPacket> pkt;
+        if ((ret = on_recv_message(entire, pkt)) != error_success) {
+            tmss_error("hook the received msg failed. ret={}", ret);
+            return ret;
+        }
+
+        if (entire->header.is_aggregate()) {
+            std::vector<std::shared_ptr<RtmpMessage>> msgs;
+            if ((ret = rtmp_aggregate_split(entire, msgs)) != error_success) {
+                tmss_error("split aggregate message failed. ret={}", ret);
+                return ret;
+            }
+            aggregate_msgs.insert(aggregate_msgs.end(), msgs.begin(), msgs.end());
+            continue;
+        }
+
+        if (entire->header.is_audio() || entire->header.is_video()
+                || entire->header.is_amf0_data() || entire->header.is_amf3_data()) {
+            msg = entire;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+int RtmpProtocolHandler::send_rtmp_message(std::shared_ptr<RtmpMessage> msg, int streamid) {
+    int ret = error_success;
+
+    if (out_aggregate_size > 0 && (msg->header.is_audio() || msg->header.is_video())) {
+        if (out_aggregate_msgs.empty()) {
+            out_aggregate_start_us = get_cache_time();
+        }
+        out_aggregate_msgs.push_back(msg);
+        out_aggregate_bytes += RTMP_AGGREGATE_TAG_HEADER_SIZE + msg->size
+            + RTMP_AGGREGATE_TAG_TAIL_SIZE;
+
+        int64_t delay_ms = msg->header.timestamp - out_aggregate_msgs[0]->header.timestamp;
+        int64_t wait_ms = (get_cache_time() - out_aggregate_start_us) / 1000;
+        if (out_aggregate_bytes < out_aggregate_size
+                && delay_ms < out_aggregate_delay_ms && wait_ms < out_aggregate_delay_ms) {
+            return ret;
+        }
+        return flush_aggregate(streamid);
+    }
+
+    // keep the order of messages.
+    if ((ret = flush_aggregate(streamid)) != error_success) {
+        return ret;
+    }
+
+    MessageHeader header = msg->header;
+    header.payload_length = msg->size;
+    header.stream_id = streamid;
+
+    iovec seg;
+    seg.iov_base = msg->payload;
+    seg.iov_len = msg->size;
+    if ((ret = send_chunks(header, &seg, 1)) != error_success) {
+        tmss_error("send message failed. type={}, size={}, ret={}",
+            header.message_type, msg->size, ret);
+        return ret;
+    }
+
+    return ret;
+}
+
+void RtmpProtocolHandler::set_aggregate_output(int max_size, int max_delay_ms) {
+    out_aggregate_size = max_size;
+    out_aggregate_delay_ms = max_delay_ms;
+}
+
+int RtmpProtocolHandler::flush_aggregate(int streamid) {
+    int ret = error_success;
+
+    if (out_aggregate_msgs.empty()) {
+        return ret;
+    }
+
+    int nb_msgs = out_aggregate_msgs.size();
+    out_aggregate_tags.resize(nb_msgs * (RTMP_AGGREGATE_TAG_HEADER_SIZE
+        + RTMP_AGGREGATE_TAG_TAIL_SIZE));
+    out_segs.resize(nb_msgs * 3);
+
+    // tag header, payload of message, previous tag size.
+    char* tags = out_aggregate_tags.data();
+    for (int i = 0; i < nb_msgs; i++) {
+        std::shared_ptr<RtmpMessage>& sub = out_aggregate_msgs[i];
+        char* tag_header = tags;
+        char* tag_tail = tags + RTMP_AGGREGATE_TAG_HEADER_SIZE;
+        rtmp_aggregate_tag(sub, tag_header, tag_tail);
+        tags += RTMP_AGGREGATE_TAG_HEADER_SIZE + RTMP_AGGREGATE_TAG_TAIL_SIZE;
+
+        out_segs[i * 3].iov_base = tag_header;
+        out_segs[i * 3].iov_len = RTMP_AGGREGATE_TAG_HEADER_SIZE;
+        out_segs[i * 3 + 1].iov_base = sub->payload;
+        out_segs[i * 3 + 1].iov_len = sub->size;
+        out_segs[i * 3 + 2].iov_base = tag_tail;
+        out_segs[i * 3 + 2].iov_len = RTMP_AGGREGATE_TAG_TAIL_SIZE;
+    }
+
+    MessageHeader header = out_aggregate_msgs[0]->header;
+    header.message_type = RTMP_MSG_AggregateMessage;
+    header.payload_length = out_aggregate_bytes;
+    header.stream_id = streamid;
+
+    // the segments point to out_aggregate_tags, never resize it when sending.
+    std::vector<iovec> segs;
+    segs.swap(out_segs);
+    ret = send_chunks(header, segs.data(), segs.size());
+    segs.swap(out_segs);
+
+    out_aggregate_msgs.clear();
+    out_aggregate_bytes = 0;
+
+    if (ret != error_success) {
+        tmss_error("send aggregate message failed. count={}, ret={}", nb_msgs, ret);
+        return ret;
+    }
+
+    return ret;
+}
+
+int RtmpProtocolHandler::send_chunks(MessageHeader& header, const iovec* segs, int nb_segs) {
+    int ret = error_success;
+
+    // the c0c3 cache is reused by each chunk, for writev is done before next.
+    char c0c3[TMSS_CONSTS_RTMP_MAX_FMT0_HEADER_SIZE];
+
+    int total = header.payload_length;
+    int sent = 0;
+    int seg = 0;
+    int seg_pos = 0;
+    while (sent < total && seg < nb_segs) {
+        int nbh = 0;
+        if (sent == 0) {
+            nbh = chunk_header_c0(header.perfer_cid, header.timestamp,
+                    header.payload_length, header.message_type, header.stream_id, c0c3,
+                    sizeof(c0c3));
+        } else {
+            nbh = chunk_header_c3(header.perfer_cid, header.timestamp, c0c3,
+                    sizeof(c0c3));
+        }
+
+        out_chunk_iovs.clear();
+        iovec iov;
+        iov.iov_base = c0c3;
+        iov.iov_len = nbh;
+        out_chunk_iovs.push_back(iov);
+        int nb_chunk = nbh;
+
+        // the chunk payload maybe in multiple segments.
+        int left = Min(total - sent, out_chunk_size);
+        while (left > 0 && seg < nb_segs) {
+            int nb = Min(left, static_cast<int>(segs[seg].iov_len) - seg_pos);
+            iov.iov_base = static_cast<char*>(segs[seg].iov_base) + seg_pos;
+            iov.iov_len = nb;
+            if (nb > 0) {
+                out_chunk_iovs.push_back(iov);
+                nb_chunk += nb;
+            }
+
+            seg_pos += nb;
+            left -= nb;
+            sent += nb;
+            if (seg_pos >= static_cast<int>(segs[seg].iov_len)) {
+                seg++;
+                seg_pos = 0;
+            }
+        }
+
+        // the positive error code is returned if the conn is closed
+        if ((ret = conn->writev(out_chunk_iovs.data(), out_chunk_iovs.size())) != nb_chunk) {
+            tmss_error("send chunks with writev failed. ret={}, size={}", ret, nb_chunk);
+            return (ret < 0) ? ret : error_socket_write;
+        }
+        ret = error_success;
+    }
+
+    return ret;
+}
+
 int RtmpProtocolHandler::recv_interlaced_message(std::shared_ptr<RtmpMessage>& msg,
         char* recv_buf, int buf_size) {
     int ret = error_success;
@@ -2628,14 +3162,10 @@ int RtmpProtocolHandler::read_message_header(std::shared_ptr<RtmpChunkStream> ch
      */
     // see also: ngx_rtmp_recv
     if (fmt <= RTMP_FMT_TYPE2) {
-        char* p = pos;
+        BufferCursor cursor(pos, mh_size);
         pos += mh_size;
 
-        char* pp = reinterpret_cast<char*>(&chunk->header.timestamp_delta);
-        pp[2] = *p++;
-        pp[1] = *p++;
-        pp[0] = *p++;
-        pp[3] = 0;
+        chunk->header.timestamp_delta = cursor.read_3bytes();
 
         // fmt: 0
         // timestamp: 3 bytes
@@ -2664,12 +3194,7 @@ int RtmpProtocolHandler::read_message_header(std::shared_ptr<RtmpChunkStream> ch
         }
 
         if (fmt <= RTMP_FMT_TYPE1) {
-            int32_t payload_length = 0;
-            pp = reinterpret_cast<char*>(&payload_length);
-            pp[2] = *p++;
-            pp[1] = *p++;
-            pp[0] = *p++;
-            pp[3] = 0;
+            int32_t payload_length = cursor.read_3bytes();
 
             // for a message, if msg exists in cache, the size must not changed.
             // always use the actual msg size to compare, for the cache payload length can changed,
@@ -2685,14 +3210,12 @@ int RtmpProtocolHandler::read_message_header(std::shared_ptr<RtmpChunkStream> ch
             }
 
             chunk->header.payload_length = payload_length;
-            chunk->header.message_type = *p++;
+            chunk->header.message_type = cursor.read_1byte();
 
             if (fmt == RTMP_FMT_TYPE0) {
-                pp = reinterpret_cast<char*>(&chunk->header.stream_id);
-                pp[0] = *p++;
-                pp[1] = *p++;
-                pp[2] = *p++;
-                pp[3] = *p++;
+                // stream_id, 4bytes, little-endian
+                memcpy(&chunk->header.stream_id, cursor.current(), 4);
+                cursor.skip(4);
                 tmss_info(
                         "header read completed. fmt={}, mh_size={}, ext_time={}, time={}, payload={}, type={}, sid={}",
                         fmt, mh_size, chunk->extended_timestamp,
@@ -2732,12 +3255,7 @@ int RtmpProtocolHandler::read_message_header(std::shared_ptr<RtmpChunkStream> ch
         char* p = pos;  //  in_buffer->read_slice(4);
         pos += 4;
 
-        uint32_t timestamp = 0x00;
-        char* pp = reinterpret_cast<char*>(&timestamp);
-        pp[3] = *p++;
-        pp[2] = *p++;
-        pp[1] = *p++;
-        pp[0] = *p++;
+        uint32_t timestamp = load_be32(p);
 
         tmss_info("read extended timestamp: {}", timestamp);
 
@@ -3021,26 +3539,39 @@ int RtmpProtocolHandler::do_decode_message(MessageHeader& header, Buffer* stream
             stream->seek_read(1);
         }
 
+        // decode the command by the flat view, never copy the strings.
+        // only the name here, the packet decodes the values it needs, the others
+        // maybe large, custom or malformed, as the unknown commands dropped.
+        if ((ret = amf0_view.decode(stream->rcurrent(), stream->get_size() - stream->get_rpos(),
+                1)) != error_success) {
+            tmss_error("decode AMF0/AMF3 command view failed. ret={}", ret);
+            return ret;
+        }
+
         // amf0 command message.
         // need to read the command name.
-        std::string command;
-        if ((ret = amf0_read_string(stream, command)) != error_success) {
+        if (!amf0_view.is_string(amf0_view.at(0))) {
+            ret = error_rtmp_amf0_decode;
             tmss_error("decode AMF0/AMF3 command name failed. ret={}", ret);
             return ret;
         }
+        // the view is decoded again by packet, keep the name in payload.
+        Amf0StrView command = amf0_view.node(amf0_view.at(0)).str;
         tmss_info("AMF0/AMF3 command message, command_name={}",
-                command.c_str());
+                command.to_str());
 
         // result/error packet
-        if (command == RTMP_AMF0_COMMAND_RESULT
-                || command == RTMP_AMF0_COMMAND_ERROR) {
-            double transactionId = 0.0;
-            if ((ret = amf0_read_number(stream, transactionId))
-                    != error_success) {
+        if (command.equals(RTMP_AMF0_COMMAND_RESULT)
+                || command.equals(RTMP_AMF0_COMMAND_ERROR)) {
+            if ((ret = amf0_view.decode(stream->rcurrent(),
+                    stream->get_size() - stream->get_rpos(), 2)) != error_success
+                    || !amf0_view.is_number(amf0_view.at(1))) {
+                ret = error_rtmp_amf0_decode;
                 tmss_error("decode AMF0/AMF3 transcationId failed. ret={}", ret);
                 return ret;
             }
-            tmss_info("AMF0/AMF3 command id, transcationId=%.2f",
+            double transactionId = amf0_view.node(amf0_view.at(1)).number;
+            tmss_info("AMF0/AMF3 command id, transcationId={}",
                     transactionId);
 
             // reset stream, for header read completed.
@@ -3098,9 +3629,11 @@ int RtmpProtocolHandler::do_decode_message(MessageHeader& header, Buffer* stream
         }
 
         // default packet to drop message.
-        tmss_info("drop the AMF0/AMF3 command message, command_name={}",
-                command.c_str());
-        packet = std::make_shared<RtmpPacket>();
+        if (!packet) {
+            tmss_info("drop the AMF0/AMF3 command message, command_name={}",
+                    command.to_str());
+            packet = std::make_shared<RtmpPacket>();
+        }
         return ret;
     } else if (header.is_user_control_message()) {
         tmss_info("start to decode user control message.");
@@ -3124,71 +3657,71 @@ int RtmpProtocolHandler::do_decode_message(MessageHeader& header, Buffer* stream
 }
 
 int RtmpProtocolHandler::do_decode_command(MessageHeader& header,
-        const std::string& command, Buffer* stream,
+        const Amf0StrView& command, Buffer* stream,
         std::shared_ptr<RtmpPacket>& packet) {
     int ret = error_success;
 
     // decode command object.
-    if (command == RTMP_AMF0_COMMAND_CONNECT) {
+    if (command.equals(RTMP_AMF0_COMMAND_CONNECT)) {
         tmss_info("decode the AMF0/AMF3 command(connect vhost/app message).");
         packet = std::make_shared<RtmpConnectAppPacket>();
-        return packet->decode(stream);
-    } else if (command == RTMP_AMF0_COMMAND_CREATE_STREAM) {
+        return do_decode_view(stream, 4, packet);
+    } else if (command.equals(RTMP_AMF0_COMMAND_CREATE_STREAM)) {
         tmss_info("decode the AMF0/AMF3 command(createBuffer message).");
         packet = std::make_shared<RtmpCreateStreamPacket>();
-        return packet->decode(stream);
-    } else if (command == RTMP_AMF0_COMMAND_PLAY) {
+        return do_decode_view(stream, 3, packet);
+    } else if (command.equals(RTMP_AMF0_COMMAND_PLAY)) {
         tmss_info("decode the AMF0/AMF3 command(paly message).");
         packet = std::make_shared<RtmpPlayPacket>();
-        return packet->decode(stream);
-    } else if (command == RTMP_AMF0_COMMAND_PAUSE) {
+        return do_decode_view(stream, 7, packet);
+    } else if (command.equals(RTMP_AMF0_COMMAND_PAUSE)) {
         tmss_info("decode the AMF0/AMF3 command(pause message).");
         packet = std::make_shared<RtmpPausePacket>();
         return packet->decode(stream);
-    } else if (command == RTMP_AMF0_COMMAND_RELEASE_STREAM) {
+    } else if (command.equals(RTMP_AMF0_COMMAND_RELEASE_STREAM)) {
         tmss_info("decode the AMF0/AMF3 command(FMLE releaseBuffer message).");
         packet = std::make_shared<RtmpFMLEStartPacket>();
-        return packet->decode(stream);
-    } else if (command == RTMP_AMF0_COMMAND_FC_PUBLISH) {
+        return do_decode_view(stream, 4, packet);
+    } else if (command.equals(RTMP_AMF0_COMMAND_FC_PUBLISH)) {
         tmss_info("decode the AMF0/AMF3 command(FMLE FCPublish message).");
         packet = std::make_shared<RtmpFMLEStartPacket>();
-        return packet->decode(stream);
-    } else if (command == RTMP_AMF0_COMMAND_PUBLISH) {
+        return do_decode_view(stream, 4, packet);
+    } else if (command.equals(RTMP_AMF0_COMMAND_PUBLISH)) {
         tmss_info("decode the AMF0/AMF3 command(publish message).");
         packet = std::make_shared<RtmpPublishPacket>();
-        return packet->decode(stream);
-    } else if (command == RTMP_AMF0_COMMAND_UNPUBLISH) {
+        return do_decode_view(stream, 5, packet);
+    } else if (command.equals(RTMP_AMF0_COMMAND_UNPUBLISH)) {
         tmss_info("decode the AMF0/AMF3 command(unpublish message).");
         packet = std::make_shared<RtmpFMLEStartPacket>();
-        return packet->decode(stream);
-    } else if (command == RTMP_AMF0_COMMAND_ON_STATUS) {
+        return do_decode_view(stream, 4, packet);
+    } else if (command.equals(RTMP_AMF0_COMMAND_ON_STATUS)) {
         tmss_info("decode the AMF0/AMF3 command(onStatus message).");
         packet = std::make_shared<RtmpOnStatusCallPacket>();
         if (packet->decode(stream) != error_success) {
             packet = std::make_shared<RtmpPacket>();
         }
         return ret;
-    } else if (command == TMSS_CONSTS_RTMP_SET_DATAFRAME
-            || command == TMSS_CONSTS_RTMP_ON_METADATA) {
+    } else if (command.equals(TMSS_CONSTS_RTMP_SET_DATAFRAME)
+            || command.equals(TMSS_CONSTS_RTMP_ON_METADATA)) {
         tmss_info("decode the AMF0/AMF3 data(onMetaData message).");
         packet = std::make_shared<RtmpOnMetaDataPacket>();
         return packet->decode(stream);
-    } else if (command == TMSS_BW_CHECK_FINISHED
-            || command == TMSS_BW_CHECK_PLAYING
-            || command == TMSS_BW_CHECK_PUBLISHING
-            || command == TMSS_BW_CHECK_STARTING_PLAY
-            || command == TMSS_BW_CHECK_STARTING_PUBLISH
-            || command == TMSS_BW_CHECK_START_PLAY
-            || command == TMSS_BW_CHECK_START_PUBLISH
-            || command == TMSS_BW_CHECK_STOPPED_PLAY
-            || command == TMSS_BW_CHECK_STOP_PLAY
-            || command == TMSS_BW_CHECK_STOP_PUBLISH
-            || command == TMSS_BW_CHECK_STOPPED_PUBLISH
-            || command == TMSS_BW_CHECK_FINAL) {
+    } else if (command.equals(TMSS_BW_CHECK_FINISHED)
+            || command.equals(TMSS_BW_CHECK_PLAYING)
+            || command.equals(TMSS_BW_CHECK_PUBLISHING)
+            || command.equals(TMSS_BW_CHECK_STARTING_PLAY)
+            || command.equals(TMSS_BW_CHECK_STARTING_PUBLISH)
+            || command.equals(TMSS_BW_CHECK_START_PLAY)
+            || command.equals(TMSS_BW_CHECK_START_PUBLISH)
+            || command.equals(TMSS_BW_CHECK_STOPPED_PLAY)
+            || command.equals(TMSS_BW_CHECK_STOP_PLAY)
+            || command.equals(TMSS_BW_CHECK_STOP_PUBLISH)
+            || command.equals(TMSS_BW_CHECK_STOPPED_PUBLISH)
+            || command.equals(TMSS_BW_CHECK_FINAL)) {
         tmss_info("decode the AMF0/AMF3 band width check message.");
         packet = std::make_shared<RtmpBandwidthPacket>();
         return packet->decode(stream);
-    } else if (command == RTMP_AMF0_COMMAND_CLOSE_STREAM) {
+    } else if (command.equals(RTMP_AMF0_COMMAND_CLOSE_STREAM)) {
         tmss_info("decode the AMF0/AMF3 closeBuffer message.");
         packet = std::make_shared<RtmpCloseStreamPacket>();
         return packet->decode(stream);
@@ -3209,6 +3742,20 @@ int RtmpProtocolHandler::do_decode_command(MessageHeader& header,
     return ret;
 }
 
+int RtmpProtocolHandler::do_decode_view(Buffer* stream, int max_values,
+        std::shared_ptr<RtmpPacket> packet) {
+    int ret = error_success;
+
+    if ((ret = amf0_view.decode(stream->rcurrent(), stream->get_size() - stream->get_rpos(),
+            max_values)) != error_success) {
+        tmss_error("decode AMF0/AMF3 command view failed. max_values={}, ret={}",
+                max_values, ret);
+        return ret;
+    }
+
+    return packet->decode_view(&amf0_view);
+}
+
 int RtmpProtocolHandler::response_acknowledgement_message() {
     int ret = error_success;
 
@@ -3281,48 +3828,30 @@ int RtmpProtocolHandler::response_ping_message(int32_t timestamp) {
 int chunk_header_c0(int perfer_cid, uint32_t timestamp, int32_t payload_length,
     int8_t message_type, int32_t stream_id,
     char* cache, int nb_cache) {
-    // to directly set the field.
-    char* pp = NULL;
-
-    // generate the header.
-    char* p = cache;
-
     // no header.
     if (nb_cache < TMSS_CONSTS_RTMP_MAX_FMT0_HEADER_SIZE) {
         return 0;
     }
 
+    // generate the header, the size of cache is checked above.
+    BufferCursor cursor(cache, nb_cache);
+
     // write new chunk stream header, fmt is 0
-    *p++ = 0x00 | (perfer_cid & 0x3F);
+    cursor.write_1byte(0x00 | (perfer_cid & 0x3F));
 
     // chunk message header, 11 bytes
     // timestamp, 3bytes, big-endian
-    if (timestamp < RTMP_EXTENDED_TIMESTAMP) {
-        pp = reinterpret_cast<char*>(&timestamp);
-        *p++ = pp[2];
-        *p++ = pp[1];
-        *p++ = pp[0];
-    } else {
-        *p++ = 0xFF;
-        *p++ = 0xFF;
-        *p++ = 0xFF;
-    }
+    cursor.write_3bytes((timestamp < RTMP_EXTENDED_TIMESTAMP) ? timestamp : 0xFFFFFF);
 
     // message_length, 3bytes, big-endian
-    pp = reinterpret_cast<char*>(&payload_length);
-    *p++ = pp[2];
-    *p++ = pp[1];
-    *p++ = pp[0];
+    cursor.write_3bytes(payload_length);
 
     // message_type, 1bytes
-    *p++ = message_type;
+    cursor.write_1byte(message_type);
 
     // stream_id, 4bytes, little-endian
-    pp = reinterpret_cast<char*>(&stream_id);
-    *p++ = pp[0];
-    *p++ = pp[1];
-    *p++ = pp[2];
-    *p++ = pp[3];
+    memcpy(cursor.current(), &stream_id, 4);
+    cursor.skip(4);
 
     // for c0
     // chunk extended timestamp header, 0 or 4 bytes, big-endian
@@ -3343,34 +3872,27 @@ int chunk_header_c0(int perfer_cid, uint32_t timestamp, int32_t payload_length,
     // @see: http://blog.csdn.net/win_lin/article/details/13363699
     // to do: FIXME: extract to outer.
     if (timestamp >= RTMP_EXTENDED_TIMESTAMP) {
-        pp = reinterpret_cast<char*>(&timestamp);
-        *p++ = pp[3];
-        *p++ = pp[2];
-        *p++ = pp[1];
-        *p++ = pp[0];
+        cursor.write_4bytes(timestamp);
     }
 
     // always has header
-    return p - cache;
+    return cursor.pos();
 }
 
 int chunk_header_c3(int perfer_cid, uint32_t timestamp,
     char* cache, int nb_cache) {
-    // to directly set the field.
-    char* pp = NULL;
-
-    // generate the header.
-    char* p = cache;
-
     // no header.
     if (nb_cache < TMSS_CONSTS_RTMP_MAX_FMT3_HEADER_SIZE) {
         return 0;
     }
 
+    // generate the header, the size of cache is checked above.
+    BufferCursor cursor(cache, nb_cache);
+
     // write no message header chunk stream, fmt is 3
     // @remark, if perfer_cid > 0x3F, that is, use 2B/3B chunk header,
     // TMSS will rollback to 1B chunk header.
-    *p++ = 0xC0 | (perfer_cid & 0x3F);
+    cursor.write_1byte(0xC0 | (perfer_cid & 0x3F));
 
     // for c0
     // chunk extended timestamp header, 0 or 4 bytes, big-endian
@@ -3391,15 +3913,11 @@ int chunk_header_c3(int perfer_cid, uint32_t timestamp,
     // @see: http://blog.csdn.net/win_lin/article/details/13363699
     // to do: FIXME: extract to outer.
     if (timestamp >= RTMP_EXTENDED_TIMESTAMP) {
-        pp = reinterpret_cast<char*>(&timestamp);
-        *p++ = pp[3];
-        *p++ = pp[2];
-        *p++ = pp[1];
-        *p++ = pp[0];
+        cursor.write_4bytes(timestamp);
     }
 
     // always has header
-    return p - cache;
+    return cursor.pos();
 }
 
 }   // namespace tmss
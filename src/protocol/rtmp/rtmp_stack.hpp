@@ -11,11 +11,14 @@
 
 #include <string>
 #include <map>
+#include <deque>
+#include <vector>
 #include "util/util.hpp"
 #include <defs/err.hpp>
 #include <defs/tmss_def.hpp>
 #include <rtmp_def.hpp>
 #include <rtmp/rtmp_amf.hpp>
+#include <rtmp/rtmp_amf_view.hpp>
 #include <rtmp/rtmp_message.hpp>
 #include <log/log.hpp>
 #include <net/tmss_conn.hpp>
@@ -116,6 +119,11 @@ class RtmpPacket {
 
      virtual int encode(int& size, char*& payload);
      virtual int decode(Buffer* stream);
+     /**
+      * decode from the flat AMF0 view of message, without Amf0Any.
+      * @remark only the hot command packets support it.
+      */
+     virtual int decode_view(Amf0View* view);
 
  public:
     /**
@@ -149,6 +157,13 @@ class RtmpConnectAppPacket : public RtmpPacket {
     RtmpConnectAppPacket();
     ~RtmpConnectAppPacket();
     virtual int decode(Buffer* stream);
+    virtual int decode_view(Amf0View* view);
+    /**
+     * build command_object and args from the raw bytes kept by decode_view.
+     */
+    virtual int materialize();
+    // materialize before encode, the size and payload are from the owning objects.
+    virtual int encode(int& size, char*& payload);
 
  public:
     virtual int get_prefer_cid();
@@ -166,6 +181,15 @@ class RtmpConnectAppPacket : public RtmpPacket {
     std::shared_ptr<Amf0Object> command_object;
 
     std::shared_ptr<Amf0Object> args;
+
+    /**
+     * copied from command_object by decode_view, for the connect storm
+     * the object is kept as raw AMF0 bytes until re-encode.
+     */
+    std::string tc_url;
+    std::string app;
+    std::string raw_command_object;
+    std::string raw_args;
 };
 
 class RtmpConnectAppResPacket : public RtmpPacket {
@@ -227,6 +251,7 @@ class RtmpPlayPacket : public RtmpPacket {
     RtmpPlayPacket();
     ~RtmpPlayPacket();
     virtual int decode(Buffer* stream);
+    virtual int decode_view(Amf0View* view);
 
  public:
     virtual int get_prefer_cid();
@@ -431,6 +456,7 @@ class RtmpCreateStreamPacket: public RtmpPacket {
 
  public:
     virtual int decode(Buffer* stream);
+    virtual int decode_view(Amf0View* view);
 // encode functions for concrete packet to override.
 
  public:
@@ -510,6 +536,7 @@ class RtmpFMLEStartPacket: public RtmpPacket {
 
  public:
     virtual int decode(Buffer* stream);
+    virtual int decode_view(Amf0View* view);
 // encode functions for concrete packet to override.
 
  public:
@@ -615,6 +642,7 @@ class RtmpPublishPacket: public RtmpPacket {
 
  public:
     virtual int decode(Buffer* stream);
+    virtual int decode_view(Amf0View* view);
 // encode functions for concrete packet to override.
 
  public:
@@ -994,6 +1022,11 @@ class RtmpProtocolHandler {
      virtual ~RtmpProtocolHandler();
 
  public:
+     /*
+     * the buffered reader of conn, shared with the client.
+     */
+     virtual void set_io_buffer(std::shared_ptr<IOBuffer> buffer);
+
      virtual int send_packet(std::shared_ptr<RtmpPacket> pkt, int streamid);
 
      /*
@@ -1005,6 +1038,28 @@ class RtmpProtocolHandler {
 
      virtual int send_message(const char* buf, int size);
 
+     /*
+     * receive an entire audio/video/data message, the aggregate message
+     * is split to sub messages in place, control messages are handled inside.
+     */
+     virtual int recv_rtmp_message(std::shared_ptr<RtmpMessage>& msg);
+
+     /*
+     * send the raw message, audio/video maybe merged to aggregate
+     * when aggregate output is enabled.
+     */
+     virtual int send_rtmp_message(std::shared_ptr<RtmpMessage> msg, int streamid);
+
+     /*
+     * merge the audio/video to aggregate message before send,
+     * for relay between our servers. 0 to disable.
+     * @param max_size, flush the aggregate when exceed max_size bytes.
+     * @param max_delay_ms, flush the aggregate when its messages span max_delay_ms
+     *      of timestamp or of wall time, so the low rate stream is not held.
+     */
+     virtual void set_aggregate_output(int max_size, int max_delay_ms);
+     virtual int flush_aggregate(int streamid);
+
      template<class T>
      int expect_packet(std::shared_ptr<T>& packet) {
         int ret = error_success;
@@ -1061,8 +1116,14 @@ class RtmpProtocolHandler {
             std::shared_ptr<RtmpPacket>& packet);
 
     virtual int do_decode_command(MessageHeader& header,
-        const std::string& command, Buffer* stream,
+        const Amf0StrView& command, Buffer* stream,
         std::shared_ptr<RtmpPacket>& packet);
+    /**
+     * decode the first max_values of stream by view, then the packet by it.
+     * the values after them are ignored, even malformed.
+     */
+    virtual int do_decode_view(Buffer* stream, int max_values,
+        std::shared_ptr<RtmpPacket> packet);
     /**
      * auto response the ack message.
      */
@@ -1071,6 +1132,10 @@ class RtmpProtocolHandler {
      * auto response the ping message.
      */
     virtual int response_ping_message(int32_t timestamp);
+    /**
+     * send the payload segments in chunks, without copy the payload.
+     */
+    virtual int send_chunks(MessageHeader& header, const iovec* segs, int nb_segs);
 
  private:
     std::shared_ptr<IConn> conn;
@@ -1090,6 +1155,31 @@ class RtmpProtocolHandler {
     std::vector<std::shared_ptr<RtmpChunkStream>> cs_cache;
     bool    fix_rtmp_timestamp;
 
+    /**
+     * the AMF0 view to decode command message, the nodes arena
+     * is reused for each message.
+     */
+    Amf0View amf0_view;
+
+    /**
+     * the sub messages split from aggregate, not consumed yet.
+     */
+    std::deque<std::shared_ptr<RtmpMessage>> aggregate_msgs;
+    /**
+     * the output aggregate, 0 to disable.
+     */
+    int out_aggregate_size;
+    int out_aggregate_delay_ms;
+    int out_aggregate_bytes;
+    // the wall time of the first message in out aggregate.
+    int64_t out_aggregate_start_us;
+    std::vector<std::shared_ptr<RtmpMessage>> out_aggregate_msgs;
+    // the tag header and tail of out aggregate.
+    std::vector<char> out_aggregate_tags;
+    // the iovs for send_chunks.
+    std::vector<iovec> out_segs;
+    std::vector<iovec> out_chunk_iovs;
+
     /**
      * input chunk size, default to 128, set by peer packet.
      */
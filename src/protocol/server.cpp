@@ -65,8 +65,12 @@ int IServer::run() {
         tmss_error("run failed, listen error,ret={}", ret);
         return ret;
     }
+    return serve();
+}
+
+int IServer::serve() {
     // start co_thread
-    ret = start();
+    int ret = start();
     if (ret != error_success) {
         tmss_error("run failed, start co_thread error,ret={}", ret);
         return ret;
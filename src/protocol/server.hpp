@@ -49,6 +49,8 @@ class IServer : public ICoroutineHandler {
     virtual int listen(const std::string &ip, int port) = 0;
     virtual std::shared_ptr<IClientConn> accept() = 0;
     virtual int run();
+    // accept on the server_conn already listened
+    virtual int serve();
 
     virtual int cycle() override;
 
@@ -0,0 +1,47 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+#include <protocol/srt/srt_client.hpp>
+
+#include <defs/err.hpp>
+#include <log/log.hpp>
+
+namespace tmss {
+SrtClient::SrtClient() {
+}
+
+int SrtClient::request(const std::string& origin_host,
+        const std::string& origin_path,
+        const std::string& stream,
+        const std::string& param,
+        std::shared_ptr<IDeMux> demux) {
+    int ret = error_srt_socket_connect;
+    tmss_error("srt origin is not supported, {}/{}/{}, ret={}",
+        origin_host, origin_path, stream, ret);
+    return ret;
+}
+
+int SrtClient::read_data(char* buf, int size) {
+    int read_size = io_buffer->read_bytes(buf, size);
+    if (read_size < 0) {
+        tmss_error("srt read data failed, ret={}", read_size);
+        return read_size;
+    }
+    return read_size;
+}
+
+int SrtClient::write_data(const char* buf, int size) {
+    return conn->write(buf, size);
+}
+
+int SrtClient::writev_data(const iovec* iov, int iov_size) {
+    return conn->writev(iov, iov_size);
+}
+
+}  // namespace tmss
@@ -0,0 +1,42 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <protocol/client.hpp>
+
+namespace tmss {
+class IDeMux;
+/*
+*   the mpeg-ts over srt, no framing, the srt messages are the ts packets.
+*/
+class SrtClient : public IClient {
+ public:
+    SrtClient();
+    virtual ~SrtClient() = default;
+
+ public:
+    /*
+    *   the streamid must be set before connect, pull from srt origin is not supported.
+    */
+    int request(const std::string& origin_host,
+        const std::string& origin_path,
+        const std::string& stream,
+        const std::string& param,
+        std::shared_ptr<IDeMux> demux) override;
+    int read_data(char* buf, int size) override;
+    int write_data(const char* buf, int size) override;
+    // the iovecs are sent as ts messages, no copy to one buffer
+    int writev_data(const iovec* iov, int iov_size) override;
+};
+
+}  // namespace tmss
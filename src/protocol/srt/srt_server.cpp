@@ -0,0 +1,212 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+#include <protocol/srt/srt_server.hpp>
+
+#include <vector>
+
+#include <defs/err.hpp>
+#include <log/log.hpp>
+#include <util/util.hpp>
+#include <tmss_user_control.hpp>
+
+namespace tmss {
+// the prefix of srt access control syntax
+const char* srt_streamid_prefix = "#!::";
+
+int srt_parse_streamid(const std::string& streamid, std::shared_ptr<SrtRequest> req) {
+    int ret = error_success;
+    req->streamid = streamid;
+    req->type = ERequestTypePlay;
+
+    std::string resource = streamid;
+    if (streamid.compare(0, 4, srt_streamid_prefix) == 0) {
+        resource.clear();
+        std::vector<std::string> items;
+        split_string(streamid.substr(4), ",", items);
+        for (auto& item : items) {
+            size_t pos = item.find('=');
+            if (pos == std::string::npos) {
+                continue;
+            }
+            std::string key = item.substr(0, pos);
+            std::string value = item.substr(pos + 1);
+            if (key == "r") {
+                resource = value;
+            } else if (key == "h") {
+                req->vhost = value;
+            } else if (key == "m") {
+                if (value == "publish") {
+                    req->type = ERequestTypePublish;
+                } else if (value != "request") {
+                    ret = error_srt_streamid_invalid;
+                    tmss_error("srt mode not supported, streamid={}, ret={}", streamid, ret);
+                    return ret;
+                }
+            } else {
+                // u, s, t and the others are kept as the params
+                req->params_map[key] = value;
+            }
+        }
+    }
+
+    // live/stream?params
+    size_t pos = resource.find('?');
+    if (pos != std::string::npos) {
+        req->params = resource.substr(pos + 1);
+        resource = resource.substr(0, pos);
+        std::vector<std::string> querys;
+        split_string(req->params, "&", querys);
+        for (auto& key_value : querys) {
+            std::vector<std::string> kv;
+            split_string(key_value, "=", kv);
+            if (kv.size() == 2) {
+                req->params_map[kv[0]] = url_decode(kv[1]);
+            }
+        }
+    }
+    while (!resource.empty() && resource.front() == '/') {
+        resource.erase(0, 1);
+    }
+    req->url = resource;
+
+    pos = resource.rfind('/');
+    if (pos != std::string::npos) {
+        req->path = resource.substr(0, pos);
+        req->name = resource.substr(pos + 1);
+    } else {
+        req->name = resource;
+    }
+    if (req->name.empty()) {
+        ret = error_srt_streamid_invalid;
+        tmss_error("srt no stream, streamid={}, ret={}", streamid, ret);
+        return ret;
+    }
+
+    // the same channel of http-ts, the name has the ext as http
+    pos = req->name.rfind('.');
+    if (pos != std::string::npos) {
+        req->ext = req->name.substr(pos + 1);
+    } else {
+        req->ext = "ts";
+        req->name += ".ts";
+    }
+    req->format = req->ext;
+    if (req->type == ERequestTypePlay && req->params_map["mode"].empty()) {
+        req->params_map["mode"] = "live";
+    }
+    return ret;
+}
+
+SrtConnHandler::SrtConnHandler(std::shared_ptr<IClientConn> conn,
+        std::shared_ptr<SrtServer> server) : IConnHandler(conn, server) {
+}
+
+int SrtConnHandler::cycle() {
+    int ret = error_success;
+
+    std::shared_ptr<SRTStreamConn> srt_conn = std::dynamic_pointer_cast<SRTStreamConn>(conn);
+    std::shared_ptr<SrtServer> srt_server = std::dynamic_pointer_cast<SrtServer>(server);
+    std::shared_ptr<IUserHandler> user_handler = srt_server->get_user_handler();
+    std::shared_ptr<SrtRequest> req = std::make_shared<SrtRequest>();
+    if (!srt_conn || !user_handler) {
+        ret = error_srt_streamid_invalid;
+        tmss_error("srt conn or handler is null, ret={}", ret);
+    } else {
+        ret = srt_parse_streamid(srt_conn->streamid, req);
+    }
+    if (ret == error_success) {
+        tmss_info("srt req=vhost={},path={},name={},type={}",
+            req->vhost, req->path, req->name, static_cast<int>(req->type));
+        ret = user_handler->handle_request(conn, req, server);
+        if (ret != error_success) {
+            tmss_error("serve srt failed, ret={}", ret);
+        }
+    }
+
+    if (ret == error_success && req->detached) {
+        // the input reads the stream, it stops the connection when done
+        tmss_info("srt conn detached");
+        return ret;
+    }
+    if (ret == error_success && req->streaming) {
+        // the output owns the connection now, wait for the client to close
+        ret = wait_close();
+    }
+
+    if (!conn->is_stop()) {
+        tmss_info("conn stop by srt_server");
+        conn->set_stop();
+    }
+    return ret;
+}
+
+int SrtConnHandler::wait_close() {
+    int ret = error_success;
+
+    conn->set_recv_timeout(-1);     // no timeout
+    char buffer[SRT_LIVE_MAX_PLSIZE];
+    while (!conn->is_stop()) {
+        int read_size = conn->read(buffer, sizeof(buffer));
+        if (read_size <= 0) {
+            tmss_info("srt conn closed, ret={}", read_size);
+            break;
+        }
+    }
+    return ret;
+}
+
+int SrtConnHandler::on_thread_stop() {
+    if (!server) {
+        return error_success;
+    }
+    return server->get_conn_manager()->remove_conn(
+        std::dynamic_pointer_cast<SrtConnHandler>(shared_from_this()));
+}
+
+int SrtConnHandler::on_accept(std::shared_ptr<IClientConn> conn) {
+    return this->start();
+}
+
+int SrtConnHandler::on_init() {
+    conn->set_handler(std::dynamic_pointer_cast<IConnHandler>(shared_from_this()));
+    return error_success;
+}
+
+SrtServer::SrtServer(std::shared_ptr<IServerConn> server_conn,
+        std::shared_ptr<ChannelPool> channel_pool,
+        std::shared_ptr<FileCache> file_cache) :
+    IServer(server_conn, channel_pool, file_cache) {
+}
+
+SrtServer::~SrtServer() {
+}
+
+int SrtServer::listen(const std::string &ip, int port) {
+    return server_conn->listen(ip, port);
+}
+
+std::shared_ptr<IConnHandler> SrtServer::create_conn_handler(std::shared_ptr<IClientConn> conn) {
+    return std::make_shared<SrtConnHandler>(conn,
+        std::dynamic_pointer_cast<SrtServer>(shared_from_this()));
+}
+
+std::shared_ptr<IClientConn> SrtServer::accept() {
+    return server_conn->accept();
+}
+
+void SrtServer::set_user_handler(std::shared_ptr<IUserHandler> handler) {
+    user_handler = handler;
+}
+
+std::shared_ptr<IUserHandler> SrtServer::get_user_handler() {
+    return user_handler;
+}
+
+}  // namespace tmss
@@ -0,0 +1,75 @@
+/* Copyright [2020] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <server.hpp>
+#include <parser.hpp>
+#include <transport/tmss_trans_srt.hpp>
+
+namespace tmss {
+class SrtServer;
+class IUserHandler;
+
+class SrtRequest : public Request {
+ public:
+    // the streamid sent by the client
+    std::string streamid;
+};
+
+/*
+*   parse the streamid of srt access control,
+*   #!::r=live/stream,m=publish,h=vhost, m is request(default) or publish,
+*   or live/stream?params without #!::, as the path of http.
+*   the stream is mpeg-ts, the name is stream.ts, shared with http-ts.
+*/
+int srt_parse_streamid(const std::string& streamid, std::shared_ptr<SrtRequest> req);
+
+class SrtConnHandler : public IConnHandler {
+ public:
+    SrtConnHandler(std::shared_ptr<IClientConn> conn,
+        std::shared_ptr<SrtServer> server);
+    int cycle() override;
+    int on_thread_stop() override;
+    int on_accept(std::shared_ptr<IClientConn> conn) override;
+    int on_stop() { return error_success; }
+    int on_init();
+
+ private:
+    // discard the input until the client closes the connection
+    int wait_close();
+};
+
+/**
+ * on_accept -> streamid -> user handler, one stream for each connection
+ */
+class SrtServer : public IServer {
+ public:
+    SrtServer(std::shared_ptr<IServerConn> server_conn,
+        std::shared_ptr<ChannelPool> channel_pool,
+        std::shared_ptr<FileCache> file_cache);
+    ~SrtServer();
+
+ public:
+    int listen(const std::string &ip, int port) override;
+    std::shared_ptr<IConnHandler> create_conn_handler(std::shared_ptr<IClientConn> conn) override;
+    std::shared_ptr<IClientConn> accept() override;
+
+ public:
+    void set_user_handler(std::shared_ptr<IUserHandler> handler);
+    std::shared_ptr<IUserHandler> get_user_handler();
+
+ private:
+    std::shared_ptr<IUserHandler> user_handler;
+};
+
+}  // namespace tmss
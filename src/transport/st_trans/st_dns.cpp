@@ -0,0 +1,525 @@
+/* Copyright [2019] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  weideng.
+ *
+ * =====================================================================================
+ */
+
+#include "st_dns.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "log/log.hpp"
+#include "util/timer.hpp"
+
+static const int dns_port = 53;
+// the answer of udp is at most 512 bytes without EDNS
+static const int dns_max_packet = 512;
+static const uint16_t dns_type_a = 1;
+static const uint16_t dns_type_soa = 6;
+static const uint16_t dns_class_in = 1;
+static const int dns_rcode_nxdomain = 3;
+static const uint16_t dns_flag_tc = 0x0200;
+// the limits of resolv.conf(5)
+static const int dns_default_ndots = 1;
+static const int dns_max_ndots = 15;
+static const size_t dns_max_search = 6;
+
+// the ttl of records is limited to [min, max] seconds
+static const uint32_t dns_min_ttl = 1;
+static const uint32_t dns_max_ttl = 3600;
+// NXDOMAIN or no record, when the SOA is not in the answer, RFC 2308
+static const uint32_t dns_negative_ttl = 30;
+// timeout or SERVFAIL, retry soon
+static const uint32_t dns_failure_ttl = 5;
+// the stale answer is used for a while when the name servers fail
+static const uint32_t dns_stale_ttl = 30;
+static const size_t dns_max_cache_size = 1024;
+
+static uint16_t dns_read_uint16(const char* p) {
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    return (u[0] << 8) | u[1];
+}
+
+static uint32_t dns_read_uint32(const char* p) {
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    return (u[0] << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+}
+
+// skip the name at pos, the compressed name ends with the pointer
+static bool dns_skip_name(const char* data, int size, int& pos) {
+    while (pos < size) {
+        uint8_t len = data[pos];
+        if ((len & 0xc0) == 0xc0) {
+            pos += 2;
+            return pos <= size;
+        }
+        pos += len + 1;
+        if (len == 0) {
+            return pos <= size;
+        }
+    }
+    return false;
+}
+
+StDnsResolver::StDnsResolver() {
+    ndots = dns_default_ndots;
+    std::random_device device;
+    random_engine.seed(device());
+    load_config();
+}
+
+StDnsResolver::~StDnsResolver() {
+    for (auto& it : cache) {
+        if (it.second.cond) {
+            st_cond_destroy(it.second.cond);
+        }
+    }
+}
+
+std::shared_ptr<StDnsResolver> StDnsResolver::get_instance() {
+    thread_local std::shared_ptr<StDnsResolver> ins = nullptr;
+    if (!ins) {
+        ins = std::make_shared<StDnsResolver>();
+    }
+    return ins;
+}
+
+void StDnsResolver::load_config() {
+    std::ifstream resolv("/etc/resolv.conf");
+    std::string line;
+    while (std::getline(resolv, line)) {
+        std::istringstream fields(line);
+        std::string key, value;
+        std::vector<std::string> values;
+        fields >> key;
+        while (fields >> value) {
+            values.push_back(value);
+        }
+        if (values.empty()) {
+            continue;
+        }
+        if (key == "nameserver") {
+            in6_addr addr6;
+            if (inet_addr(values[0].c_str()) != INADDR_NONE) {
+                nameservers.push_back(values[0]);
+            } else if (inet_pton(AF_INET6, values[0].c_str(), &addr6) == 1) {
+                // the queries are sent by AF_INET socket
+                tmss_warn("dns skip IPv6 nameserver {}", values[0]);
+            } else {
+                tmss_warn("dns invalid nameserver {}", values[0]);
+            }
+        } else if (key == "domain" || key == "search") {
+            // the last one of domain and search wins
+            search.clear();
+            for (auto& domain : values) {
+                if (domain.back() == '.') {
+                    domain.pop_back();
+                }
+                if (!domain.empty() && search.size() < dns_max_search) {
+                    search.push_back(domain);
+                }
+            }
+        } else if (key == "options") {
+            for (auto& option : values) {
+                if (option.compare(0, 6, "ndots:") == 0) {
+                    ndots = std::min(atoi(option.c_str() + 6), dns_max_ndots);
+                }
+            }
+        }
+    }
+    if (nameservers.empty()) {
+        // the default of resolv.conf(5)
+        nameservers.push_back("127.0.0.1");
+    }
+
+    std::ifstream hosts_file("/etc/hosts");
+    while (std::getline(hosts_file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string ip, name;
+        fields >> ip;
+        if (inet_addr(ip.c_str()) == INADDR_NONE) {
+            continue;
+        }
+        while (fields >> name) {
+            hosts[name].push_back(ip);
+        }
+    }
+    tmss_info("dns load config, nameservers={}, search={}, ndots={}, hosts={}",
+        nameservers.size(), search.size(), ndots, hosts.size());
+}
+
+error_t StDnsResolver::resolve(const std::string& host, std::vector<std::string>& ips,
+        utime_t timeout) {
+    error_t ret = error_success;
+    ips.clear();
+
+    if (inet_addr(host.c_str()) != INADDR_NONE) {
+        ips.push_back(host);
+        return ret;
+    }
+    auto host_ips = hosts.find(host);
+    if (host_ips != hosts.end()) {
+        ips = host_ips->second;
+        return ret;
+    }
+
+    if (cache.size() > dns_max_cache_size) {
+        utime_t now = tmss::get_cache_time();
+        for (auto it = cache.begin(); it != cache.end();) {
+            if (!it->second.resolving && it->second.waiters == 0 && it->second.expire_at < now) {
+                if (it->second.cond) {
+                    st_cond_destroy(it->second.cond);
+                }
+                it = cache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // the entry is never erased while resolving or waited
+    DnsEntry& entry = cache[host];
+    while (entry.resolving) {
+        if (!entry.cond) {
+            entry.cond = st_cond_new();
+        }
+        entry.waiters++;
+        int r0 = st_cond_timedwait(entry.cond, timeout);
+        // the entry can be evicted after the last waiter is gone
+        if (--entry.waiters == 0) {
+            st_cond_destroy(entry.cond);
+            entry.cond = nullptr;
+        }
+        if (r0 != 0) {
+            ret = error_dns_timeout;
+            tmss_error("dns wait resolving timeout, host={}, ret={}", host, ret);
+            return ret;
+        }
+    }
+
+    utime_t now = tmss::update_time();
+    if (entry.expire_at > now) {
+        ips = entry.ips;
+        return entry.ret;
+    }
+
+    entry.resolving = true;
+    std::vector<std::string> answer;
+    uint32_t ttl = 0;
+    ret = query(host, answer, ttl, timeout);
+    now = tmss::update_time();
+
+    if (ret == error_success) {
+        ttl = std::max(dns_min_ttl, std::min(ttl, dns_max_ttl));
+        entry.ips = answer;
+        entry.ret = ret;
+        entry.expire_at = now + (utime_t)ttl * 1000 * 1000;
+        tmss_info("dns resolved, host={}, ips={}, ttl={}", host, answer.size(), ttl);
+    } else if (entry.ret == error_success && !entry.ips.empty()) {
+        // the origin is still there when the name servers are down
+        entry.expire_at = now + (utime_t)dns_stale_ttl * 1000 * 1000;
+        tmss_warn("dns failed, use the stale answer, host={}, ret={}", host, ret);
+        ret = error_success;
+    } else {
+        if (ret != error_dns_no_answer) {
+            ttl = dns_failure_ttl;
+        }
+        entry.ips.clear();
+        entry.ret = ret;
+        entry.expire_at = now + (utime_t)std::min(ttl, dns_max_ttl) * 1000 * 1000;
+        tmss_error("dns failed, host={}, ttl={}, ret={}", host, ttl, ret);
+    }
+
+    entry.resolving = false;
+    if (entry.cond) {
+        st_cond_broadcast(entry.cond);
+    }
+    ips = entry.ips;
+    return ret;
+}
+
+error_t StDnsResolver::query(const std::string& host, std::vector<std::string>& ips,
+        uint32_t& ttl, utime_t timeout) {
+    // the trailing dot is absolute, no search
+    if (!host.empty() && host.back() == '.') {
+        return query_name(host.substr(0, host.size() - 1), ips, ttl, timeout);
+    }
+
+    std::vector<std::string> names;
+    int dots = std::count(host.begin(), host.end(), '.');
+    if (dots >= ndots) {
+        names.push_back(host);
+    }
+    for (auto& domain : search) {
+        names.push_back(host + "." + domain);
+    }
+    if (dots < ndots) {
+        names.push_back(host);
+    }
+
+    // the next name is tried only when this one does not exist
+    error_t ret = error_dns_resolve;
+    utime_t deadline = tmss::update_time() + timeout;
+    for (auto& name : names) {
+        utime_t now = tmss::update_time();
+        if (now >= deadline) {
+            return error_dns_timeout;
+        }
+        ret = query_name(name, ips, ttl, deadline - now);
+        if (ret != error_dns_no_answer) {
+            return ret;
+        }
+    }
+    return ret;
+}
+
+error_t StDnsResolver::query_name(const std::string& host, std::vector<std::string>& ips,
+        uint32_t& ttl, utime_t timeout) {
+    error_t ret = error_dns_resolve;
+    if (host.empty() || host.size() > 253) {
+        return ret;
+    }
+
+    // two rounds over the name servers, like the attempts of resolv.conf
+    int tries = nameservers.size() * 2;
+    utime_t try_timeout = timeout / tries;
+    for (int i = 0; i < tries; i++) {
+        const std::string& server = nameservers[i % nameservers.size()];
+        ret = query_server(server, host, ips, ttl, try_timeout);
+        // the NXDOMAIN is the answer, no need to ask others
+        if (ret == error_success || ret == error_dns_no_answer) {
+            return ret;
+        }
+        tmss_warn("dns query failed, server={}, host={}, ret={}", server, host, ret);
+    }
+    return ret;
+}
+
+error_t StDnsResolver::query_server(const std::string& server, const std::string& host,
+        std::vector<std::string>& ips, uint32_t& ttl, utime_t timeout) {
+    error_t ret = error_success;
+
+    // header: id, flags with RD, one question
+    std::string request;
+    uint16_t id = random_engine() & 0xffff;
+    request.push_back(id >> 8);
+    request.push_back(id & 0xff);
+    request.push_back(0x01);
+    request.push_back(0x00);
+    const char counts[] = {0, 1, 0, 0, 0, 0, 0, 0};
+    request.append(counts, sizeof(counts));
+
+    // the labels of name
+    size_t pos = 0;
+    while (pos < host.size()) {
+        size_t end = host.find('.', pos);
+        if (end == std::string::npos) {
+            end = host.size();
+        }
+        size_t label = end - pos;
+        if (label == 0 || label > 63) {
+            return error_dns_resolve;
+        }
+        request.push_back(label);
+        request.append(host, pos, label);
+        pos = end + 1;
+    }
+    const char question[] = {0, 0, dns_type_a, 0, dns_class_in};
+    request.append(question, sizeof(question));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(dns_port);
+    addr.sin_addr.s_addr = inet_addr(server.c_str());
+
+    utime_t deadline = tmss::update_time() + timeout;
+    std::string response;
+    if ((ret = query_udp(addr, request, response, deadline)) != error_success) {
+        return ret;
+    }
+    if (dns_read_uint16(response.data() + 2) & dns_flag_tc) {
+        tmss_info("dns answer truncated, retry over tcp, server={}, host={}", server, host);
+        if ((ret = query_tcp(addr, request, response, deadline)) != error_success) {
+            return ret;
+        }
+    }
+    return parse_answer(response.data(), response.size(), ips, ttl);
+}
+
+error_t StDnsResolver::query_udp(const sockaddr_in& addr, const std::string& request,
+        std::string& response, utime_t deadline) {
+    error_t ret = error_success;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return error_socket_create;
+    }
+    st_netfd_t stfd = st_netfd_open_socket(sock);
+    if (stfd == nullptr) {
+        ::close(sock);
+        return error_socket_open;
+    }
+
+    utime_t timeout = deadline - tmss::update_time();
+    int size = request.size();
+    if (st_sendto(stfd, request.data(), size, (const sockaddr*)&addr, sizeof(addr), timeout) != size) {
+        st_netfd_close(stfd);
+        return error_socket_write;
+    }
+
+    ret = error_dns_timeout;
+    while (true) {
+        utime_t now = tmss::update_time();
+        if (now >= deadline) {
+            break;
+        }
+        char buf[dns_max_packet];
+        sockaddr_in from{};
+        int from_size = sizeof(from);
+        int nread = st_recvfrom(stfd, buf, sizeof(buf),
+            (sockaddr*)&from, &from_size, deadline - now);
+        if (nread < 0) {
+            ret = (errno == ETIME) ? error_dns_timeout : error_socket_read;
+            break;
+        }
+        // drop the packet not from server, or not the answer of our query
+        if (from.sin_addr.s_addr != addr.sin_addr.s_addr || from.sin_port != addr.sin_port
+            || nread < 12 || memcmp(buf, request.data(), 2) != 0) {
+            continue;
+        }
+        response.assign(buf, nread);
+        ret = error_success;
+        break;
+    }
+
+    st_netfd_close(stfd);
+    return ret;
+}
+
+error_t StDnsResolver::query_tcp(const sockaddr_in& addr, const std::string& request,
+        std::string& response, utime_t deadline) {
+    error_t ret = error_success;
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return error_socket_create;
+    }
+    st_netfd_t stfd = st_netfd_open_socket(sock);
+    if (stfd == nullptr) {
+        ::close(sock);
+        return error_socket_open;
+    }
+
+    // the message is prefixed by its 2 bytes length
+    char length[2];
+    length[0] = request.size() >> 8;
+    length[1] = request.size() & 0xff;
+    std::string message(length, sizeof(length));
+    message.append(request);
+
+    utime_t now = tmss::update_time();
+    if (now >= deadline
+        || st_connect(stfd, (const sockaddr*)&addr, sizeof(addr), deadline - now) != 0) {
+        st_netfd_close(stfd);
+        return error_dns_timeout;
+    }
+    now = tmss::update_time();
+    if (now >= deadline
+        || st_write(stfd, message.data(), message.size(), deadline - now) != (ssize_t)message.size()) {
+        st_netfd_close(stfd);
+        return error_socket_write;
+    }
+
+    ret = error_socket_read;
+    now = tmss::update_time();
+    if (now < deadline && st_read_fully(stfd, length, sizeof(length), deadline - now) == sizeof(length)) {
+        int size = dns_read_uint16(length);
+        response.resize(size);
+        now = tmss::update_time();
+        if (size >= 12 && now < deadline
+            && st_read_fully(stfd, &response[0], size, deadline - now) == size
+            && memcmp(response.data(), request.data(), 2) == 0) {
+            ret = error_success;
+        }
+    }
+
+    st_netfd_close(stfd);
+    return ret;
+}
+
+error_t StDnsResolver::parse_answer(const char* data, int size,
+        std::vector<std::string>& ips, uint32_t& ttl) {
+    uint16_t flags = dns_read_uint16(data + 2);
+    int rcode = flags & 0x0f;
+    int qdcount = dns_read_uint16(data + 4);
+    int ancount = dns_read_uint16(data + 6);
+    int nscount = dns_read_uint16(data + 8);
+    if (!(flags & 0x8000)) {
+        return error_dns_resolve;
+    }
+    if (rcode != 0 && rcode != dns_rcode_nxdomain) {
+        // SERVFAIL, REFUSED, ask the next server
+        tmss_warn("dns server failed, rcode={}", rcode);
+        return error_dns_resolve;
+    }
+
+    int pos = 12;
+    for (int i = 0; i < qdcount; i++) {
+        if (!dns_skip_name(data, size, pos) || pos + 4 > size) {
+            return error_dns_resolve;
+        }
+        pos += 4;
+    }
+
+    ips.clear();
+    ttl = dns_max_ttl;
+    uint32_t negative_ttl = dns_negative_ttl;
+    for (int i = 0; i < ancount + nscount; i++) {
+        if (!dns_skip_name(data, size, pos) || pos + 10 > size) {
+            return error_dns_resolve;
+        }
+        uint16_t type = dns_read_uint16(data + pos);
+        uint16_t rclass = dns_read_uint16(data + pos + 2);
+        uint32_t record_ttl = dns_read_uint32(data + pos + 4);
+        int rdlength = dns_read_uint16(data + pos + 8);
+        pos += 10;
+        if (pos + rdlength > size) {
+            return error_dns_resolve;
+        }
+
+        // the CNAME chain is followed by the recursive server, only take the A records
+        if (i < ancount && type == dns_type_a && rclass == dns_class_in && rdlength == 4) {
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, data + pos, ip, sizeof(ip));
+            ips.push_back(ip);
+            ttl = std::min(ttl, record_ttl);
+        } else if (i >= ancount && type == dns_type_soa) {
+            // the negative ttl is min(SOA ttl, SOA minimum), RFC 2308 5
+            int soa = pos;
+            if (dns_skip_name(data, size, soa) && dns_skip_name(data, size, soa)
+                && soa + 20 <= pos + rdlength) {
+                negative_ttl = std::min(record_ttl, dns_read_uint32(data + soa + 16));
+            }
+        }
+        pos += rdlength;
+    }
+
+    if (ips.empty()) {
+        ttl = negative_ttl;
+        return error_dns_no_answer;
+    }
+    return error_success;
+}
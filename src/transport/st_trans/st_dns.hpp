@@ -0,0 +1,89 @@
+/* Copyright [2019] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  weideng.
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <netinet/in.h>
+#include <st.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "defs/err.hpp"
+
+/**
+ * dns 解析，查询通过st的udp socket发出，不阻塞st线程上的其他协程
+ * the answer is cached by the ttl of records, the failure is cached too,
+ * the concurrent lookups of the same host wait for one query.
+ * @remark one resolver for each st thread, the st fd can not cross threads.
+ */
+class StDnsResolver {
+ public:
+    StDnsResolver();
+    virtual ~StDnsResolver();
+
+ public:
+    /**
+     * resolve the IPv4 addresses of host, the ip is returned as is.
+     * the short name is expanded by the search list of resolv.conf.
+     * @param timeout the timeout of the whole lookup in us.
+     */
+    error_t resolve(const std::string& host, std::vector<std::string>& ips,
+        utime_t timeout = 3 * 1000 * 1000);
+
+ public:
+    static std::shared_ptr<StDnsResolver> get_instance();
+
+ private:
+    struct DnsEntry {
+        std::vector<std::string> ips;
+        error_t ret = error_success;
+        // us, the entry is stale after it
+        utime_t expire_at = 0;
+        // a query is on the way, the others wait for it
+        bool resolving = false;
+        // created by the first waiter, destroyed by the last one
+        st_cond_t cond = nullptr;
+        int waiters = 0;
+    };
+
+    // try the names of search list in the order of ndots
+    error_t query(const std::string& host, std::vector<std::string>& ips,
+        uint32_t& ttl, utime_t timeout);
+    // ask the name servers in order, until one answers
+    error_t query_name(const std::string& name, std::vector<std::string>& ips,
+        uint32_t& ttl, utime_t timeout);
+    error_t query_server(const std::string& server, const std::string& name,
+        std::vector<std::string>& ips, uint32_t& ttl, utime_t timeout);
+    error_t query_udp(const sockaddr_in& addr, const std::string& request,
+        std::string& response, utime_t deadline);
+    // the truncated answer of udp is asked again over tcp, RFC 7766
+    error_t query_tcp(const sockaddr_in& addr, const std::string& request,
+        std::string& response, utime_t deadline);
+    // parse the answer of A query
+    error_t parse_answer(const char* data, int size,
+        std::vector<std::string>& ips, uint32_t& ttl);
+    void load_config();
+
+ private:
+    std::map<std::string, DnsEntry> cache;
+    // from /etc/resolv.conf
+    std::vector<std::string> nameservers;
+    std::vector<std::string> search;
+    // the name with fewer dots is tried with the search list first
+    int ndots;
+    // from /etc/hosts
+    std::map<std::string, std::vector<std::string>> hosts;
+    // the query id
+    std::mt19937 random_engine;
+};
@@ -11,12 +11,18 @@
 #include <srt/srt.h>
 #include <srt/udt.h>
 
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #include "st_srt.hpp"
 #include "log/log.hpp"
 #include "st_tcp.hpp"
+#include "coroutine/co_threads.hpp"
 
 static StSrtMode default_srt_mode = ST_SRT_MODE_FILE;
 
@@ -317,6 +323,19 @@ SRTSOCKET st_srt_accept(SRTSOCKET fd, struct sockaddr *addr, int *addrlen, utime
     return ret;
 }
 
+error_t st_srt_get_streamid(SRTSOCKET fd, std::string& streamid) {
+    // at most 512 bytes
+    char buf[512 + 1];
+    int size = sizeof(buf) - 1;
+    if (srt_getsockflag(fd, SRTO_STREAMID, buf, &size) == SRT_ERROR) {
+        tmss_error("[st_srt_get_streamid]: get streamid failed, fd:{}, err:{}",
+                   fd, srt_getlasterror_str());
+        return error_srt_socket_other;
+    }
+    streamid.assign(buf, size);
+    return error_success;
+}
+
 error_t st_srt_read(SRTSOCKET fd, void *buf, size_t nbyte, utime_t timeout, size_t& nread) {
     std::string err;
     int ret = error_success;
@@ -349,9 +368,31 @@ error_t st_srt_read(SRTSOCKET fd, void *buf, size_t nbyte, utime_t timeout, size
     return error_success;
 }
 
-error_t st_srt_write(SRTSOCKET fd, const void *buf, size_t nbyte, utime_t timeout, size_t& nwrite) {
+// send one message, wait until the socket is writable
+static error_t st_srt_sendmsg(SRTSOCKET fd, const char* buf, int size, utime_t timeout) {
     std::string err;
     int ret = error_success;
+    while ((ret = srt_sendmsg(fd, buf, size, -1, true)) == SRT_ERROR) {
+        int eno = 0;
+        if (st_srt_again(eno)) {
+            ret = st_srt_epoll(fd, ST_SRT_OUT, timeout, err);
+            if (ret != error_success) {
+                tmss_error("[st_srt_write]: srt write epoll failed, fd:{}, "
+                           "ret:{}, err:{}", fd, ret, err);
+                return ret;
+            }
+        } else {
+            err = srt_getlasterror_str();
+            tmss_error("[st_srt_write]: srt write socket addr failed, fd:{},"
+                       " errno:{}, err:{}", fd, eno, err);
+            return ret;
+        }
+    }
+    return error_success;
+}
+
+error_t st_srt_write(SRTSOCKET fd, const void *buf, size_t nbyte, utime_t timeout, size_t& nwrite) {
+    int ret = error_success;
 
     size_t has_send = 0;
 
@@ -363,24 +404,87 @@ error_t st_srt_write(SRTSOCKET fd, const void *buf, size_t nbyte, utime_t timeou
             next_send = SRT_LIVE_DEF_PLSIZE;
         }
 
-        while ((ret = srt_sendmsg(fd, reinterpret_cast<const char*>(buf) + has_send, next_send,
-                 -1, true)) == SRT_ERROR) {
-            int eno = 0;
-            if (st_srt_again(eno)) {
-                ret = st_srt_epoll(fd, ST_SRT_OUT, timeout, err);
+        ret = st_srt_sendmsg(fd, reinterpret_cast<const char*>(buf) + has_send, next_send, timeout);
+        if (ret != error_success) {
+            return ret;
+        }
+        has_send += next_send;
+    }
+    nwrite = has_send;
+    return error_success;
+}
+
+error_t st_srt_readv(SRTSOCKET fd, const struct iovec *iov, int iov_size,
+        utime_t timeout, size_t& nread) {
+    size_t total = 0;
+    for (int i = 0; i < iov_size; i++) {
+        total += iov[i].iov_len;
+    }
+    if (iov_size == 1 || (iov_size > 0 && iov[0].iov_len >= SRT_LIVE_MAX_PLSIZE)) {
+        return st_srt_read(fd, iov[0].iov_base, iov[0].iov_len, timeout, nread);
+    }
+
+    // the message is not split by srt, receive it whole and scatter
+    char msg[SRT_LIVE_MAX_PLSIZE];
+    size_t msg_size = 0;
+    int ret = st_srt_read(fd, msg, std::min(total, sizeof(msg)), timeout, msg_size);
+    if (ret != error_success) {
+        return ret;
+    }
+    size_t pos = 0;
+    for (int i = 0; i < iov_size && pos < msg_size; i++) {
+        size_t size = std::min(iov[i].iov_len, msg_size - pos);
+        memcpy(iov[i].iov_base, msg + pos, size);
+        pos += size;
+    }
+    nread = msg_size;
+    return error_success;
+}
+
+error_t st_srt_writev(SRTSOCKET fd, const struct iovec *iov, int iov_size,
+        utime_t timeout, size_t& nwrite) {
+    int ret = error_success;
+    size_t has_send = 0;
+    // the message across iovecs
+    char msg[SRT_LIVE_DEF_PLSIZE];
+    size_t msg_size = 0;
+
+    for (int i = 0; i < iov_size; i++) {
+        const char* p = static_cast<const char*>(iov[i].iov_base);
+        size_t left = iov[i].iov_len;
+        while (left > 0) {
+            if (msg_size == 0 && left >= SRT_LIVE_DEF_PLSIZE) {
+                // a whole message in the iovec, no copy
+                ret = st_srt_sendmsg(fd, p, SRT_LIVE_DEF_PLSIZE, timeout);
                 if (ret != error_success) {
-                    tmss_error("[st_srt_write]: srt write epoll failed, fd:{}, "
-                               "ret:{}, err:{}", fd, ret, err);
                     return ret;
                 }
-            } else {
-                err = srt_getlasterror_str();
-                tmss_error("[st_srt_write]: srt write socket addr failed, fd:{},"
-                           " errno:{}, err:{}", fd, eno, err);
-                return ret;
+                p += SRT_LIVE_DEF_PLSIZE;
+                left -= SRT_LIVE_DEF_PLSIZE;
+                has_send += SRT_LIVE_DEF_PLSIZE;
+                continue;
+            }
+            size_t size = std::min(left, sizeof(msg) - msg_size);
+            memcpy(msg + msg_size, p, size);
+            msg_size += size;
+            p += size;
+            left -= size;
+            if (msg_size == sizeof(msg)) {
+                ret = st_srt_sendmsg(fd, msg, msg_size, timeout);
+                if (ret != error_success) {
+                    return ret;
+                }
+                has_send += msg_size;
+                msg_size = 0;
             }
         }
-        has_send += ret;
+    }
+    if (msg_size > 0) {
+        ret = st_srt_sendmsg(fd, msg, msg_size, timeout);
+        if (ret != error_success) {
+            return ret;
+        }
+        has_send += msg_size;
     }
     nwrite = has_send;
     return error_success;
@@ -401,61 +505,6 @@ bool st_srt_again(int &err) {
     return err / 1000 == MJ_AGAIN;
 }
 
-int st_srt_stat(SRTSOCKET fd, std::string& res, SRT_TRACEBSTATS* perf) {
-    int ret = srt_bstats(fd, perf, 1);
-    if (ret == SRT_ERROR) {
-        return ret;
-    }
-
-    return st_srt_stat_print(res, perf);
-}
-
-int st_srt_stat_print(std::string& res, SRT_TRACEBSTATS* perf) {
-    std::stringstream in;
-
-    // 重传率
-    double re_send = st_srt_stat_retrans(perf, true);
-    double re_rcv  = st_srt_stat_retrans(perf, false);
-
-    // 丢包率
-    double send_loss = st_srt_stat_loss(perf, true);
-    double recv_loss = st_srt_stat_loss(perf, false);
-
-    in  << "rcv_drop_bytes: "  <<  perf->byteRcvDrop << "\t"
-        << "send_loss_bytes: " <<  perf->byteSndDrop << "\t"
-        << "send_re: "         <<  re_send   << "\t"
-        << "rcv_re: "          <<  re_rcv    << "\t"
-        << "send_loss: "       <<  send_loss << "\t"
-        << "recv_loss: "       <<  recv_loss << "\t"
-        << "send_app_bytes: "  <<  perf->byteSentUnique << "\t"
-        << "rcv_app_bytes: "   <<  perf->byteRecvUnique << "\t"
-        << "send_total_bytes: " <<  perf->byteSent << "\t"
-        << "rcv_total_bytes: "  <<  perf->byteRecv;
-
-    res =  in.str();
-    return error_success;
-}
-
-double st_srt_stat_loss(SRT_TRACEBSTATS* perf, bool is_send) {
-    if (is_send) {
-        return (perf->byteSentUnique > 0) ?
-            perf->byteSndDrop * 10000.0 / perf->byteSentUnique : 0.0;
-    } else {
-        return (perf->byteRecvUnique > 0) ?
-            perf->byteRcvDrop * 10000.0 / perf->byteRecvUnique : 0.0;
-    }
-}
-
-double st_srt_stat_retrans(SRT_TRACEBSTATS* perf, bool is_send) {
-    if (is_send) {
-        return (perf->byteSentUnique > 0) ?
-            (perf->byteSent - perf->byteSentUnique) * 10000.0 / perf->byteSentUnique : 0.0;
-    } else {
-        return (perf->byteRecvUnique > 0) ?
-            (perf->byteRecv - perf->byteRecvUnique) * 10000.0 / perf->byteRecvUnique : 0.0;
-    }
-}
-
 SrtEventCondition::SrtEventCondition(StSrtEvent evt) {
     cond        = st_cond_new();
     event       = evt;
@@ -466,10 +515,11 @@ SrtEventCondition::~SrtEventCondition() {
     st_cond_destroy(cond);
 }
 
-SrtStDispatch* SrtStDispatch::get_instance() {
-    thread_local SrtStDispatch* srt_dispatch = nullptr;
-    if (srt_dispatch == nullptr) {
-        srt_dispatch = new SrtStDispatch();
+std::shared_ptr<SrtStDispatch> SrtStDispatch::get_instance() {
+    // the coroutine holds it by shared_from_this
+    thread_local std::shared_ptr<SrtStDispatch> srt_dispatch = nullptr;
+    if (!srt_dispatch) {
+        srt_dispatch = std::make_shared<SrtStDispatch>();
         srt_dispatch->init();
     }
     return srt_dispatch;
@@ -477,19 +527,55 @@ SrtStDispatch* SrtStDispatch::get_instance() {
 
 SrtStDispatch::SrtStDispatch() : ICoroutineHandler("srt-dispatch") {
     cid        = get_ctx_id();
-    stop       = false;
+    stop.store(false, std::memory_order_relaxed);
     // coroutine  = new STCoroutine(std::string("srt-dispatch"), this, cid);
     srt_eid    = -1;
+    notify_fd  = -1;
+    notify_stfd = nullptr;
+    ack_fd     = -1;
+    waiter     = 0;
+    events.resize(1024);
 }
 
 SrtStDispatch::~SrtStDispatch() {
     // delete coroutine;
+    stop.store(true, std::memory_order_release);
+    if (waiter) {
+        // the waiter may wait for the ack
+        uint64_t ack = 1;
+        ::write(ack_fd, &ack, sizeof(ack));
+        pthread_join(waiter, nullptr);
+    }
+    if (notify_stfd) {
+        st_netfd_close(notify_stfd);
+    }
+    if (ack_fd >= 0) {
+        ::close(ack_fd);
+    }
 }
 
 int SrtStDispatch::init() {
     srt_eid = srt_epoll_create();
 
     srt_epoll_set(srt_eid, SRT_EPOLL_ENABLE_EMPTY);
+
+    notify_fd = eventfd(0, EFD_CLOEXEC);
+    ack_fd = eventfd(0, EFD_CLOEXEC);
+    if (notify_fd < 0 || ack_fd < 0) {
+        tmss_error("srt dispatch create eventfd failed, errno={}", errno);
+        return error_srt_socket_open;
+    }
+    notify_stfd = st_netfd_open(notify_fd);
+    if (notify_stfd == nullptr) {
+        tmss_error("srt dispatch open eventfd failed, errno={}", errno);
+        return error_srt_socket_open;
+    }
+    int ret = pthread_create(&waiter, nullptr, wait_thread, this);
+    if (ret != 0) {
+        waiter = 0;
+        tmss_error("srt dispatch create wait thread failed, ret={}", ret);
+        return error_srt_socket_open;
+    }
     return start();
 }
 
@@ -574,61 +660,103 @@ int SrtStDispatch::get_exits_evt(SRTSOCKET fd) {
     return old_evt;
 }
 
-error_t SrtStDispatch::cycle() {
-    const int len = 1024;
-    std::vector<SRT_EPOLL_EVENT> events(len);
-    while (!stop) {
-        int es = UDT::epoll_uwait(srt_eid, &events[0], len, 0);
-
-        for (int i = 0; i < es; ++i) {
-            SRT_EPOLL_EVENT& event = events[i];
-            auto it = conditions.find(event.fd);
-
-            // empty event removed from events
-            if (it == conditions.end()) {
-                tmss_error("unknow srt_fd:{}", event.fd);
-                UDT::epoll_remove_ssock(srt_eid, event.fd);
-            } else {
-                std::set<SrtEventCondition*>& sets = it->second;
-                int  err = 0;
-                const char* err_msg = nullptr;
+void SrtStDispatch::dispatch(const SRT_EPOLL_EVENT* events, int count) {
+    for (int i = 0; i < count; ++i) {
+        const SRT_EPOLL_EVENT& event = events[i];
+        auto it = conditions.find(event.fd);
 
-                if (event.events & StSrtEvent::ST_SRT_ERR) {
-                    SRT_SOCKSTATUS status = srt_getsockstate(event.fd);
-                    err_msg               = srt_getlasterror_str();
-                    err                   = st_srt_socket_error(status);
-                    tmss_error("epoll error srt_fd:{} status:{}, err:{}", event.fd, status, err);
-                }
+        // empty event removed from events
+        if (it == conditions.end()) {
+            tmss_error("unknow srt_fd:{}", event.fd);
+            UDT::epoll_remove_usock(srt_eid, event.fd);
+        } else {
+            std::set<SrtEventCondition*>& sets = it->second;
+            int  err = 0;
+            const char* err_msg = nullptr;
+
+            if (event.events & StSrtEvent::ST_SRT_ERR) {
+                SRT_SOCKSTATUS status = srt_getsockstate(event.fd);
+                err_msg               = srt_getlasterror_str();
+                err                   = st_srt_socket_error(status);
+                tmss_error("epoll error srt_fd:{} status:{}, err:{}", event.fd, status, err);
+            }
 
-                for (auto e = sets.begin(); e != sets.end(); ) {
-                    SrtEventCondition* cnd = *e;
-                    bool notify = false;
+            for (auto e = sets.begin(); e != sets.end(); ) {
+                SrtEventCondition* cnd = *e;
+                bool notify = false;
 
-                    // error event notify all the socket
-                    if (event.events & StSrtEvent::ST_SRT_ERR) {
-                        cnd->err      = err;
-                        cnd->err_msg  = err_msg;
+                // error event notify all the socket
+                if (event.events & StSrtEvent::ST_SRT_ERR) {
+                    cnd->err      = err;
+                    cnd->err_msg  = err_msg;
+                    notify = true;
+                } else {
+                    if (event.events & cnd->event) {
                         notify = true;
-                    } else {
-                        if (event.events & cnd->event) {
-                            notify = true;
-                        }
-                    }
-
-                    if (notify) {
-                        sets.erase(e++);
-                        st_cond_broadcast(cnd->cond);
-                    } else {
-                        e++;
                     }
                 }
 
-                if (it->second.empty()) {
-                    conditions.erase(it);
+                if (notify) {
+                    sets.erase(e++);
+                    st_cond_broadcast(cnd->cond);
+                } else {
+                    e++;
                 }
             }
+
+            if (it->second.empty()) {
+                conditions.erase(it);
+            }
+        }
+    }
+}
+
+void* SrtStDispatch::wait_thread(void* arg) {
+    SrtStDispatch* self = static_cast<SrtStDispatch*>(arg);
+    StThreadName tn("srt-epoll");
+    const int len = static_cast<int>(self->events.size());
+    while (!self->stop.load(std::memory_order_acquire)) {
+        // the timeout is only to check stop, the events wake it at once
+        int es = UDT::epoll_uwait(self->srt_eid, &self->events[0], len, 1000);
+        if (es <= 0) {
+            if (es < 0) {
+                tmss_error("srt epoll wait failed, eid:{}, err:{}", self->srt_eid, srt_getlasterror_str());
+                usleep(10 * 1000);
+            }
+            continue;
+        }
+
+        uint64_t count = es;
+        if (::write(self->notify_fd, &count, sizeof(count)) != sizeof(count)) {
+            tmss_error("srt dispatch notify failed, errno={}", errno);
+            continue;
+        }
+        // the level triggered events are the same before st updates them
+        uint64_t ack = 0;
+        while (::read(self->ack_fd, &ack, sizeof(ack)) < 0 && errno == EINTR) {
+        }
+    }
+    return nullptr;
+}
+
+error_t SrtStDispatch::cycle() {
+    while (!stop.load(std::memory_order_acquire)) {
+        uint64_t count = 0;
+        ssize_t nread = st_read(notify_stfd, &count, sizeof(count), ST_UTIME_NO_TIMEOUT);
+        if (nread != sizeof(count)) {
+            tmss_error("srt dispatch read eventfd failed, nread={}, errno={}", nread, errno);
+            return error_srt_socket_read;
+        }
+
+        dispatch(&events[0], static_cast<int>(count));
+
+        // let the notified coroutines run, they update or remove the events of fd
+        st_usleep(0);
+
+        uint64_t ack = 1;
+        if (::write(ack_fd, &ack, sizeof(ack)) != sizeof(ack)) {
+            tmss_error("srt dispatch ack failed, errno={}", errno);
         }
-        st_usleep(10 * 1000);
     }
     return error_success;
 }
@@ -11,11 +11,16 @@
 #pragma once
 
 #include <srt/srt.h>
+#include <pthread.h>
 #include <st.h>
+#include <sys/uio.h>
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "defs/err.hpp"
 #include "coroutine/coroutine.hpp"
@@ -51,17 +56,19 @@ error_t    st_srt_connect(SRTSOCKET fd, const std::string& server, int port,
 error_t    st_srt_listen(SRTSOCKET fd, const std::string& server, int port,
                          int back_log, bool reuse_port = true);
 SRTSOCKET  st_srt_accept(SRTSOCKET fd, struct sockaddr *addr, int *addrlen, utime_t timeout);
+// 客户端连接时设置的streamid, 如 #!::r=live/stream,m=publish
+error_t    st_srt_get_streamid(SRTSOCKET fd, std::string& streamid);
 error_t    st_srt_read(SRTSOCKET fd, void *buf, size_t nbyte, utime_t timeout, size_t& nread);
 error_t    st_srt_write(SRTSOCKET fd, const void *buf, size_t nbyte, utime_t timeout, size_t& nwrite);
+// 一次收一个消息, 分散到iov, live模式下iov总长度应不小于一个消息
+error_t    st_srt_readv(SRTSOCKET fd, const struct iovec *iov, int iov_size,
+                        utime_t timeout, size_t& nread);
+// 与写入各iov拼接后的数据相同, 按payload size切分消息, 只拷贝跨iov的消息
+error_t    st_srt_writev(SRTSOCKET fd, const struct iovec *iov, int iov_size,
+                         utime_t timeout, size_t& nwrite);
 error_t    st_srt_close(SRTSOCKET& fd);
 bool       st_srt_again(int &err);
 
-// srt stat
-int        st_srt_stat(SRTSOCKET fd, std::string& res, SRT_TRACEBSTATS* perf);
-int        st_srt_stat_print(std::string& res, SRT_TRACEBSTATS* perf);
-double     st_srt_stat_loss(SRT_TRACEBSTATS* perf, bool is_send);
-double     st_srt_stat_retrans(SRT_TRACEBSTATS* perf, bool is_send);
-
 class SrtEventCondition {
  public:
     explicit SrtEventCondition(StSrtEvent event);
@@ -76,10 +83,12 @@ class SrtEventCondition {
 
 /**
  * st 的各种信息回调，需要线程级别隔离
+ * 每个st线程一个分发器, 各带一个等待线程阻塞在srt epoll上, 有事件时通过eventfd唤醒st线程,
+ * st线程处理完事件(被唤醒的协程已更新关注的事件)后再应答, 等待线程才继续等待, 不轮询
  */
 class SrtStDispatch : public ICoroutineHandler {
  public:
-    static SrtStDispatch* get_instance();
+    static std::shared_ptr<SrtStDispatch> get_instance();
 
  public:
     SrtStDispatch();
@@ -93,6 +102,10 @@ class SrtStDispatch : public ICoroutineHandler {
 
  private:
     int get_exits_evt(SRTSOCKET fd);
+    // 唤醒等待事件的协程
+    void dispatch(const SRT_EPOLL_EVENT* events, int count);
+    // 等待线程, 不在st上运行
+    static void* wait_thread(void* arg);
 
  public:
     error_t cycle() override;
@@ -102,7 +115,16 @@ class SrtStDispatch : public ICoroutineHandler {
     int cid;
     // STCoroutine* coroutine;
     std::map<SRTSOCKET, std::set<SrtEventCondition*> > conditions;
-    bool stop;
+    // 由析构写入, 等待线程读取
+    std::atomic<bool> stop;
+    // 等待线程写入事件数目, st线程读取
+    int notify_fd;
+    st_netfd_t notify_stfd;
+    // st线程处理完事件后写入, 等待线程阻塞读取
+    int ack_fd;
+    pthread_t waiter;
+    // 等待线程写入, 应答前只有st线程读取
+    std::vector<SRT_EPOLL_EVENT> events;
 };
 
 class StSrtSocket : public IReaderWriter {
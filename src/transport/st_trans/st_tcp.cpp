@@ -11,13 +11,18 @@
 #include "st_tcp.hpp"
 
 #include <arpa/inet.h>
+#include <linux/filter.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <poll.h>
 #include <string.h>
+#include <sys/sendfile.h>
 
 #include <string>
+#include <vector>
 
 #include "log/log.hpp"
+#include "st_dns.hpp"
 
 
 st_netfd_t st_open_socket_only(int fd) {
@@ -29,22 +34,11 @@ void st_free_socket_only(st_netfd_t fd) {
 }
 
 std::string dns_resolve(const std::string& host) {
-    if (inet_addr(host.c_str()) != INADDR_NONE) {
-        return host;
-    }
-
-    hostent* answer = gethostbyname(host.c_str());
-    if (answer == nullptr) {
+    std::vector<std::string> ips;
+    if (StDnsResolver::get_instance()->resolve(host, ips) != error_success || ips.empty()) {
         return "";
     }
-
-    char ipv4[16];
-    memset(ipv4, 0, sizeof(ipv4));
-    if (0 < answer->h_length) {
-        inet_ntop(AF_INET, answer->h_addr_list[0], ipv4, sizeof(ipv4));
-    }
-
-    return ipv4;
+    return ips[0];
 }
 
 int st_tcp_fd(st_netfd_t fd) {
@@ -79,18 +73,17 @@ error_t st_tcp_close(st_netfd_t& fd) {
     return error_success;
 }
 
-error_t st_tcp_listen(const std::string& server, int port,
-                      int back_log, st_netfd_t& fd, bool reuse_port) {
-    error_t ret = st_tcp_create_fd(fd);
-
-    if (ret != error_success) {
-        return ret;
+error_t st_tcp_listen_fd(const std::string& server, int port,
+                         int back_log, int& fd, bool reuse_port) {
+    error_t ret = error_success;
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return error_socket_create;
     }
 
     addrinfo  hints{};
     char      sport[8];
     addrinfo* r       = nullptr;
-    int       fileno  = st_netfd_fileno(fd);
 
     snprintf(sport, sizeof(sport), "%d", port);
     memset(&hints, 0, sizeof(hints));
@@ -98,12 +91,12 @@ error_t st_tcp_listen(const std::string& server, int port,
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags    = AI_NUMERICHOST;
 
-    if ((ret = st_tcp_fd_reuseaddr(fileno)) != error_success) {
+    if ((ret = st_tcp_fd_reuseaddr(fd)) != error_success) {
         goto failed;
     }
 
     if (reuse_port) {
-        if ((ret = st_tcp_fd_reuseport(fileno)) != error_success) {
+        if ((ret = st_tcp_fd_reuseport(fd)) != error_success) {
             goto failed;
         }
     }
@@ -113,22 +106,42 @@ error_t st_tcp_listen(const std::string& server, int port,
         goto failed;
     }
 
-    if (::bind(fileno, r->ai_addr, r->ai_addrlen) == -1) {
+    if (::bind(fd, r->ai_addr, r->ai_addrlen) == -1) {
         ret = error_socket_bind;
         goto failed;
     }
 
-    if (::listen(fileno, back_log) == -1) {
+    if (::listen(fd, back_log) == -1) {
         ret = error_socket_listen;
         goto failed;
     }
 
-    free(r);
+    freeaddrinfo(r);
     return ret;
 
 failed:
-    st_tcp_close(fd);
-    free(r);
+    ::close(fd);
+    fd = -1;
+    if (r) {
+        freeaddrinfo(r);
+    }
+    return ret;
+}
+
+error_t st_tcp_listen(const std::string& server, int port,
+                      int back_log, st_netfd_t& fd, bool reuse_port) {
+    fd = nullptr;
+    int sock = -1;
+    error_t ret = st_tcp_listen_fd(server, port, back_log, sock, reuse_port);
+    if (ret != error_success) {
+        return ret;
+    }
+
+    fd = st_tcp_open_fd(sock);
+    if (fd == nullptr) {
+        ::close(sock);
+        return error_socket_open;
+    }
     return ret;
 }
 
@@ -193,6 +206,34 @@ error_t st_tcp_writev(st_netfd_t stfd, const iovec *iov,
     return n;
 }
 
+error_t st_tcp_sendfile(st_netfd_t stfd, int in_fd, off_t offset,
+                        size_t nbyte, utime_t timeout) {
+    int fd = st_netfd_fileno(stfd);
+    size_t left = nbyte;
+    while (left > 0) {
+        ssize_t n = sendfile(fd, in_fd, &offset, left);
+        if (n > 0) {
+            left -= n;
+            continue;
+        }
+        if (n == 0) {
+            // the file is shorter than nbyte
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN) {
+            return -1;
+        }
+        // the socket is full, other coroutines run until it is writable
+        if (st_netfd_poll(stfd, POLLOUT, timeout) < 0) {
+            return -1;
+        }
+    }
+    return nbyte - left;
+}
+
 error_t st_tcp_fd_reuseaddr(int fd, int enable) {
     if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int)) == -1) {
         return error_socket_set_resuse;
@@ -209,6 +250,20 @@ error_t st_tcp_fd_reuseport(int fd) {
     return error_success;
 }
 
+error_t st_tcp_fd_reuseport_cpu(int fd, int group_size) {
+    // the index of socket in the reuseport group = the cpu of softirq % group_size
+    sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)group_size },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    sock_fprog prog = { sizeof(code) / sizeof(code[0]), code };
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == -1) {
+        return error_socket_set_resuse;
+    }
+    return error_success;
+}
+
 StTcpSocket::StTcpSocket(st_netfd_t stfd) {
     this->stfd = stfd;
     rtm = stm = ST_UTIME_NO_TIMEOUT;
@@ -31,7 +31,8 @@ st_netfd_t   st_open_socket_only(int fd);
 void         st_free_socket_only(st_netfd_t fd);
 
 /**
- * dns 解析域名
+ * dns 解析域名, 不阻塞st线程, 结果按ttl缓存
+ * @see StDnsResolver
  */
 std::string dns_resolve(const std::string& host);
 
@@ -46,6 +47,9 @@ st_netfd_t    st_tcp_open_fd(int fd);
 // 释放stfd，同时关闭文件句柄
 error_t       st_tcp_close(st_netfd_t& fd);
 
+// 只创建监听的文件句柄fd，不生成st句柄, eg. 在其他线程上用st_tcp_open_fd打开
+error_t    st_tcp_listen_fd(const std::string& server, int port,
+                            int back_log, int& fd, bool reuse_port = true);
 error_t    st_tcp_listen(const std::string& server, int port,
                          int back_log, st_netfd_t& fd, bool reuse_port = true);
 error_t    st_tcp_connect(const std::string& server, int port,
@@ -62,9 +66,14 @@ error_t    st_tcp_write(st_netfd_t stfd, const void *buf,
 
 error_t    st_tcp_writev(st_netfd_t stfd, const iovec *iov, int iov_size,
                          utime_t timeout);
+// 从文件fd直接发送到socket, 不经过用户态拷贝, 发送缓冲区满时等待可写, 返回发送的字节数
+error_t    st_tcp_sendfile(st_netfd_t stfd, int in_fd, off_t offset,
+                           size_t nbyte, utime_t timeout);
 
 error_t    st_tcp_fd_reuseaddr(int fd, int enable = 1);
 error_t    st_tcp_fd_reuseport(int fd);
+// reuseport组内按软中断所在cpu选择socket, 第i个bind的socket接收cpu % group_size == i的连接
+error_t    st_tcp_fd_reuseport_cpu(int fd, int group_size);
 
 
 class StTcpSocket : public IReaderWriter {
@@ -0,0 +1,532 @@
+/* Copyright [2019] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  weideng.
+ *
+ * =====================================================================================
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "st_uring.hpp"
+#include "log/log.hpp"
+
+// the sqes of one batch, the cq is larger for the multishot ops
+const unsigned uring_entries = 4096;
+const unsigned uring_cq_entries = uring_entries * 4;
+// the provided buffers of recv, shared by all sockets of the thread, power of 2
+const int uring_recv_buf_count = 512;
+const int uring_recv_buf_size = TMSS_IO_BLOCK_SIZE;
+const int uring_buf_group = 0;
+// the received bytes not read yet, the peer can not grow them without limit
+const int uring_recv_high_water = 4 * uring_recv_buf_size;
+// the registered buffers of the segment sends, read from file and sent from them
+const int uring_fixed_buf_count = 16;
+const int uring_fixed_buf_size = 256 * 1024;
+
+static int uring_setup(unsigned entries, struct io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+        nullptr, _NSIG / 8));
+}
+
+static int uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+StUringOp::StUringOp() {
+    cond      = st_cond_new();
+    res       = 0;
+    flags     = 0;
+    done      = false;
+    in_flight = false;
+    orphan    = false;
+    cancel_requested = false;
+    canceling = false;
+}
+
+StUringOp::~StUringOp() {
+    st_cond_destroy(cond);
+}
+
+void StUringOp::on_complete(int res, uint32_t flags, const char* buf) {
+    this->res = res;
+    this->flags = flags;
+    done = true;
+    if (!(flags & IORING_CQE_F_MORE)) {
+        in_flight = false;
+    }
+    st_cond_signal(cond);
+}
+
+StUringRecvOp::StUringRecvOp() {
+    eof       = false;
+    err       = 0;
+    multishot = false;
+}
+
+void StUringRecvOp::on_complete(int res, uint32_t flags, const char* buf) {
+    if (res > 0 && buf) {
+        data.append(buf, res);
+        if ((flags & IORING_CQE_F_MORE) && data.size() >= uring_recv_high_water) {
+            cancel_requested = true;
+        }
+    } else if (res == 0) {
+        eof = true;
+    } else if (res != -ENOBUFS && res != -ECANCELED) {
+        // no buffer in ring, armed again when the data is read
+        err = -res;
+    }
+    StUringOp::on_complete(res, flags, buf);
+}
+
+StUringAcceptOp::StUringAcceptOp() {
+    err = 0;
+}
+
+StUringAcceptOp::~StUringAcceptOp() {
+    for (auto fd : fds) {
+        ::close(fd);
+    }
+}
+
+void StUringAcceptOp::on_complete(int res, uint32_t flags, const char* buf) {
+    if (res >= 0) {
+        fds.push_back(res);
+    } else if (res != -ECANCELED) {
+        err = -res;
+    }
+    StUringOp::on_complete(res, flags, buf);
+}
+
+StUringSubmitter::StUringSubmitter(StUring* uring) : ICoroutineHandler("uring-submit") {
+    this->uring = uring;
+    cond = st_cond_new();
+    scheduled = false;
+}
+
+void StUringSubmitter::schedule() {
+    if (scheduled) {
+        return;
+    }
+    scheduled = true;
+    // run at the tail of the ready coroutines
+    st_cond_signal(cond);
+}
+
+error_t StUringSubmitter::cycle() {
+    while (true) {
+        while (!scheduled) {
+            st_cond_wait(cond);
+        }
+        scheduled = false;
+        uring->flush();
+    }
+    return error_success;
+}
+
+std::shared_ptr<StUring> StUring::get_instance() {
+    // the coroutine holds it by shared_from_this
+    thread_local std::shared_ptr<StUring> uring = nullptr;
+    thread_local bool inited = false;
+    if (!inited) {
+        inited = true;
+        std::shared_ptr<StUring> ins = std::make_shared<StUring>();
+        int ret = ins->init();
+        if (ret != error_success) {
+            tmss_warn("io_uring is not supported, ret={}", ret);
+        } else {
+            uring = ins;
+        }
+    }
+    return uring;
+}
+
+StUring::StUring() : ICoroutineHandler("uring-reap") {
+    ring_fd    = -1;
+    memset(&params, 0, sizeof(params));
+    sq_ptr     = nullptr;
+    sq_size    = 0;
+    cq_ptr     = nullptr;
+    cq_size    = 0;
+    sqes       = nullptr;
+    sqes_size  = 0;
+    sq_head    = sq_tail = sq_array = nullptr;
+    sq_mask    = 0;
+    sqe_tail   = 0;
+    cq_head    = cq_tail = nullptr;
+    cq_mask    = 0;
+    cqes       = nullptr;
+    buf_ring   = nullptr;
+    recv_bufs  = nullptr;
+    buf_tail   = 0;
+    fixed_bufs = nullptr;
+    event_fd   = -1;
+    event_stfd = nullptr;
+    stop       = false;
+}
+
+StUring::~StUring() {
+    stop = true;
+    if (event_stfd) {
+        st_netfd_close(event_stfd);
+    }
+    // the kernel cancels all requests of the ring
+    if (ring_fd >= 0) {
+        ::close(ring_fd);
+    }
+    if (sqes) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ptr && cq_ptr != sq_ptr) {
+        munmap(cq_ptr, cq_size);
+    }
+    if (sq_ptr) {
+        munmap(sq_ptr, sq_size);
+    }
+    free(buf_ring);
+    free(recv_bufs);
+    free(fixed_bufs);
+}
+
+int StUring::init() {
+    int ret = error_success;
+    if ((ret = setup_rings()) != error_success) {
+        return ret;
+    }
+    if ((ret = setup_buffers()) != error_success) {
+        return ret;
+    }
+
+    event_fd = eventfd(0, EFD_CLOEXEC);
+    if (event_fd < 0) {
+        tmss_error("uring create eventfd failed, errno={}", errno);
+        return error_uring_setup;
+    }
+    if (uring_register(ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1) < 0) {
+        tmss_error("uring register eventfd failed, errno={}", errno);
+        ::close(event_fd);
+        return error_uring_register;
+    }
+    event_stfd = st_netfd_open(event_fd);
+    if (event_stfd == nullptr) {
+        tmss_error("uring open eventfd failed, errno={}", errno);
+        ::close(event_fd);
+        return error_uring_setup;
+    }
+
+    submitter = std::make_shared<StUringSubmitter>(this);
+    if ((ret = submitter->start()) != error_success) {
+        return ret;
+    }
+    return start();
+}
+
+int StUring::setup_rings() {
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = uring_cq_entries;
+    ring_fd = uring_setup(uring_entries, &params);
+    if (ring_fd < 0) {
+        tmss_error("uring setup failed, errno={}", errno);
+        return error_uring_setup;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_size = cq_size = std::max(sq_size, cq_size);
+    }
+
+    sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) {
+        sq_ptr = nullptr;
+        tmss_error("uring mmap sq failed, errno={}", errno);
+        return error_uring_setup;
+    }
+    if (single_mmap) {
+        cq_ptr = sq_ptr;
+    } else {
+        cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) {
+            cq_ptr = nullptr;
+            tmss_error("uring mmap cq failed, errno={}", errno);
+            return error_uring_setup;
+        }
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* p = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd, IORING_OFF_SQES);
+    if (p == MAP_FAILED) {
+        tmss_error("uring mmap sqes failed, errno={}", errno);
+        return error_uring_setup;
+    }
+    sqes = static_cast<io_uring_sqe*>(p);
+
+    char* sq = static_cast<char*>(sq_ptr);
+    sq_head  = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+    sq_tail  = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    sq_mask  = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+    sqe_tail = *sq_tail;
+    // the sqes are used in order, the index array never changes
+    for (uint32_t i = 0; i < params.sq_entries; i++) {
+        sq_array[i] = i;
+    }
+
+    char* cq = static_cast<char*>(cq_ptr);
+    cq_head = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    cqes    = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return error_success;
+}
+
+int StUring::setup_buffers() {
+    size_t page = sysconf(_SC_PAGESIZE);
+    void* p = nullptr;
+    if (posix_memalign(&p, page, uring_recv_buf_count * sizeof(io_uring_buf)) != 0) {
+        return error_uring_setup;
+    }
+    memset(p, 0, uring_recv_buf_count * sizeof(io_uring_buf));
+    buf_ring = static_cast<io_uring_buf_ring*>(p);
+    size_t size = static_cast<size_t>(uring_recv_buf_count) * uring_recv_buf_size;
+    if (posix_memalign(&p, page, size) != 0) {
+        return error_uring_setup;
+    }
+    recv_bufs = static_cast<char*>(p);
+
+    // since linux 5.19, with the multishot accept
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+    reg.ring_entries = uring_recv_buf_count;
+    reg.bgid = uring_buf_group;
+    if (uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        tmss_error("uring register buffer ring failed, errno={}", errno);
+        return error_uring_register;
+    }
+    for (int i = 0; i < uring_recv_buf_count; i++) {
+        recycle_buffer(i);
+    }
+
+    // only the large sends from file use them, the small writes are never copied
+    size = static_cast<size_t>(uring_fixed_buf_count) * uring_fixed_buf_size;
+    if (posix_memalign(&p, page, size) != 0) {
+        return error_uring_setup;
+    }
+    fixed_bufs = static_cast<char*>(p);
+    std::vector<iovec> iovs(uring_fixed_buf_count);
+    for (int i = 0; i < uring_fixed_buf_count; i++) {
+        iovs[i].iov_base = fixed_bufs + static_cast<size_t>(i) * uring_fixed_buf_size;
+        iovs[i].iov_len = uring_fixed_buf_size;
+    }
+    if (uring_register(ring_fd, IORING_REGISTER_BUFFERS, iovs.data(), uring_fixed_buf_count) < 0) {
+        // such as the memlock limit, the files are sent by the copy of conn
+        tmss_warn("uring register buffers failed, errno={}", errno);
+        return error_success;
+    }
+    for (int i = uring_fixed_buf_count - 1; i >= 0; i--) {
+        free_fixed_bufs.push_back(i);
+    }
+    return error_success;
+}
+
+io_uring_sqe* StUring::get_sqe(StUringOp* op) {
+    if (ring_fd < 0 || stop) {
+        return nullptr;
+    }
+    if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+        flush();
+        if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+            tmss_error("uring sq is full");
+            return nullptr;
+        }
+    }
+    io_uring_sqe* sqe = &sqes[sqe_tail & sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+    sqe_tail++;
+    if (op) {
+        op->done = false;
+        op->in_flight = true;
+        op->cancel_requested = false;
+        op->canceling = false;
+    }
+    return sqe;
+}
+
+void StUring::submit() {
+    submitter->schedule();
+}
+
+int StUring::wait(StUringOp* op, utime_t timeout) {
+    submit();
+    while (!op->done) {
+        if (st_cond_timedwait(op->cond, timeout) == 0) {
+            continue;
+        }
+        int err = errno;
+        cancel(op);
+        // the kernel may use the memory of op until the last cqe
+        while (op->in_flight) {
+            st_cond_wait(op->cond);
+        }
+        errno = err;
+        return (err == ETIME) ? error_socket_timeout : error_cothread_interrupt;
+    }
+    return error_success;
+}
+
+void StUring::cancel(StUringOp* op) {
+    io_uring_sqe* sqe = get_sqe(nullptr);
+    if (sqe == nullptr) {
+        return;
+    }
+    op->canceling = true;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(op);
+    submit();
+}
+
+void StUring::release(StUringOp* op) {
+    if (!op->in_flight) {
+        delete op;
+        return;
+    }
+    op->orphan = true;
+    cancel(op);
+}
+
+int StUring::get_buffer_group() {
+    return uring_buf_group;
+}
+
+int StUring::alloc_fixed(char*& buf, int& size) {
+    if (free_fixed_bufs.empty()) {
+        return -1;
+    }
+    int index = free_fixed_bufs.back();
+    free_fixed_bufs.pop_back();
+    buf = fixed_bufs + static_cast<size_t>(index) * uring_fixed_buf_size;
+    size = uring_fixed_buf_size;
+    return index;
+}
+
+void StUring::free_fixed(int index) {
+    free_fixed_bufs.push_back(index);
+}
+
+int StUring::flush() {
+    uint32_t to_submit = sqe_tail - *sq_tail;
+    if (to_submit == 0) {
+        return error_success;
+    }
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+    int retry = 0;
+    while (to_submit > 0) {
+        int ret = uring_enter(ring_fd, to_submit, 0, 0);
+        if (ret >= 0) {
+            to_submit -= ret;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if ((errno == EBUSY || errno == EAGAIN) && retry++ < 3) {
+            // the cq overflows, make room and try again
+            reap();
+            continue;
+        }
+        tmss_error("uring submit failed, count={}, errno={}", to_submit, errno);
+        return error_uring_submit;
+    }
+    return error_success;
+}
+
+int StUring::reap() {
+    int count = 0;
+    uint32_t head = *cq_head;
+    while (true) {
+        uint32_t tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            break;
+        }
+        for (; head != tail; head++) {
+            io_uring_cqe* cqe = &cqes[head & cq_mask];
+            StUringOp* op = reinterpret_cast<StUringOp*>(cqe->user_data);
+            int res = cqe->res;
+            uint32_t flags = cqe->flags;
+            count++;
+
+            int bid = -1;
+            const char* buf = nullptr;
+            if (flags & IORING_CQE_F_BUFFER) {
+                bid = flags >> IORING_CQE_BUFFER_SHIFT;
+                buf = recv_bufs + static_cast<size_t>(bid) * uring_recv_buf_size;
+            }
+            // the cancel has no op
+            if (op) {
+                op->on_complete(res, flags, buf);
+                if (op->orphan && !op->in_flight) {
+                    delete op;
+                } else if (op->cancel_requested && op->in_flight && !op->canceling) {
+                    cancel(op);
+                }
+            }
+            if (bid >= 0) {
+                recycle_buffer(bid);
+            }
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+    return count;
+}
+
+void StUring::recycle_buffer(int bid) {
+    // not buf_ring->bufs, the flex array of the header is after an empty struct in c++,
+    // it is 8 bytes later than the entries seen by kernel
+    io_uring_buf* bufs = reinterpret_cast<io_uring_buf*>(buf_ring);
+    io_uring_buf* buf = &bufs[buf_tail & (uring_recv_buf_count - 1)];
+    char* p = recv_bufs + static_cast<size_t>(bid) * uring_recv_buf_size;
+    buf->addr = reinterpret_cast<uint64_t>(p);
+    buf->len = uring_recv_buf_size;
+    buf->bid = bid;
+    buf_tail++;
+    __atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+}
+
+error_t StUring::cycle() {
+    while (!stop) {
+        reap();
+
+        // the cqes after reap also count in the eventfd
+        uint64_t count = 0;
+        ssize_t nread = st_read(event_stfd, &count, sizeof(count), ST_UTIME_NO_TIMEOUT);
+        if (nread != sizeof(count)) {
+            tmss_error("uring read eventfd failed, nread={}, errno={}", nread, errno);
+            return error_socket_read;
+        }
+    }
+    return error_success;
+}
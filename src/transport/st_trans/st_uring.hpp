@@ -0,0 +1,202 @@
+/* Copyright [2019] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021/7
+ *        Author:  weideng.
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <linux/io_uring.h>
+#include <st.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "defs/err.hpp"
+#include "coroutine/coroutine.hpp"
+#include "io/io_buf.hpp"
+
+/**
+ * an operation submitted to io_uring, the result is set by the reaper coroutine,
+ * the coroutine of owner waits on cond.
+ * the multishot op posts results until the cqe without IORING_CQE_F_MORE.
+ */
+class StUringOp {
+ public:
+    StUringOp();
+    virtual ~StUringOp();
+
+ public:
+    /**
+     * called by the reaper for each cqe of the op.
+     * @param buf the provided buffer selected by the kernel, null if none,
+     *      it is given back to the ring after return.
+     */
+    virtual void on_complete(int res, uint32_t flags, const char* buf);
+
+ public:
+    st_cond_t cond;
+    int       res;
+    uint32_t  flags;
+    // a result is set since submitted
+    bool      done;
+    // submitted and the last cqe is not received
+    bool      in_flight;
+    // the owner is gone, deleted by the reaper at the last cqe
+    bool      orphan;
+    // set by on_complete, the reaper cancels the multishot op after it
+    bool      cancel_requested;
+    // the cancel is submitted, reset when the op is submitted again
+    bool      canceling;
+};
+
+/**
+ * the recv of a socket, the bytes of the selected buffer are copied to data,
+ * then the buffer goes back to the ring at once.
+ * the multishot recv is canceled when data reaches the high water, the owner
+ * arms it again after data is read.
+ */
+class StUringRecvOp : public StUringOp {
+ public:
+    StUringRecvOp();
+    ~StUringRecvOp() override = default;
+
+ public:
+    void on_complete(int res, uint32_t flags, const char* buf) override;
+
+ public:
+    tmss::IOBuf data;
+    bool eof;
+    // errno of the recv, no more cqe
+    int  err;
+    bool multishot;
+};
+
+/**
+ * the multishot accept of a listen socket, the accepted fds are queued.
+ */
+class StUringAcceptOp : public StUringOp {
+ public:
+    StUringAcceptOp();
+    ~StUringAcceptOp() override;
+
+ public:
+    void on_complete(int res, uint32_t flags, const char* buf) override;
+
+ public:
+    std::deque<int> fds;
+    int err;
+};
+
+class StUring;
+
+/**
+ * submit the queued sqes together, it is signaled by the first sqe and runs after
+ * the coroutines ready now, so the sqes of them are submitted by one io_uring_enter
+ */
+class StUringSubmitter : public ICoroutineHandler {
+ public:
+    explicit StUringSubmitter(StUring* uring);
+    ~StUringSubmitter() override = default;
+
+ public:
+    void schedule();
+    error_t cycle() override;
+
+ private:
+    StUring* uring;
+    st_cond_t cond;
+    bool scheduled;
+};
+
+/**
+ * io_uring of st thread, instead of the epoll of st for sockets.
+ * the sqes are submitted in batch, the cqes are reaped when the eventfd registered
+ * to the ring is readable by st, then the waiting coroutines are signaled.
+ * the multishot recv selects the buffers from a provided buffer ring, shared by all
+ * sockets of the thread, the sends are the writev of the iovecs of caller.
+ * the files are read to the registered buffers and sent from them.
+ * @remark needs linux 5.19 or later, get_instance returns null if not supported.
+ */
+class StUring : public ICoroutineHandler {
+ public:
+    static std::shared_ptr<StUring> get_instance();
+
+ public:
+    StUring();
+    ~StUring() override;
+
+ public:
+    int init();
+
+    // the sqe of op to fill, submitted later in batch, null if the ring is broken
+    io_uring_sqe* get_sqe(StUringOp* op);
+    // submit the sqes of this round, the op waits for its cqe after it
+    void submit();
+    // submit and wait the one shot op, it is canceled at timeout
+    int wait(StUringOp* op, utime_t timeout);
+    // cancel the op, it is in flight until its last cqe
+    void cancel(StUringOp* op);
+    // the owner does not use the op any more, deleted now or at the last cqe
+    void release(StUringOp* op);
+
+    // the provided buffers of multishot recv
+    int get_buffer_group();
+    // a registered buffer of READ_FIXED and WRITE_FIXED, -1 if all are used
+    int alloc_fixed(char*& buf, int& size);
+    void free_fixed(int index);
+
+    // io_uring_enter for the queued sqes
+    int flush();
+
+ public:
+    error_t cycle() override;
+
+ private:
+    int setup_rings();
+    int setup_buffers();
+    // handle the cqes, return the count
+    int reap();
+    void recycle_buffer(int bid);
+
+ private:
+    int ring_fd;
+    struct io_uring_params params;
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t  sq_mask;
+    uint32_t* sq_array;
+    // the sqes filled, not seen by kernel until flush
+    uint32_t  sqe_tail;
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t  cq_mask;
+    io_uring_cqe* cqes;
+
+    // the provided buffer ring
+    io_uring_buf_ring* buf_ring;
+    char* recv_bufs;
+    uint16_t buf_tail;
+
+    // the registered buffers
+    char* fixed_bufs;
+    std::vector<int> free_fixed_bufs;
+
+    int event_fd;
+    st_netfd_t event_stfd;
+    std::shared_ptr<StUringSubmitter> submitter;
+    bool stop;
+};
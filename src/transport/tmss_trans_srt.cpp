@@ -8,12 +8,41 @@
  * =====================================================================================
  */
 #include <tmss_trans_srt.hpp>
+
+#include <sstream>
+#include <vector>
+
 #include <defs/err.hpp>
 #include <log/log.hpp>
+#include <util/timer.hpp>
+#include <util/util.hpp>
 #include <protocol/server.hpp>
 
 namespace tmss {
-SRTServerConn::SRTServerConn() {
+const utime_t srt_stat_interval_us = 1000 * 1000;
+// the congestion falls after the stats keep low for it
+const utime_t srt_congestion_hold_us = 3 * 1000 * 1000;
+// the unacked data in send buffer, and the loss percent of the packets sent
+const int srt_light_send_buf_ms = 250;
+const int srt_heavy_send_buf_ms = 1000;
+const double srt_light_send_loss = 2.0;
+const double srt_heavy_send_loss = 10.0;
+
+std::mutex SrtStatCollector::stats_mutex;
+std::map<int, SrtStat> SrtStatCollector::stats;
+
+SrtStat::SrtStat() {
+    rtt_ms = bandwidth_mbps = send_mbps = recv_mbps = 0;
+    send_loss = recv_loss = retrans = 0;
+    send_buf_ms = send_buf_pkts = 0;
+    send_bytes = recv_bytes = 0;
+    congestion = ECongestionNone;
+    update_at = 0;
+}
+
+SRTServerConn::SRTServerConn(StSrtMode mode) {
+    server_socket = SRT_INVALID_SOCK;
+    this->mode = mode;
 }
 
 SRTServerConn::~SRTServerConn() {
@@ -22,7 +51,7 @@ SRTServerConn::~SRTServerConn() {
 
 int SRTServerConn::listen(const std::string &ip, int port) {
     srt_startup();
-    server_socket = st_srt_create_fd();
+    server_socket = st_srt_create_fd(mode);
     if (server_socket == SRT_INVALID_SOCK) {
         tmss_error("create sock failed fd:{}", server_socket);
         return error_srt_socket_create;
@@ -50,7 +79,11 @@ std::shared_ptr<IClientConn> SRTServerConn::accept() {
         tmss_info("srt accept new connection");
     }
 
-    conn = std::make_shared<SRTStreamConn>(cfd);
+    std::shared_ptr<SRTStreamConn> srt_conn = std::make_shared<SRTStreamConn>(cfd);
+    st_srt_get_streamid(cfd, srt_conn->streamid);
+    tmss_info("srt accept, fd:{}, streamid:{}", cfd, srt_conn->streamid);
+    SrtStatCollector::get_instance()->add(srt_conn);
+    conn = srt_conn;
     return conn;
 }
 
@@ -64,6 +97,7 @@ error_t SRTServerConn::cycle() {
 
 SRTStreamConn::SRTStreamConn(SRTSOCKET client_fd) {
     this->client_socket = client_fd;
+    congested_at = 0;
     if (client_fd) {
         // not null, connected
         is_connected = true;
@@ -94,6 +128,8 @@ int SRTStreamConn::connect(Address address) {
         return ret;
     }
     is_connected = true;
+    SrtStatCollector::get_instance()->add(
+        std::dynamic_pointer_cast<SRTStreamConn>(shared_from_this()));
     return ret;
 }
 
@@ -140,6 +176,40 @@ int SRTStreamConn::read(char* buf, int size) {
     return read_size;
 }
 
+int SRTStreamConn::readv(const iovec *iov, int iov_size) {
+    if (!is_connected) {
+        tmss_info("not connect, id={}", get_id());
+        return error_srt_socket_already_closed;
+    }
+
+    size_t read_size = 0;
+    int ret = st_srt_readv(client_socket, iov, iov_size,
+        (recv_timeout_ms < 0) ? -1 : (utime_t)recv_timeout_ms * 1000, read_size);
+    if (ret == SRT_ERROR) {
+        tmss_error("srt readv error, id{}, ret={}", get_id(), ret);
+        return ret;
+    }
+    return read_size;
+}
+
+int SRTStreamConn::writev(const iovec *iov, int iov_size) {
+    if (!is_connected) {
+        tmss_info("not connect, id={}", get_id());
+        return error_srt_socket_already_closed;
+    }
+
+    size_t write_size = 0;
+    int ret = st_srt_writev(client_socket, iov, iov_size,
+        (send_timeout_ms < 0) ? -1 : (utime_t)send_timeout_ms * 1000, write_size);
+    if (ret == SRT_ERROR) {
+        tmss_error("srt writev error, id{}, ret={}", get_id(), ret);
+        return ret;
+    }
+
+    tmss_info("srt writev complete, id{}, {}, iov_size={}", get_id(), write_size, iov_size);
+    return write_size;
+}
+
 int SRTStreamConn::close() {
     if (!is_connected) {
         tmss_info("already close, id={}", get_id());
@@ -167,4 +237,132 @@ error_t SRTStreamConn::cycle() {
     return error_success;
 }
 
+int SRTStreamConn::get_congestion() {
+    return stat.congestion;
+}
+
+int SRTStreamConn::update_stat() {
+    if (!is_connected) {
+        return error_srt_socket_already_closed;
+    }
+    SRT_TRACEBSTATS perf;
+    // the interval since the last call, the buffer is instantaneous
+    if (srt_bistats(client_socket, &perf, 1, 1) == SRT_ERROR) {
+        tmss_error("srt stats error, id={}, err={}", get_id(), srt_getlasterror_str());
+        return error_srt_socket_other;
+    }
+
+    stat.streamid = streamid;
+    stat.rtt_ms = perf.msRTT;
+    stat.bandwidth_mbps = perf.mbpsBandwidth;
+    stat.send_mbps = perf.mbpsSendRate;
+    stat.recv_mbps = perf.mbpsRecvRate;
+    stat.send_loss = (perf.pktSent > 0) ? perf.pktSndLoss * 100.0 / perf.pktSent : 0;
+    stat.recv_loss = (perf.pktRecv > 0) ? perf.pktRcvLoss * 100.0 / perf.pktRecv : 0;
+    stat.retrans = (perf.pktSent > 0) ? perf.pktRetrans * 100.0 / perf.pktSent : 0;
+    stat.send_buf_ms = perf.msSndBuf;
+    stat.send_buf_pkts = perf.pktSndBuf;
+    stat.send_bytes = perf.byteSentTotal;
+    stat.recv_bytes = perf.byteRecvTotal;
+    stat.update_at = get_cache_time();
+
+    int level = ECongestionNone;
+    if (stat.send_buf_ms >= srt_heavy_send_buf_ms || stat.send_loss >= srt_heavy_send_loss) {
+        level = ECongestionHeavy;
+    } else if (stat.send_buf_ms >= srt_light_send_buf_ms || stat.send_loss >= srt_light_send_loss) {
+        level = ECongestionLight;
+    }
+    if (level >= stat.congestion) {
+        if (level > stat.congestion) {
+            tmss_warn("srt congested, id={}, level={}, send_buf_ms={}, send_loss={}",
+                get_id(), level, stat.send_buf_ms, stat.send_loss);
+        }
+        stat.congestion = level;
+        congested_at = stat.update_at;
+    } else if (stat.update_at - congested_at >= srt_congestion_hold_us) {
+        // one level down each time
+        stat.congestion--;
+        congested_at = stat.update_at;
+        tmss_info("srt congestion falls, id={}, level={}", get_id(), stat.congestion);
+    }
+    return error_success;
+}
+
+SrtStat SRTStreamConn::get_stat() {
+    return stat;
+}
+
+SrtStatCollector::SrtStatCollector() : ICoroutineHandler("srt-stat") {
+}
+
+void SrtStatCollector::add(std::shared_ptr<SRTStreamConn> conn) {
+    conns[conn->get_id()] = conn;
+}
+
+int SrtStatCollector::cycle() {
+    while (true) {
+        st_usleep(srt_stat_interval_us);
+
+        std::map<int, SrtStat> updates;
+        std::vector<int> removes;
+        for (auto it = conns.begin(); it != conns.end(); ) {
+            std::shared_ptr<SRTStreamConn> conn = it->second.lock();
+            if (!conn || conn->update_stat() != error_success) {
+                removes.push_back(it->first);
+                conns.erase(it++);
+                continue;
+            }
+            updates[it->first] = conn->get_stat();
+            it++;
+        }
+
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        for (auto id : removes) {
+            stats.erase(id);
+        }
+        for (auto& update : updates) {
+            stats[update.first] = update.second;
+        }
+    }
+    return error_success;
+}
+
+std::shared_ptr<SrtStatCollector> SrtStatCollector::get_instance() {
+    thread_local std::shared_ptr<SrtStatCollector> ins = nullptr;
+    if (!ins) {
+        ins = std::make_shared<SrtStatCollector>();
+        ins->start();
+    }
+    return ins;
+}
+
+std::string SrtStatCollector::dump_json() {
+    std::stringstream ss;
+    ss << "{\"conns\":[";
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    for (auto it = stats.begin(); it != stats.end(); it++) {
+        const SrtStat& stat = it->second;
+        if (it != stats.begin()) {
+            ss << ",";
+        }
+        ss << "{\"id\":" << it->first
+            << ",\"streamid\":\"" << json_escape(stat.streamid) << "\""
+            << ",\"rtt_ms\":" << stat.rtt_ms
+            << ",\"bandwidth_mbps\":" << stat.bandwidth_mbps
+            << ",\"send_mbps\":" << stat.send_mbps
+            << ",\"recv_mbps\":" << stat.recv_mbps
+            << ",\"send_loss\":" << stat.send_loss
+            << ",\"recv_loss\":" << stat.recv_loss
+            << ",\"retrans\":" << stat.retrans
+            << ",\"send_buf_ms\":" << stat.send_buf_ms
+            << ",\"send_buf_pkts\":" << stat.send_buf_pkts
+            << ",\"send_bytes\":" << stat.send_bytes
+            << ",\"recv_bytes\":" << stat.recv_bytes
+            << ",\"congestion\":" << stat.congestion
+            << "}";
+    }
+    ss << "]}";
+    return ss.str();
+}
+
 }  // namespace tmss
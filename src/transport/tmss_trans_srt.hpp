@@ -10,14 +10,21 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
 #include <net/tmss_conn.hpp>
+#include <coroutine/coroutine.hpp>
 #include "st_trans/st_srt.hpp"
 
 namespace tmss {
 
 class SRTServerConn : virtual public IServerConn {
  public:
-    SRTServerConn();
+    // the accepted sockets inherit the mode of listen socket
+    explicit SRTServerConn(StSrtMode mode = ST_SRT_MODE_GLOBAL);
     ~SRTServerConn();
 
     int listen(const std::string &ip, int port);
@@ -27,6 +34,33 @@ class SRTServerConn : virtual public IServerConn {
 
  private:
     SRTSOCKET server_socket;
+    StSrtMode mode;
+};
+
+/*
+*   the stats of srt socket in the last interval
+*/
+class SrtStat {
+ public:
+    SrtStat();
+
+ public:
+    std::string streamid;
+    double rtt_ms;
+    double bandwidth_mbps;
+    double send_mbps;
+    double recv_mbps;
+    // percent of the packets sent or received
+    double send_loss;
+    double recv_loss;
+    double retrans;
+    // the data not acked in the send buffer
+    int send_buf_ms;
+    int send_buf_pkts;
+    int64_t send_bytes;
+    int64_t recv_bytes;
+    int congestion;
+    utime_t update_at;
 };
 
 class SRTStreamConn : virtual public IClientConn {
@@ -36,12 +70,55 @@ class SRTStreamConn : virtual public IClientConn {
 
     int read(char* buf, int size) override;
     int write(const char* buf, int size) override;
+    int readv(const iovec *iov, int iov_size) override;
+    int writev(const iovec *iov, int iov_size) override;
     int connect(Address address) override;
     int close() override;
+    int get_congestion() override;
     error_t cycle();
 
+    /*
+    *   read the stats of the interval since the last update,
+    *   the congestion rises at once, and falls after it keeps low for a while.
+    */
+    int update_stat();
+    SrtStat get_stat();
+
  public:
     SRTSOCKET client_socket;
     bool    is_connected;
+    // the streamid sent by the peer of accepted socket
+    std::string streamid;
+
+ private:
+    SrtStat stat;
+    // when the congestion is higher than now
+    utime_t congested_at;
+};
+
+/*
+*   update the stats of srt conns on this st thread every second,
+*   the stats of all threads are read by the api.
+*/
+class SrtStatCollector : public ICoroutineHandler {
+ public:
+    SrtStatCollector();
+    virtual ~SrtStatCollector() = default;
+
+ public:
+    void add(std::shared_ptr<SRTStreamConn> conn);
+    int cycle() override;
+
+ public:
+    static std::shared_ptr<SrtStatCollector> get_instance();
+    // the stats of all conns in json, by conn id
+    static std::string dump_json();
+
+ private:
+    std::map<int, std::weak_ptr<SRTStreamConn>> conns;
+
+ private:
+    static std::mutex stats_mutex;
+    static std::map<int, SrtStat> stats;
 };
 }  // namespace tmss
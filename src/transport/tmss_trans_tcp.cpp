@@ -13,7 +13,9 @@
 #include <protocol/server.hpp>
 
 namespace tmss {
-TcpServerConn::TcpServerConn() {
+TcpServerConn::TcpServerConn(bool reuse_port) {
+    server_fd = nullptr;
+    this->reuse_port = reuse_port;
 }
 
 TcpServerConn::~TcpServerConn() {
@@ -21,27 +23,25 @@ TcpServerConn::~TcpServerConn() {
 }
 
 int TcpServerConn::listen(const std::string &ip, int port) {
-    // bind
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        return error_socket_create;
-    }
-    int ret = st_tcp_fd_reuseaddr(sock, 1);
+    // bind and listen
+    int ret = st_tcp_listen(ip, port, 1024, server_fd, reuse_port);
     if (ret != error_success) {
+        tmss_error("tcp listen error, {}:{}, ret={}", ip.c_str(), port, ret);
         return ret;
     }
-    server_fd = st_tcp_open_fd(sock);
-    // listen
-    if ((ret = st_tcp_listen(ip, port,
-            1024, server_fd, ST_UTIME_NO_TIMEOUT)) != error_success) {
-        tmss_error("tcp listen error, {}:{}", ip.c_str(), port);
-        return ret;
-    } else {
-        tmss_info("tcp listen success, {}:{}", ip.c_str(), port);
-    }
+    tmss_info("tcp listen success, {}:{}, reuse_port={}", ip.c_str(), port, reuse_port);
     return ret;
 }
 
+int TcpServerConn::open(int fd) {
+    server_fd = st_tcp_open_fd(fd);
+    if (server_fd == nullptr) {
+        tmss_error("tcp open listen fd error, fd={}", fd);
+        return error_socket_open;
+    }
+    return error_success;
+}
+
 std::shared_ptr<IClientConn> TcpServerConn::accept() {
     sockaddr_in addr {};
     int         addr_len = sizeof(addr);
@@ -63,6 +63,9 @@ std::shared_ptr<IClientConn> TcpServerConn::accept() {
 }
 
 int TcpServerConn::close() {
+    if (server_fd == nullptr) {
+        return error_success;
+    }
     return st_tcp_close(server_fd);
 }
 
@@ -107,6 +110,22 @@ int TcpStreamConn::read(char* buf, int size) {
     return ret;
 }
 
+int TcpStreamConn::readv(const iovec *iov, int iov_size) {
+    if (!is_connected) {
+        tmss_info("not connect, id={}", get_id());
+        return error_socket_already_closed;
+    }
+    int ret = st_tcp_readv(client_fd, iov, iov_size,
+        (recv_timeout_ms < 0) ? -1 : static_cast<utime_t>(recv_timeout_ms) * 1000);
+    if (ret < 0) {
+        tmss_error("tcp read error, id{}, ret={}", get_id(), ret);
+        return ret;
+    }
+    recv_bytes += ret;
+    tmss_info("tcp readv, {}, iov_size={}", ret, iov_size);
+    return ret;
+}
+
 int TcpStreamConn::read_fully(char* buf, int size) {
     int ret = error_success;
 
@@ -152,6 +171,27 @@ int TcpStreamConn::writev(const iovec *iov, int iov_size) {
     return ret;
 }
 
+int TcpStreamConn::sendfile(int in_fd, int64_t offset, int size) {
+    if (!is_connected) {
+        tmss_info("not connect, id={}", get_id());
+        return -1;
+    }
+    int ret = st_tcp_sendfile(client_fd, in_fd, offset, size,
+        (send_timeout_ms < 0) ? -1 : static_cast<utime_t>(send_timeout_ms) * 1000);
+    if (ret < 0) {
+        tmss_error("tcp sendfile error, id{}, errno={}", get_id(), errno);
+        return ret;
+    }
+    if (ret != size) {
+        tmss_error("tcp sendfile not complete, id{}, {}/{}", get_id(), ret, size);
+    }
+
+    tmss_info("tcp sendfile complete, id{}, {}/{}", get_id(), ret, size);
+
+    send_bytes += ret;
+    return ret;
+}
+
 int TcpStreamConn::connect(Address address) {
     int ret = st_tcp_connect(address.get_ip(), address.get_port(),
         (connect_timeout_ms < 0) ? -1 : (utime_t)connect_timeout_ms * 1000,
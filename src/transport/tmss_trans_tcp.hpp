@@ -16,17 +16,24 @@
 namespace tmss {
 class TcpServerConn : virtual public IServerConn {
  public:
-    TcpServerConn();
+    /*
+    *   @param reuse_port bind with SO_REUSEPORT, each thread of a listener group
+    *       listens on its own socket of the same port.
+    */
+    explicit TcpServerConn(bool reuse_port = false);
     ~TcpServerConn();
 
  public:
     int listen(const std::string &ip, int port);
+    // accept on the fd listened by other thread, it is opened on this st thread
+    int open(int fd);
     std::shared_ptr<IClientConn> accept();
     int close();
     error_t cycle();
 
  private:
     st_netfd_t server_fd;
+    bool reuse_port;
 };
 
 class TcpStreamConn : public IClientConn {
@@ -36,9 +43,12 @@ class TcpStreamConn : public IClientConn {
 
  public:
     int read(char* buf, int size) override;
+    int readv(const iovec *iov, int iov_size) override;
     int read_fully(char* buf, int size) override;
     int write(const char* buf, int size) override;
     int writev(const iovec *iov, int iov_size) override;
+    // by sendfile from the page cache, waits on st when the socket is full
+    int sendfile(int in_fd, int64_t offset, int size) override;
     int connect(Address address) override;
     int close() override;
     error_t cycle();
@@ -0,0 +1,483 @@
+/* Copyright [2021] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021.
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+#include <tmss_trans_uring.hpp>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <defs/err.hpp>
+#include <log/log.hpp>
+#include <io/io_buf.hpp>
+#include <protocol/server.hpp>
+#include "st_trans/st_tcp.hpp"
+
+namespace tmss {
+const int uring_back_log = 1024;
+// the accept is armed again after it stops on error, such as too many open files
+const utime_t uring_accept_retry_us = 10 * 1000;
+// the multishot recv needs linux 6.0, one shot recv if not supported
+thread_local bool uring_recv_multishot = true;
+
+static utime_t uring_timeout(int32_t timeout_ms) {
+    return (timeout_ms < 0) ? ST_UTIME_NO_TIMEOUT : static_cast<utime_t>(timeout_ms) * 1000;
+}
+
+UringServerConn::UringServerConn(bool reuse_port) {
+    server_fd = -1;
+    this->reuse_port = reuse_port;
+    uring = StUring::get_instance();
+    accept_op = new StUringAcceptOp();
+}
+
+UringServerConn::~UringServerConn() {
+    close();
+    if (uring) {
+        uring->release(accept_op);
+    } else {
+        delete accept_op;
+    }
+}
+
+int UringServerConn::listen(const std::string &ip, int port) {
+    int ret = st_tcp_listen_fd(ip, port, uring_back_log, server_fd, reuse_port);
+    if (ret != error_success) {
+        tmss_error("uring listen error, {}:{}, ret={}", ip.c_str(), port, ret);
+        return ret;
+    }
+    tmss_info("uring listen success, {}:{}, reuse_port={}", ip.c_str(), port, reuse_port);
+    return ret;
+}
+
+int UringServerConn::open(int fd) {
+    server_fd = fd;
+    return error_success;
+}
+
+int UringServerConn::arm_accept() {
+    io_uring_sqe* sqe = uring ? uring->get_sqe(accept_op) : nullptr;
+    if (sqe == nullptr) {
+        tmss_error("uring accept no sqe, fd={}", server_fd);
+        return error_uring_submit;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server_fd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    uring->submit();
+    return error_success;
+}
+
+std::shared_ptr<IClientConn> UringServerConn::accept() {
+    std::shared_ptr<IClientConn> conn;
+    while (accept_op->fds.empty()) {
+        if (server_fd < 0) {
+            return conn;
+        }
+        if (!accept_op->in_flight) {
+            if (accept_op->err != 0) {
+                tmss_error("uring accept failed, fd={}, errno={}", server_fd, accept_op->err);
+                accept_op->err = 0;
+                st_usleep(uring_accept_retry_us);
+            }
+            if (arm_accept() != error_success) {
+                return conn;
+            }
+        }
+        if (st_cond_wait(accept_op->cond) != 0) {
+            tmss_error("uring accept interrupted, fd={}", server_fd);
+            return conn;
+        }
+    }
+
+    int fd = accept_op->fds.front();
+    accept_op->fds.pop_front();
+    tmss_info("uring accept new connection, fd={}", fd);
+    conn = std::make_shared<UringStreamConn>(fd);
+    return conn;
+}
+
+int UringServerConn::close() {
+    if (server_fd < 0) {
+        return error_success;
+    }
+    if (uring && accept_op->in_flight) {
+        uring->cancel(accept_op);
+    }
+    ::close(server_fd);
+    server_fd = -1;
+    return error_success;
+}
+
+error_t UringServerConn::cycle() {
+    return error_success;
+}
+
+UringStreamConn::UringStreamConn(int fd) {
+    this->fd = fd;
+    is_connected = (fd >= 0);
+    uring = StUring::get_instance();
+    recv_op = nullptr;
+    tmss_info("create new uring conn, id={}", get_id());
+    recv_bytes = send_bytes = 0;
+}
+
+UringStreamConn::~UringStreamConn() {
+    tmss_info("~uring conn, id={}", get_id());
+    close();
+}
+
+int UringStreamConn::arm_recv() {
+    if (recv_op == nullptr) {
+        recv_op = new StUringRecvOp();
+    }
+    io_uring_sqe* sqe = uring ? uring->get_sqe(recv_op) : nullptr;
+    if (sqe == nullptr) {
+        tmss_error("uring recv no sqe, id={}", get_id());
+        errno = EAGAIN;
+        return -1;
+    }
+    // the size of the selected buffer
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = uring->get_buffer_group();
+    recv_op->multishot = uring_recv_multishot;
+    if (recv_op->multishot) {
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    }
+    uring->submit();
+    return 0;
+}
+
+int UringStreamConn::wait_recv() {
+    if (!is_connected) {
+        tmss_info("not connect, id={}", get_id());
+        return error_socket_already_closed;
+    }
+    while (!recv_op || recv_op->data.empty()) {
+        if (recv_op && recv_op->eof) {
+            return 0;
+        }
+        if (recv_op && recv_op->err != 0) {
+            if (recv_op->err == EINVAL && recv_op->multishot) {
+                tmss_warn("uring multishot recv not supported, use one shot recv");
+                uring_recv_multishot = false;
+                recv_op->err = 0;
+            } else {
+                tmss_error("uring recv error, id={}, errno={}", get_id(), recv_op->err);
+                errno = recv_op->err;
+                return -1;
+            }
+        }
+        if ((!recv_op || !recv_op->in_flight) && arm_recv() < 0) {
+            return -1;
+        }
+        // the op may be released by close, not touch it after wake up if closed
+        StUringRecvOp* op = recv_op;
+        int ret = st_cond_timedwait(op->cond, uring_timeout(recv_timeout_ms));
+        if (!is_connected) {
+            errno = EBADF;
+            return -1;
+        }
+        if (ret != 0 && op->data.empty()) {
+            // ETIME or EINTR, the recv keeps armed
+            return -1;
+        }
+    }
+    return recv_op->data.size();
+}
+
+int UringStreamConn::read(char* buf, int size) {
+    int ret = wait_recv();
+    if (ret <= 0) {
+        return ret;
+    }
+    int read_size = recv_op->data.copy_to(buf, size);
+    recv_op->data.pop_front(read_size);
+    recv_bytes += read_size;
+    return read_size;
+}
+
+int UringStreamConn::readv(const iovec *iov, int iov_size) {
+    int ret = wait_recv();
+    if (ret <= 0) {
+        return ret;
+    }
+    int read_size = 0;
+    for (int i = 0; i < iov_size && !recv_op->data.empty(); i++) {
+        int size = recv_op->data.copy_to(static_cast<char*>(iov[i].iov_base),
+            static_cast<int>(iov[i].iov_len));
+        recv_op->data.pop_front(size);
+        read_size += size;
+    }
+    recv_bytes += read_size;
+    return read_size;
+}
+
+int UringStreamConn::read_buf(IOBuf& buf, int size) {
+    int ret = wait_recv();
+    if (ret <= 0) {
+        return ret;
+    }
+    // the received blocks are shared to buf
+    int read_size = recv_op->data.cut(buf, size);
+    recv_bytes += read_size;
+    return read_size;
+}
+
+int UringStreamConn::read_fully(char* buf, int size) {
+    int read_size = 0;
+    while (read_size < size) {
+        int ret = read(buf + read_size, size - read_size);
+        if (ret <= 0) {
+            return (ret == 0) ? error_socket_read : ret;
+        }
+        read_size += ret;
+    }
+    return read_size;
+}
+
+int UringStreamConn::send(const iovec *iov, int iov_size) {
+    StUringOp op;
+    io_uring_sqe* sqe = uring->get_sqe(&op);
+    if (sqe == nullptr) {
+        tmss_error("uring send no sqe, id={}", get_id());
+        errno = EAGAIN;
+        return -1;
+    }
+    // the iovecs of caller are sent, they are valid until the last cqe
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = iov_size;
+
+    int ret = uring->wait(&op, uring_timeout(send_timeout_ms));
+    if (ret != error_success) {
+        tmss_error("uring send timeout, id={}, ret={}", get_id(), ret);
+        return -1;
+    }
+    if (op.res < 0) {
+        errno = -op.res;
+        return -1;
+    }
+    return op.res;
+}
+
+int UringStreamConn::rw_fixed(int opcode, int rw_fd, char* buf, int size, int64_t offset,
+        int index, int32_t timeout_ms) {
+    StUringOp op;
+    io_uring_sqe* sqe = uring->get_sqe(&op);
+    if (sqe == nullptr) {
+        tmss_error("uring rw fixed no sqe, id={}", get_id());
+        errno = EAGAIN;
+        return -1;
+    }
+    sqe->opcode = opcode;
+    sqe->fd = rw_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->buf_index = index;
+
+    int ret = uring->wait(&op, uring_timeout(timeout_ms));
+    if (ret != error_success) {
+        tmss_error("uring rw fixed timeout, id={}, opcode={}, ret={}", get_id(), opcode, ret);
+        return -1;
+    }
+    if (op.res < 0) {
+        errno = -op.res;
+        return -1;
+    }
+    return op.res;
+}
+
+int UringStreamConn::sendfile(int in_fd, int64_t offset, int size) {
+    if (!is_connected || !uring) {
+        tmss_info("not connect, id={}", get_id());
+        return -1;
+    }
+    char* fixed = nullptr;
+    int fixed_size = 0;
+    int index = uring->alloc_fixed(fixed, fixed_size);
+    if (index < 0) {
+        // all are used or not registered, read to a buffer and write it
+        return IClientConn::sendfile(in_fd, offset, size);
+    }
+
+    int sent = 0;
+    while (sent < size) {
+        int wanted = std::min(size - sent, fixed_size);
+        int n = rw_fixed(IORING_OP_READ_FIXED, in_fd, fixed, wanted, offset + sent, index,
+            recv_timeout_ms);
+        if (n <= 0) {
+            tmss_error("uring sendfile read error, id={}, errno={}", get_id(), errno);
+            sent = -1;
+            break;
+        }
+        // the socket has no offset, the short write is sent again
+        int written = 0;
+        while (written < n) {
+            int ret = rw_fixed(IORING_OP_WRITE_FIXED, fd, fixed + written, n - written, 0, index,
+                send_timeout_ms);
+            if (ret <= 0) {
+                tmss_error("uring sendfile write error, id={}, errno={}, {}/{}",
+                    get_id(), errno, sent, size);
+                break;
+            }
+            written += ret;
+        }
+        if (written < n) {
+            sent = -1;
+            break;
+        }
+        sent += n;
+        send_bytes += n;
+    }
+    // the kernel is done with it, wait returns after the last cqe
+    uring->free_fixed(index);
+    return sent;
+}
+
+int UringStreamConn::write(const char* buf, int size) {
+    iovec iov;
+    iov.iov_base = const_cast<char*>(buf);
+    iov.iov_len = size;
+    return writev(&iov, 1);
+}
+
+int UringStreamConn::writev(const iovec *iov, int iov_size) {
+    if (!is_connected || !uring) {
+        tmss_info("not connect, id={}", get_id());
+        return error_socket_already_closed;
+    }
+    int size = 0;
+    for (int i = 0; i < iov_size; i++) {
+        size += iov[i].iov_len;
+    }
+
+    // write all as st_writev, the sent iovecs are skipped at short write
+    std::vector<iovec> iovs(iov, iov + iov_size);
+    int pos = 0;
+    int write_size = 0;
+    while (write_size < size) {
+        int ret = send(&iovs[pos], iov_size - pos);
+        if (ret < 0) {
+            tmss_error("uring write error, id{}, errno={}", get_id(), errno);
+            return ret;
+        }
+        write_size += ret;
+        while (ret > 0 && pos < iov_size) {
+            int skip = std::min(ret, static_cast<int>(iovs[pos].iov_len));
+            iovs[pos].iov_base = static_cast<char*>(iovs[pos].iov_base) + skip;
+            iovs[pos].iov_len -= skip;
+            ret -= skip;
+            if (iovs[pos].iov_len == 0) {
+                pos++;
+            }
+        }
+    }
+
+    tmss_info("uring write complete, id{}, {}", get_id(), write_size);
+    send_bytes += write_size;
+    return write_size;
+}
+
+int UringStreamConn::connect(Address address) {
+    if (!uring) {
+        return error_uring_setup;
+    }
+    std::string ip = dns_resolve(address.get_ip());
+    if (ip.empty()) {
+        tmss_error("uring connect resolve error, id{}, host={}", get_id(), address.get_ip());
+        return error_system_ip_invalid;
+    }
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(address.get_port());
+    addr.sin_addr.s_addr = inet_addr(ip.c_str());
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        tmss_error("uring connect create socket error, id{}, errno={}", get_id(), errno);
+        return error_socket_create;
+    }
+
+    StUringOp op;
+    io_uring_sqe* sqe = uring->get_sqe(&op);
+    int ret = error_uring_submit;
+    if (sqe) {
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&addr);
+        sqe->off = sizeof(addr);
+        ret = uring->wait(&op, uring_timeout(connect_timeout_ms));
+    }
+    if (ret == error_success && op.res < 0) {
+        ret = error_socket_connect;
+    }
+    if (ret != error_success) {
+        tmss_error("uring connect error, id{}, {}, ret={}, res={}",
+            get_id(), address.str(), ret, op.res);
+        ::close(fd);
+        fd = -1;
+        return ret;
+    }
+    is_connected = true;
+    return ret;
+}
+
+int UringStreamConn::close() {
+    if (!is_connected) {
+        tmss_info("already close, id={}", get_id());
+        return error_success;
+    }
+    tmss_info("fd={}, id={}", fd, get_id());
+
+    if (handler.lock()) {
+        handler.lock()->stop();
+        tmss_info("stop_handler,fd={}, id={}", fd, get_id());
+    }
+    is_connected = false;
+    if (recv_op) {
+        // the armed recv holds the socket until canceled
+        StUringRecvOp* op = recv_op;
+        recv_op = nullptr;
+        // wake up the reader, it returns for closed
+        st_cond_signal(op->cond);
+        uring->release(op);
+    }
+    if (::close(fd) != 0) {
+        tmss_error("conn close error, id={}, errno={}", get_id(), errno);
+    }
+    fd = -1;
+    tmss_info("conn close, id={}", get_id());
+    return error_success;
+}
+
+error_t UringStreamConn::cycle() {
+    return error_success;
+}
+
+int64_t UringStreamConn::get_recv_bytes() {
+    return recv_bytes;
+}
+
+int64_t UringStreamConn::get_send_bytes() {
+    return send_bytes;
+}
+
+}  // namespace tmss
@@ -0,0 +1,95 @@
+/* Copyright [2021] <Tencent, China>
+ *
+ * =====================================================================================
+ *        Version:  1.0
+ *        Created:  on 2021.
+ *        Author:  rainwu
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <net/tmss_conn.hpp>
+#include "st_trans/st_uring.hpp"
+
+namespace tmss {
+/*
+*   the tcp listener on io_uring, the connections are accepted by one multishot accept.
+*/
+class UringServerConn : virtual public IServerConn {
+ public:
+    // @param reuse_port as TcpServerConn
+    explicit UringServerConn(bool reuse_port = false);
+    ~UringServerConn();
+
+ public:
+    int listen(const std::string &ip, int port);
+    // accept on the fd listened by other thread
+    int open(int fd);
+    std::shared_ptr<IClientConn> accept();
+    int close();
+    error_t cycle();
+
+ private:
+    int arm_accept();
+
+ private:
+    int server_fd;
+    bool reuse_port;
+    std::shared_ptr<StUring> uring;
+    StUringAcceptOp* accept_op;
+};
+
+/*
+*   the tcp connection on io_uring, instead of the st epoll.
+*   the recv is armed once and receives until the bytes not read reach the high water,
+*   the bytes of provided buffers are copied to the received buf once, read_buf
+*   shares the blocks of it without another copy.
+*/
+class UringStreamConn : public IClientConn {
+ public:
+    // @param fd the connected socket, -1 to connect
+    explicit UringStreamConn(int fd);
+    virtual ~UringStreamConn();
+
+ public:
+    int read(char* buf, int size) override;
+    int readv(const iovec *iov, int iov_size) override;
+    int read_buf(IOBuf& buf, int size) override;
+    int read_fully(char* buf, int size) override;
+    int write(const char* buf, int size) override;
+    int writev(const iovec *iov, int iov_size) override;
+    // read to a registered buffer and send from it, the pages are pinned once
+    int sendfile(int in_fd, int64_t offset, int size) override;
+    int connect(Address address) override;
+    int close() override;
+    error_t cycle();
+
+    virtual int64_t get_recv_bytes() override;
+    virtual int64_t get_send_bytes() override;
+
+ private:
+    int arm_recv();
+    // wait until some bytes are received, return the received size, 0 if eof, -1 if error
+    int wait_recv();
+    // one send of the iovecs, return the sent size
+    int send(const iovec *iov, int iov_size);
+    // one READ_FIXED or WRITE_FIXED of the registered buffer index, return the size
+    int rw_fixed(int opcode, int rw_fd, char* buf, int size, int64_t offset, int index,
+        int32_t timeout_ms);
+
+ private:
+    int     fd;
+    bool    is_connected;
+    std::shared_ptr<StUring> uring;
+    StUringRecvOp* recv_op;
+
+    int64_t recv_bytes;
+    int64_t send_bytes;
+};
+
+}  // namespace tmss